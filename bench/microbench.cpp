@@ -0,0 +1,299 @@
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "microbench.hpp"
+
+#include "net/connection_line_buffer.hpp"
+#include "net/ioqueue.hpp"
+#include "net/socketaddress.hpp"
+#include "test/loopback_connection_client.hpp"
+#include "utils/hexdump.hpp"
+
+/**
+ * Microbenchmarks of the primitives on the hot paths of rmrf::net and
+ * rmrf::utils. `make microbench` compares them with the stored baseline.
+ */
+
+using rmrf::bench::do_not_optimize;
+using rmrf::bench::state;
+
+namespace {
+
+/**
+ * A pipelined SMTP conversation as a client sends it, repeated to size.
+ */
+std::string smtp_commands(size_t size) {
+    static const char *conversation =
+        "MAIL FROM:<alice@example.org> SIZE=12345 BODY=8BITMIME\r\n"
+        "RCPT TO:<bob@example.net>\r\n"
+        "RCPT TO:<carol.smith@mail.example.com> NOTIFY=FAILURE\r\n"
+        "DATA\r\n"
+        "RSET\r\n";
+    std::string text;
+
+    while (text.size() < size) {
+        text += conversation;
+    }
+
+    text.resize(size);
+    return text;
+}
+
+/**
+ * A message body with the usual line length.
+ */
+std::string message_body(size_t size) {
+    std::string text;
+    size_t n = 0;
+
+    while (text.size() < size) {
+        std::string line = "Line " + std::to_string(n++) + " of a message body with some filler text";
+        line.resize(76, 'x');
+        text += line + "\r\n";
+    }
+
+    text.resize(size);
+    return text;
+}
+
+}
+
+static void bm_ioqueue_push_pop(state &st) {
+    // About the size of an SMTP reply
+    const std::string reply(96, 'r');
+    rmrf::net::ioqueue queue;
+
+    while (st.keep_running()) {
+        queue.push_back(rmrf::net::iorecord{reply.data(), reply.size()});
+        rmrf::net::iorecord record = queue.pop_front();
+        do_not_optimize(record);
+    }
+
+    st.set_bytes_processed(st.iterations() * reply.size());
+}
+RMRF_BENCHMARK(bm_ioqueue_push_pop);
+
+static void bm_ioqueue_burst_16x1460(state &st) {
+    const std::string segment(1460, 's');
+    rmrf::net::ioqueue queue;
+
+    while (st.keep_running()) {
+        for (int i = 0; i < 16; i++) {
+            queue.push_back(rmrf::net::iorecord{segment.data(), segment.size()});
+        }
+
+        while (!queue.empty()) {
+            rmrf::net::iorecord record = queue.pop_front();
+            do_not_optimize(record);
+        }
+    }
+
+    st.set_bytes_processed(st.iterations() * 16 * segment.size());
+}
+RMRF_BENCHMARK(bm_ioqueue_burst_16x1460);
+
+static void bm_ioqueue_partial_writes(state &st) {
+    // A large message written out by a socket that takes 4 KiB at a time
+    const std::string message = message_body(64 * 1024);
+    rmrf::net::ioqueue queue;
+
+    while (st.keep_running()) {
+        queue.push_back(rmrf::net::iorecord{message.data(), message.size()});
+
+        while (!queue.empty()) {
+            rmrf::net::iorecord record = queue.pop_front();
+            record.advance(std::min<size_t>(record.size(), 4096));
+
+            if (!record.empty()) {
+                queue.push_front(std::move(record));
+            }
+        }
+    }
+
+    st.set_bytes_processed(st.iterations() * message.size());
+}
+RMRF_BENCHMARK(bm_ioqueue_partial_writes);
+
+static void bm_line_buffer_smtp_commands(state &st) {
+    // Reads of a pipelining client rarely end on a line break
+    const std::string stream = smtp_commands(64 * 1024);
+    std::vector<std::string> chunks;
+
+    for (size_t pos = 0; pos < stream.size(); pos += 1000) {
+        chunks.push_back(stream.substr(pos, 1000));
+    }
+
+    auto client = std::make_shared<rmrf::test::loopback_connection_client>(nullptr);
+    size_t lines = 0;
+    rmrf::net::connection_line_buffer buffer{client, [&lines](const std::string &line, bool complete) {
+        do_not_optimize(line);
+        lines += complete ? 1 : 0;
+    }, 1000};
+
+    while (st.keep_running()) {
+        for (const auto &chunk : chunks) {
+            client->send_data_to_incomming_data_cb(chunk);
+        }
+    }
+
+    do_not_optimize(lines);
+    st.set_bytes_processed(st.iterations() * stream.size());
+}
+RMRF_BENCHMARK(bm_line_buffer_smtp_commands);
+
+static void bm_line_buffer_message_body(state &st) {
+    const std::string body = message_body(64 * 1024);
+    std::vector<std::string> chunks;
+
+    for (size_t pos = 0; pos < body.size(); pos += 16 * 1024) {
+        chunks.push_back(body.substr(pos, 16 * 1024));
+    }
+
+    auto client = std::make_shared<rmrf::test::loopback_connection_client>(nullptr);
+    rmrf::net::connection_line_buffer buffer{client, [](const std::string &line, bool complete) {
+        do_not_optimize(line);
+        do_not_optimize(complete);
+    }, 1000};
+
+    while (st.keep_running()) {
+        for (const auto &chunk : chunks) {
+            client->send_data_to_incomming_data_cb(chunk);
+        }
+    }
+
+    st.set_bytes_processed(st.iterations() * body.size());
+}
+RMRF_BENCHMARK(bm_line_buffer_message_body);
+
+static void bm_default_eol_search_lines(state &st) {
+    const std::string body = message_body(64 * 1024);
+
+    while (st.keep_running()) {
+        std::string::size_type pos = 0;
+
+        while ((pos = rmrf::net::default_eol_search(body, pos)) != std::string::npos) {
+            pos++;
+        }
+    }
+
+    st.set_bytes_processed(st.iterations() * body.size());
+}
+RMRF_BENCHMARK(bm_default_eol_search_lines);
+
+static void bm_default_eol_search_no_break(state &st) {
+    // The worst case: an overlong line, e.g. from a misbehaving client
+    const std::string line(16 * 1024, 'a');
+
+    while (st.keep_running()) {
+        do_not_optimize(rmrf::net::default_eol_search(line, 0));
+    }
+
+    st.set_bytes_processed(st.iterations() * line.size());
+}
+RMRF_BENCHMARK(bm_default_eol_search_no_break);
+
+static void bm_socketaddr_from_accept_v4(state &st) {
+    // What accept() fills in for a client connecting via IPv4
+    sockaddr_storage storage = {};
+    sockaddr_in *in4 = reinterpret_cast<sockaddr_in *>(&storage);
+    in4->sin_family = AF_INET;
+    in4->sin_port = htons(50123);
+    in4->sin_addr.s_addr = htonl(0xc0000201);
+
+    while (st.keep_running()) {
+        const rmrf::net::socketaddr peer{&storage, sizeof(sockaddr_in)};
+        do_not_optimize(peer);
+    }
+}
+RMRF_BENCHMARK(bm_socketaddr_from_accept_v4);
+
+static void bm_socketaddr_from_sockaddr_in6(state &st) {
+    sockaddr_in6 in6 = {};
+    in6.sin6_family = AF_INET6;
+    in6.sin6_port = htons(25);
+    in6.sin6_addr.s6_addr[0] = 0x20;
+    in6.sin6_addr.s6_addr[1] = 0x01;
+    in6.sin6_addr.s6_addr[2] = 0x0d;
+    in6.sin6_addr.s6_addr[3] = 0xb8;
+    in6.sin6_addr.s6_addr[15] = 0x25;
+
+    while (st.keep_running()) {
+        const rmrf::net::socketaddr peer{in6};
+        do_not_optimize(peer);
+    }
+}
+RMRF_BENCHMARK(bm_socketaddr_from_sockaddr_in6);
+
+static void bm_socketaddr_unix_path(state &st) {
+    const std::string path = "/run/mumta/lmtp";
+
+    while (st.keep_running()) {
+        const rmrf::net::socketaddr address = rmrf::net::socketaddr::unix_path(path);
+        do_not_optimize(address);
+    }
+}
+RMRF_BENCHMARK(bm_socketaddr_unix_path);
+
+static void bm_socketaddr_str_v6(state &st) {
+    // Formatting happens whenever a peer is logged
+    sockaddr_in6 in6 = {};
+    in6.sin6_family = AF_INET6;
+    in6.sin6_port = htons(25);
+    in6.sin6_addr.s6_addr[0] = 0x20;
+    in6.sin6_addr.s6_addr[1] = 0x01;
+    in6.sin6_addr.s6_addr[2] = 0x0d;
+    in6.sin6_addr.s6_addr[3] = 0xb8;
+    in6.sin6_addr.s6_addr[15] = 0x25;
+    const rmrf::net::socketaddr peer{in6};
+
+    while (st.keep_running()) {
+        do_not_optimize(peer.str());
+    }
+}
+RMRF_BENCHMARK(bm_socketaddr_str_v6);
+
+static void bm_hexdump_to_string_4k(state &st) {
+    std::vector<uint8_t> data(4096);
+
+    for (size_t i = 0; i < data.size(); i++) {
+        data[i] = static_cast<uint8_t>(i * 131 + 7);
+    }
+
+    while (st.keep_running()) {
+        do_not_optimize(rmrf::utils::hexdump_to_string(16, 8, 1, 1, 0, static_cast<off_t>(data.size()), 0,
+            true, false, data.data(), data.size()));
+    }
+
+    st.set_bytes_processed(st.iterations() * data.size());
+}
+RMRF_BENCHMARK(bm_hexdump_to_string_4k);
+
+static void bm_hexdump_to_buffer_4k(state &st) {
+    // The reusable output buffer, as used by the hex viewer
+    std::vector<uint8_t> data(4096);
+
+    for (size_t i = 0; i < data.size(); i++) {
+        data[i] = static_cast<uint8_t>(i * 131 + 7);
+    }
+
+    const rmrf::utils::hexdump_getspan_t get_span = rmrf::utils::make_getspan_t(data.data(), data.size());
+    std::string out;
+
+    while (st.keep_running()) {
+        rmrf::utils::hexdump_to_buffer(out, 16, 8, 1, 1, 0, static_cast<off_t>(data.size()), 0, true, false, get_span);
+        do_not_optimize(out);
+    }
+
+    st.set_bytes_processed(st.iterations() * data.size());
+}
+RMRF_BENCHMARK(bm_hexdump_to_buffer_4k);
+
+int main(int argc, char **argv) {
+    return rmrf::bench::run(argc, argv);
+}
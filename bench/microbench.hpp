@@ -0,0 +1,325 @@
+#pragma once
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "macros.hpp"
+
+/**
+ * A small harness for microbenchmarks in the spirit of Google Benchmark:
+ *
+ *     static void bm_something(rmrf::bench::state &st) {
+ *         setup();
+ *
+ *         while (st.keep_running()) {
+ *             rmrf::bench::do_not_optimize(something());
+ *         }
+ *
+ *         st.set_bytes_processed(st.iterations() * size);
+ *     }
+ *     RMRF_BENCHMARK(bm_something);
+ *
+ * Only the loop is timed. Every benchmark is calibrated to run for a
+ * minimum time and then repeated; the fastest time per iteration counts,
+ * as noise only ever makes a run slower. Results can be written as
+ * baseline and later runs compared against it. Baselines only hold for the
+ * machine and build flags they were recorded with.
+ */
+
+namespace rmrf::bench {
+
+/**
+ * Benchmarks faster than this in ns are dominated by timer and pipeline
+ * noise, so they get short_tolerance_factor times the tolerance.
+ */
+constexpr double short_benchmark_ns = 100;
+constexpr double short_tolerance_factor = 3;
+
+/**
+ * How often a benchmark slower than the baseline is measured again before
+ * it counts as regression.
+ */
+constexpr unsigned regression_retries = 2;
+
+class state {
+private:
+    const uint64_t target;
+    uint64_t done;
+    uint64_t bytes;
+    std::chrono::steady_clock::time_point started;
+    std::chrono::steady_clock::duration elapsed;
+
+public:
+    explicit state(uint64_t iterations_) :
+        target{iterations_}, done{0}, bytes{0}, started{}, elapsed{}
+    {
+        // NOP
+    }
+
+    inline bool keep_running() {
+        if (this->done == 0) {
+            this->started = std::chrono::steady_clock::now();
+        }
+
+        if (this->done < this->target) {
+            this->done++;
+            return true;
+        }
+
+        this->elapsed = std::chrono::steady_clock::now() - this->started;
+        return false;
+    }
+
+    uint64_t iterations() const {
+        return this->target;
+    }
+
+    void set_bytes_processed(uint64_t bytes_) {
+        this->bytes = bytes_;
+    }
+
+    uint64_t get_bytes_processed() const {
+        return this->bytes;
+    }
+
+    double get_seconds() const {
+        return std::chrono::duration<double>(this->elapsed).count();
+    }
+};
+
+typedef std::function<void(state &)> benchmark_fn;
+
+/**
+ * Keep the compiler from optimising away the computation of a value.
+ */
+template<typename T>
+inline void do_not_optimize(const T &value) {
+    asm volatile("" : : "g"(&value) : "memory");
+}
+
+inline std::vector<std::pair<std::string, benchmark_fn>> &registry() {
+    static std::vector<std::pair<std::string, benchmark_fn>> benchmarks;
+    return benchmarks;
+}
+
+inline int register_benchmark(const char *name, benchmark_fn fn) {
+    registry().emplace_back(name, std::move(fn));
+    return 0;
+}
+
+#define RMRF_BENCHMARK(fn) \
+    static const int rmrf_benchmark_##fn ATTR_UNUSED = ::rmrf::bench::register_benchmark(#fn, fn)
+
+struct result {
+    double ns_per_op;
+    double bytes_per_second;
+};
+
+/**
+ * Run a benchmark until it takes at least min_seconds, then the given
+ * number of times more with that iteration count. The fastest of these
+ * runs is returned.
+ */
+inline result measure(const benchmark_fn &fn, double min_seconds, unsigned repetitions) {
+    uint64_t iterations = 1;
+
+    for (;;) {
+        state st{iterations};
+        fn(st);
+
+        const double seconds = st.get_seconds();
+
+        if (seconds >= min_seconds || iterations >= (uint64_t{1} << 40)) {
+            break;
+        }
+
+        // Aim a bit beyond the minimum, but grow by at most 100x per step
+        const double factor = seconds > 0 ? min_seconds * 1.4 / seconds : 100;
+        iterations = std::max(iterations + 1, static_cast<uint64_t>(static_cast<double>(iterations) * std::min(factor, 100.0)));
+    }
+
+    result best{0, 0};
+
+    for (unsigned i = 0; i < repetitions; i++) {
+        state st{iterations};
+        fn(st);
+
+        const double seconds = st.get_seconds();
+        const result r{seconds * 1e9 / static_cast<double>(iterations),
+            seconds > 0 ? static_cast<double>(st.get_bytes_processed()) / seconds : 0};
+
+        if (i == 0 || r.ns_per_op < best.ns_per_op) {
+            best = r;
+        }
+    }
+
+    return best;
+}
+
+/**
+ * The slowdown against a baseline tolerated for a benchmark.
+ */
+inline double tolerance_for(double baseline_ns, double tolerance) {
+    return baseline_ns < short_benchmark_ns ? tolerance * short_tolerance_factor : tolerance;
+}
+
+/**
+ * Baselines are lines of a benchmark name and its time per iteration in
+ * nanoseconds. Lines starting with # are comments.
+ */
+inline std::map<std::string, double> read_baseline(const std::string &path) {
+    std::map<std::string, double> baseline;
+    std::ifstream in{path};
+    std::string line;
+
+    while (std::getline(in, line)) {
+        std::istringstream fields{line};
+        std::string name;
+        double ns = 0;
+
+        if (line.empty() || line.front() == '#' || !(fields >> name >> ns)) {
+            continue;
+        }
+
+        baseline[name] = ns;
+    }
+
+    return baseline;
+}
+
+inline void usage(const char *self) {
+    std::cerr << "Usage: " << self << " [-f FILTER] [-m MIN_SECONDS] [-r REPETITIONS] [-b BASELINE [-t TOLERANCE]] [-w BASELINE]\n"
+        "\n"
+        "  -f  only run benchmarks whose name contains FILTER\n"
+        "  -m  minimum time per measurement (0.2)\n"
+        "  -r  measurements per benchmark, the fastest is reported (5)\n"
+        "  -b  compare with this baseline and fail on regressions\n"
+        "  -t  slowdown against the baseline tolerated, as a fraction (0.2);\n"
+        "      tripled for benchmarks below 100 ns\n"
+        "  -w  write the results as new baseline\n"
+        "\n"
+        "Baselines only hold for the machine and build flags they were recorded\n"
+        "with; record a new one with -w before comparing elsewhere." << std::endl;
+}
+
+inline int run(int argc, char **argv) {
+    std::string filter;
+    std::string baseline_path;
+    std::string output_path;
+    double min_seconds = 0.2;
+    double tolerance = 0.2;
+    unsigned repetitions = 5;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "f:m:r:b:t:w:h")) != -1) {
+        switch (opt) {
+        case 'f':
+            filter = optarg;
+            break;
+        case 'm':
+            min_seconds = std::strtod(optarg, nullptr);
+            break;
+        case 'r':
+            repetitions = std::max(1u, static_cast<unsigned>(std::strtoul(optarg, nullptr, 10)));
+            break;
+        case 'b':
+            baseline_path = optarg;
+            break;
+        case 't':
+            tolerance = std::strtod(optarg, nullptr);
+            break;
+        case 'w':
+            output_path = optarg;
+            break;
+        default:
+            usage(argv[0]);
+            return 2;
+        }
+    }
+
+    const std::map<std::string, double> baseline =
+        baseline_path.empty() ? std::map<std::string, double>{} : read_baseline(baseline_path);
+    std::ostringstream output;
+    size_t regressions = 0;
+
+    output << "# Time per iteration in ns, written by " << argv[0] << "\n"
+        "# Only valid for the machine and build flags it was recorded with\n";
+    output.setf(std::ios::fixed);
+    output.precision(2);
+    std::printf("%-36s %12s %12s %12s %8s\n", "benchmark", "ns/op", "MB/s", "baseline", "change");
+
+    for (const auto &[name, fn] : registry()) {
+        if (name.find(filter) == std::string::npos) {
+            continue;
+        }
+
+        result r = measure(fn, min_seconds, repetitions);
+        char throughput[32] = "-";
+        char reference[32] = "-";
+        char change[32] = "";
+
+        if (r.bytes_per_second > 0) {
+            std::snprintf(throughput, sizeof(throughput), "%.1f", r.bytes_per_second / 1e6);
+        }
+
+        auto it = baseline.find(name);
+
+        if (it != baseline.end() && it->second > 0) {
+            const double allowed = tolerance_for(it->second, tolerance);
+
+            // A single slow measurement is more likely noise than a regression
+            for (unsigned i = 0; i < regression_retries && r.ns_per_op / it->second - 1 > allowed; i++) {
+                const result again = measure(fn, min_seconds, repetitions);
+
+                if (again.ns_per_op < r.ns_per_op) {
+                    r = again;
+                }
+            }
+
+            const double ratio = r.ns_per_op / it->second - 1;
+            const bool regressed = ratio > allowed;
+
+            std::snprintf(reference, sizeof(reference), "%.2f", it->second);
+            std::snprintf(change, sizeof(change), "%+.1f%%%s", ratio * 100, regressed ? " !" : "");
+            regressions += regressed ? 1 : 0;
+        }
+
+        std::printf("%-36s %12.2f %12s %12s %8s\n", name.c_str(), r.ns_per_op, throughput, reference, change);
+        std::fflush(stdout);
+
+        output << name << " " << r.ns_per_op << "\n";
+    }
+
+    if (!output_path.empty()) {
+        std::ofstream out{output_path, std::ios::out | std::ios::trunc};
+        out << output.str();
+
+        if (!out) {
+            std::cerr << "Failed to write baseline " << output_path << std::endl;
+            return 1;
+        }
+    }
+
+    if (regressions) {
+        std::cerr << regressions << " benchmark(s) slower than the baseline by more than "
+            << tolerance * 100 << "% (" << tolerance * short_tolerance_factor * 100 << "% below "
+            << short_benchmark_ns << " ns)" << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
+
+}
@@ -0,0 +1,738 @@
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <ev++.h>
+
+#include "macros.hpp"
+#include "net/netio_exception.hpp"
+#include "net/socketaddress.hpp"
+#include "net/tcp_client.hpp"
+#include "service/metrics.hpp"
+#include "smtp/smtp_client.hpp"
+
+/**
+ * Keeps many concurrent LMTP (or SMTP) sessions busy delivering messages
+ * to a local server and reports throughput, latency and CPU time spent per
+ * message. `make bench` runs it against a scratch mumta instance.
+ *
+ * The latency of a message is the time from sending MAIL FROM until the
+ * last reply to the message data arrived.
+ */
+
+using rmrf::smtp::smtp_reply;
+
+static void usage(const char *self) {
+    std::cerr << "Usage: " << self << " -a unix:PATH|unix:@NAME|tcp:ADDRESS:PORT [-c SESSIONS] [-t THREADS]\n"
+        "    [-n MESSAGES] [-s SIZE|uniform:MIN:MAX|lognormal:MEDIAN:SIGMA] [-r RECIPIENTS] [-P] [-S] [-p SERVER_PID]\n"
+        "\n"
+        "  -c  concurrent sessions (1000)\n"
+        "  -t  threads generating load (all CPUs)\n"
+        "  -n  messages to deliver in total (100000)\n"
+        "  -s  message sizes in bytes (lognormal:8192:1)\n"
+        "  -r  recipients per message (1)\n"
+        "  -P  send MAIL, RCPT and DATA in one go as with PIPELINING\n"
+        "  -S  speak SMTP instead of LMTP\n"
+        "  -p  also report the CPU time of this server process" << std::endl;
+}
+
+struct size_distribution {
+    enum class kind : uint8_t {
+        fixed,
+        uniform,
+        lognormal
+    };
+
+    kind type;
+    double a;
+    double b;
+
+    size_t draw(std::mt19937_64 &rng) const {
+        double size = this->a;
+
+        switch (this->type) {
+        case kind::fixed:
+            break;
+        case kind::uniform:
+            size = std::uniform_real_distribution<double>{this->a, this->b}(rng);
+            break;
+        case kind::lognormal:
+            size = std::lognormal_distribution<double>{std::log(this->a), this->b}(rng);
+            break;
+        default:
+            break;
+        }
+
+        // Messages larger than this are not what a throughput test is about
+        return static_cast<size_t>(std::clamp(size, 0.0, 64.0 * 1024 * 1024));
+    }
+};
+
+struct options {
+    rmrf::net::socketaddr target;
+    size_t sessions;
+    size_t threads;
+    uint64_t messages;
+    size_distribution sizes;
+    size_t recipients;
+    bool pipelining;
+    bool lmtp;
+    pid_t server_pid;
+};
+
+static rmrf::net::socketaddr parse_address(const std::string &spec) {
+    if (spec.rfind("unix:", 0) == 0) {
+        const std::string path = spec.substr(5);
+
+        if (path.size() > 1 && path.front() == '@') {
+            return rmrf::net::socketaddr::unix_abstract(path.substr(1));
+        }
+
+        return rmrf::net::socketaddr::unix_path(path);
+    }
+
+    const size_t colon = spec.rfind(':');
+
+    if (spec.rfind("tcp:", 0) == 0 && colon > 4) {
+        std::string host = spec.substr(4, colon - 4);
+        const long port = std::strtol(spec.c_str() + colon + 1, nullptr, 10);
+
+        if (host.size() > 2 && host.front() == '[' && host.back() == ']') {
+            host = host.substr(1, host.size() - 2);
+        }
+
+        if (port > 0 && port <= 65535) {
+            sockaddr_in addr4 = {};
+            sockaddr_in6 addr6 = {};
+
+            if (inet_pton(AF_INET, host.c_str(), &addr4.sin_addr) == 1) {
+                addr4.sin_family = AF_INET;
+                addr4.sin_port = htons(static_cast<uint16_t>(port));
+                return rmrf::net::socketaddr{addr4};
+            }
+
+            if (inet_pton(AF_INET6, host.c_str(), &addr6.sin6_addr) == 1) {
+                addr6.sin6_family = AF_INET6;
+                addr6.sin6_port = htons(static_cast<uint16_t>(port));
+                return rmrf::net::socketaddr{addr6};
+            }
+        }
+    }
+
+    throw rmrf::net::netio_exception("Invalid address " + spec);
+}
+
+static size_distribution parse_sizes(const std::string &spec) {
+    size_distribution dist{size_distribution::kind::fixed, 0, 0};
+    std::string params = spec;
+
+    if (spec.rfind("uniform:", 0) == 0) {
+        dist.type = size_distribution::kind::uniform;
+        params = spec.substr(8);
+    } else if (spec.rfind("lognormal:", 0) == 0) {
+        dist.type = size_distribution::kind::lognormal;
+        params = spec.substr(10);
+    }
+
+    char *end = nullptr;
+    dist.a = std::strtod(params.c_str(), &end);
+
+    if (dist.type != size_distribution::kind::fixed) {
+        if (*end != ':') {
+            throw std::invalid_argument("Invalid size distribution " + spec);
+        }
+
+        dist.b = std::strtod(end + 1, &end);
+    }
+
+    if (*end || dist.a < 0 || dist.b < 0 || (dist.type == size_distribution::kind::lognormal && dist.a <= 0)) {
+        throw std::invalid_argument("Invalid size distribution " + spec);
+    }
+
+    return dist;
+}
+
+/**
+ * What all threads share: the messages left to start and the results.
+ */
+struct totals {
+    std::atomic<int64_t> remaining;
+    std::atomic<uint64_t> delivered;
+    std::atomic<uint64_t> failed;
+    std::atomic<uint64_t> bytes;
+    std::atomic<uint64_t> lost_sessions;
+    rmrf::metrics::histogram latency;
+
+    explicit totals(uint64_t messages) :
+        remaining{static_cast<int64_t>(messages)}, delivered{0}, failed{0}, bytes{0}, lost_sessions{0}, latency{}
+    {
+        // NOP
+    }
+
+    bool take_message() {
+        return this->remaining.fetch_sub(1, std::memory_order_relaxed) > 0;
+    }
+};
+
+class worker;
+
+/**
+ * A single session, delivering one message after the other.
+ */
+class session {
+private:
+    enum class stage : uint8_t {
+        greeting,
+        hello,
+        envelope,
+        data,
+        reset,
+        quit,
+        done
+    };
+
+    worker &owner;
+    std::shared_ptr<rmrf::net::tcp_client> conn;
+    rmrf::smtp::smtp_reply_parser parser;
+
+    stage current;
+    /** Commands held back until the previous reply arrived, without pipelining */
+    std::vector<std::string> lockstep;
+    size_t next_command;
+    size_t pending;
+    size_t accepted;
+    bool transaction_failed;
+    uint64_t started;
+
+public:
+    session(worker &owner_, const rmrf::net::socketaddr &target, ::ev::loop_ref loop);
+
+    session(const session &) = delete;
+    session &operator=(const session &) = delete;
+
+    bool is_done() const {
+        return this->current == stage::done;
+    }
+
+private:
+    void handle_reply(const smtp_reply &reply);
+    void start_transaction();
+    void send_message();
+    void finish_transaction();
+    void send(const std::string &command, size_t replies);
+    void finish();
+};
+
+class worker {
+private:
+    const options &opts;
+    totals &results;
+    ::ev::dynamic_loop loop;
+    ::ev::timer opener;
+    ::ev::idle reaper;
+
+    std::unordered_map<session *, std::unique_ptr<session>> sessions;
+    size_t to_open;
+    ::ev::tstamp failing_since;
+
+    std::mt19937_64 rng;
+    std::string filler;
+    uint64_t message_counter;
+
+    std::thread thread;
+
+public:
+    worker(const options &opts_, totals &results_, size_t sessions_, uint64_t seed);
+    ~worker();
+
+    worker(const worker &) = delete;
+    worker &operator=(const worker &) = delete;
+
+    void start();
+    void join();
+
+    const options &get_options() const {
+        return this->opts;
+    }
+
+    totals &get_results() {
+        return this->results;
+    }
+
+    std::string make_message(const std::string &recipient);
+    void session_done();
+
+private:
+    void cb_open(::ev::timer &w, int events);
+    void cb_reap(::ev::idle &w, int events);
+};
+
+session::session(worker &owner_, const rmrf::net::socketaddr &target, ::ev::loop_ref loop) :
+    owner{owner_},
+    conn{std::make_shared<rmrf::net::tcp_client>(target, loop)},
+    parser{std::bind(&session::handle_reply, this, std::placeholders::_1)},
+    current{stage::greeting}, lockstep{}, next_command{0},
+    pending{1}, accepted{0}, transaction_failed{false}, started{0}
+{
+    this->conn->set_incomming_data_callback([this](const std::string &data) {
+        this->parser.feed(data);
+    });
+    this->conn->set_closed_callback([this]() {
+        if (this->current != stage::quit && this->current != stage::done) {
+            this->owner.get_results().lost_sessions.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        this->finish();
+    });
+}
+
+void session::send(const std::string &command, size_t replies) {
+    this->pending = replies;
+    this->conn->write_data(command);
+}
+
+void session::handle_reply(const smtp_reply &reply) {
+    if (this->current == stage::done || !this->pending) {
+        return;
+    }
+
+    this->pending--;
+    const options &opts = this->owner.get_options();
+
+    switch (this->current) {
+    case stage::greeting:
+        if (reply.code != 220) {
+            this->finish();
+            return;
+        }
+
+        this->current = stage::hello;
+        this->send(std::string(opts.lmtp ? "LHLO" : "EHLO") + " bench.invalid\r\n", 1);
+        break;
+    case stage::hello:
+        if (!reply.positive()) {
+            this->finish();
+            return;
+        }
+
+        this->start_transaction();
+        break;
+    case stage::envelope: {
+        // Replies come in order: MAIL FROM, one per recipient, then DATA
+        const size_t index = this->lockstep.size() - this->pending - 1;
+
+        if (index + 1 == this->lockstep.size()) {
+            if (reply.code == 354) {
+                this->send_message();
+            } else {
+                this->transaction_failed = true;
+                this->finish_transaction();
+            }
+
+            break;
+        }
+
+        // A rejected recipient only counts once no recipient is left for DATA
+        if (index == 0 && !reply.positive()) {
+            this->transaction_failed = true;
+        } else if (index > 0 && reply.positive()) {
+            this->accepted++;
+        }
+
+        if (this->next_command < this->lockstep.size()) {
+            const size_t left = this->pending;
+            this->send(this->lockstep[this->next_command++], left);
+        }
+
+        break;
+    }
+    case stage::data:
+        if (!reply.positive()) {
+            this->transaction_failed = true;
+        }
+
+        if (this->pending == 0) {
+            this->finish_transaction();
+        }
+
+        break;
+    case stage::reset:
+        this->start_transaction();
+        break;
+    case stage::quit:
+        this->finish();
+        break;
+    case stage::done:
+        break;
+    default:
+        break;
+    }
+}
+
+void session::start_transaction() {
+    if (!this->owner.get_results().take_message()) {
+        this->current = stage::quit;
+        this->send("QUIT\r\n", 1);
+        return;
+    }
+
+    const options &opts = this->owner.get_options();
+
+    this->current = stage::envelope;
+    this->accepted = 0;
+    this->transaction_failed = false;
+    this->started = rmrf::metrics::now_ns();
+
+    this->lockstep.clear();
+    this->lockstep.push_back("MAIL FROM:<load@bench.invalid>\r\n");
+
+    for (size_t i = 0; i < opts.recipients; i++) {
+        this->lockstep.push_back("RCPT TO:<rcpt" + std::to_string(i) + "@bench.invalid>\r\n");
+    }
+
+    this->lockstep.push_back("DATA\r\n");
+
+    if (opts.pipelining) {
+        std::string batch;
+
+        for (const std::string &command : this->lockstep) {
+            batch += command;
+        }
+
+        this->next_command = this->lockstep.size();
+        this->send(batch, this->lockstep.size());
+    } else {
+        this->next_command = 1;
+        this->send(this->lockstep.front(), this->lockstep.size());
+    }
+}
+
+void session::send_message() {
+    const options &opts = this->owner.get_options();
+    std::string message = this->owner.make_message("rcpt0@bench.invalid");
+
+    this->owner.get_results().bytes.fetch_add(message.size(), std::memory_order_relaxed);
+    this->current = stage::data;
+
+    // LMTP answers for every recipient that was accepted
+    this->send(message, opts.lmtp ? std::max<size_t>(this->accepted, 1) : 1);
+}
+
+void session::finish_transaction() {
+    totals &results = this->owner.get_results();
+
+    if (this->transaction_failed) {
+        results.failed.fetch_add(1, std::memory_order_relaxed);
+    } else {
+        results.delivered.fetch_add(1, std::memory_order_relaxed);
+        results.latency.record_since(this->started);
+    }
+
+    if (this->current == stage::envelope) {
+        // Start over cleanly after a rejected envelope
+        this->current = stage::reset;
+        this->send("RSET\r\n", 1);
+        return;
+    }
+
+    this->start_transaction();
+}
+
+void session::finish() {
+    if (this->current == stage::done) {
+        return;
+    }
+
+    this->current = stage::done;
+    this->owner.session_done();
+}
+
+worker::worker(const options &opts_, totals &results_, size_t sessions_, uint64_t seed) :
+    opts{opts_}, results{results_}, loop{}, opener{loop}, reaper{loop},
+    sessions{}, to_open{sessions_}, failing_since{0},
+    rng{seed}, filler{}, message_counter{0},
+    thread{}
+{
+    this->opener.set<worker, &worker::cb_open>(this);
+    this->reaper.set<worker, &worker::cb_reap>(this);
+}
+
+worker::~worker() {
+    this->join();
+    this->opener.stop();
+    this->reaper.stop();
+    this->sessions.clear();
+}
+
+void worker::start() {
+    this->thread = std::thread([this]() {
+        this->opener.start(0, 0.001);
+        this->loop.run(0);
+    });
+}
+
+void worker::join() {
+    if (this->thread.joinable()) {
+        this->thread.join();
+    }
+}
+
+std::string worker::make_message(const std::string &recipient) {
+    const size_t size = this->opts.sizes.draw(this->rng);
+
+    std::string message =
+        "From: <load@bench.invalid>\r\n"
+        "To: <" + recipient + ">\r\n"
+        "Subject: Load test " + std::to_string(++this->message_counter) + "\r\n"
+        "\r\n";
+
+    // Lines of 78 characters, as typical for mail bodies, none starting with a dot
+    while (this->filler.size() < size) {
+        this->filler.append(78, 'x');
+        this->filler += "\r\n";
+    }
+
+    const size_t body = size > message.size() ? size - message.size() : 0;
+    message.append(this->filler, 0, body - body % 80);
+    message += ".\r\n";
+
+    return message;
+}
+
+void worker::session_done() {
+    this->reaper.start();
+}
+
+void worker::cb_open(::ev::timer &w, int events) {
+    MARK_UNUSED(events);
+
+    while (this->to_open) {
+        try {
+            auto s = std::make_unique<session>(*this, this->opts.target, this->loop);
+            session *raw = s.get();
+            this->sessions.emplace(raw, std::move(s));
+            this->to_open--;
+            this->failing_since = 0;
+        } catch (const rmrf::net::netio_exception &e) {
+            // Usually a full listen backlog; the server catches up in a moment
+            const ::ev::tstamp now = ::ev::now(this->loop);
+
+            if (this->failing_since <= 0) {
+                this->failing_since = now;
+            } else if (now - this->failing_since > 10) {
+                std::cerr << "Giving up connecting: " << e.what() << std::endl;
+                this->results.lost_sessions.fetch_add(this->to_open, std::memory_order_relaxed);
+                this->to_open = 0;
+                this->reaper.start();
+            }
+
+            return;
+        }
+    }
+
+    w.stop();
+}
+
+void worker::cb_reap(::ev::idle &w, int events) {
+    MARK_UNUSED(events);
+    w.stop();
+
+    for (auto it = this->sessions.begin(); it != this->sessions.end();) {
+        if (it->second->is_done()) {
+            it = this->sessions.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    if (this->sessions.empty() && !this->to_open) {
+        this->loop.break_loop(::ev::ALL);
+    }
+}
+
+/**
+ * User and system time of a process in seconds.
+ */
+static double process_cpu_time(pid_t pid) {
+    if (pid == 0) {
+        rusage usage = {};
+        getrusage(RUSAGE_SELF, &usage);
+        return static_cast<double>(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) +
+            static_cast<double>(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+    }
+
+    std::ifstream stat{"/proc/" + std::to_string(pid) + "/stat"};
+    std::string line;
+
+    if (!std::getline(stat, line) || line.rfind(')') == std::string::npos) {
+        return -1;
+    }
+
+    // The fields after the command name; utime and stime are the 12th and 13th
+    std::istringstream fields{line.substr(line.rfind(')') + 2)};
+    std::string field;
+    unsigned long long utime = 0;
+    unsigned long long stime = 0;
+
+    for (int i = 1; i <= 13 && fields >> field; i++) {
+        if (i == 12) {
+            utime = std::stoull(field);
+        } else if (i == 13) {
+            stime = std::stoull(field);
+        }
+    }
+
+    return static_cast<double>(utime + stime) / static_cast<double>(sysconf(_SC_CLK_TCK));
+}
+
+static double quantile(const std::array<uint64_t, rmrf::metrics::histogram::bucket_count> &buckets,
+    uint64_t count, double q)
+{
+    const uint64_t rank = static_cast<uint64_t>(std::ceil(q * static_cast<double>(count)));
+    uint64_t seen = 0;
+
+    for (size_t i = 0; i < buckets.size(); i++) {
+        seen += buckets[i];
+
+        if (seen >= rank && seen) {
+            return static_cast<double>(rmrf::metrics::histogram::upper_bound(i)) / 1e6;
+        }
+    }
+
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    options opts{rmrf::net::socketaddr{}, 1000, std::max(1u, std::thread::hardware_concurrency()), 100000,
+        size_distribution{size_distribution::kind::lognormal, 8192, 1}, 1, false, true, 0};
+    bool have_target = false;
+    int opt;
+
+    try {
+        while ((opt = getopt(argc, argv, "a:c:t:n:s:r:PSp:h")) != -1) {
+            switch (opt) {
+            case 'a':
+                opts.target = parse_address(optarg);
+                have_target = true;
+                break;
+            case 'c':
+                opts.sessions = std::stoul(optarg);
+                break;
+            case 't':
+                opts.threads = std::stoul(optarg);
+                break;
+            case 'n':
+                opts.messages = std::stoull(optarg);
+                break;
+            case 's':
+                opts.sizes = parse_sizes(optarg);
+                break;
+            case 'r':
+                opts.recipients = std::stoul(optarg);
+                break;
+            case 'P':
+                opts.pipelining = true;
+                break;
+            case 'S':
+                opts.lmtp = false;
+                break;
+            case 'p':
+                opts.server_pid = static_cast<pid_t>(std::stol(optarg));
+                break;
+            default:
+                usage(argv[0]);
+                return 2;
+            }
+        }
+    } catch (const std::exception &e) {
+        std::cerr << e.what() << std::endl;
+        usage(argv[0]);
+        return 2;
+    }
+
+    if (!have_target || optind != argc || !opts.sessions || !opts.threads || !opts.recipients) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    opts.threads = std::min(opts.threads, opts.sessions);
+
+    // Thousands of sessions need more descriptors than the usual soft limit
+    rlimit files = {};
+
+    if (getrlimit(RLIMIT_NOFILE, &files) == 0 && files.rlim_cur < files.rlim_max) {
+        files.rlim_cur = files.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &files);
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+
+    totals results{opts.messages};
+    std::vector<std::unique_ptr<worker>> workers;
+
+    for (size_t i = 0; i < opts.threads; i++) {
+        const size_t share = opts.sessions / opts.threads + (i < opts.sessions % opts.threads ? 1 : 0);
+        workers.push_back(std::make_unique<worker>(opts, results, share, 0x5eed + i));
+    }
+
+    const double client_cpu_start = process_cpu_time(0);
+    const double server_cpu_start = opts.server_pid ? process_cpu_time(opts.server_pid) : 0;
+    const auto start = std::chrono::steady_clock::now();
+
+    for (auto &w : workers) {
+        w->start();
+    }
+
+    for (auto &w : workers) {
+        w->join();
+    }
+
+    const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    const double client_cpu = process_cpu_time(0) - client_cpu_start;
+    const double server_cpu = opts.server_pid ? process_cpu_time(opts.server_pid) - server_cpu_start : 0;
+
+    std::array<uint64_t, rmrf::metrics::histogram::bucket_count> buckets{};
+    results.latency.snapshot(buckets);
+
+    const uint64_t delivered = results.delivered.load();
+    const double per_message = delivered ? 1e6 / static_cast<double>(delivered) : 0;
+
+    std::printf("sessions     %zu on %zu threads, %s%s\n", opts.sessions, opts.threads,
+        opts.lmtp ? "LMTP" : "SMTP", opts.pipelining ? " pipelined" : "");
+    std::printf("messages     %llu delivered, %llu failed, %llu sessions lost\n",
+        static_cast<unsigned long long>(delivered), static_cast<unsigned long long>(results.failed.load()),
+        static_cast<unsigned long long>(results.lost_sessions.load()));
+    std::printf("elapsed      %.3f s\n", elapsed);
+    std::printf("throughput   %.0f msg/s, %.1f MiB/s\n", static_cast<double>(delivered) / elapsed,
+        static_cast<double>(results.bytes.load()) / elapsed / (1024 * 1024));
+    std::printf("latency      p50 %.3f ms, p99 %.3f ms, p999 %.3f ms\n",
+        quantile(buckets, delivered, 0.5), quantile(buckets, delivered, 0.99), quantile(buckets, delivered, 0.999));
+
+    if (opts.server_pid) {
+        std::printf("cpu/message  client %.1f us, server %.1f us\n", client_cpu * per_message, server_cpu * per_message);
+    } else {
+        std::printf("cpu/message  client %.1f us\n", client_cpu * per_message);
+    }
+
+    return results.failed.load() || results.lost_sessions.load() ? 1 : 0;
+}
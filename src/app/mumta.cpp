@@ -1,17 +1,149 @@
+#include <signal.h>
+#include <unistd.h>
+
 #include <chrono>
 #include <cstdint>
-#include <iostream>
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <string>
 #include <thread>
+#include <vector>
 
 #include "lib/ev/ev.hpp"
 #include "lib/nl/nl.hpp"
 #include "lib/openssl/openssl.hpp"
 
 #include "mumta/evloop.hpp"
+#include "mumta/handover.hpp"
+#include "mumta/settings.hpp"
+#include "mumta/settings_exception.hpp"
+#include "net/address.hpp"
+#include "net/admission_filter.hpp"
+
+#include "net/netio_exception.hpp"
+#include "net/socketaddress.hpp"
+
+#include "queue/delivery_queue.hpp"
+#include "queue/message_spool.hpp"
+#include "queue/queue_exception.hpp"
 
 #include "service/daemonctl.hpp"
+#include "service/log.hpp"
+#include "service/metrics_server.hpp"
+
+#include "smtp/lmtp_server.hpp"
+
+using rmrf::smtp::smtp_reply;
+
+/**
+ * Spool a message received via LMTP and queue it per recipient domain.
+ */
+static std::vector<smtp_reply> queue_message(rmrf::queue::delivery_queue &queue, rmrf::queue::message_spool &spool,
+    const rmrf::smtp::envelope &env, const std::string &message)
+{
+    std::vector<smtp_reply> replies(env.recipients.size(), smtp_reply{250, "2.1.5 Queued"});
+    std::map<std::string, std::vector<std::string>> by_domain;
+
+    for (size_t i = 0; i < env.recipients.size(); i++) {
+        const std::string &rcpt = env.recipients[i];
+        const size_t at = rcpt.rfind('@');
+
+        if (at == std::string::npos || at + 1 == rcpt.size()) {
+            replies[i] = smtp_reply{550, "5.1.3 Recipient has no domain"};
+            continue;
+        }
+
+        by_domain[rcpt.substr(at + 1)].push_back(rcpt);
+    }
+
+    if (by_domain.empty()) {
+        return replies;
+    }
+
+    std::string name;
 
-int main() {
+    try {
+        name = spool.store(message);
+
+        for (const auto &[domain, recipients] : by_domain) {
+            queue.enqueue(domain, name, env.sender, recipients);
+        }
+
+        // One flush commits the entries of all domains before we say so
+        queue.commit();
+    } catch (const rmrf::queue::queue_exception &e) {
+        rmrf::log::error("Failed to queue message", {{"error", e.what()}});
+
+        // The client retries, so none of the domains may get the message from this attempt
+        try {
+            queue.rollback();
+        } catch (const rmrf::queue::queue_exception &e2) {
+            rmrf::log::error("Failed to drop partially queued message", {{"error", e2.what()}});
+        }
+
+        if (!name.empty()) {
+            spool.remove(name);
+        }
+
+        return std::vector<smtp_reply>(env.recipients.size(), smtp_reply{451, "4.3.0 Failed to queue message"});
+    }
+
+    return replies;
+}
+
+/**
+ * Start a new instance on SIGUSR2 and hand over to it, e.g. after an upgrade.
+ */
+struct upgrade_trigger {
+    const std::vector<std::string> argv;
+    rmrf::smtp::lmtp_server &lmtp;
+    std::unique_ptr<rmrf::mumta::successor> next;
+    ::ev::sig signal;
+
+    upgrade_trigger(const std::vector<std::string> &argv_, rmrf::smtp::lmtp_server &lmtp_) :
+        argv{argv_}, lmtp{lmtp_}, next{}, signal{}
+    {
+        signal.set<upgrade_trigger, &upgrade_trigger::cb>(this);
+        signal.start(SIGUSR2);
+    }
+
+    ~upgrade_trigger() {
+        signal.stop();
+    }
+
+    upgrade_trigger(const upgrade_trigger &) = delete;
+    upgrade_trigger &operator=(const upgrade_trigger &) = delete;
+
+    bool handed_over() const {
+        return this->next && this->next->is_drained() && !this->next->is_failed();
+    }
+
+    bool handover_failed() const {
+        return this->next && this->next->is_failed();
+    }
+
+    void cb(::ev::sig &w, int events) {
+        (void)w;
+        (void)events;
+
+        if (this->next && (this->next->is_running() || this->next->is_drained())) {
+            return;
+        }
+
+        dctl_status_msg("Handing over to a new instance");
+
+        try {
+            this->next = std::make_unique<rmrf::mumta::successor>(this->argv, this->lmtp, []() {
+                ::ev::get_default_loop().break_loop(::ev::ALL);
+            });
+        } catch (const rmrf::net::netio_exception &e) {
+            rmrf::log::error("Failed to start a new instance", {{"error", e.what()}});
+        }
+    }
+};
+
+int main(int argc, char **argv) {
     dctl_status_msg("Checking environment");
 
     if (!check_version_libev()) {
@@ -28,27 +160,211 @@ int main() {
 
     dctl_status_msg("Initializing");
     dctl_status_msg("Reading configuration");
+
+    rmrf::mumta::settings config{};
+
+    try {
+        config = rmrf::mumta::read_settings();
+    } catch (const rmrf::mumta::settings_exception &e) {
+        rmrf::log::error("Invalid configuration", {{"error", e.what()}});
+        return 1;
+    }
+
+    rmrf::ev::set_loop_budget(config.loop_budget);
     dctl_status_msg("Initializing network");
+
+    // Clients hanging up before reading their reply must not take us down
+    signal(SIGPIPE, SIG_IGN);
+
+    // A previous instance passes on its listeners right away, but its state only once it stopped
+    std::unique_ptr<rmrf::mumta::predecessor> previous;
+
+    try {
+        previous = rmrf::mumta::predecessor::attach();
+    } catch (const rmrf::net::netio_exception &e) {
+        rmrf::log::error("Failed to take over from the previous instance", {{"error", e.what()}});
+        return 1;
+    }
+
+    rmrf::net::auto_fd lmtp_fd;
+
+    if (previous && previous->get_sockets().listeners.count("lmtp")) {
+        lmtp_fd = std::move(previous->get_sockets().listeners.at("lmtp"));
+    }
+
+    // Socket units without FileDescriptorName=lmtp work as long as there is just one socket
+    const std::vector<dctl_socket> activated = previous ? std::vector<dctl_socket>{} : dctl_listen_fds();
+
+    for (const dctl_socket &socket : activated) {
+        if (!lmtp_fd.valid() && (socket.name == "lmtp" || activated.size() == 1)) {
+            lmtp_fd = rmrf::net::auto_fd{socket.fd};
+        } else {
+            rmrf::log::warning("Ignoring passed socket", {{"name", socket.name}});
+            close(socket.fd);
+        }
+    }
+
+    dctl_status_msg("Binding sockets");
+
+    // Local MTAs and clients hand over messages via LMTP on a UNIX socket
+    const char *runtime_directory = std::getenv("RUNTIME_DIRECTORY");
+    std::unique_ptr<rmrf::queue::delivery_queue> queue;
+    std::unique_ptr<rmrf::queue::message_spool> spool;
+    std::unique_ptr<rmrf::smtp::lmtp_server> lmtp;
+
+    auto handler = [&queue, &spool](const rmrf::smtp::envelope &env, const std::string &message) {
+        return queue_message(*queue, *spool, env, message);
+    };
+
+    try {
+        if (lmtp_fd.valid()) {
+            lmtp = std::make_unique<rmrf::smtp::lmtp_server>(std::move(lmtp_fd), "localhost", handler);
+        } else {
+            lmtp = std::make_unique<rmrf::smtp::lmtp_server>(
+                rmrf::net::socketaddr::unix_path(std::string(runtime_directory ? runtime_directory : "/run/mumta") + "/lmtp"),
+                "localhost", handler);
+        }
+    } catch (const rmrf::net::netio_exception &e) {
+        rmrf::log::error("Failed to listen for LMTP", {{"error", e.what()}});
+        return 1;
+    }
+
+    // Only TCP clients are subject to these, local ones are trusted anyway
+    if (config.lmtp_rate > 0 || config.lmtp_connections || !config.lmtp_allow.empty() || !config.lmtp_deny.empty()) {
+        auto filter = std::make_shared<rmrf::net::admission_filter>(
+            rmrf::net::admission_limits{config.lmtp_rate, 10, 8 * config.lmtp_rate, 40, 24, 48, config.lmtp_connections, 0, true});
+
+        filter->exempt("127.0.0.0/8"_cidr4);
+        filter->exempt("::1/128"_cidr6);
+
+        for (const auto &net : config.lmtp_allow) {
+            filter->exempt(net.key, net.prefix_length);
+        }
+
+        for (const auto &net : config.lmtp_deny) {
+            filter->block(net.key, net.prefix_length);
+        }
+
+        lmtp->get_listener().set_admission_filter(filter);
+    }
+
+    // The limits then apply to the clients behind the balancers
+    if (!config.lmtp_proxy.empty()) {
+        auto balancers = std::make_shared<rmrf::net::prefix_table<bool>>();
+
+        for (const auto &net : config.lmtp_proxy) {
+            balancers->insert(net.key, net.prefix_length, true);
+        }
+
+        lmtp->get_listener().set_proxy_protocol(true, 3.0, balancers);
+    }
+
+    // No message must reach the handler before the queue is read
+    lmtp->hold();
+
+    if (previous) {
+        dctl_status_msg("Waiting for the previous instance");
+
+        try {
+            previous->wait();
+        } catch (const rmrf::net::netio_exception &e) {
+            rmrf::log::error("Failed to take over from the previous instance", {{"error", e.what()}});
+            return 1;
+        }
+    }
+
     dctl_status_msg("Loading caches");
     dctl_status_msg("Refreshing caches");
     dctl_status_msg("Reading state");
+
+    // systemd passes the directory from StateDirectory= in the environment
+    const char *state_directory = std::getenv("STATE_DIRECTORY");
+    const std::string state_path = state_directory ? state_directory : "/var/lib/mumta";
+
+    try {
+        queue = std::make_unique<rmrf::queue::delivery_queue>(state_path + "/queue",
+            rmrf::queue::queue_limits{20, 200, 10.0, 20.0, 300, 4 * 3600, 5 * 86400});
+        spool = std::make_unique<rmrf::queue::message_spool>(state_path + "/spool");
+    } catch (const rmrf::queue::queue_exception &e) {
+        rmrf::log::error("Failed to open the queue", {{"error", e.what()}});
+        return 1;
+    }
+
     dctl_status_msg("Initializing");
-    dctl_status_msg("Binding sockets");
+
+    if (previous) {
+        for (auto &[name, connection] : previous->get_sockets().connections) {
+            if (name != "lmtp") {
+                continue;
+            }
+
+            try {
+                lmtp->adopt(std::move(connection));
+            } catch (const rmrf::net::netio_exception &e) {
+                // The client went away in the meantime
+                rmrf::log::warning("Failed to adopt connection", {{"error", e.what()}});
+            }
+        }
+
+        previous.reset();
+    }
+
+    lmtp->resume();
+
+    // Metrics are nice to have, so failing to serve them is no reason to stop
+    std::unique_ptr<rmrf::metrics::metrics_server> metrics;
+
+    try {
+        metrics = std::make_unique<rmrf::metrics::metrics_server>(
+            rmrf::net::socketaddr::unix_path(std::string(runtime_directory ? runtime_directory : "/run/mumta") + "/metrics"));
+    } catch (const rmrf::net::netio_exception &e) {
+        rmrf::log::warning("Failed to serve metrics", {{"error", e.what()}});
+    }
+
+    auto upgrade = std::make_unique<upgrade_trigger>(std::vector<std::string>(argv, argv + argc), *lmtp);
 
     dctl_status_msg("Activating");
     dctl_status_ready();
     dctl_status_msg("Active");
 
-    dctl_watchdog_refresh();
+    rmrf::ev::init_watchdog();
     rmrf::ev::loop();
 
     dctl_status_msg("Preparing for shutdown");
-    dctl_status_shutdown();
+
+    // After a handover the service goes on with the new instance
+    const bool handed_over = upgrade->handed_over();
+
+    if (!handed_over) {
+        dctl_status_shutdown();
+    }
+
     dctl_status_msg("Finalizing pending transactions");
     dctl_status_msg("Storing active state");
+
+    try {
+        queue->compact();
+    } catch (const rmrf::queue::queue_exception &e) {
+        // The journal written so far still describes the queue
+        rmrf::log::error("Failed to compact the queue", {{"error", e.what()}});
+    }
+
     dctl_status_msg("Storing active caches");
     dctl_status_msg("Closing active sockets");
+
+    // Must not remove the socket file once the new instance took over
+    metrics.reset();
+
+    if (handed_over) {
+        upgrade->next->finish();
+    }
+
+    // Nobody accepts anymore if the new instance went away, so get us restarted
+    const bool failed = upgrade->handover_failed();
+
+    upgrade.reset();
+    lmtp.reset();
     dctl_status_msg("Inactive");
 
-    return 0;
+    return failed ? 1 : 0;
 }
@@ -1,4 +1,6 @@
+#include <cstdlib>
 #include <iostream>
+#include <string>
 
 #include "lib/gettext/translations.hpp"
 
@@ -6,26 +8,56 @@
 
 #include "lib/nccpp/ncursescpp.hpp"
 
+#include "service/log.hpp"
+
+#include "ui/ui_loop.hpp"
 #include "ui/view.hpp"
 
 #include <iostream>
 
 int main() {
     using rmrf::ui::display;
+    using rmrf::ui::ui_loop;
 
     std::cout << "Hallo" << std::endl;
     setlocale(LC_ALL, "");
     bindtextdomain("rmrf", "/usr/share/locale");
     textdomain("rmrf");
 
+    // stderr is the terminal curses draws on, so log records go elsewhere
+    const char *log_path = std::getenv("RMRF_LOG");
+    const char *state_home = std::getenv("XDG_STATE_HOME");
+    const char *home = std::getenv("HOME");
+    std::string default_log_path = "/dev/null";
+
+    if (state_home && *state_home) {
+        default_log_path = std::string(state_home) + "/rmrf.log";
+    } else if (home && *home) {
+        default_log_path = std::string(home) + "/.local/state/rmrf.log";
+    }
+
+    if (!rmrf::log::open_file(log_path ? log_path : default_log_path)) {
+        rmrf::log::open_file("/dev/null");
+    }
+
     auto h_nc = std::make_shared<display>();
 
     h_nc->clear();
 
-    // Start main loop of RMRF here
     h_nc->sync([](const display::ptr_type &) {
         mvprintw(0, 0, _("Starting RMRF…"));
+        wnoutrefresh(stdscr);
     });
+    h_nc->request_frame();
+
+    // Main loop of RMRF: input, resizes and network I/O share one libev loop
+    ui_loop loop{h_nc};
+
+    loop.set_key_callback([](int ch) {
+        return 'q' != ch;
+    });
+
+    loop.run();
 
     return 0;
 }
@@ -0,0 +1,127 @@
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <unistd.h>
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "net/netio_exception.hpp"
+#include "net/socketaddress.hpp"
+#include "net/tcp_server_socket.hpp"
+
+/**
+ * A stand-in for the socket activation of systemd, e.g. for testing mumta
+ * locally. It binds the given sockets and runs the command with them
+ * passed in the same way (LISTEN_FDS, LISTEN_PID, LISTEN_FDNAMES).
+ */
+
+static void usage(const char *self) {
+    std::cerr << "Usage: " << self << " -l unix:PATH[:NAME] | -l unix:@NAME[:NAME] | -l tcp:PORT[:NAME] ... [--] COMMAND [ARGS...]" << std::endl;
+}
+
+/**
+ * Split off the name of the socket after the last colon that is not part of
+ * the address itself.
+ */
+static std::string split_name(std::string &spec, size_t address_start) {
+    const size_t colon = spec.rfind(':');
+
+    if (colon == std::string::npos || colon < address_start || spec.find('/', colon) != std::string::npos) {
+        return {};
+    }
+
+    std::string name = spec.substr(colon + 1);
+    spec.erase(colon);
+    return name;
+}
+
+static rmrf::net::socketaddr parse_address(std::string spec, std::string &name) {
+    if (spec.rfind("unix:", 0) == 0) {
+        name = split_name(spec, 6);
+        const std::string path = spec.substr(5);
+
+        if (path.size() > 1 && path.front() == '@') {
+            return rmrf::net::socketaddr::unix_abstract(path.substr(1));
+        }
+
+        return rmrf::net::socketaddr::unix_path(path);
+    }
+
+    if (spec.rfind("tcp:", 0) == 0) {
+        name = split_name(spec, 5);
+        const long port = std::strtol(spec.c_str() + 4, nullptr, 10);
+
+        if (port <= 0 || port > 65535) {
+            throw rmrf::net::netio_exception("Invalid port in " + spec);
+        }
+
+        sockaddr_in6 addr = {};
+        addr.sin6_family = AF_INET6;
+        addr.sin6_port = htons(static_cast<uint16_t>(port));
+        addr.sin6_addr = IN6ADDR_ANY_INIT;
+        return rmrf::net::socketaddr{addr};
+    }
+
+    throw rmrf::net::netio_exception("Unknown socket type in " + spec);
+}
+
+int main(int argc, char **argv) {
+    std::vector<rmrf::net::auto_fd> sockets;
+    std::string names;
+    int arg = 1;
+
+    try {
+        for (; arg + 1 < argc && std::string(argv[arg]) == "-l"; arg += 2) {
+            std::string name;
+            const rmrf::net::socketaddr address = parse_address(argv[arg + 1], name);
+            sockets.push_back(rmrf::net::bind_listener(address, 0));
+
+            if (!names.empty()) {
+                names += ':';
+            }
+
+            names += name.empty() ? "unknown" : name;
+        }
+    } catch (const rmrf::net::netio_exception &e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    if (arg < argc && std::string(argv[arg]) == "--") {
+        arg++;
+    }
+
+    if (sockets.empty() || arg >= argc) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    // Move everything out of the way first, so the renumbering cannot clobber a socket
+    const int count = static_cast<int>(sockets.size());
+
+    for (auto &socket : sockets) {
+        socket = rmrf::net::auto_fd{fcntl(socket.get(), F_DUPFD_CLOEXEC, 3 + count)};
+    }
+
+    // The passed descriptors start at 3; dup2 leaves them open across exec
+    for (int i = 0; i < count; i++) {
+        if (dup2(sockets[static_cast<size_t>(i)].get(), 3 + i) < 0) {
+            std::cerr << "Failed to pass socket " << i << std::endl;
+            return 1;
+        }
+    }
+
+    sockets.clear();
+
+    // The pid stays the same across exec, so the command finds its own pid here
+    setenv("LISTEN_PID", std::to_string(getpid()).c_str(), 1);
+    setenv("LISTEN_FDS", std::to_string(count).c_str(), 1);
+    setenv("LISTEN_FDNAMES", names.c_str(), 1);
+
+    execvp(argv[arg], argv + arg);
+    std::cerr << "Failed to run " << argv[arg] << std::endl;
+    return 127;
+}
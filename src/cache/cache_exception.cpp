@@ -0,0 +1,13 @@
+#include "cache/cache_exception.hpp"
+
+namespace rmrf::cache {
+
+cache_exception::cache_exception(const std::string &cause_) : cause(cause_) {
+    // NOP
+}
+
+const char *cache_exception::what() const throw() {
+    return this->cause.c_str();
+}
+
+}
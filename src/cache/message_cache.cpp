@@ -0,0 +1,662 @@
+#include "cache/message_cache.hpp"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <openssl/sha.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+#include <unordered_set>
+
+#include "cache/cache_exception.hpp"
+
+namespace rmrf::cache {
+
+namespace {
+
+constexpr uint32_t blob_magic = 0x42434d52; // "RMCB"
+constexpr size_t blob_header_size = 4 + 4 + 32;
+constexpr size_t journal_header_size = 1 + 4;
+
+constexpr char journal_blob_record = 'B';
+constexpr char journal_key_record = 'K';
+constexpr char journal_evict_record = 'E';
+constexpr char journal_invalidate_record = 'I';
+
+digest_t compute_digest(std::string_view data) {
+    digest_t digest{};
+    SHA256(reinterpret_cast<const unsigned char *>(data.data()), data.size(), digest.data());
+    return digest;
+}
+
+bool write_all(int fd, const void *buf, size_t length) {
+    const uint8_t *p = static_cast<const uint8_t *>(buf);
+
+    while (length) {
+        ssize_t written = ::write(fd, p, length);
+
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            return false;
+        }
+
+        p += written;
+        length -= static_cast<size_t>(written);
+    }
+
+    return true;
+}
+
+bool pread_all(int fd, void *buf, size_t length, uint64_t offset) {
+    uint8_t *p = static_cast<uint8_t *>(buf);
+
+    while (length) {
+        ssize_t n = ::pread(fd, p, length, static_cast<off_t>(offset));
+
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+
+        if (n <= 0) {
+            return false;
+        }
+
+        p += n;
+        offset += static_cast<uint64_t>(n);
+        length -= static_cast<size_t>(n);
+    }
+
+    return true;
+}
+
+template<typename T>
+void put_raw(std::string &out, const T &value) {
+    out.append(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+template<typename T>
+bool get_raw(std::string_view &in, T &value) {
+    if (in.size() < sizeof(T)) {
+        return false;
+    }
+
+    memcpy(&value, in.data(), sizeof(T));
+    in.remove_prefix(sizeof(T));
+    return true;
+}
+
+}
+
+bool message_key::operator==(const message_key &other) const {
+    return this->uid == other.uid && this->uid_validity == other.uid_validity && this->mailbox == other.mailbox;
+}
+
+size_t message_key_hash::operator()(const message_key &key) const {
+    size_t h = std::hash<std::string>{}(key.mailbox);
+    h ^= (static_cast<size_t>(key.uid_validity) << 32 | key.uid) + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2);
+    return h;
+}
+
+size_t digest_hash::operator()(const digest_t &digest) const {
+    size_t h;
+    memcpy(&h, digest.data(), sizeof(h));
+    return h;
+}
+
+message_cache::message_cache(const std::string &directory_, uint64_t byte_budget_, uint64_t segment_size_,
+    std::chrono::steady_clock::duration prefetch_timeout_) :
+    m{},
+    directory{directory_},
+    byte_budget{byte_budget_},
+    segment_size{segment_size_},
+    prefetch_timeout{prefetch_timeout_},
+    journal{}, journal_records{0},
+    keys{}, blobs{}, lru{}, segments{},
+    active_segment{0}, live_bytes{0},
+    in_flight{}
+{
+    if (mkdir(this->directory.c_str(), 0700) != 0 && errno != EEXIST) {
+        throw cache_exception("Failed to create cache directory '" + this->directory + "': " + strerror(errno));
+    }
+
+    this->replay_journal();
+    this->enforce_budget();
+    this->rewrite_journal();
+}
+
+message_cache::~message_cache() {
+    try {
+        std::lock_guard<std::mutex> lock(this->m);
+        this->rewrite_journal();
+    } catch (const cache_exception &) {
+        // The journal on disk stays valid, we only lose the recency order
+    }
+}
+
+std::string message_cache::segment_path(uint32_t segment) const {
+    char name[32];
+    snprintf(name, sizeof(name), "/seg-%08x.dat", segment);
+    return this->directory + name;
+}
+
+message_cache::segment_info &message_cache::open_segment(uint32_t segment, bool create) {
+    auto it = this->segments.find(segment);
+
+    if (it != this->segments.end()) {
+        return it->second;
+    }
+
+    int flags = O_RDWR | O_APPEND | O_CLOEXEC | (create ? O_CREAT : 0);
+    rmrf::net::auto_fd fd{::open(this->segment_path(segment).c_str(), flags, 0600)};
+
+    if (!fd.valid()) {
+        throw cache_exception("Failed to open cache segment '" + this->segment_path(segment) + "': " + strerror(errno));
+    }
+
+    off_t size = lseek(fd.get(), 0, SEEK_END);
+
+    const uint64_t length = size > 0 ? static_cast<uint64_t>(size) : 0;
+    return this->segments.emplace(segment, segment_info{std::move(fd), length, 0}).first->second;
+}
+
+void message_cache::replay_journal() {
+    const std::string path = this->directory + "/journal";
+    rmrf::net::auto_fd fd{::open(path.c_str(), O_RDONLY | O_CLOEXEC)};
+
+    std::string data;
+
+    if (fd.valid()) {
+        char buffer[65536];
+        ssize_t n;
+
+        while ((n = ::read(fd.get(), buffer, sizeof(buffer))) > 0) {
+            data.append(buffer, static_cast<size_t>(n));
+        }
+    }
+
+    std::string_view in{data};
+
+    while (in.size() >= journal_header_size) {
+        char type = in[0];
+        uint32_t length;
+        memcpy(&length, in.data() + 1, sizeof(length));
+
+        if (in.size() < journal_header_size + length) {
+            // Torn write at the end of the journal, ignore it
+            break;
+        }
+
+        std::string_view payload = in.substr(journal_header_size, length);
+        in.remove_prefix(journal_header_size + length);
+
+        digest_t digest;
+
+        if (!get_raw(payload, digest)) {
+            continue;
+        }
+
+        if (type == journal_blob_record) {
+            uint32_t segment;
+            uint64_t offset;
+            uint32_t body_length;
+
+            if (!get_raw(payload, segment) || !get_raw(payload, offset) || !get_raw(payload, body_length)) {
+                continue;
+            }
+
+            auto it = this->blobs.find(digest);
+
+            if (it != this->blobs.end()) {
+                this->lru.erase(it->second.lru_pos);
+                this->blobs.erase(it);
+            }
+
+            this->lru.push_back(digest);
+            this->blobs.emplace(digest, blob_entry{segment, offset, body_length, std::prev(this->lru.end())});
+        } else if (type == journal_key_record) {
+            uint32_t uid_validity;
+            uint32_t uid;
+
+            if (!get_raw(payload, uid_validity) || !get_raw(payload, uid)) {
+                continue;
+            }
+
+            this->keys[message_key{std::string(payload), uid_validity, uid}] = digest;
+        } else if (type == journal_evict_record) {
+            auto it = this->blobs.find(digest);
+
+            if (it != this->blobs.end()) {
+                this->lru.erase(it->second.lru_pos);
+                this->blobs.erase(it);
+            }
+        } else if (type == journal_invalidate_record) {
+            for (auto it = this->keys.begin(); it != this->keys.end();) {
+                it = it->first.mailbox == payload ? this->keys.erase(it) : std::next(it);
+            }
+        }
+    }
+
+    // Open all segments still referenced and account their live data
+    for (auto it = this->blobs.begin(); it != this->blobs.end();) {
+        try {
+            auto &info = this->open_segment(it->second.segment, false);
+
+            if (it->second.offset + blob_header_size + it->second.length > info.size) {
+                throw cache_exception("Cache segment truncated");
+            }
+
+            info.live_bytes += it->second.length;
+            this->live_bytes += it->second.length;
+            this->active_segment = std::max(this->active_segment, it->second.segment);
+            ++it;
+        } catch (const cache_exception &) {
+            this->lru.erase(it->second.lru_pos);
+            it = this->blobs.erase(it);
+        }
+    }
+
+    for (auto it = this->keys.begin(); it != this->keys.end();) {
+        it = this->blobs.count(it->second) ? std::next(it) : this->keys.erase(it);
+    }
+
+    // Remove segment files no longer referenced by the journal
+    if (DIR *dir = opendir(this->directory.c_str())) {
+        while (dirent *de = readdir(dir)) {
+            unsigned int segment;
+            char tail;
+
+            if (sscanf(de->d_name, "seg-%8x.da%c", &segment, &tail) == 2 && !this->segments.count(segment)) {
+                unlink((this->directory + "/" + de->d_name).c_str());
+            }
+        }
+
+        closedir(dir);
+    }
+
+    // Always continue writing into a fresh segment after a restart
+    this->active_segment++;
+}
+
+void message_cache::append_journal(char type, const void *payload, size_t length) {
+    std::string record;
+    record.reserve(journal_header_size + length);
+    record.push_back(type);
+    put_raw(record, static_cast<uint32_t>(length));
+    record.append(static_cast<const char *>(payload), length);
+
+    if (!write_all(this->journal.get(), record.data(), record.size())) {
+        throw cache_exception(std::string("Failed to write cache journal: ") + strerror(errno));
+    }
+
+    // Keep the journal from growing without bounds
+    if (++this->journal_records > 2 * (this->blobs.size() + this->keys.size()) + 1024) {
+        this->rewrite_journal();
+    }
+}
+
+void message_cache::journal_blob(const digest_t &digest, const blob_entry &entry) {
+    std::string payload;
+    put_raw(payload, digest);
+    put_raw(payload, entry.segment);
+    put_raw(payload, entry.offset);
+    put_raw(payload, entry.length);
+    this->append_journal(journal_blob_record, payload.data(), payload.size());
+}
+
+void message_cache::journal_key(const message_key &key, const digest_t &digest) {
+    std::string payload;
+    put_raw(payload, digest);
+    put_raw(payload, key.uid_validity);
+    put_raw(payload, key.uid);
+    payload.append(key.mailbox);
+    this->append_journal(journal_key_record, payload.data(), payload.size());
+}
+
+void message_cache::rewrite_journal() {
+    const std::string path = this->directory + "/journal";
+    const std::string tmp_path = path + ".new";
+
+    std::string data;
+    size_t records = 0;
+
+    // Blobs are written in LRU order so a replay restores the recency
+    for (const digest_t &digest : this->lru) {
+        const blob_entry &entry = this->blobs.at(digest);
+        std::string payload;
+        put_raw(payload, digest);
+        put_raw(payload, entry.segment);
+        put_raw(payload, entry.offset);
+        put_raw(payload, entry.length);
+
+        data.push_back(journal_blob_record);
+        put_raw(data, static_cast<uint32_t>(payload.size()));
+        data.append(payload);
+        records++;
+    }
+
+    for (const auto &entry : this->keys) {
+        std::string payload;
+        put_raw(payload, entry.second);
+        put_raw(payload, entry.first.uid_validity);
+        put_raw(payload, entry.first.uid);
+        payload.append(entry.first.mailbox);
+
+        data.push_back(journal_key_record);
+        put_raw(data, static_cast<uint32_t>(payload.size()));
+        data.append(payload);
+        records++;
+    }
+
+    rmrf::net::auto_fd fd{::open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600)};
+
+    if (!fd.valid() || !write_all(fd.get(), data.data(), data.size()) || fsync(fd.get()) != 0) {
+        throw cache_exception("Failed to write cache journal '" + tmp_path + "': " + strerror(errno));
+    }
+
+    fd.close();
+
+    if (rename(tmp_path.c_str(), path.c_str()) != 0) {
+        throw cache_exception("Failed to replace cache journal '" + path + "': " + strerror(errno));
+    }
+
+    this->journal = rmrf::net::auto_fd{::open(path.c_str(), O_WRONLY | O_APPEND | O_CLOEXEC)};
+
+    if (!this->journal.valid()) {
+        throw cache_exception("Failed to open cache journal '" + path + "': " + strerror(errno));
+    }
+
+    this->journal_records = records;
+}
+
+uint32_t message_cache::write_blob(const digest_t &digest, std::string_view body, uint64_t &offset) {
+    auto *info = &this->open_segment(this->active_segment, true);
+
+    if (info->size && info->size + body.size() > this->segment_size) {
+        info = &this->open_segment(++this->active_segment, true);
+    }
+
+    std::string header;
+    put_raw(header, blob_magic);
+    put_raw(header, static_cast<uint32_t>(body.size()));
+    put_raw(header, digest);
+
+    offset = info->size;
+
+    if (!write_all(info->fd.get(), header.data(), header.size()) || !write_all(info->fd.get(), body.data(), body.size())) {
+        throw cache_exception(std::string("Failed to write cache segment: ") + strerror(errno));
+    }
+
+    info->size += header.size() + body.size();
+    info->live_bytes += body.size();
+
+    return this->active_segment;
+}
+
+std::optional<std::string> message_cache::read_blob(const blob_entry &entry) {
+    auto it = this->segments.find(entry.segment);
+
+    if (it == this->segments.end()) {
+        return std::nullopt;
+    }
+
+    uint8_t header[blob_header_size];
+
+    if (!pread_all(it->second.fd.get(), header, sizeof(header), entry.offset)) {
+        return std::nullopt;
+    }
+
+    uint32_t magic;
+    uint32_t length;
+    memcpy(&magic, header, sizeof(magic));
+    memcpy(&length, header + 4, sizeof(length));
+
+    if (magic != blob_magic || length != entry.length) {
+        return std::nullopt;
+    }
+
+    std::string body(length, '\0');
+
+    if (!pread_all(it->second.fd.get(), body.data(), length, entry.offset + blob_header_size)) {
+        return std::nullopt;
+    }
+
+    return body;
+}
+
+void message_cache::touch(blob_entry &entry) {
+    this->lru.splice(this->lru.end(), this->lru, entry.lru_pos);
+}
+
+void message_cache::remove_blob(digest_t digest, bool journaled) {
+    auto it = this->blobs.find(digest);
+
+    if (it == this->blobs.end()) {
+        return;
+    }
+
+    const uint32_t segment = it->second.segment;
+    const uint32_t length = it->second.length;
+
+    this->lru.erase(it->second.lru_pos);
+    this->blobs.erase(it);
+    this->live_bytes -= length;
+
+    if (journaled) {
+        this->append_journal(journal_evict_record, digest.data(), digest.size());
+    }
+
+    auto seg = this->segments.find(segment);
+
+    if (seg == this->segments.end()) {
+        return;
+    }
+
+    seg->second.live_bytes -= length;
+
+    if (!seg->second.live_bytes && segment != this->active_segment) {
+        this->segments.erase(seg);
+        unlink(this->segment_path(segment).c_str());
+    }
+}
+
+void message_cache::enforce_budget() {
+    while (this->live_bytes > this->byte_budget && !this->lru.empty()) {
+        this->remove_blob(this->lru.front(), this->journal.valid());
+    }
+}
+
+std::optional<std::string> message_cache::get(const message_key &key) {
+    std::lock_guard<std::mutex> lock(this->m);
+
+    auto key_it = this->keys.find(key);
+
+    if (key_it == this->keys.end()) {
+        return std::nullopt;
+    }
+
+    auto blob_it = this->blobs.find(key_it->second);
+
+    if (blob_it == this->blobs.end()) {
+        this->keys.erase(key_it);
+        return std::nullopt;
+    }
+
+    auto body = this->read_blob(blob_it->second);
+
+    if (!body) {
+        this->remove_blob(key_it->second, true);
+        this->keys.erase(key_it);
+        return std::nullopt;
+    }
+
+    this->touch(blob_it->second);
+    return body;
+}
+
+bool message_cache::contains(const message_key &key) const {
+    std::lock_guard<std::mutex> lock(this->m);
+
+    auto key_it = this->keys.find(key);
+    return key_it != this->keys.end() && this->blobs.count(key_it->second);
+}
+
+void message_cache::put(const message_key &key, std::string_view body) {
+    const digest_t digest = compute_digest(body);
+
+    std::lock_guard<std::mutex> lock(this->m);
+
+    this->in_flight.erase(key);
+
+    if (body.size() > this->byte_budget) {
+        return;
+    }
+
+    auto it = this->blobs.find(digest);
+
+    if (it == this->blobs.end()) {
+        uint64_t offset = 0;
+        uint32_t segment = this->write_blob(digest, body, offset);
+
+        this->lru.push_back(digest);
+        it = this->blobs.emplace(digest, blob_entry{segment, offset, static_cast<uint32_t>(body.size()), std::prev(this->lru.end())}).first;
+        this->live_bytes += body.size();
+    } else {
+        this->touch(it->second);
+    }
+
+    this->journal_blob(digest, it->second);
+
+    this->keys[key] = digest;
+    this->journal_key(key, digest);
+    this->enforce_budget();
+}
+
+void message_cache::invalidate_mailbox(std::string_view mailbox) {
+    std::lock_guard<std::mutex> lock(this->m);
+
+    for (auto it = this->keys.begin(); it != this->keys.end();) {
+        it = it->first.mailbox == mailbox ? this->keys.erase(it) : std::next(it);
+    }
+
+    this->append_journal(journal_invalidate_record, mailbox.data(), mailbox.size());
+
+    // Bodies only referenced from the invalidated mailbox are of no use anymore
+    std::unordered_set<digest_t, digest_hash> referenced;
+
+    for (const auto &entry : this->keys) {
+        referenced.insert(entry.second);
+    }
+
+    std::vector<digest_t> unreferenced;
+
+    for (const auto &entry : this->blobs) {
+        if (!referenced.count(entry.first)) {
+            unreferenced.push_back(entry.first);
+        }
+    }
+
+    for (const auto &digest : unreferenced) {
+        this->remove_blob(digest, true);
+    }
+}
+
+void message_cache::prefetch(const std::vector<message_key> &candidates, const fetch_cb_t &fetch) {
+    std::vector<message_key> wanted;
+
+    {
+        std::lock_guard<std::mutex> lock(this->m);
+        const auto now = std::chrono::steady_clock::now();
+
+        // A fetch may fail without anybody telling us; retry those eventually
+        for (auto it = this->in_flight.begin(); it != this->in_flight.end();) {
+            it = now - it->second >= this->prefetch_timeout ? this->in_flight.erase(it) : std::next(it);
+        }
+
+        for (const auto &key : candidates) {
+            auto key_it = this->keys.find(key);
+
+            if (key_it != this->keys.end() && this->blobs.count(key_it->second)) {
+                continue;
+            }
+
+            if (this->in_flight.emplace(key, now).second) {
+                wanted.push_back(key);
+            }
+        }
+    }
+
+    // Call out without holding the lock; the fetcher may call put() synchronously
+    for (const auto &key : wanted) {
+        fetch(key);
+    }
+}
+
+void message_cache::cancel_prefetch(const message_key &key) {
+    std::lock_guard<std::mutex> lock(this->m);
+
+    this->in_flight.erase(key);
+}
+
+void message_cache::compact_segment(uint32_t segment) {
+    for (auto &entry : this->blobs) {
+        if (entry.second.segment != segment) {
+            continue;
+        }
+
+        auto body = this->read_blob(entry.second);
+
+        if (!body) {
+            continue;
+        }
+
+        uint64_t offset = 0;
+        uint32_t new_segment = this->write_blob(entry.first, *body, offset);
+        entry.second.segment = new_segment;
+        entry.second.offset = offset;
+    }
+
+    this->segments.erase(segment);
+    unlink(this->segment_path(segment).c_str());
+}
+
+void message_cache::compact() {
+    std::lock_guard<std::mutex> lock(this->m);
+
+    std::vector<uint32_t> sparse;
+
+    for (const auto &seg : this->segments) {
+        if (seg.first != this->active_segment && seg.second.live_bytes * 4 < seg.second.size) {
+            sparse.push_back(seg.first);
+        }
+    }
+
+    // Start a new segment so compacted data does not land in a sparse one
+    this->active_segment++;
+
+    for (uint32_t segment : sparse) {
+        this->compact_segment(segment);
+    }
+
+    this->rewrite_journal();
+}
+
+uint64_t message_cache::size() const {
+    std::lock_guard<std::mutex> lock(this->m);
+
+    return this->live_bytes;
+}
+
+uint64_t message_cache::budget() const {
+    return this->byte_budget;
+}
+
+}
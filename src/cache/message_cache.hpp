@@ -0,0 +1,169 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "net/async_fd.hpp"
+
+namespace rmrf::cache {
+
+/**
+ * Identifies a message body on the server. Bodies of messages are immutable,
+ * so this key stays valid until the UIDVALIDITY of the mailbox changes.
+ */
+struct message_key {
+    std::string mailbox;
+    uint32_t uid_validity;
+    uint32_t uid;
+
+    bool operator==(const message_key &other) const;
+};
+
+struct message_key_hash {
+    size_t operator()(const message_key &key) const;
+};
+
+typedef std::array<uint8_t, 32> digest_t;
+
+struct digest_hash {
+    size_t operator()(const digest_t &digest) const;
+};
+
+/**
+ * A persistent, content-addressed cache for message bodies.
+ *
+ * Bodies are stored once per distinct content (SHA-256) in append-only
+ * segment files, so copies of the same message in several mailboxes share
+ * storage. The total size of all bodies is kept within a byte budget by
+ * evicting the least recently used ones. All changes are recorded in a
+ * journal which is replayed on open, so the cache survives restarts.
+ */
+class message_cache {
+public:
+    typedef std::function<void(const message_key &)> fetch_cb_t;
+
+private:
+    struct blob_entry {
+        uint32_t segment;
+        uint64_t offset;
+        uint32_t length;
+        std::list<digest_t>::iterator lru_pos;
+    };
+
+    struct segment_info {
+        rmrf::net::auto_fd fd;
+        uint64_t size;
+        uint64_t live_bytes;
+    };
+
+    mutable std::mutex m;
+
+    const std::string directory;
+    const uint64_t byte_budget;
+    const uint64_t segment_size;
+    const std::chrono::steady_clock::duration prefetch_timeout;
+
+    rmrf::net::auto_fd journal;
+    size_t journal_records;
+
+    std::unordered_map<message_key, digest_t, message_key_hash> keys;
+    std::unordered_map<digest_t, blob_entry, digest_hash> blobs;
+    std::list<digest_t> lru;
+    std::map<uint32_t, segment_info> segments;
+    uint32_t active_segment;
+    uint64_t live_bytes;
+
+    // Outstanding prefetches and when they were requested
+    std::unordered_map<message_key, std::chrono::steady_clock::time_point, message_key_hash> in_flight;
+
+public:
+    /**
+     * Open (or create) a cache in the given directory.
+     *
+     * @param directory_ The directory holding the journal and segment files
+     * @param byte_budget_ The maximum number of body bytes to keep
+     * @param segment_size_ The size after which a new segment file is started
+     * @param prefetch_timeout_ The time after which a prefetch whose body
+     *                          never arrived may be requested again
+     * @throws cache_exception if the directory cannot be used
+     */
+    message_cache(const std::string &directory_, uint64_t byte_budget_, uint64_t segment_size_ = 64 * 1024 * 1024,
+        std::chrono::steady_clock::duration prefetch_timeout_ = std::chrono::seconds(30));
+    ~message_cache();
+
+    message_cache(const message_cache &) = delete;
+    message_cache &operator=(const message_cache &) = delete;
+
+    /**
+     * Look up a body. A hit marks the body as recently used.
+     *
+     * @return The body or an empty optional if it is not cached
+     */
+    std::optional<std::string> get(const message_key &key);
+
+    /**
+     * Check if a body is cached without touching its recency.
+     */
+    bool contains(const message_key &key) const;
+
+    /**
+     * Store a body fetched from the server.
+     */
+    void put(const message_key &key, std::string_view body);
+
+    /**
+     * Drop all bodies of a mailbox, e.g. after its UIDVALIDITY changed.
+     */
+    void invalidate_mailbox(std::string_view mailbox);
+
+    /**
+     * Request bodies that are likely to be opened next (e.g. the neighbours
+     * of the selected row in the message list). The fetch callback is invoked
+     * for every key that is neither cached nor already being fetched; the
+     * fetched body is expected to arrive through put() eventually. Fetches
+     * that did not deliver within the prefetch timeout are forgotten.
+     */
+    void prefetch(const std::vector<message_key> &candidates, const fetch_cb_t &fetch);
+
+    /**
+     * Forget about an outstanding prefetch, e.g. because the fetch failed.
+     */
+    void cancel_prefetch(const message_key &key);
+
+    /**
+     * Rewrite sparsely populated segments and the journal to reclaim disk space.
+     */
+    void compact();
+
+    uint64_t size() const;
+    uint64_t budget() const;
+
+private:
+    void replay_journal();
+    void append_journal(char type, const void *payload, size_t length);
+    void journal_blob(const digest_t &digest, const blob_entry &entry);
+    void journal_key(const message_key &key, const digest_t &digest);
+    void rewrite_journal();
+
+    segment_info &open_segment(uint32_t segment, bool create);
+    std::string segment_path(uint32_t segment) const;
+    uint32_t write_blob(const digest_t &digest, std::string_view body, uint64_t &offset);
+    std::optional<std::string> read_blob(const blob_entry &entry);
+
+    void touch(blob_entry &entry);
+    void remove_blob(digest_t digest, bool journaled);
+    void enforce_budget();
+    void compact_segment(uint32_t segment);
+};
+
+}
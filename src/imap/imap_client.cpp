@@ -0,0 +1,393 @@
+#include "imap/imap_client.hpp"
+
+#include <algorithm>
+
+#include "lib/ev/loop_monitor.hpp"
+#include "net/netio_exception.hpp"
+
+namespace rmrf::imap {
+
+namespace {
+
+bool iequals(std::string_view a, std::string_view b) {
+    return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(), [](char ca, char cb) {
+        auto upper = [](char c) {
+            return (c >= 'a' && c <= 'z') ? static_cast<char>(c - 'a' + 'A') : c;
+        };
+
+        return upper(ca) == upper(cb);
+    });
+}
+
+command_status to_command_status(std::string_view status) {
+    if (status == "OK") {
+        return command_status::ok;
+    } else if (status == "NO") {
+        return command_status::no;
+    }
+
+    return command_status::bad;
+}
+
+/**
+ * A tagged BAD response standing in for one the server never sent.
+ */
+imap_response local_failure(const std::string &tag, const std::string &reason) {
+    return imap_response{tag, {imap_value{imap_value::kind::atom, "BAD", {}}}, reason};
+}
+
+uint32_t to_uid(uint64_t value) {
+    return value > UINT32_MAX ? UINT32_MAX : static_cast<uint32_t>(value);
+}
+
+}
+
+imap_client::imap_client(std::shared_ptr<rmrf::net::connection_client> conn_) :
+    conn{conn_},
+    parser{std::bind(&imap_client::handle_response, this, std::placeholders::_1)},
+    tag_counter{0}, pending{},
+    capabilities{}, qresync_enabled{false}, condstore_enabled{false},
+    selected{make_mailbox_state("")},
+    untagged_cb{}, fetch_cb{}, vanished_cb{},
+    corked{false}, out_buffer{}, closed{false}
+{
+    this->conn->set_incomming_data_callback(std::bind(&imap_client::conn_data_in_cb, this, std::placeholders::_1));
+    this->conn->set_closed_callback(std::bind(&imap_client::conn_closed_cb, this));
+}
+
+void imap_client::set_untagged_callback(const untagged_cb_t &cb) {
+    this->untagged_cb = cb;
+}
+
+void imap_client::set_fetch_callback(const fetch_cb_t &cb) {
+    this->fetch_cb = cb;
+}
+
+void imap_client::set_vanished_callback(const vanished_cb_t &cb) {
+    this->vanished_cb = cb;
+}
+
+std::string imap_client::command(std::string_view cmd, completion_cb_t cb) {
+    std::string tag = "A" + std::to_string(++this->tag_counter);
+
+    if (this->closed) {
+        if (cb) {
+            cb(command_status::bad, local_failure(tag, "Connection closed"));
+        }
+
+        return tag;
+    }
+
+    std::string line;
+    line.reserve(tag.size() + cmd.size() + 3);
+    line.append(tag).append(" ").append(cmd).append("\r\n");
+
+    this->pending.push_back(pending_command{tag, cb});
+    this->write(std::move(line));
+
+    return tag;
+}
+
+void imap_client::cork() {
+    this->corked = true;
+}
+
+void imap_client::uncork() {
+    this->corked = false;
+
+    if (!this->out_buffer.empty()) {
+        this->conn->write_data(this->out_buffer);
+        this->out_buffer.clear();
+    }
+}
+
+void imap_client::write(std::string &&data) {
+    if (this->corked) {
+        this->out_buffer += data;
+    } else {
+        this->conn->write_data(data);
+    }
+}
+
+void imap_client::capability(completion_cb_t cb) {
+    this->command("CAPABILITY", cb);
+}
+
+void imap_client::login(std::string_view user, std::string_view password, completion_cb_t cb) {
+    this->command("LOGIN " + quote(user) + " " + quote(password), cb);
+}
+
+void imap_client::logout(completion_cb_t cb) {
+    this->command("LOGOUT", cb);
+}
+
+void imap_client::noop(completion_cb_t cb) {
+    this->command("NOOP", cb);
+}
+
+void imap_client::enable_qresync(completion_cb_t cb) {
+    if (this->has_capability("QRESYNC")) {
+        this->command("ENABLE QRESYNC", cb);
+    } else if (this->has_capability("CONDSTORE")) {
+        this->command("ENABLE CONDSTORE", cb);
+    } else {
+        this->command("NOOP", cb);
+    }
+}
+
+void imap_client::select(const mailbox_state &known, completion_cb_t cb) {
+    std::string cmd = "SELECT " + quote(known.name);
+
+    if (this->qresync_enabled && known.can_resync()) {
+        cmd += " (QRESYNC (" + std::to_string(known.uid_validity) + " " + std::to_string(known.highest_modseq) + "))";
+    } else if (this->has_capability("CONDSTORE")) {
+        cmd += " (CONDSTORE)";
+    }
+
+    this->selected = make_mailbox_state(known.name);
+    this->command(cmd, cb);
+}
+
+void imap_client::synchronize(const mailbox_state &known, sync_cb_t cb) {
+    auto self = this->shared_from_this();
+
+    this->select(known, [self, known, cb](command_status status, const imap_response &) {
+        const mailbox_state &current = self->selected;
+
+        if (status != command_status::ok) {
+            cb(sync_result::failed, current);
+            return;
+        }
+
+        if (current.uid_validity != known.uid_validity) {
+            cb(sync_result::uid_validity_changed, current);
+            return;
+        }
+
+        // QRESYNC already delivered all changes as part of the SELECT
+        if (self->qresync_enabled && known.can_resync()) {
+            cb(sync_result::incremental, current);
+            return;
+        }
+
+        auto done = [self, cb](sync_result result) {
+            return [self, cb, result](command_status, const imap_response &) {
+                cb(result, self->selected);
+            };
+        };
+
+        if (current.modseq_supported && known.can_resync()) {
+            self->command("UID FETCH 1:* (UID FLAGS) (CHANGEDSINCE " + std::to_string(known.highest_modseq) + ")",
+                done(sync_result::incremental));
+        } else {
+            self->command("UID FETCH 1:* (UID FLAGS)", done(sync_result::flags_refetched));
+        }
+    });
+}
+
+void imap_client::fetch_body(uint32_t uid, completion_cb_t cb) {
+    this->command("UID FETCH " + std::to_string(uid) + " (UID BODY.PEEK[])", cb);
+}
+
+bool imap_client::has_capability(std::string_view name) const {
+    return std::any_of(this->capabilities.begin(), this->capabilities.end(), [name](const std::string &cap) {
+        return iequals(cap, name);
+    });
+}
+
+const mailbox_state &imap_client::get_selected() const {
+    return this->selected;
+}
+
+void imap_client::conn_data_in_cb(const std::string &data) {
+    static auto &histogram = rmrf::ev::callback_histogram("imap.client");
+    rmrf::ev::callback_probe probe{histogram};
+
+    // Completion callbacks may drop the last reference to us
+    ptr_type self = this->shared_from_this();
+
+    try {
+        this->parser.feed(data);
+    } catch (const rmrf::net::netio_exception &e) {
+        // The response stream is out of sync; nothing after this can be trusted
+        this->fail_pending(e.what());
+        this->conn->close();
+    }
+}
+
+void imap_client::conn_closed_cb() {
+    ptr_type self = this->shared_from_this();
+
+    this->fail_pending("Connection closed");
+}
+
+void imap_client::fail_pending(const std::string &reason) {
+    this->closed = true;
+    this->out_buffer.clear();
+
+    // Callbacks may issue new commands, which then fail right away
+    std::deque<pending_command> failed;
+    failed.swap(this->pending);
+
+    for (auto &cmd : failed) {
+        if (cmd.cb) {
+            cmd.cb(command_status::bad, local_failure(cmd.tag, reason));
+        }
+    }
+}
+
+void imap_client::handle_response(const imap_response &response) {
+    if (response.is_continuation()) {
+        // We never send synchronising literals, so there is nothing to continue
+        return;
+    }
+
+    if (response.is_untagged()) {
+        this->handle_untagged(response);
+        return;
+    }
+
+    if (const imap_value *code = response.response_code()) {
+        this->handle_response_code(*code);
+    }
+
+    auto it = std::find_if(this->pending.begin(), this->pending.end(), [&response](const pending_command &cmd) {
+        return cmd.tag == response.tag;
+    });
+
+    if (it == this->pending.end()) {
+        return;
+    }
+
+    completion_cb_t cb = std::move(it->cb);
+    this->pending.erase(it);
+
+    if (cb) {
+        cb(to_command_status(response.status()), response);
+    }
+}
+
+void imap_client::handle_untagged(const imap_response &response) {
+    const auto &values = response.values;
+
+    if (values.empty()) {
+        return;
+    }
+
+    if (!response.status().empty()) {
+        if (const imap_value *code = response.response_code()) {
+            this->handle_response_code(*code);
+        }
+    } else if (values.size() >= 2 && values[0].as_number()) {
+        uint32_t number = to_uid(values[0].as_number());
+
+        if (values[1].is_atom("EXISTS")) {
+            this->selected.exists = number;
+        } else if (values[1].is_atom("EXPUNGE")) {
+            this->selected.exists -= this->selected.exists ? 1 : 0;
+        } else if (values[1].is_atom("FETCH") && values.size() >= 3) {
+            this->handle_fetch(number, values[2]);
+        }
+    } else if (values[0].is_atom("CAPABILITY")) {
+        this->set_capabilities(values.begin() + 1, values.end());
+    } else if (values[0].is_atom("ENABLED")) {
+        for (auto it = values.begin() + 1; it != values.end(); ++it) {
+            if (it->is_atom("QRESYNC")) {
+                this->qresync_enabled = true;
+                this->condstore_enabled = true;
+            } else if (it->is_atom("CONDSTORE")) {
+                this->condstore_enabled = true;
+            }
+        }
+    } else if (values[0].is_atom("VANISHED")) {
+        bool earlier = values.size() >= 2 && values[1].is_list() &&
+            !values[1].items.empty() && values[1].items[0].is_atom("EARLIER");
+
+        if (this->vanished_cb && !values.empty()) {
+            this->vanished_cb(parse_uid_set(values.back().text), earlier);
+        }
+    }
+
+    if (this->untagged_cb) {
+        this->untagged_cb(response);
+    }
+}
+
+void imap_client::handle_response_code(const imap_value &code) {
+    if (code.items.empty()) {
+        return;
+    }
+
+    const imap_value &name = code.items[0];
+    uint64_t arg = code.items.size() >= 2 ? code.items[1].as_number() : 0;
+
+    if (name.is_atom("UIDVALIDITY")) {
+        this->selected.uid_validity = to_uid(arg);
+    } else if (name.is_atom("UIDNEXT")) {
+        this->selected.uid_next = to_uid(arg);
+    } else if (name.is_atom("HIGHESTMODSEQ")) {
+        this->selected.highest_modseq = arg;
+        this->selected.modseq_supported = true;
+    } else if (name.is_atom("NOMODSEQ")) {
+        this->selected.modseq_supported = false;
+    } else if (name.is_atom("CAPABILITY")) {
+        this->set_capabilities(code.items.begin() + 1, code.items.end());
+    }
+}
+
+void imap_client::handle_fetch(uint32_t seq, const imap_value &attributes) {
+    message_update update{seq, 0, 0, false, {}, false, {}};
+    const auto &items = attributes.items;
+
+    for (size_t i = 0; i + 1 < items.size(); i++) {
+        const imap_value &name = items[i];
+
+        if (name.is_atom("UID")) {
+            update.uid = to_uid(items[++i].as_number());
+        } else if (name.is_atom("FLAGS")) {
+            update.has_flags = true;
+
+            for (const auto &flag : items[++i].items) {
+                update.flags.push_back(flag.text);
+            }
+        } else if (name.is_atom("MODSEQ")) {
+            const imap_value &modseq = items[++i];
+            update.modseq = modseq.items.empty() ? 0 : modseq.items[0].as_number();
+        } else if (name.is_atom("BODY") || name.is_atom("BINARY")) {
+            // BODY[] is followed by its section and then the literal
+            if (items[i + 1].type == imap_value::kind::section) {
+                i++;
+            }
+
+            if (i + 1 < items.size()) {
+                update.has_body = true;
+                update.body = items[++i].text;
+            }
+        } else {
+            // Skip the value of attributes we are not interested in
+            i++;
+        }
+    }
+
+    if (update.modseq > this->selected.highest_modseq) {
+        this->selected.highest_modseq = update.modseq;
+    }
+
+    if (update.uid >= this->selected.uid_next) {
+        this->selected.uid_next = update.uid + 1;
+    }
+
+    if (this->fetch_cb) {
+        this->fetch_cb(update);
+    }
+}
+
+void imap_client::set_capabilities(std::vector<imap_value>::const_iterator begin, std::vector<imap_value>::const_iterator end) {
+    this->capabilities.clear();
+
+    for (auto it = begin; it != end; ++it) {
+        this->capabilities.push_back(it->text);
+    }
+}
+
+}
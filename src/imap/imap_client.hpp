@@ -0,0 +1,170 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "imap/imap_response.hpp"
+#include "imap/mailbox_state.hpp"
+#include "net/connection_client.hpp"
+
+namespace rmrf::imap {
+
+enum class command_status : uint8_t {
+    ok,
+    no,
+    bad
+};
+
+/**
+ * The outcome of a mailbox synchronisation.
+ */
+enum class sync_result : uint8_t {
+    /** Only changes since the known state were transferred. */
+    incremental,
+    /** The server lacks CONDSTORE; all flags were fetched again. */
+    flags_refetched,
+    /** The UIDVALIDITY changed; the local copy has to be discarded. */
+    uid_validity_changed,
+    /** The mailbox could not be selected. */
+    failed
+};
+
+/**
+ * The data of a single FETCH response that is of interest for synchronisation.
+ */
+struct message_update {
+    uint32_t seq;
+    uint32_t uid;
+    uint64_t modseq;
+    bool has_flags;
+    std::vector<std::string> flags;
+    bool has_body;
+    std::string body;
+};
+
+/**
+ * An asynchronous IMAP4rev1/IMAP4rev2 client engine.
+ *
+ * Commands are tagged and written immediately, so several commands can be
+ * in flight at once (pipelining). Use cork() and uncork() to coalesce a
+ * batch of commands into a single write. Server data is dispatched through
+ * the registered callbacks while the mailbox_state of the selected mailbox
+ * is kept up to date. With CONDSTORE/QRESYNC a reselect of a known mailbox
+ * only transfers changed flags, new messages and expunged UIDs.
+ */
+class imap_client : public std::enable_shared_from_this<imap_client> {
+public:
+    typedef std::shared_ptr<imap_client> ptr_type;
+
+    typedef std::function<void(command_status, const imap_response &)> completion_cb_t;
+    typedef std::function<void(const imap_response &)> untagged_cb_t;
+    typedef std::function<void(const message_update &)> fetch_cb_t;
+    typedef std::function<void(const uid_set_t &, bool)> vanished_cb_t;
+    typedef std::function<void(sync_result, const mailbox_state &)> sync_cb_t;
+
+private:
+    struct pending_command {
+        std::string tag;
+        completion_cb_t cb;
+    };
+
+    std::shared_ptr<rmrf::net::connection_client> conn;
+    imap_response_parser parser;
+
+    uint32_t tag_counter;
+    std::deque<pending_command> pending;
+
+    std::vector<std::string> capabilities;
+    bool qresync_enabled;
+    bool condstore_enabled;
+
+    mailbox_state selected;
+
+    untagged_cb_t untagged_cb;
+    fetch_cb_t fetch_cb;
+    vanished_cb_t vanished_cb;
+
+    bool corked;
+    std::string out_buffer;
+    bool closed;
+
+public:
+    explicit imap_client(std::shared_ptr<rmrf::net::connection_client> conn_);
+
+    imap_client(const imap_client &) = delete;
+    imap_client &operator=(const imap_client &) = delete;
+
+    void set_untagged_callback(const untagged_cb_t &cb);
+    void set_fetch_callback(const fetch_cb_t &cb);
+    void set_vanished_callback(const vanished_cb_t &cb);
+
+    /**
+     * Send a raw command. The tag is generated and prepended automatically.
+     * Once the connection is gone, commands fail right away with BAD.
+     *
+     * @param cmd The command including its arguments but without tag or CRLF
+     * @param cb The callback to invoke once the tagged response arrives
+     * @return The tag assigned to the command
+     */
+    std::string command(std::string_view cmd, completion_cb_t cb);
+
+    /**
+     * Hold back written commands until uncork() so a pipelined batch goes
+     * out in one write.
+     */
+    void cork();
+    void uncork();
+
+    void capability(completion_cb_t cb);
+    void login(std::string_view user, std::string_view password, completion_cb_t cb);
+    void logout(completion_cb_t cb);
+    void noop(completion_cb_t cb);
+
+    /**
+     * Enable QRESYNC (and thereby CONDSTORE) if the server supports it.
+     */
+    void enable_qresync(completion_cb_t cb);
+
+    /**
+     * Select a mailbox, passing the known state to the server if QRESYNC is enabled.
+     */
+    void select(const mailbox_state &known, completion_cb_t cb);
+
+    /**
+     * Select a mailbox and bring the local copy up to date.
+     *
+     * Flag changes and new messages are reported through the fetch callback,
+     * expunged messages through the vanished callback (with QRESYNC) before
+     * the sync callback is invoked with the new state to persist.
+     *
+     * @param known The state persisted after the last synchronisation
+     * @param cb The callback to invoke once the synchronisation is complete
+     */
+    void synchronize(const mailbox_state &known, sync_cb_t cb);
+
+    /**
+     * Fetch the full body of a message without setting the \Seen flag.
+     */
+    void fetch_body(uint32_t uid, completion_cb_t cb);
+
+    bool has_capability(std::string_view name) const;
+    const mailbox_state &get_selected() const;
+
+private:
+    void conn_data_in_cb(const std::string &data);
+    void conn_closed_cb();
+    void fail_pending(const std::string &reason);
+    void handle_response(const imap_response &response);
+    void handle_untagged(const imap_response &response);
+    void handle_response_code(const imap_value &code);
+    void handle_fetch(uint32_t seq, const imap_value &attributes);
+    void set_capabilities(std::vector<imap_value>::const_iterator begin, std::vector<imap_value>::const_iterator end);
+    void write(std::string &&data);
+};
+
+}
@@ -0,0 +1,343 @@
+#include "imap/imap_response.hpp"
+
+#include <array>
+#include <stack>
+
+#include "net/netio_exception.hpp"
+
+namespace rmrf::imap {
+
+namespace {
+
+bool iequals(std::string_view a, std::string_view b) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+
+    for (size_t i = 0; i < a.size(); i++) {
+        char ca = (a[i] >= 'a' && a[i] <= 'z') ? static_cast<char>(a[i] - 'a' + 'A') : a[i];
+        char cb = (b[i] >= 'a' && b[i] <= 'z') ? static_cast<char>(b[i] - 'a' + 'A') : b[i];
+
+        if (ca != cb) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool is_atom_char(char c) {
+    switch (c) {
+    case ' ':
+    case '(':
+    case ')':
+    case '[':
+    case ']':
+    case '"':
+    case '{':
+        return false;
+    default:
+        return true;
+    }
+}
+
+/**
+ * Check if the line ends with a literal marker ({n} or {n+}) and extract its size.
+ */
+bool literal_marker(std::string_view line, size_t &size) {
+    if (line.empty() || line.back() != '}') {
+        return false;
+    }
+
+    size_t open = line.rfind('{');
+
+    if (open == std::string_view::npos) {
+        return false;
+    }
+
+    std::string_view digits = line.substr(open + 1, line.size() - open - 2);
+
+    if (!digits.empty() && digits.back() == '+') {
+        digits.remove_suffix(1);
+    }
+
+    if (digits.empty() || digits.size() > 18) {
+        return false;
+    }
+
+    size = 0;
+
+    for (char c : digits) {
+        if (c < '0' || c > '9') {
+            return false;
+        }
+
+        size = size * 10 + static_cast<size_t>(c - '0');
+    }
+
+    return true;
+}
+
+const std::array<std::string_view, 5> status_atoms = {"OK", "NO", "BAD", "BYE", "PREAUTH"};
+
+}
+
+bool imap_value::is_atom(std::string_view name) const {
+    return this->type == kind::atom && iequals(this->text, name);
+}
+
+bool imap_value::is_list() const {
+    return this->type == kind::list;
+}
+
+uint64_t imap_value::as_number() const {
+    if (this->type != kind::atom || this->text.empty()) {
+        return 0;
+    }
+
+    uint64_t result = 0;
+
+    for (char c : this->text) {
+        if (c < '0' || c > '9') {
+            return 0;
+        }
+
+        result = result * 10 + static_cast<uint64_t>(c - '0');
+    }
+
+    return result;
+}
+
+bool imap_response::is_untagged() const {
+    return this->tag == "*";
+}
+
+bool imap_response::is_continuation() const {
+    return this->tag == "+";
+}
+
+std::string_view imap_response::status() const {
+    if (this->values.empty()) {
+        return {};
+    }
+
+    for (auto s : status_atoms) {
+        if (this->values[0].is_atom(s)) {
+            return s;
+        }
+    }
+
+    return {};
+}
+
+const imap_value *imap_response::response_code() const {
+    if (this->status().empty() || this->values.size() < 2 || this->values[1].type != imap_value::kind::section) {
+        return nullptr;
+    }
+
+    return &this->values[1];
+}
+
+namespace {
+
+/**
+ * Parse values starting at pos into out. If single is set, parsing stops
+ * after the first complete top level value.
+ *
+ * @return The position after the last parsed value
+ */
+size_t parse_values(std::string_view line, size_t pos, std::vector<std::string> &literals, size_t &literal_idx, std::vector<imap_value> &out, bool single) {
+    std::stack<std::vector<imap_value> *> nesting;
+    nesting.push(&out);
+
+    while (pos < line.size()) {
+        if (single && nesting.size() == 1 && !out.empty()) {
+            break;
+        }
+
+        char c = line[pos];
+        auto &current = *nesting.top();
+
+        if (c == ' ') {
+            pos++;
+        } else if (c == '(' || c == '[') {
+            current.push_back(imap_value{c == '(' ? imap_value::kind::list : imap_value::kind::section, {}, {}});
+            nesting.push(&current.back().items);
+            pos++;
+        } else if (c == ')' || c == ']') {
+            if (nesting.size() > 1) {
+                nesting.pop();
+            }
+
+            pos++;
+        } else if (c == '"') {
+            std::string str;
+            pos++;
+
+            while (pos < line.size() && line[pos] != '"') {
+                if (line[pos] == '\\' && pos + 1 < line.size()) {
+                    pos++;
+                }
+
+                str.push_back(line[pos++]);
+            }
+
+            pos++;
+            current.push_back(imap_value{imap_value::kind::string, std::move(str), {}});
+        } else if (c == '{') {
+            size_t close = line.find('}', pos);
+            pos = close == std::string_view::npos ? line.size() : close + 1;
+
+            std::string str;
+
+            if (literal_idx < literals.size()) {
+                str = std::move(literals[literal_idx++]);
+            }
+
+            current.push_back(imap_value{imap_value::kind::string, std::move(str), {}});
+        } else {
+            size_t end = pos;
+
+            while (end < line.size() && is_atom_char(line[end])) {
+                end++;
+            }
+
+            std::string_view atom = line.substr(pos, end - pos);
+            pos = end;
+
+            if (iequals(atom, "NIL")) {
+                current.push_back(imap_value{imap_value::kind::nil, {}, {}});
+            } else {
+                current.push_back(imap_value{imap_value::kind::atom, std::string(atom), {}});
+            }
+        }
+    }
+
+    return pos;
+}
+
+}
+
+imap_response parse_response(std::string_view line, std::vector<std::string> &literals) {
+    imap_response result{{}, {}, {}};
+
+    size_t pos = line.find(' ');
+    result.tag = std::string(line.substr(0, pos));
+
+    if (pos == std::string_view::npos) {
+        return result;
+    }
+
+    pos++;
+
+    if (result.is_continuation()) {
+        result.text = std::string(line.substr(pos));
+        return result;
+    }
+
+    size_t literal_idx = 0;
+    pos = parse_values(line, pos, literals, literal_idx, result.values, true);
+
+    if (result.status().empty()) {
+        parse_values(line, pos, literals, literal_idx, result.values, false);
+        return result;
+    }
+
+    // Status responses carry an optional response code followed by free text
+    if (pos + 1 < line.size() && line[pos + 1] == '[') {
+        std::vector<imap_value> code;
+        pos = parse_values(line, pos + 1, literals, literal_idx, code, true);
+        result.values.push_back(std::move(code.front()));
+    }
+
+    if (pos < line.size() && line[pos] == ' ') {
+        pos++;
+    }
+
+    result.text = std::string(line.substr(std::min(pos, line.size())));
+    return result;
+}
+
+std::string quote(std::string_view str) {
+    std::string result;
+    result.reserve(str.size() + 2);
+    result.push_back('"');
+
+    for (char c : str) {
+        if (c == '"' || c == '\\') {
+            result.push_back('\\');
+        }
+
+        result.push_back(c);
+    }
+
+    result.push_back('"');
+    return result;
+}
+
+imap_response_parser::imap_response_parser(response_cb_t response_cb_, size_t max_line_size_, size_t max_literal_size_) :
+    response_cb{response_cb_},
+    max_line_size{max_line_size_},
+    max_literal_size{max_literal_size_},
+    line{}, literals{}, literal_remaining{0}
+{
+    // NOP
+}
+
+void imap_response_parser::feed(std::string_view data) {
+    while (!data.empty()) {
+        if (this->literal_remaining) {
+            size_t n = std::min(this->literal_remaining, data.size());
+            this->literals.back().append(data.data(), n);
+            this->literal_remaining -= n;
+            data.remove_prefix(n);
+            continue;
+        }
+
+        size_t eol = data.find('\n');
+
+        if (eol == std::string_view::npos) {
+            this->line.append(data.data(), data.size());
+
+            if (this->line.size() > this->max_line_size) {
+                throw rmrf::net::netio_exception("IMAP response line exceeds size limit.");
+            }
+
+            return;
+        }
+
+        this->line.append(data.data(), eol);
+        data.remove_prefix(eol + 1);
+
+        if (!this->line.empty() && this->line.back() == '\r') {
+            this->line.pop_back();
+        }
+
+        this->complete_line();
+    }
+}
+
+void imap_response_parser::complete_line() {
+    size_t size = 0;
+
+    if (literal_marker(this->line, size)) {
+        if (size > this->max_literal_size) {
+            throw rmrf::net::netio_exception("IMAP literal exceeds size limit.");
+        }
+
+        this->literals.emplace_back();
+        this->literals.back().reserve(size);
+        this->literal_remaining = size;
+
+        // The response continues with another line part after the literal
+        return;
+    }
+
+    imap_response response = parse_response(this->line, this->literals);
+    this->line.clear();
+    this->literals.clear();
+
+    this->response_cb(response);
+}
+
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace rmrf::imap {
+
+/**
+ * A single syntactic element of a server response.
+ */
+struct imap_value {
+    enum class kind : uint8_t {
+        atom,
+        string,
+        nil,
+        list,
+        section
+    };
+
+    kind type;
+    std::string text;
+    std::vector<imap_value> items;
+
+    bool is_atom(std::string_view name) const;
+    bool is_list() const;
+
+    /**
+     * Interpret the value as an unsigned number.
+     * @return The number or 0 if the value is not numeric
+     */
+    uint64_t as_number() const;
+};
+
+/**
+ * A complete response as sent by the server, including all literals.
+ */
+struct imap_response {
+    /**
+     * The tag of the response: "*" for untagged data, "+" for continuation
+     * requests or the tag of the command being completed.
+     */
+    std::string tag;
+
+    /**
+     * The parsed elements following the tag.
+     */
+    std::vector<imap_value> values;
+
+    /**
+     * The human readable text of status responses (OK, NO, BAD, BYE, PREAUTH).
+     */
+    std::string text;
+
+    bool is_untagged() const;
+    bool is_continuation() const;
+
+    /**
+     * @return The status atom (OK, NO, BAD, ...) or an empty view if this is no status response
+     */
+    std::string_view status() const;
+
+    /**
+     * @return The bracketed response code of a status response or nullptr if there is none
+     */
+    const imap_value *response_code() const;
+};
+
+/**
+ * This class splits the incoming byte stream into complete IMAP responses.
+ *
+ * Data is consumed as it arrives: line parts are scanned exactly once and
+ * literal payloads are copied straight into their preallocated target
+ * string, so large message bodies never get rescanned for line endings.
+ */
+class imap_response_parser {
+public:
+    typedef std::function<void(const imap_response &)> response_cb_t;
+
+private:
+    response_cb_t response_cb;
+    const size_t max_line_size;
+    const size_t max_literal_size;
+
+    std::string line;
+    std::vector<std::string> literals;
+    size_t literal_remaining;
+
+public:
+    imap_response_parser(response_cb_t response_cb_, size_t max_line_size_ = 64 * 1024, size_t max_literal_size_ = 256 * 1024 * 1024);
+
+    /**
+     * Feed data received from the server into the parser.
+     * Every response that gets completed by this data is passed to the callback.
+     *
+     * @throws rmrf::net::netio_exception if the server exceeds the configured limits
+     */
+    void feed(std::string_view data);
+
+private:
+    void complete_line();
+};
+
+/**
+ * Parse a single response line with its literals already extracted.
+ * The line contains {n} markers where literals[i] belong.
+ */
+imap_response parse_response(std::string_view line, std::vector<std::string> &literals);
+
+/**
+ * Quote a string for use as an astring argument in a command.
+ */
+std::string quote(std::string_view str);
+
+}
@@ -0,0 +1,98 @@
+#include "imap/mailbox_state.hpp"
+
+#include <limits>
+
+namespace rmrf::imap {
+
+namespace {
+
+bool parse_seq_number(std::string_view str, uint32_t &value) {
+    if (str == "*") {
+        value = std::numeric_limits<uint32_t>::max();
+        return true;
+    }
+
+    if (str.empty() || str.size() > 10) {
+        return false;
+    }
+
+    uint64_t result = 0;
+
+    for (char c : str) {
+        if (c < '0' || c > '9') {
+            return false;
+        }
+
+        result = result * 10 + static_cast<uint64_t>(c - '0');
+    }
+
+    if (result > std::numeric_limits<uint32_t>::max()) {
+        return false;
+    }
+
+    value = static_cast<uint32_t>(result);
+    return true;
+}
+
+}
+
+uid_set_t parse_uid_set(std::string_view set) {
+    uid_set_t result;
+
+    while (!set.empty()) {
+        size_t comma = set.find(',');
+        std::string_view range = set.substr(0, comma);
+        set = comma == std::string_view::npos ? std::string_view{} : set.substr(comma + 1);
+
+        size_t colon = range.find(':');
+        uint32_t first = 0;
+        uint32_t last = 0;
+
+        if (!parse_seq_number(range.substr(0, colon), first)) {
+            continue;
+        }
+
+        if (colon == std::string_view::npos) {
+            last = first;
+        } else if (!parse_seq_number(range.substr(colon + 1), last)) {
+            continue;
+        }
+
+        if (first > last) {
+            std::swap(first, last);
+        }
+
+        result.emplace_back(first, last);
+    }
+
+    return result;
+}
+
+std::string format_uid_set(const uid_set_t &set) {
+    std::string result;
+
+    for (const auto &range : set) {
+        if (!result.empty()) {
+            result.push_back(',');
+        }
+
+        result += range.first == std::numeric_limits<uint32_t>::max() ? std::string("*") : std::to_string(range.first);
+
+        if (range.first != range.second) {
+            result.push_back(':');
+            result += range.second == std::numeric_limits<uint32_t>::max() ? std::string("*") : std::to_string(range.second);
+        }
+    }
+
+    return result;
+}
+
+bool mailbox_state::can_resync() const {
+    return this->uid_validity && this->modseq_supported && this->highest_modseq;
+}
+
+mailbox_state make_mailbox_state(std::string_view name) {
+    return mailbox_state{std::string(name), 0, 0, 0, 0, false};
+}
+
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace rmrf::imap {
+
+/**
+ * A set of UIDs as a list of inclusive ranges, e.g. "1:3,7,9:12".
+ */
+typedef std::vector<std::pair<uint32_t, uint32_t>> uid_set_t;
+
+/**
+ * Parse an IMAP sequence set. The "*" wildcard maps to UINT32_MAX.
+ */
+uid_set_t parse_uid_set(std::string_view set);
+
+/**
+ * Format an IMAP sequence set.
+ */
+std::string format_uid_set(const uid_set_t &set);
+
+/**
+ * The synchronisation state of a mailbox as needed to resume it cheaply.
+ *
+ * Persist this structure together with the local copy of the mailbox.
+ * When the mailbox gets selected again with CONDSTORE/QRESYNC, only the
+ * changes since highest_modseq will be transferred.
+ */
+struct mailbox_state {
+    std::string name;
+    uint32_t uid_validity;
+    uint32_t uid_next;
+    uint64_t highest_modseq;
+    uint32_t exists;
+    bool modseq_supported;
+
+    /**
+     * @return true if this state contains enough information for a quick resync
+     */
+    bool can_resync() const;
+};
+
+mailbox_state make_mailbox_state(std::string_view name);
+
+}
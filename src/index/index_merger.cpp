@@ -0,0 +1,71 @@
+#include "index/index_merger.hpp"
+
+#include <algorithm>
+
+namespace rmrf::index {
+
+index_merger::index_merger() : m{}, cv{}, pending{}, stopping{false}, worker{} {
+    this->worker = std::thread(&index_merger::run, this);
+}
+
+index_merger::~index_merger() {
+    {
+        std::lock_guard<std::mutex> lock(this->m);
+        this->stopping = true;
+    }
+
+    this->cv.notify_all();
+    this->worker.join();
+}
+
+void index_merger::schedule(const mailbox_index::ptr_type &idx) {
+    {
+        std::lock_guard<std::mutex> lock(this->m);
+
+        // Avoid queueing the same index twice
+        auto same = [&idx](const std::weak_ptr<mailbox_index> &p) {
+            return p.lock() == idx;
+        };
+
+        if (std::any_of(this->pending.begin(), this->pending.end(), same)) {
+            return;
+        }
+
+        this->pending.push_back(idx);
+    }
+
+    this->cv.notify_one();
+}
+
+void index_merger::schedule_if_needed(const mailbox_index::ptr_type &idx) {
+    if (idx->needs_merge()) {
+        this->schedule(idx);
+    }
+}
+
+void index_merger::run() {
+    std::unique_lock<std::mutex> lock(this->m);
+
+    while (true) {
+        this->cv.wait(lock, [this]() {
+            return this->stopping || !this->pending.empty();
+        });
+
+        if (this->stopping) {
+            return;
+        }
+
+        auto idx = this->pending.front().lock();
+        this->pending.pop_front();
+
+        if (!idx) {
+            continue;
+        }
+
+        lock.unlock();
+        idx->merge();
+        lock.lock();
+    }
+}
+
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "index/mailbox_index.hpp"
+
+namespace rmrf::index {
+
+/**
+ * This class runs index merges on a dedicated background thread so
+ * delivery and flag updates never wait for segment compaction.
+ */
+class index_merger {
+private:
+    std::mutex m;
+    std::condition_variable cv;
+    std::deque<std::weak_ptr<mailbox_index>> pending;
+    bool stopping;
+    std::thread worker;
+
+public:
+    index_merger();
+    ~index_merger();
+
+    index_merger(const index_merger &) = delete;
+    index_merger &operator=(const index_merger &) = delete;
+
+    /**
+     * Queue a merge of the given index.
+     * Indexes destroyed before their turn are skipped.
+     */
+    void schedule(const mailbox_index::ptr_type &idx);
+
+    /**
+     * Queue a merge only if the index reports that it needs one.
+     */
+    void schedule_if_needed(const mailbox_index::ptr_type &idx);
+
+private:
+    void run();
+};
+
+}
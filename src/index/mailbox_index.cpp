@@ -0,0 +1,268 @@
+#include "index/mailbox_index.hpp"
+
+#include <algorithm>
+
+#include "index/tokenizer.hpp"
+
+namespace rmrf::index {
+
+namespace {
+
+constexpr size_t field_index(index_field field) {
+    return static_cast<size_t>(field);
+}
+
+void insert_sorted(std::vector<message_uid_t> &uids, message_uid_t uid) {
+    if (uids.empty() || uids.back() < uid) {
+        uids.push_back(uid);
+        return;
+    }
+
+    auto it = std::lower_bound(uids.begin(), uids.end(), uid);
+
+    if (it == uids.end() || *it != uid) {
+        uids.insert(it, uid);
+    }
+}
+
+}
+
+mailbox_index::mailbox_index(size_t merge_threshold_) :
+    m{}, merge_mutex{},
+    base{std::make_shared<const base_segment_type>()},
+    merging{}, delta{},
+    expunged{}, flags{},
+    delta_postings{0}, merge_threshold{merge_threshold_}
+{
+    // NOP
+}
+
+void mailbox_index::add_tokens(index_field field, message_uid_t uid, std::string_view text) {
+    auto &terms = this->delta[field_index(field)];
+
+    tokenize(text, [this, &terms, uid](std::string_view token) {
+        auto &uids = terms[std::string(token)];
+        size_t before = uids.size();
+        insert_sorted(uids, uid);
+        this->delta_postings += uids.size() - before;
+    });
+}
+
+void mailbox_index::add_message(const indexed_message &msg) {
+    // Decoding is the expensive part, so do it before taking the lock
+    const std::string body = decode_transfer_encoding(msg.body, msg.transfer_encoding);
+
+    write_lock_type lock(this->m);
+
+    this->expunged.erase(msg.uid);
+    this->flags[msg.uid] = msg.flags;
+
+    this->add_tokens(index_field::from, msg.uid, msg.from);
+    this->add_tokens(index_field::to, msg.uid, msg.to);
+    this->add_tokens(index_field::subject, msg.uid, msg.subject);
+    this->add_tokens(index_field::body, msg.uid, body);
+}
+
+void mailbox_index::set_flags(message_uid_t uid, uint32_t new_flags) {
+    write_lock_type lock(this->m);
+
+    auto it = this->flags.find(uid);
+
+    if (it != this->flags.end()) {
+        it->second = new_flags;
+    }
+}
+
+void mailbox_index::remove_message(message_uid_t uid) {
+    write_lock_type lock(this->m);
+
+    if (this->flags.erase(uid)) {
+        this->expunged.insert(uid);
+    }
+}
+
+std::vector<message_uid_t> mailbox_index::lookup(index_field field, const std::string &token) const {
+    if (field == index_field::any) {
+        std::vector<message_uid_t> result;
+
+        for (size_t f = 0; f < index_field_count; f++) {
+            result = unite_uids(result, this->lookup(static_cast<index_field>(f), token));
+        }
+
+        return result;
+    }
+
+    const size_t idx = field_index(field);
+    std::vector<message_uid_t> result;
+
+    auto base_it = (*this->base)[idx].find(token);
+
+    if (base_it != (*this->base)[idx].end()) {
+        base_it->second->decode_into(result);
+    }
+
+    if (this->merging) {
+        auto merging_it = (*this->merging)[idx].find(token);
+
+        if (merging_it != (*this->merging)[idx].end()) {
+            result = unite_uids(result, merging_it->second);
+        }
+    }
+
+    auto delta_it = this->delta[idx].find(token);
+
+    if (delta_it != this->delta[idx].end()) {
+        result = unite_uids(result, delta_it->second);
+    }
+
+    return result;
+}
+
+std::vector<message_uid_t> mailbox_index::search(const search_query &query) const {
+    read_lock_type lock(this->m);
+
+    std::vector<message_uid_t> result;
+
+    if (query.match_none) {
+        return result;
+    }
+
+    if (query.terms.empty()) {
+        result.reserve(this->flags.size());
+
+        for (const auto &entry : this->flags) {
+            result.push_back(entry.first);
+        }
+
+        std::sort(result.begin(), result.end());
+    } else {
+        bool first = true;
+
+        for (const auto &term : query.terms) {
+            auto uids = this->lookup(term.field, term.token);
+            result = first ? std::move(uids) : intersect_uids(result, uids);
+            first = false;
+
+            if (result.empty()) {
+                return result;
+            }
+        }
+    }
+
+    // Drop expunged messages and apply flag filters in one pass
+    auto is_excluded = [this, &query](message_uid_t uid) {
+        auto it = this->flags.find(uid);
+
+        if (it == this->flags.end()) {
+            return true;
+        }
+
+        return (it->second & query.required_flags) != query.required_flags ||
+            (it->second & query.excluded_flags) != 0;
+    };
+
+    result.erase(std::remove_if(result.begin(), result.end(), is_excluded), result.end());
+    return result;
+}
+
+std::vector<message_uid_t> mailbox_index::search(std::string_view query) const {
+    return this->search(parse_query(query));
+}
+
+size_t mailbox_index::size() const {
+    read_lock_type lock(this->m);
+
+    return this->flags.size();
+}
+
+bool mailbox_index::needs_merge() const {
+    read_lock_type lock(this->m);
+
+    return this->delta_postings >= this->merge_threshold ||
+        this->expunged.size() * 8 >= this->flags.size() + 8;
+}
+
+void mailbox_index::merge() {
+    std::lock_guard<std::mutex> merge_lock(this->merge_mutex);
+
+    std::shared_ptr<const base_segment_type> old_base;
+    std::shared_ptr<const delta_segment_type> frozen;
+    std::unordered_set<message_uid_t> dead;
+
+    // Freeze the current delta; new updates go into a fresh one meanwhile
+    {
+        write_lock_type lock(this->m);
+
+        old_base = this->base;
+        frozen = std::make_shared<const delta_segment_type>(std::move(this->delta));
+        this->delta = delta_segment_type{};
+        this->merging = frozen;
+        this->delta_postings = 0;
+        dead = this->expunged;
+    }
+
+    auto new_base = std::make_shared<base_segment_type>();
+    std::vector<message_uid_t> uids;
+
+    auto is_dead = [&dead](message_uid_t uid) {
+        return dead.count(uid) != 0;
+    };
+
+    for (size_t f = 0; f < index_field_count; f++) {
+        const auto &old_terms = (*old_base)[f];
+        const auto &new_terms = (*frozen)[f];
+        auto &merged = (*new_base)[f];
+
+        merged.reserve(old_terms.size() + new_terms.size());
+
+        for (const auto &entry : old_terms) {
+            auto update = new_terms.find(entry.first);
+
+            if (update == new_terms.end() && dead.empty()) {
+                merged.emplace(entry.first, entry.second);
+                continue;
+            }
+
+            uids.clear();
+            entry.second->decode_into(uids);
+
+            if (update != new_terms.end()) {
+                uids = unite_uids(uids, update->second);
+            }
+
+            const size_t before = uids.size();
+            uids.erase(std::remove_if(uids.begin(), uids.end(), is_dead), uids.end());
+
+            if (update == new_terms.end() && uids.size() == before) {
+                // None of the expunged messages were in this list
+                merged.emplace(entry.first, entry.second);
+            } else if (!uids.empty()) {
+                merged.emplace(entry.first, std::make_shared<const posting_list>(uids));
+            }
+        }
+
+        for (const auto &entry : new_terms) {
+            if (old_terms.count(entry.first)) {
+                continue;
+            }
+
+            uids = entry.second;
+            uids.erase(std::remove_if(uids.begin(), uids.end(), is_dead), uids.end());
+
+            if (!uids.empty()) {
+                merged.emplace(entry.first, std::make_shared<const posting_list>(uids));
+            }
+        }
+    }
+
+    write_lock_type lock(this->m);
+
+    this->base = std::move(new_base);
+    this->merging.reset();
+
+    for (message_uid_t uid : dead) {
+        this->expunged.erase(uid);
+    }
+}
+
+}
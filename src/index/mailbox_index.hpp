@@ -0,0 +1,126 @@
+#pragma once
+
+#include <array>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "index/posting_list.hpp"
+#include "index/query.hpp"
+
+namespace rmrf::index {
+
+/**
+ * The parts of a message that get fed into the index.
+ * The body is the raw text part; it gets decoded according to
+ * transfer_encoding before tokenisation.
+ */
+struct indexed_message {
+    message_uid_t uid;
+    std::string from;
+    std::string to;
+    std::string subject;
+    std::string body;
+    std::string transfer_encoding;
+    uint32_t flags;
+};
+
+/**
+ * An inverted index over all messages of a single mailbox.
+ *
+ * Newly delivered messages land in a small uncompressed delta segment that
+ * is cheap to update. merge() folds the delta into the compressed base
+ * segment and may run on a background thread while queries and updates
+ * continue to be served.
+ */
+class mailbox_index : public std::enable_shared_from_this<mailbox_index> {
+public:
+    typedef std::shared_ptr<mailbox_index> ptr_type;
+
+private:
+    // Lists are shared between base generations, so a merge only has to
+    // re-encode the terms it actually touches
+    typedef std::unordered_map<std::string, std::shared_ptr<const posting_list>> base_terms_type;
+    typedef std::unordered_map<std::string, std::vector<message_uid_t>> delta_terms_type;
+    typedef std::array<base_terms_type, index_field_count> base_segment_type;
+    typedef std::array<delta_terms_type, index_field_count> delta_segment_type;
+
+    typedef std::shared_mutex mutex_type;
+    typedef std::shared_lock<mutex_type> read_lock_type;
+    typedef std::unique_lock<mutex_type> write_lock_type;
+
+    mutable mutex_type m;
+    std::mutex merge_mutex;
+
+    std::shared_ptr<const base_segment_type> base;
+    std::shared_ptr<const delta_segment_type> merging;
+    delta_segment_type delta;
+
+    std::unordered_set<message_uid_t> expunged;
+    std::unordered_map<message_uid_t, uint32_t> flags;
+
+    size_t delta_postings;
+    const size_t merge_threshold;
+
+public:
+    /**
+     * @param merge_threshold_ The number of postings in the delta segment
+     *        after which needs_merge() starts to report true
+     */
+    explicit mailbox_index(size_t merge_threshold_ = 1 << 18);
+
+    mailbox_index(const mailbox_index &) = delete;
+    mailbox_index &operator=(const mailbox_index &) = delete;
+
+    /**
+     * Add a newly delivered message to the index.
+     */
+    void add_message(const indexed_message &msg);
+
+    /**
+     * Update the flags of a message after a flag change.
+     */
+    void set_flags(message_uid_t uid, uint32_t new_flags);
+
+    /**
+     * Remove an expunged message from all search results.
+     * Its postings are physically dropped on the next merge.
+     */
+    void remove_message(message_uid_t uid);
+
+    /**
+     * Run a query against the index.
+     *
+     * @return The UIDs of all matching messages in ascending order
+     * @throws query_exception If a query string does not parse
+     */
+    std::vector<message_uid_t> search(const search_query &query) const;
+    std::vector<message_uid_t> search(std::string_view query) const;
+
+    /**
+     * @return The number of messages currently indexed
+     */
+    size_t size() const;
+
+    /**
+     * Check if enough updates accumulated to make a merge worthwhile.
+     */
+    bool needs_merge() const;
+
+    /**
+     * Fold all pending updates into the compressed base segment.
+     * This is safe to call from any thread.
+     */
+    void merge();
+
+private:
+    void add_tokens(index_field field, message_uid_t uid, std::string_view text);
+    std::vector<message_uid_t> lookup(index_field field, const std::string &token) const;
+};
+
+}
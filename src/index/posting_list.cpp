@@ -0,0 +1,200 @@
+#include "index/posting_list.hpp"
+
+#include <algorithm>
+#include <iterator>
+
+namespace rmrf::index {
+
+namespace {
+
+void put_varint(std::vector<uint8_t> &out, uint32_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+uint32_t get_varint(const uint8_t *&p) {
+    uint32_t value = 0;
+
+    for (unsigned shift = 0; shift < 35; shift += 7) {
+        uint8_t b = *p++;
+        value |= static_cast<uint32_t>(b & 0x7F) << shift;
+
+        if (!(b & 0x80)) {
+            break;
+        }
+    }
+
+    return value;
+}
+
+uint8_t bit_width(uint32_t value) {
+    return value ? static_cast<uint8_t>(32 - __builtin_clz(value)) : 0;
+}
+
+void pack_block(std::vector<uint8_t> &out, const uint32_t (&deltas)[posting_list::block_size]) {
+    uint32_t combined = 0;
+
+    for (uint32_t d : deltas) {
+        combined |= d;
+    }
+
+    const uint8_t width = bit_width(combined);
+    out.push_back(width);
+
+    if (!width) {
+        return;
+    }
+
+    const size_t offset = out.size();
+    out.resize(offset + posting_list::block_size * width / 8);
+
+    uint8_t *p = out.data() + offset;
+    uint64_t acc = 0;
+    unsigned bits = 0;
+
+    for (uint32_t d : deltas) {
+        acc |= static_cast<uint64_t>(d) << bits;
+        bits += width;
+
+        while (bits >= 8) {
+            *p++ = static_cast<uint8_t>(acc);
+            acc >>= 8;
+            bits -= 8;
+        }
+    }
+}
+
+const uint8_t *unpack_block(const uint8_t *p, uint32_t (&deltas)[posting_list::block_size]) {
+    const uint8_t width = *p++;
+
+    if (!width) {
+        std::fill(std::begin(deltas), std::end(deltas), 0);
+        return p;
+    }
+
+    const uint64_t mask = (uint64_t{1} << width) - 1;
+    uint64_t acc = 0;
+    unsigned bits = 0;
+
+    for (uint32_t &d : deltas) {
+        while (bits < width) {
+            acc |= static_cast<uint64_t>(*p++) << bits;
+            bits += 8;
+        }
+
+        d = static_cast<uint32_t>(acc & mask);
+        acc >>= width;
+        bits -= width;
+    }
+
+    return p;
+}
+
+}
+
+posting_list::posting_list() : blocks{}, tail{}, tail_count{0}, count{0}, last{0} {
+    // NOP
+}
+
+posting_list::posting_list(const std::vector<message_uid_t> &sorted_uids) : posting_list{} {
+    for (message_uid_t uid : sorted_uids) {
+        append(uid);
+    }
+}
+
+bool posting_list::append(message_uid_t uid) {
+    if (count && uid <= last) {
+        return false;
+    }
+
+    put_varint(tail, uid - last);
+    last = uid;
+    count++;
+
+    if (++tail_count == block_size) {
+        flush_tail();
+    }
+
+    return true;
+}
+
+void posting_list::flush_tail() {
+    uint32_t deltas[block_size];
+    const uint8_t *p = tail.data();
+
+    for (uint32_t &d : deltas) {
+        d = get_varint(p);
+    }
+
+    pack_block(blocks, deltas);
+    tail.clear();
+    tail_count = 0;
+}
+
+size_t posting_list::size() const {
+    return count;
+}
+
+bool posting_list::empty() const {
+    return !count;
+}
+
+size_t posting_list::encoded_size() const {
+    return blocks.size() + tail.size();
+}
+
+message_uid_t posting_list::back() const {
+    return last;
+}
+
+void posting_list::decode_into(std::vector<message_uid_t> &out) const {
+    out.reserve(out.size() + count);
+
+    message_uid_t base = 0;
+    const uint8_t *p = blocks.data();
+    const uint8_t *end = p + blocks.size();
+
+    uint32_t deltas[block_size];
+
+    while (p < end) {
+        p = unpack_block(p, deltas);
+
+        for (uint32_t d : deltas) {
+            base += d;
+            out.push_back(base);
+        }
+    }
+
+    p = tail.data();
+
+    for (uint32_t i = 0; i < tail_count; i++) {
+        base += get_varint(p);
+        out.push_back(base);
+    }
+}
+
+std::vector<message_uid_t> posting_list::decode() const {
+    std::vector<message_uid_t> result;
+    decode_into(result);
+    return result;
+}
+
+std::vector<message_uid_t> intersect_uids(const std::vector<message_uid_t> &a, const std::vector<message_uid_t> &b) {
+    std::vector<message_uid_t> result;
+    result.reserve(std::min(a.size(), b.size()));
+    std::set_intersection(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(result));
+    return result;
+}
+
+std::vector<message_uid_t> unite_uids(const std::vector<message_uid_t> &a, const std::vector<message_uid_t> &b) {
+    std::vector<message_uid_t> result;
+    result.reserve(a.size() + b.size());
+    std::set_union(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(result));
+    return result;
+}
+
+}
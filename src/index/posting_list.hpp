@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace rmrf::index {
+
+/**
+ * The identifier of a message within a mailbox (the IMAP UID).
+ */
+typedef uint32_t message_uid_t;
+
+/**
+ * A compressed, append-only list of message UIDs in ascending order.
+ *
+ * UIDs are stored as deltas to their predecessor. Full blocks of
+ * block_size deltas are bit-packed with the width of the largest delta
+ * in that block (the BP128 layout), while the trailing partial block is
+ * kept as LEB128 varints so appending stays cheap.
+ */
+class posting_list {
+public:
+    static constexpr size_t block_size = 128;
+
+private:
+    std::vector<uint8_t> blocks;
+    std::vector<uint8_t> tail;
+    uint32_t tail_count;
+    uint32_t count;
+    message_uid_t last;
+
+public:
+    posting_list();
+
+    /**
+     * Build a posting list from UIDs that are already sorted and unique.
+     */
+    explicit posting_list(const std::vector<message_uid_t> &sorted_uids);
+
+    /**
+     * Append a UID to the list.
+     *
+     * @param uid The UID to append; must be larger than every UID already contained
+     * @return false if the UID was not appended because it would break ordering
+     */
+    bool append(message_uid_t uid);
+
+    /**
+     * @return The number of UIDs in the list
+     */
+    size_t size() const;
+    bool empty() const;
+
+    /**
+     * @return The number of bytes used by the encoded representation
+     */
+    size_t encoded_size() const;
+
+    /**
+     * @return The largest UID contained or 0 if the list is empty
+     */
+    message_uid_t back() const;
+
+    /**
+     * Decode the list, appending all UIDs to the given vector.
+     */
+    void decode_into(std::vector<message_uid_t> &out) const;
+    std::vector<message_uid_t> decode() const;
+
+private:
+    void flush_tail();
+};
+
+/**
+ * Intersect two sorted UID lists.
+ */
+std::vector<message_uid_t> intersect_uids(const std::vector<message_uid_t> &a, const std::vector<message_uid_t> &b);
+
+/**
+ * Unite two sorted UID lists.
+ */
+std::vector<message_uid_t> unite_uids(const std::vector<message_uid_t> &a, const std::vector<message_uid_t> &b);
+
+}
@@ -0,0 +1,140 @@
+#include "index/query.hpp"
+
+#include "index/query_exception.hpp"
+#include "index/tokenizer.hpp"
+
+namespace rmrf::index {
+
+namespace {
+
+struct field_prefix {
+    std::string_view name;
+    index_field field;
+};
+
+constexpr field_prefix field_prefixes[] = {
+    {"from", index_field::from},
+    {"to", index_field::to},
+    {"subject", index_field::subject},
+    {"body", index_field::body}
+};
+
+struct flag_name {
+    std::string_view name;
+    uint32_t flag;
+    bool negated;
+};
+
+constexpr flag_name flag_names[] = {
+    {"seen", flag_seen, false},
+    {"unseen", flag_seen, true},
+    {"read", flag_seen, false},
+    {"unread", flag_seen, true},
+    {"answered", flag_answered, false},
+    {"flagged", flag_flagged, false},
+    {"unflagged", flag_flagged, true},
+    {"deleted", flag_deleted, false},
+    {"draft", flag_draft, false}
+};
+
+bool is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+}
+
+search_query parse_query(std::string_view query) {
+    search_query result{{}, 0, 0, false};
+
+    size_t pos = 0;
+    bool has_words = false;
+
+    while (pos < query.size()) {
+        while (pos < query.size() && is_space(query[pos])) {
+            pos++;
+        }
+
+        if (pos == query.size()) {
+            break;
+        }
+
+        // Split off an optional field prefix
+        index_field field = index_field::any;
+        std::string_view prefix;
+        size_t colon = query.find(':', pos);
+
+        if (colon != std::string_view::npos) {
+            std::string_view candidate = query.substr(pos, colon - pos);
+
+            if (candidate.find_first_of(" \t\r\n\"") == std::string_view::npos) {
+                prefix = candidate;
+            }
+        }
+
+        bool known_prefix = false;
+
+        for (const auto &fp : field_prefixes) {
+            if (fp.name == prefix) {
+                field = fp.field;
+                known_prefix = true;
+            }
+        }
+
+        if (known_prefix || prefix == "is") {
+            pos = colon + 1;
+        }
+
+        // Extract the value, honouring double quotes
+        std::string_view value;
+
+        if (pos < query.size() && query[pos] == '"') {
+            size_t end = query.find('"', pos + 1);
+
+            if (end == std::string_view::npos) {
+                end = query.size();
+            }
+
+            value = query.substr(pos + 1, end - pos - 1);
+            pos = end + 1;
+        } else {
+            size_t end = pos;
+
+            while (end < query.size() && !is_space(query[end])) {
+                end++;
+            }
+
+            value = query.substr(pos, end - pos);
+            pos = end;
+        }
+
+        if (!known_prefix && prefix == "is") {
+            bool known_flag = false;
+
+            for (const auto &fn : flag_names) {
+                if (fn.name == value) {
+                    (fn.negated ? result.excluded_flags : result.required_flags) |= fn.flag;
+                    known_flag = true;
+                }
+            }
+
+            if (!known_flag) {
+                throw query_exception("Unknown flag is:" + std::string(value));
+            }
+
+            continue;
+        }
+
+        has_words = true;
+        tokenize(value, [&result, field](std::string_view token) {
+            result.terms.push_back(query_term{field, std::string(token)});
+        });
+    }
+
+    // Words like from:@ leave nothing to search for; they must not turn
+    // into a query without terms, which would match every message
+    result.match_none = has_words && result.terms.empty();
+
+    return result;
+}
+
+}
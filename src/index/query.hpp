@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace rmrf::index {
+
+/**
+ * The parts of a message that are indexed separately.
+ */
+enum class index_field : uint8_t {
+    from,
+    to,
+    subject,
+    body,
+    any
+};
+
+constexpr size_t index_field_count = 4;
+
+/**
+ * IMAP system flags as tracked by the index.
+ */
+enum message_flag : uint32_t {
+    flag_seen = 1 << 0,
+    flag_answered = 1 << 1,
+    flag_flagged = 1 << 2,
+    flag_deleted = 1 << 3,
+    flag_draft = 1 << 4
+};
+
+/**
+ * A single token that has to be present in a given field.
+ * The field any matches the token in any of the indexed fields.
+ */
+struct query_term {
+    index_field field;
+    std::string token;
+};
+
+/**
+ * A parsed search query. All terms need to match (logical and).
+ * If match_none is set, the query asked for words but none of them
+ * contained anything searchable, so no message can match.
+ */
+struct search_query {
+    std::vector<query_term> terms;
+    uint32_t required_flags;
+    uint32_t excluded_flags;
+    bool match_none;
+};
+
+/**
+ * Parse a search query.
+ *
+ * The query consists of whitespace separated words. A word can be
+ * restricted to a field by prefixing it with from:, to:, subject: or body:,
+ * and the value may be enclosed in double quotes to include whitespace.
+ * Flags can be filtered with is:seen, is:unseen, is:flagged, is:answered,
+ * is:draft or is:deleted. Any other word is matched against all fields.
+ *
+ * @param query The query string as entered by the user
+ * @return The parsed query
+ * @throws query_exception If an unknown flag is given with is:
+ */
+search_query parse_query(std::string_view query);
+
+}
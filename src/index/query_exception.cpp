@@ -0,0 +1,13 @@
+#include "index/query_exception.hpp"
+
+namespace rmrf::index {
+
+query_exception::query_exception(const std::string &cause_) : cause(cause_) {
+    // NOP
+}
+
+const char *query_exception::what() const throw() {
+    return this->cause.c_str();
+}
+
+}
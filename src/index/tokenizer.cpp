@@ -0,0 +1,173 @@
+#include "index/tokenizer.hpp"
+
+#include <array>
+#include <cstdint>
+
+namespace rmrf::index {
+
+namespace {
+
+// Maps every byte to its lower case token character or 0 for separators.
+constexpr std::array<char, 256> make_token_table() {
+    std::array<char, 256> table{};
+
+    for (size_t c = 0; c < table.size(); c++) {
+        if (c >= 'A' && c <= 'Z') {
+            table[c] = static_cast<char>(c - 'A' + 'a');
+        } else if ((c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c >= 0x80) {
+            table[c] = static_cast<char>(c);
+        }
+    }
+
+    return table;
+}
+
+constexpr std::array<char, 256> token_table = make_token_table();
+
+constexpr int hex_value(char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    } else if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    } else if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+
+    return -1;
+}
+
+constexpr int base64_value(char c) {
+    if (c >= 'A' && c <= 'Z') {
+        return c - 'A';
+    } else if (c >= 'a' && c <= 'z') {
+        return c - 'a' + 26;
+    } else if (c >= '0' && c <= '9') {
+        return c - '0' + 52;
+    } else if (c == '+') {
+        return 62;
+    } else if (c == '/') {
+        return 63;
+    }
+
+    return -1;
+}
+
+constexpr char ascii_lower(char c) {
+    return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+bool iequals(std::string_view a, std::string_view b) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+
+    for (size_t i = 0; i < a.size(); i++) {
+        if (ascii_lower(a[i]) != ascii_lower(b[i])) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+}
+
+void tokenize(std::string_view text, const token_cb_t &cb) {
+    char token[max_token_length];
+    size_t length = 0;
+
+    for (char c : text) {
+        char t = token_table[static_cast<uint8_t>(c)];
+
+        if (t) {
+            if (length < max_token_length) {
+                token[length++] = t;
+            }
+        } else if (length) {
+            cb(std::string_view(token, length));
+            length = 0;
+        }
+    }
+
+    if (length) {
+        cb(std::string_view(token, length));
+    }
+}
+
+std::string decode_quoted_printable(std::string_view data) {
+    std::string result;
+    result.reserve(data.size());
+
+    for (size_t i = 0; i < data.size(); i++) {
+        if (data[i] != '=') {
+            result.push_back(data[i]);
+            continue;
+        }
+
+        // Soft line break
+        if (i + 1 < data.size() && (data[i + 1] == '\r' || data[i + 1] == '\n')) {
+            i++;
+
+            if (data[i] == '\r' && i + 1 < data.size() && data[i + 1] == '\n') {
+                i++;
+            }
+
+            continue;
+        }
+
+        int hi = i + 2 < data.size() ? hex_value(data[i + 1]) : -1;
+        int lo = i + 2 < data.size() ? hex_value(data[i + 2]) : -1;
+
+        if (hi < 0 || lo < 0) {
+            result.push_back(data[i]);
+            continue;
+        }
+
+        result.push_back(static_cast<char>((hi << 4) | lo));
+        i += 2;
+    }
+
+    return result;
+}
+
+std::string decode_base64(std::string_view data) {
+    std::string result;
+    result.reserve(data.size() / 4 * 3);
+
+    uint32_t acc = 0;
+    int bits = 0;
+
+    for (char c : data) {
+        if (c == '=') {
+            break;
+        }
+
+        int v = base64_value(c);
+
+        if (v < 0) {
+            continue;
+        }
+
+        acc = (acc << 6) | static_cast<uint32_t>(v);
+        bits += 6;
+
+        if (bits >= 8) {
+            bits -= 8;
+            result.push_back(static_cast<char>((acc >> bits) & 0xFF));
+        }
+    }
+
+    return result;
+}
+
+std::string decode_transfer_encoding(std::string_view data, std::string_view transfer_encoding) {
+    if (iequals(transfer_encoding, "quoted-printable")) {
+        return decode_quoted_printable(data);
+    } else if (iequals(transfer_encoding, "base64")) {
+        return decode_base64(data);
+    }
+
+    return std::string(data);
+}
+
+}
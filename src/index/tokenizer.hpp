@@ -0,0 +1,52 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <string_view>
+
+namespace rmrf::index {
+
+/**
+ * Callback receiving each token found in a piece of text.
+ * The view is only valid for the duration of the call.
+ */
+typedef std::function<void(std::string_view)> token_cb_t;
+
+/**
+ * Tokens longer than this are truncated before being indexed.
+ */
+constexpr size_t max_token_length = 64;
+
+/**
+ * Split a text into lower case search tokens.
+ *
+ * A token is any run of ASCII letters, digits or non-ASCII bytes (which keeps
+ * UTF-8 sequences intact). Everything else acts as a separator.
+ *
+ * @param text The text to tokenise
+ * @param cb The callback to invoke for every token
+ */
+void tokenize(std::string_view text, const token_cb_t &cb);
+
+/**
+ * Decode a quoted-printable encoded body part (RFC 2045, section 6.7).
+ * Malformed escape sequences are passed through unchanged.
+ */
+std::string decode_quoted_printable(std::string_view data);
+
+/**
+ * Decode a base64 encoded body part (RFC 2045, section 6.8).
+ * Characters outside the base64 alphabet are skipped.
+ */
+std::string decode_base64(std::string_view data);
+
+/**
+ * Decode a body part according to its Content-Transfer-Encoding.
+ * Unknown encodings (7bit, 8bit, binary, ...) are returned as is.
+ *
+ * @param data The raw body part
+ * @param transfer_encoding The value of the Content-Transfer-Encoding header
+ */
+std::string decode_transfer_encoding(std::string_view data, std::string_view transfer_encoding);
+
+}
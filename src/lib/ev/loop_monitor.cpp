@@ -0,0 +1,247 @@
+#include "lib/ev/loop_monitor.hpp"
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "macros.hpp"
+#include "service/log.hpp"
+#include "service/metrics.hpp"
+
+namespace rmrf::ev {
+
+namespace {
+
+std::mutex registry_lock;
+std::vector<loop_monitor *> monitors;
+std::map<std::string, std::unique_ptr<lag_histogram>> callbacks;
+
+// The monitor of the loop running on this thread
+thread_local loop_monitor *current_monitor = nullptr;
+
+int64_t to_us(::ev::tstamp t) {
+    return static_cast<int64_t>(t * 1e6);
+}
+
+}
+
+lag_histogram::lag_histogram(const std::string &name_) :
+    name{name_}, buckets{}, count{0}, sum_us{0}, max_us{0}
+{
+    // NOP
+}
+
+void lag_histogram::record(::ev::tstamp duration) {
+    const uint64_t us = duration > 0 ? static_cast<uint64_t>(duration * 1e6) : 0;
+    const size_t bucket = us ? std::min(bucket_count - 1, static_cast<size_t>(64 - __builtin_clzll(us))) : 0;
+
+    this->buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    this->count.fetch_add(1, std::memory_order_relaxed);
+    this->sum_us.fetch_add(us, std::memory_order_relaxed);
+
+    uint64_t seen = this->max_us.load(std::memory_order_relaxed);
+
+    while (seen < us && !this->max_us.compare_exchange_weak(seen, us, std::memory_order_relaxed)) {
+        // Retry with the value somebody else stored
+    }
+}
+
+const std::string &lag_histogram::get_name() const {
+    return this->name;
+}
+
+uint64_t lag_histogram::get_count() const {
+    return this->count.load(std::memory_order_relaxed);
+}
+
+::ev::tstamp lag_histogram::get_max() const {
+    return static_cast<::ev::tstamp>(this->max_us.load(std::memory_order_relaxed)) / 1e6;
+}
+
+void lag_histogram::write(std::ostream &out, const std::string &metric, const std::string &labels) const {
+    const std::string prefix = labels.empty() ? "" : labels + ",";
+    uint64_t cumulative = 0;
+
+    for (size_t i = 0; i + 1 < bucket_count; i++) {
+        cumulative += this->buckets[i].load(std::memory_order_relaxed);
+        out << metric << "_bucket{" << prefix << "le=\"" << static_cast<double>(uint64_t{1} << i) / 1e6 << "\"} " << cumulative << "\n";
+    }
+
+    out << metric << "_bucket{" << prefix << "le=\"+Inf\"} " << this->get_count() << "\n";
+    out << metric << "_sum{" << labels << "} " << static_cast<double>(this->sum_us.load(std::memory_order_relaxed)) / 1e6 << "\n";
+    out << metric << "_count{" << labels << "} " << this->get_count() << "\n";
+}
+
+lag_histogram &callback_histogram(const std::string &name) {
+    std::lock_guard<std::mutex> guard{registry_lock};
+    auto &histogram = callbacks[name];
+
+    if (!histogram) {
+        histogram = std::make_unique<lag_histogram>(name);
+    }
+
+    return *histogram;
+}
+
+callback_probe::callback_probe(lag_histogram &histogram_) :
+    histogram{histogram_}, start{ev_time()}
+{
+    // NOP
+}
+
+callback_probe::~callback_probe() {
+    const ::ev::tstamp duration = ev_time() - this->start;
+    this->histogram.record(duration);
+
+    if (current_monitor) {
+        current_monitor->probe_finished(this->histogram, duration);
+    }
+}
+
+loop_monitor::loop_monitor(const std::string &name_, ::ev::tstamp budget_, ::ev::loop_ref loop_) :
+    name{name_}, loop{loop_}, budget{budget_},
+    e_check{loop_}, e_prepare{loop_}, e_heartbeat{loop_},
+    busy{name_}, lag{name_},
+    last_seen_us{to_us(ev_time())},
+    iteration_start{0}, last_beat{0}, slowest{nullptr}, slowest_time{0}
+{
+    // Enclose all other watchers of an iteration
+    ev_set_priority(static_cast<ev_check *>(&this->e_check), EV_MAXPRI);
+    ev_set_priority(static_cast<ev_prepare *>(&this->e_prepare), EV_MINPRI);
+
+    this->e_check.set<loop_monitor, &loop_monitor::cb_check>(this);
+    this->e_check.start();
+    this->e_prepare.set<loop_monitor, &loop_monitor::cb_prepare>(this);
+    this->e_prepare.start();
+
+    // Idle loops have to wake up now and then to show they are alive
+    this->last_beat = ::ev::now(this->loop);
+    this->e_heartbeat.set<loop_monitor, &loop_monitor::cb_heartbeat>(this);
+    this->e_heartbeat.start(this->budget, this->budget);
+
+    // The report is part of every metrics scrape once a loop is watched
+    static const bool exported = (rmrf::metrics::add_collector(&loop_monitor::write_report), true);
+    MARK_UNUSED(exported);
+
+    // Probes report to the first monitor of their thread
+    if (!current_monitor) {
+        current_monitor = this;
+    }
+
+    std::lock_guard<std::mutex> guard{registry_lock};
+    monitors.push_back(this);
+}
+
+loop_monitor::~loop_monitor() {
+    {
+        std::lock_guard<std::mutex> guard{registry_lock};
+        monitors.erase(std::remove(monitors.begin(), monitors.end(), this), monitors.end());
+    }
+
+    if (current_monitor == this) {
+        current_monitor = nullptr;
+    }
+
+    this->e_heartbeat.stop();
+    this->e_prepare.stop();
+    this->e_check.stop();
+}
+
+bool loop_monitor::healthy(int64_t now_us, int64_t max_silence_us) const {
+    const int64_t silent = now_us - this->last_seen_us.load(std::memory_order_relaxed);
+
+    // A wedged loop does not even get around to measuring itself; idle ones
+    // still show up with their heartbeat
+    return silent <= std::max(max_silence_us, 3 * to_us(this->budget));
+}
+
+bool loop_monitor::all_healthy(::ev::tstamp max_silence) {
+    const int64_t now_us = to_us(ev_time());
+
+    std::lock_guard<std::mutex> guard{registry_lock};
+
+    return std::all_of(monitors.begin(), monitors.end(), [now_us, max_silence](const loop_monitor *monitor) {
+        return monitor->healthy(now_us, to_us(max_silence));
+    });
+}
+
+void loop_monitor::write_report(std::ostream &out) {
+    std::lock_guard<std::mutex> guard{registry_lock};
+
+    out << "# TYPE rmrf_loop_busy_seconds histogram\n";
+
+    for (const loop_monitor *monitor : monitors) {
+        monitor->busy.write(out, "rmrf_loop_busy_seconds", "loop=\"" + monitor->name + "\"");
+    }
+
+    out << "# TYPE rmrf_loop_lag_seconds histogram\n";
+
+    for (const loop_monitor *monitor : monitors) {
+        monitor->lag.write(out, "rmrf_loop_lag_seconds", "loop=\"" + monitor->name + "\"");
+    }
+
+    out << "# TYPE rmrf_callback_seconds histogram\n";
+
+    for (const auto &[name, histogram] : callbacks) {
+        histogram->write(out, "rmrf_callback_seconds", "callback=\"" + name + "\"");
+    }
+
+    out.flush();
+}
+
+void loop_monitor::probe_finished(const lag_histogram &histogram, ::ev::tstamp duration) {
+    if (duration > this->slowest_time) {
+        this->slowest = &histogram;
+        this->slowest_time = duration;
+    }
+}
+
+void loop_monitor::cb_check(::ev::check &w, int events) {
+    (void)w;
+    (void)events;
+
+    // ev_now was just updated after the poll returned
+    this->iteration_start = ::ev::now(this->loop);
+    this->slowest = nullptr;
+    this->slowest_time = 0;
+}
+
+void loop_monitor::cb_prepare(::ev::prepare &w, int events) {
+    (void)w;
+    (void)events;
+
+    const ::ev::tstamp now = ev_time();
+    this->last_seen_us.store(to_us(now), std::memory_order_relaxed);
+
+    // The first prepare runs before any poll
+    if (this->iteration_start <= 0) {
+        return;
+    }
+
+    const ::ev::tstamp duration = now - this->iteration_start;
+    this->iteration_start = 0;
+    this->busy.record(duration);
+
+    if (duration > this->budget) {
+        rmrf::log::warning("Event loop lagging", {
+            {"loop", this->name},
+            {"busy_ms", duration * 1e3},
+            {"slowest", this->slowest ? this->slowest->get_name() : std::string{}},
+            {"slowest_ms", this->slowest_time * 1e3}
+        });
+    }
+}
+
+void loop_monitor::cb_heartbeat(::ev::timer &w, int events) {
+    (void)w;
+    (void)events;
+
+    // How much later than asked for the timer fired
+    const ::ev::tstamp now = ::ev::now(this->loop);
+    this->lag.record(now - this->last_beat - this->budget);
+    this->last_beat = now;
+}
+
+}
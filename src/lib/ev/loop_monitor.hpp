@@ -0,0 +1,142 @@
+#pragma once
+
+#include <ev++.h>
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+namespace rmrf::ev {
+
+/**
+ * Durations in buckets of powers of two microseconds. Recording is wait-free,
+ * so histograms may be shared between loops on different threads.
+ */
+class lag_histogram {
+public:
+    // Bucket i counts durations below 2^i µs, the last one everything longer
+    static constexpr size_t bucket_count = 25;
+
+private:
+    const std::string name;
+    std::array<std::atomic<uint64_t>, bucket_count> buckets;
+    std::atomic<uint64_t> count;
+    std::atomic<uint64_t> sum_us;
+    std::atomic<uint64_t> max_us;
+
+public:
+    explicit lag_histogram(const std::string &name_);
+
+    lag_histogram(const lag_histogram &) = delete;
+    lag_histogram &operator=(const lag_histogram &) = delete;
+
+    void record(::ev::tstamp duration);
+
+    const std::string &get_name() const;
+    uint64_t get_count() const;
+    ::ev::tstamp get_max() const;
+
+    /**
+     * Write the histogram in Prometheus text format.
+     */
+    void write(std::ostream &out, const std::string &metric, const std::string &labels) const;
+};
+
+/**
+ * Get the histogram for callbacks of the given name, shared by all loops.
+ */
+lag_histogram &callback_histogram(const std::string &name);
+
+/**
+ * Measures the run time of a callback for as long as it is in scope:
+ *
+ *     static auto &histogram = rmrf::ev::callback_histogram("lmtp.session");
+ *     rmrf::ev::callback_probe probe{histogram};
+ *
+ * The slowest callback of an iteration gets named when the loop lags.
+ */
+class callback_probe {
+private:
+    lag_histogram &histogram;
+    const ::ev::tstamp start;
+
+public:
+    explicit callback_probe(lag_histogram &histogram_);
+    ~callback_probe();
+
+    callback_probe(const callback_probe &) = delete;
+    callback_probe &operator=(const callback_probe &) = delete;
+};
+
+/**
+ * Watches the health of one event loop.
+ *
+ * A check/prepare watcher pair measures how long each iteration is busy
+ * running callbacks (from ev_now after the poll until the loop goes back to
+ * sleep) and a heartbeat timer measures how late timers fire. Iterations
+ * over the budget are recorded and logged. A loop is healthy as long as it
+ * still finishes iterations; being slow now and then is no reason to get
+ * restarted.
+ */
+class loop_monitor {
+private:
+    const std::string name;
+    ::ev::loop_ref loop;
+    const ::ev::tstamp budget;
+
+    ::ev::check e_check;
+    ::ev::prepare e_prepare;
+    ::ev::timer e_heartbeat;
+
+    lag_histogram busy;
+    lag_histogram lag;
+
+    // Read by the watchdog from the main thread
+    std::atomic<int64_t> last_seen_us;
+
+    ::ev::tstamp iteration_start;
+    ::ev::tstamp last_beat;
+    const lag_histogram *slowest;
+    ::ev::tstamp slowest_time;
+
+public:
+    /**
+     * @param name_ The name of the loop in reports
+     * @param budget_ The longest an iteration may take in seconds
+     * @param loop_ The loop to watch; it has to run on the calling thread
+     */
+    explicit loop_monitor(const std::string &name_, ::ev::tstamp budget_ = 0.25, ::ev::loop_ref loop_ = ::ev::get_default_loop());
+    ~loop_monitor();
+
+    loop_monitor(const loop_monitor &) = delete;
+    loop_monitor &operator=(const loop_monitor &) = delete;
+
+    /**
+     * Check that all loops finished an iteration recently. Call this right
+     * before feeding the watchdog.
+     *
+     * @param max_silence The longest time in seconds a loop may be stuck in
+     *                    one iteration; at least three budgets are allowed
+     */
+    static bool all_healthy(::ev::tstamp max_silence);
+
+    /**
+     * Write the lag histograms of all loops and callbacks in Prometheus
+     * text format.
+     */
+    static void write_report(std::ostream &out);
+
+    void probe_finished(const lag_histogram &histogram, ::ev::tstamp duration);
+
+private:
+    bool healthy(int64_t now_us, int64_t max_silence_us) const;
+
+    void cb_check(::ev::check &w, int events);
+    void cb_prepare(::ev::prepare &w, int events);
+    void cb_heartbeat(::ev::timer &w, int events);
+};
+
+}
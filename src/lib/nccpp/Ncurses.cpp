@@ -7,7 +7,7 @@
 
 namespace nccpp {
 
-inline Ncurses::Ncurses()    : Window{initscr()}, registered_colors_{},
+Ncurses::Ncurses()    : Window{initscr()}, registered_colors_{},
 #ifndef NDEBUG
     windows_ {}, is_exit_ {false},
 #endif
@@ -18,7 +18,7 @@ inline Ncurses::Ncurses()    : Window{initscr()}, registered_colors_{},
     }
 }
 
-inline Ncurses::~Ncurses() {
+Ncurses::~Ncurses() {
     endwin();
     win_ = nullptr;
 #ifdef NO_LEAKS
@@ -27,11 +27,11 @@ inline Ncurses::~Ncurses() {
 }
 
 #ifndef NDEBUG
-inline void Ncurses::register_window_(Window &new_win, Window::Key /*dummy*/) {
+void Ncurses::register_window_(Window &new_win, Window::Key /*dummy*/) {
     windows_.push_back(&new_win);
 }
 
-inline void Ncurses::unregister_window_(Window &win, Window::Key /*dummy*/) {
+void Ncurses::unregister_window_(Window &win, Window::Key /*dummy*/) {
     auto it = std::find(std::begin(windows_), std::end(windows_), &win);
 
     assert(it != std::end(windows_));
@@ -40,7 +40,7 @@ inline void Ncurses::unregister_window_(Window &win, Window::Key /*dummy*/) {
 }
 #endif
 
-inline void Ncurses::exit_ncurses_mode() {
+void Ncurses::exit_ncurses_mode() {
     assert(!is_exit_ && "Ncurses mode is already off");
 
 #ifndef NDEBUG
@@ -57,7 +57,7 @@ inline void Ncurses::exit_ncurses_mode() {
     endwin();
 }
 
-inline void Ncurses::resume_ncurses_mode() {
+void Ncurses::resume_ncurses_mode() {
     assert(is_exit_ && "Ncurses mode is already on");
 
 #ifndef NDEBUG
@@ -76,49 +76,49 @@ inline void Ncurses::resume_ncurses_mode() {
 
 // Input options
 
-inline int Ncurses::cbreak(bool on) {
+int Ncurses::cbreak(bool on) {
     assert(!is_exit_ && "Ncurses mode is off");
 
     return on ? ::cbreak() : nocbreak();
 }
 
-inline int Ncurses::echo(bool on) {
+int Ncurses::echo(bool on) {
     assert(!is_exit_ && "Ncurses mode is off");
 
     return on ? ::echo() : noecho();
 }
 
-inline int Ncurses::halfdelay(int delay) {
+int Ncurses::halfdelay(int delay) {
     assert(!is_exit_ && "Ncurses mode is off");
 
     return ::halfdelay(delay);
 }
 
-inline int Ncurses::intrflush(bool on) {
+int Ncurses::intrflush(bool on) {
     assert(!is_exit_ && "Ncurses mode is off");
 
     return ::intrflush(win_, on);
 }
 
-inline int Ncurses::meta(bool on) {
+int Ncurses::meta(bool on) {
     assert(!is_exit_ && "Ncurses mode is off");
 
     return ::meta(win_, on);
 }
 
-inline int Ncurses::raw(bool on) {
+int Ncurses::raw(bool on) {
     assert(!is_exit_ && "Ncurses mode is off");
 
     return on ? ::raw() : noraw();
 }
 
-inline void Ncurses::qiflush(bool on) {
+void Ncurses::qiflush(bool on) {
     assert(!is_exit_ && "Ncurses mode is off");
 
     on ? ::qiflush() : noqiflush();
 }
 
-inline int Ncurses::typeahead(int fd) {
+int Ncurses::typeahead(int fd) {
     assert(!is_exit_ && "Ncurses mode is off");
 
     return ::typeahead(fd);
@@ -126,43 +126,43 @@ inline int Ncurses::typeahead(int fd) {
 
 // Output options
 
-inline int Ncurses::clearok(bool on, bool use_cs) {
+int Ncurses::clearok(bool on, bool use_cs) {
     assert(!is_exit_ && "Ncurses mode is off");
 
     return::clearok(use_cs ? curscr : win_, on);
 }
 
-inline int Ncurses::idlok(bool on) {
+int Ncurses::idlok(bool on) {
     assert(!is_exit_ && "Ncurses mode is off");
 
     return ::idlok(win_, on);
 }
 
-inline void Ncurses::idcok(bool on) {
+void Ncurses::idcok(bool on) {
     assert(!is_exit_ && "Ncurses mode is off");
 
     ::idcok(win_, on);
 }
 
-inline void Ncurses::immedok(bool on) {
+void Ncurses::immedok(bool on) {
     assert(!is_exit_ && "Ncurses mode is off");
 
     ::immedok(win_, on);
 }
 
-inline int Ncurses::leaveok(bool on) {
+int Ncurses::leaveok(bool on) {
     assert(!is_exit_ && "Ncurses mode is off");
 
     return ::leaveok(win_, on);
 }
 
-inline int Ncurses::scrollok(bool on) {
+int Ncurses::scrollok(bool on) {
     assert(!is_exit_ && "Ncurses mode is off");
 
     return ::scrollok(win_, on);
 }
 
-inline int Ncurses::nl(bool on) {
+int Ncurses::nl(bool on) {
     assert(!is_exit_ && "Ncurses mode is off");
 
     return on ? ::nl() : nonl();
@@ -170,13 +170,13 @@ inline int Ncurses::nl(bool on) {
 
 // Input functions
 
-inline int Ncurses::ungetch(int ch) {
+int Ncurses::ungetch(int ch) {
     assert(!is_exit_ && "Ncurses mode is off");
 
     return ::ungetch(ch);
 }
 
-inline int Ncurses::has_key(int ch) {
+int Ncurses::has_key(int ch) {
     assert(!is_exit_ && "Ncurses mode is off");
 
     return ::has_key(ch);
@@ -184,19 +184,19 @@ inline int Ncurses::has_key(int ch) {
 
 // Misc
 
-inline int Ncurses::doupdate() {
+int Ncurses::doupdate() {
     assert(!is_exit_ && "Ncurses mode is off");
 
     return ::doupdate();
 }
 
-inline int Ncurses::line_count() {
+int Ncurses::line_count() {
     assert(!is_exit_ && "Ncurses mode is off");
 
     return LINES;
 }
 
-inline int Ncurses::column_count() {
+int Ncurses::column_count() {
     assert(!is_exit_ && "Ncurses mode is off");
 
     return COLS;
@@ -204,31 +204,31 @@ inline int Ncurses::column_count() {
 
 // Mouse
 
-inline bool Ncurses::has_mouse() {
+bool Ncurses::has_mouse() {
     assert(!is_exit_ && "Ncurses mode is off");
 
     return ::has_mouse();
 }
 
-inline int Ncurses::getmouse(MEVENT &event) {
+int Ncurses::getmouse(MEVENT &event) {
     assert(!is_exit_ && "Ncurses mode is off");
 
     return ::getmouse(&event);
 }
 
-inline int Ncurses::ungetmouse(MEVENT &event) {
+int Ncurses::ungetmouse(MEVENT &event) {
     assert(!is_exit_ && "Ncurses mode is off");
 
     return ::ungetmouse(&event);
 }
 
-inline mmask_t Ncurses::mousemask(mmask_t newmask, mmask_t* oldmask) {
+mmask_t Ncurses::mousemask(mmask_t newmask, mmask_t* oldmask) {
     assert(!is_exit_ && "Ncurses mode is off");
 
     return ::mousemask(newmask, oldmask);
 }
 
-inline int Ncurses::mouseinterval(int erval) {
+int Ncurses::mouseinterval(int erval) {
     assert(!is_exit_ && "Ncurses mode is off");
 
     return ::mouseinterval(erval);
@@ -236,7 +236,7 @@ inline int Ncurses::mouseinterval(int erval) {
 
 // Window
 
-inline WINDOW* Ncurses::newwin_(int nlines, int ncols, int begin_y, int begin_x, Window::Key /*dummy*/) {
+WINDOW* Ncurses::newwin_(int nlines, int ncols, int begin_y, int begin_x, Window::Key /*dummy*/) {
     assert(!is_exit_ && "Ncurses mode is off");
 
     return newwin(nlines, ncols, begin_y, begin_x);
@@ -244,7 +244,7 @@ inline WINDOW* Ncurses::newwin_(int nlines, int ncols, int begin_y, int begin_x,
 
 // Color
 
-inline void Ncurses::start_color() {
+void Ncurses::start_color() {
     assert(!is_exit_ && "Ncurses mode is off");
 
     if (colors_initialized_) {
@@ -258,7 +258,7 @@ inline void Ncurses::start_color() {
     colors_initialized_ = true;
 }
 
-inline int Ncurses::use_default_colors() {
+int Ncurses::use_default_colors() {
     assert(!is_exit_ && "Ncurses mode is off");
 
     start_color();
@@ -266,7 +266,7 @@ inline int Ncurses::use_default_colors() {
     return ::use_default_colors();
 }
 
-inline short Ncurses::color_to_pair_number(Color const &color) {
+short Ncurses::color_to_pair_number(Color const &color) {
     assert(!is_exit_ && "Ncurses mode is off");
 
     auto it = std::find_if(
@@ -295,26 +295,26 @@ inline short Ncurses::color_to_pair_number(Color const &color) {
     return static_cast<short>(registered_colors_.size());
 }
 
-inline attr_t Ncurses::color_to_attr(Color const &color) {
+attr_t Ncurses::color_to_attr(Color const &color) {
     assert(!is_exit_ && "Ncurses mode is off");
 
     return static_cast<attr_t>(COLOR_PAIR(color_to_pair_number(color)));
 }
 
-inline Color Ncurses::pair_number_to_color(short pair_n) {
+Color Ncurses::pair_number_to_color(short pair_n) {
     assert(!is_exit_ && "Ncurses mode is off");
     assert(static_cast<std::size_t>(pair_n) <= registered_colors_.size() && "No such color");
 
     return registered_colors_[static_cast<std::size_t>(pair_n - 1)];
 }
 
-inline Color Ncurses::attr_to_color(attr_t a) {
+Color Ncurses::attr_to_color(attr_t a) {
     assert(!is_exit_ && "Ncurses mode is off");
 
     return pair_number_to_color(static_cast<short>(PAIR_NUMBER(static_cast<int>(a))));
 }
 
-inline int Ncurses::init_color(short color, short r, short g, short b) {
+int Ncurses::init_color(short color, short r, short g, short b) {
     assert(!is_exit_ && "Ncurses mode is off");
 
     start_color();
@@ -322,11 +322,11 @@ inline int Ncurses::init_color(short color, short r, short g, short b) {
     return ::init_color(color, r, g, b);
 }
 
-inline void Ncurses::assign(WINDOW*) {
+void Ncurses::assign(WINDOW*) {
     assert(false && "Can't call nccpp::Ncurses::assign");
 }
 
-inline void Ncurses::destroy() {
+void Ncurses::destroy() {
     assert(false && "Can't call nccpp::Ncurses::destroy");
 }
 
@@ -6,47 +6,47 @@
 
 namespace nccpp {
 
-inline Window &Subwindow::get_parent() {
+Window &Subwindow::get_parent() {
     assert(win_ && "Invalid subwindow");
 
     return parent_;
 }
 
-inline int Subwindow::mvderwin(int y, int x) {
+int Subwindow::mvderwin(int y, int x) {
     assert(win_ && "Invalid subwindow");
 
     return ::mvderwin(win_, y, x);
 }
 
-inline void Subwindow::syncup() {
+void Subwindow::syncup() {
     assert(win_ && "Invalid subwindow");
 
     wsyncup(win_);
 }
 
-inline int Subwindow::syncok(bool on) {
+int Subwindow::syncok(bool on) {
     assert(win_ && "Invalid subwindow");
 
     return ::syncok(win_, on);
 }
 
-inline void Subwindow::cursyncup() {
+void Subwindow::cursyncup() {
     assert(win_ && "Invalid subwindow");
 
     wcursyncup(win_);
 }
 
-inline void Subwindow::syncdown() {
+void Subwindow::syncdown() {
     assert(win_ && "Invalid subwindow");
 
     wsyncdown(win_);
 }
 
-inline void Subwindow::assign(WINDOW*) {
+void Subwindow::assign(WINDOW*) {
     assert(false && "Can't call nccpp::Subwindow::assign");
 }
 
-inline void Subwindow::destroy() {
+void Subwindow::destroy() {
     assert(false && "Can't call nccpp::Subwindow::destroy");
 }
 
@@ -8,7 +8,7 @@
 
 namespace nccpp {
 
-inline Window::Window(WINDOW* win) :
+Window::Window(WINDOW* win) :
     win_{win},
 #ifndef NDEBUG
     win_save_ {nullptr},
@@ -24,7 +24,7 @@ inline Window::Window(WINDOW* win) :
 #endif
 }
 
-inline Window::Window(int nlines, int ncols, int begin_y, int begin_x) :
+Window::Window(int nlines, int ncols, int begin_y, int begin_x) :
     win_{ncurses().newwin_(nlines, ncols, begin_y, begin_x, Key{})},
 #ifndef NDEBUG
     win_save_ {nullptr},
@@ -48,7 +48,7 @@ inline Window::Window(int nlines, int ncols, int begin_y, int begin_x) :
 #endif
 }
 
-inline Window::Window(Window const &cp) :
+Window::Window(Window const &cp) :
     win_{nullptr},
 #ifndef NDEBUG
     win_save_ {nullptr},
@@ -75,7 +75,7 @@ inline Window::Window(Window const &cp) :
 #endif
 }
 
-inline Window &Window::operator=(Window const &cp) {
+Window &Window::operator=(Window const &cp) {
     if (this != &cp) {
         Window tmp{cp};
         *this = std::move(tmp);
@@ -84,7 +84,7 @@ inline Window &Window::operator=(Window const &cp) {
     return *this;
 }
 
-inline Window::Window(Window &&mv)
+Window::Window(Window &&mv)
 #ifdef NDEBUG
 noexcept
 #endif
@@ -102,7 +102,7 @@ noexcept
 #endif
 }
 
-inline Window &Window::operator=(Window &&mv) noexcept {
+Window &Window::operator=(Window &&mv) noexcept {
     if (this != &mv) {
         destroy();
         win_ = mv.win_;
@@ -119,7 +119,7 @@ inline Window &Window::operator=(Window &&mv) noexcept {
     return *this;
 }
 
-inline Window::~Window() {
+Window::~Window() {
 #ifndef NDEBUG
 
     if (this != &ncurses()) {
@@ -131,7 +131,7 @@ inline Window::~Window() {
     destroy();
 }
 
-inline void Window::assign(WINDOW* new_win) {
+void Window::assign(WINDOW* new_win) {
     assert(!win_save_ && "Can't modify window while ncurses mode is off");
 
     if (win_) {
@@ -141,7 +141,7 @@ inline void Window::assign(WINDOW* new_win) {
     win_ = new_win;
 }
 
-inline void Window::destroy() {
+void Window::destroy() {
     if (win_) {
         subwindows_.clear();
         delwin(win_);
@@ -158,18 +158,18 @@ inline void Window::destroy() {
 #endif
 }
 
-inline WINDOW* Window::get_handle() {
+WINDOW* Window::get_handle() {
     assert(win_ && "Window doesn't manage any object");
 
     return win_;
 }
 
-inline WINDOW const* Window::get_handle() const {
+WINDOW const* Window::get_handle() const {
     assert(win_ && "Window doesn't manage any object");
     return win_;
 }
 
-inline std::size_t Window::add_subwindow(int lines, int cols, int beg_y, int beg_x) {
+std::size_t Window::add_subwindow(int lines, int cols, int beg_y, int beg_x) {
     assert(win_ && "Window doesn't manage any object");
 
 #ifndef NDEBUG
@@ -200,14 +200,14 @@ inline std::size_t Window::add_subwindow(int lines, int cols, int beg_y, int beg
     return subwindows_.size() - 1;
 }
 
-inline Subwindow &Window::get_subwindow(std::size_t index) {
+Subwindow &Window::get_subwindow(std::size_t index) {
     assert(win_ && "Window doesn't manage any object");
     assert(index < subwindows_.size() && subwindows_[index].win_ && "Invalid subwindow");
 
     return subwindows_[index];
 }
 
-inline void Window::delete_subwindow(std::size_t index) {
+void Window::delete_subwindow(std::size_t index) {
     assert(win_ && "Window doesn't manage any object");
     assert(index < subwindows_.size() && subwindows_[index].win_ && "Invalid subwindow");
 
@@ -216,7 +216,7 @@ inline void Window::delete_subwindow(std::size_t index) {
 }
 
 #ifndef NDEBUG
-inline void Window::invalidate_for_exit_(Window::Key /*dummy*/) {
+void Window::invalidate_for_exit_(Window::Key /*dummy*/) {
     for (auto &elem : subwindows_) {
         elem.invalidate_for_exit_(Key{});
     }
@@ -225,7 +225,7 @@ inline void Window::invalidate_for_exit_(Window::Key /*dummy*/) {
     win_ = nullptr;
 }
 
-inline void Window::validate_for_resume_(Window::Key /*dummy*/) {
+void Window::validate_for_resume_(Window::Key /*dummy*/) {
     for (auto &elem : subwindows_) {
         elem.validate_for_resume_(Key{});
     }
@@ -235,15 +235,15 @@ inline void Window::validate_for_resume_(Window::Key /*dummy*/) {
 }
 #endif
 
-inline int overlay(Window const &src, Window &dst) {
+int overlay(Window const &src, Window &dst) {
     return ::overlay(src.get_handle(), dst.get_handle());
 }
 
-inline int overwrite(Window const &src, Window &dst) {
+int overwrite(Window const &src, Window &dst) {
     return ::overwrite(src.get_handle(), dst.get_handle());
 }
 
-inline int copywin(
+int copywin(
     Window const &src,
     Window &dst,
     int sminrow,
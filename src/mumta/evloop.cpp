@@ -1,9 +1,25 @@
 #include "mumta/evloop.hpp"
 
 #include <fcntl.h>
+#include <signal.h>
 
+#include <cstdlib>
 #include <functional>
+#include <iostream>
 #include <memory>
+#include <string>
+
+#include "lib/ev/loop_monitor.hpp"
+
+#include "service/daemonctl.hpp"
+#include "service/log.hpp"
+#include "service/trace.hpp"
+
+// The watchdog interval requested by the service manager, 0 if disabled
+static ::ev::tstamp watchdog_interval = 0;
+
+// Main loop iterations taking longer get reported
+static ::ev::tstamp loop_budget = 0.25;
 
 struct stdin_waiter;
 struct stdin_waiter : std::enable_shared_from_this<stdin_waiter>
@@ -27,10 +43,96 @@ struct stdin_waiter : std::enable_shared_from_this<stdin_waiter>
     }
 };
 
+/**
+ * Writes the lag histograms of all loops to stdout on SIGUSR1. Builds with
+ * trace points also dump the trace rings into the runtime directory.
+ */
+struct lag_reporter
+{
+    ::ev::sig e_signal;
+
+    lag_reporter() : e_signal{} {
+        e_signal.set<lag_reporter, &lag_reporter::cb>(this);
+        e_signal.start(SIGUSR1);
+    }
+    ~lag_reporter() {
+        e_signal.stop();
+    }
+
+    void cb(::ev::sig &w, int events) {
+        (void)w;
+        (void)events;
+        rmrf::ev::loop_monitor::write_report(std::cout);
+
+#if defined(RMRF_TRACE_ENABLED)
+        const char *runtime_directory = std::getenv("RUNTIME_DIRECTORY");
+        const std::string path = rmrf::trace::dump(runtime_directory ? runtime_directory : "/tmp");
+
+        if (path.empty()) {
+            rmrf::log::warning("Failed to dump trace");
+        } else {
+            rmrf::log::info("Dumped trace", {{"path", path}});
+        }
+#endif
+    }
+};
+
+/**
+ * Feeds the watchdog of the service manager, but only while all monitored
+ * loops are alive. A wedged loop thus gets us restarted; a slow one is only
+ * reported by its monitor, as a missed refresh leaves no slack for the next.
+ */
+struct watchdog_feeder
+{
+    ::ev::timer e_timer;
+    const ::ev::tstamp interval;
+
+    explicit watchdog_feeder(::ev::tstamp interval_) : e_timer{}, interval{interval_} {
+        e_timer.set<watchdog_feeder, &watchdog_feeder::cb>(this);
+        e_timer.start(0, interval_);
+    }
+    ~watchdog_feeder() {
+        e_timer.stop();
+    }
+
+    watchdog_feeder(const watchdog_feeder &) = delete;
+    watchdog_feeder &operator=(const watchdog_feeder &) = delete;
+
+    void cb(::ev::timer &w, int events) {
+        (void)w;
+        (void)events;
+
+        // A loop stuck for a whole refresh interval is not coming back
+        if (rmrf::ev::loop_monitor::all_healthy(this->interval)) {
+            dctl_watchdog_refresh();
+        }
+    }
+};
+
+bool rmrf::ev::init_watchdog() {
+    const uint64_t usec = dctl_watchdog_interval();
+
+    // Refresh twice per interval, so a single slow period is no reason for a restart yet
+    watchdog_interval = static_cast<::ev::tstamp>(usec) / 1e6 / 2;
+
+    return usec != 0;
+}
+
+void rmrf::ev::set_loop_budget(::ev::tstamp seconds) {
+    loop_budget = seconds;
+}
+
 void rmrf::ev::loop() {
     ::ev::default_loop defloop;
 
     auto w = std::make_shared<stdin_waiter>();
+    rmrf::ev::loop_monitor monitor{"main", loop_budget};
+    lag_reporter reporter;
+    std::unique_ptr<watchdog_feeder> feeder;
+
+    if (watchdog_interval > 0) {
+        feeder = std::make_unique<watchdog_feeder>(watchdog_interval);
+    }
 
     defloop.run(0);
 }
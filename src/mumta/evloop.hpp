@@ -11,6 +11,12 @@ namespace rmrf::ev {
 bool init_libev();
 bool init_watchdog();
 
+/**
+ * Set the time an iteration of the main loop may take before it is
+ * reported as lagging. Call this before loop().
+ */
+void set_loop_budget(::ev::tstamp seconds);
+
 void loop();
 
 }
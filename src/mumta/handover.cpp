@@ -0,0 +1,318 @@
+#include "mumta/handover.hpp"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+
+#include <cstdlib>
+
+#include "net/fd_passing.hpp"
+#include "net/netio_exception.hpp"
+
+#include "service/daemonctl.hpp"
+#include "service/log.hpp"
+
+extern char **environ;
+
+namespace rmrf::mumta {
+
+namespace {
+
+// The variable telling a new instance where to find its predecessor
+constexpr const char *handover_variable = "MUMTA_HANDOVER_FD";
+
+// Busy sessions get this long to finish before they are dropped
+constexpr ::ev::tstamp drain_time = 30.0;
+
+}
+
+predecessor::predecessor(rmrf::net::auto_fd &&channel_) :
+    channel{std::forward<rmrf::net::auto_fd>(channel_)}, io{}, timeout{}, done{false}, error{}, sockets{}
+{
+    this->io.set<predecessor, &predecessor::cb_channel>(this);
+    this->timeout.set<predecessor, &predecessor::cb_timeout>(this);
+}
+
+predecessor::~predecessor() {
+    this->io.stop();
+    this->timeout.stop();
+}
+
+std::unique_ptr<predecessor> predecessor::attach() {
+    const char *value = std::getenv(handover_variable);
+
+    if (!value) {
+        return nullptr;
+    }
+
+    rmrf::net::auto_fd channel{static_cast<int>(std::strtol(value, nullptr, 10))};
+    unsetenv(handover_variable);
+    fcntl(channel.get(), F_SETFD, FD_CLOEXEC);
+
+    // The previous instance answers right away; only its state takes a while
+    struct timeval timeout = {10, 0};
+    setsockopt(channel.get(), SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    auto p = std::make_unique<predecessor>(std::move(channel));
+    rmrf::net::send_fds(p->channel.get(), {}, "R");
+
+    while (p->receive()) {
+        // NOP
+    }
+
+    return p;
+}
+
+void predecessor::wait() {
+    if (!this->done) {
+        // Draining and writing out the queue may take a while, but not forever
+        this->io.start(this->channel.get(), ::ev::READ);
+        this->timeout.start(drain_time + 90, 0);
+
+        while (!this->done && this->error.empty()) {
+            ::ev::get_default_loop().run(::ev::ONCE);
+        }
+
+        this->io.stop();
+        this->timeout.stop();
+    }
+
+    this->channel.reset();
+
+    if (!this->error.empty()) {
+        throw rmrf::net::netio_exception(this->error);
+    }
+}
+
+inherited_sockets &predecessor::get_sockets() {
+    return this->sockets;
+}
+
+bool predecessor::receive() {
+    std::vector<rmrf::net::auto_fd> fds;
+    const std::string message = rmrf::net::receive_fds(this->channel.get(), fds);
+
+    // The listeners end with D, the connections with E
+    if (message == "D") {
+        return false;
+    }
+
+    if (message == "E") {
+        this->done = true;
+        return false;
+    }
+
+    if (message.empty()) {
+        throw rmrf::net::netio_exception("The previous instance went away during the handover.");
+    }
+
+    if (fds.size() != 1 || message.size() < 3 || message[1] != ' ') {
+        throw rmrf::net::netio_exception("Unexpected handover message: " + message);
+    }
+
+    const size_t space = message.find(' ', 2);
+    const std::string name = message.substr(2, space == std::string::npos ? std::string::npos : space - 2);
+
+    if (message[0] == 'L') {
+        this->sockets.listeners[name] = std::move(fds.front());
+    } else if (message[0] == 'C' && space != std::string::npos) {
+        this->sockets.connections.emplace_back(name,
+            rmrf::smtp::lmtp_server::idle_connection{std::move(fds.front()), message.substr(space + 1) == "1"});
+    } else {
+        throw rmrf::net::netio_exception("Unexpected handover message: " + message);
+    }
+
+    return true;
+}
+
+void predecessor::cb_channel(::ev::io &w, int events) {
+    (void)w;
+    (void)events;
+
+    try {
+        this->receive();
+    } catch (const rmrf::net::netio_exception &e) {
+        this->error = e.what();
+    }
+}
+
+void predecessor::cb_timeout(::ev::timer &w, int events) {
+    (void)w;
+    (void)events;
+
+    this->error = "The previous instance did not finish the handover in time.";
+}
+
+successor::successor(const std::vector<std::string> &argv, rmrf::smtp::lmtp_server &lmtp_, drained_cb_type drained_cb_) :
+    lmtp{lmtp_}, drained_cb{drained_cb_},
+    pid{-1}, channel{}, io{}, drain_timer{}, deadline{0}, drained{false}, released{false}, failed{false},
+    held{}
+{
+    int pair[2];
+
+    if (argv.empty() || socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, pair) != 0) {
+        throw rmrf::net::netio_exception(std::string("Failed to set up the handover: ") + strerror(errno));
+    }
+
+    this->channel = rmrf::net::auto_fd{pair[0]};
+    rmrf::net::auto_fd child_end{pair[1]};
+
+    // Nothing but async-signal-safe calls are allowed after fork, so prepare everything here
+    std::vector<std::string> env;
+
+    for (char **e = environ; *e; e++) {
+        if (strncmp(*e, handover_variable, strlen(handover_variable)) != 0) {
+            env.emplace_back(*e);
+        }
+    }
+
+    env.push_back(std::string(handover_variable) + "=" + std::to_string(child_end.get()));
+
+    std::vector<char *> c_argv;
+    std::vector<char *> c_env;
+
+    for (const std::string &arg : argv) {
+        c_argv.push_back(const_cast<char *>(arg.c_str()));
+    }
+
+    for (const std::string &var : env) {
+        c_env.push_back(const_cast<char *>(var.c_str()));
+    }
+
+    c_argv.push_back(nullptr);
+    c_env.push_back(nullptr);
+
+    this->pid = fork();
+
+    if (this->pid < 0) {
+        throw rmrf::net::netio_exception(std::string("Failed to start a new instance: ") + strerror(errno));
+    }
+
+    if (this->pid == 0) {
+        fcntl(child_end.get(), F_SETFD, 0);
+        execve(c_argv[0], c_argv.data(), c_env.data());
+        _exit(127);
+    }
+
+    this->io.set<successor, &successor::cb_channel>(this);
+    this->io.start(this->channel.get(), ::ev::READ);
+    this->drain_timer.set<successor, &successor::cb_drain>(this);
+}
+
+successor::~successor() {
+    this->io.stop();
+    this->drain_timer.stop();
+}
+
+bool successor::is_running() const {
+    return this->channel.valid() && !this->drained;
+}
+
+bool successor::is_drained() const {
+    return this->drained;
+}
+
+bool successor::is_failed() const {
+    return this->failed;
+}
+
+void successor::cb_channel(::ev::io &w, int events) {
+    (void)w;
+    (void)events;
+
+    std::vector<rmrf::net::auto_fd> fds;
+    std::string message;
+
+    try {
+        message = rmrf::net::receive_fds(this->channel.get(), fds);
+    } catch (const rmrf::net::netio_exception &e) {
+        rmrf::log::error("Failed to talk to the new instance", {{"error", e.what()}});
+    }
+
+    if (message != "R" || this->released) {
+        this->abort();
+        return;
+    }
+
+    // From now on the new instance is responsible for incoming connections
+    const rmrf::net::auto_fd listener = this->lmtp.release_listener();
+    this->released = true;
+
+    try {
+        rmrf::net::send_fds(this->channel.get(), {listener.get()}, "L lmtp");
+        rmrf::net::send_fds(this->channel.get(), {}, "D");
+    } catch (const rmrf::net::netio_exception &e) {
+        rmrf::log::error("Failed to hand over the listener", {{"error", e.what()}});
+        this->abort();
+        return;
+    }
+
+    this->deadline = ::ev::now(::ev::get_default_loop()) + drain_time;
+    this->drain_timer.start(0, 0.1);
+}
+
+void successor::cb_drain(::ev::timer &w, int events) {
+    (void)events;
+
+    for (auto &connection : this->lmtp.release_idle()) {
+        this->held.push_back(std::move(connection));
+    }
+
+    if (this->lmtp.get_session_count() && ::ev::now(::ev::get_default_loop()) < this->deadline) {
+        return;
+    }
+
+    w.stop();
+    this->drained = true;
+    this->drained_cb();
+}
+
+void successor::abort() {
+    this->io.stop();
+    this->channel.reset();
+
+    if (this->pid > 0) {
+        waitpid(this->pid, nullptr, WNOHANG);
+    }
+
+    if (!this->released) {
+        rmrf::log::error("The new instance failed to start, continuing", {{"pid", this->pid}});
+        return;
+    }
+
+    // We stopped accepting already; the service manager has to restart us
+    rmrf::log::error("The new instance went away during the handover", {{"pid", this->pid}});
+    this->drain_timer.stop();
+    this->drained = true;
+    this->failed = true;
+    this->drained_cb();
+}
+
+void successor::finish() {
+    if (!this->channel.valid()) {
+        return;
+    }
+
+    try {
+        for (const auto &connection : this->held) {
+            rmrf::net::send_fds(this->channel.get(), {connection.fd.get()}, connection.greeted ? "C lmtp 1" : "C lmtp 0");
+        }
+
+        rmrf::net::send_fds(this->channel.get(), {}, "E");
+        dctl_status_mainpid(this->pid);
+    } catch (const rmrf::net::netio_exception &e) {
+        rmrf::log::error("Failed to hand over connections", {{"error", e.what()}});
+        this->failed = true;
+    }
+
+    this->channel.reset();
+    this->held.clear();
+}
+
+}
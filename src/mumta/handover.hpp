@@ -0,0 +1,137 @@
+#pragma once
+
+#include <sys/types.h>
+
+#include <ev++.h>
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "net/async_fd.hpp"
+
+#include "smtp/lmtp_server.hpp"
+
+namespace rmrf::mumta {
+
+/**
+ * The sockets a previous instance handed over to us.
+ */
+struct inherited_sockets {
+    std::map<std::string, rmrf::net::auto_fd> listeners;
+    std::vector<std::pair<std::string, rmrf::smtp::lmtp_server::idle_connection>> connections;
+};
+
+/**
+ * The instance that started us for an upgrade.
+ *
+ * It passes on its listening sockets right away, so we accept while it
+ * drains; new clients have to wait for their greeting until we serve. Its
+ * idle connections follow once it stopped serving and wrote out its state,
+ * so the state must not be read before wait() returned.
+ */
+class predecessor {
+private:
+    rmrf::net::auto_fd channel;
+    ::ev::io io;
+    ::ev::timer timeout;
+    bool done;
+    std::string error;
+
+    inherited_sockets sockets;
+
+public:
+    explicit predecessor(rmrf::net::auto_fd &&channel_);
+    ~predecessor();
+
+    predecessor(const predecessor &) = delete;
+    predecessor &operator=(const predecessor &) = delete;
+
+    /**
+     * Take over the listening sockets of the previous instance. Without a
+     * previous instance nothing is returned.
+     *
+     * @throws rmrf::net::netio_exception
+     */
+    static std::unique_ptr<predecessor> attach();
+
+    /**
+     * Run the event loop until the previous instance handed over its
+     * connections, so the listeners taken over are served meanwhile.
+     *
+     * @throws rmrf::net::netio_exception
+     */
+    void wait();
+
+    inherited_sockets &get_sockets();
+
+private:
+    bool receive();
+    void cb_channel(::ev::io &w, int events);
+    void cb_timeout(::ev::timer &w, int events);
+};
+
+/**
+ * Starts a new instance of ourselves and hands over all sockets to it once
+ * it is up, so restarts do not refuse a single connection.
+ *
+ * When the new instance reports back, it gets the listening sockets right
+ * away and we wait for busy sessions to finish. Then the drained callback
+ * fires; the owner has to leave the event loop, write out its state and
+ * call finish() to pass on the idle connections. Should the new instance
+ * go away in between, nobody accepts anymore and is_failed() tells the
+ * owner to exit with an error, so the service manager restarts us.
+ */
+class successor {
+public:
+    typedef std::function<void()> drained_cb_type;
+
+private:
+    rmrf::smtp::lmtp_server &lmtp;
+    drained_cb_type drained_cb;
+
+    pid_t pid;
+    rmrf::net::auto_fd channel;
+    ::ev::io io;
+    ::ev::timer drain_timer;
+    ::ev::tstamp deadline;
+    bool drained;
+    bool released;
+    bool failed;
+
+    std::vector<rmrf::smtp::lmtp_server::idle_connection> held;
+
+public:
+    /**
+     * @param argv The command line to start the new instance with
+     * @param lmtp_ The LMTP endpoint to hand over
+     * @param drained_cb_ Called once we stopped serving
+     */
+    successor(const std::vector<std::string> &argv, rmrf::smtp::lmtp_server &lmtp_, drained_cb_type drained_cb_);
+    ~successor();
+
+    successor(const successor &) = delete;
+    successor &operator=(const successor &) = delete;
+
+    /**
+     * Whether the handover is still going on or done.
+     */
+    bool is_running() const;
+    bool is_drained() const;
+    bool is_failed() const;
+
+    /**
+     * Pass on the idle connections and let the new instance continue.
+     */
+    void finish();
+
+private:
+    void cb_channel(::ev::io &w, int events);
+    void cb_drain(::ev::timer &w, int events);
+    void abort();
+};
+
+}
@@ -0,0 +1,75 @@
+#include "mumta/settings.hpp"
+
+#include <cerrno>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "mumta/settings_exception.hpp"
+
+namespace rmrf::mumta {
+
+namespace {
+
+double get_number(const char *name, double fallback, double min, double max) {
+    const char *value = std::getenv(name);
+
+    if (!value || !*value) {
+        return fallback;
+    }
+
+    char *end = nullptr;
+    errno = 0;
+    const double number = std::strtod(value, &end);
+
+    if (errno || *end || !(number >= min && number <= max)) {
+        throw settings_exception(std::string("Invalid value for ") + name + ": " + value);
+    }
+
+    return number;
+}
+
+std::vector<settings::network> get_networks(const char *name) {
+    const char *value = std::getenv(name);
+    std::vector<settings::network> networks;
+
+    if (!value) {
+        return networks;
+    }
+
+    const std::string list{value};
+    const char *separators = ", \t\n";
+    size_t start = list.find_first_not_of(separators);
+
+    while (start != std::string::npos) {
+        const size_t end = list.find_first_of(separators, start);
+        const std::string text = list.substr(start, end - start);
+        settings::network net{0, 0};
+
+        if (!rmrf::net::parse_cidr(text, net.key, net.prefix_length)) {
+            throw settings_exception(std::string("Invalid network in ") + name + ": " + text);
+        }
+
+        networks.push_back(net);
+        start = list.find_first_not_of(separators, end);
+    }
+
+    return networks;
+}
+
+}
+
+settings read_settings() {
+    settings result{};
+
+    result.loop_budget = get_number("MUMTA_LOOP_BUDGET_MS", 250, 1, 60000) / 1e3;
+    result.lmtp_rate = get_number("MUMTA_LMTP_RATE", 0, 0, 1e6);
+    result.lmtp_connections = static_cast<uint32_t>(get_number("MUMTA_LMTP_CONNECTIONS", 0, 0, 1e6));
+    result.lmtp_allow = get_networks("MUMTA_LMTP_ALLOW");
+    result.lmtp_deny = get_networks("MUMTA_LMTP_DENY");
+    result.lmtp_proxy = get_networks("MUMTA_LMTP_PROXY");
+
+    return result;
+}
+
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <ev++.h>
+
+#include "net/prefix_table.hpp"
+
+namespace rmrf::mumta {
+
+/**
+ * The settings of mumta. They are taken from the environment, so they can
+ * be given with Environment= in the service unit:
+ *
+ *     MUMTA_LOOP_BUDGET_MS    Iterations of the main loop taking longer
+ *                             are reported as lagging (250)
+ *     MUMTA_LMTP_RATE         New LMTP connections per second allowed per
+ *                             source address, 0 for no limit (0)
+ *     MUMTA_LMTP_CONNECTIONS  Open LMTP connections allowed per source
+ *                             address, 0 for no limit (0)
+ *     MUMTA_LMTP_ALLOW        Networks exempt from these limits, e.g.
+ *                             "192.0.2.0/24, 2001:db8::/32"; loopback
+ *                             always is
+ *     MUMTA_LMTP_DENY         Networks not allowed to connect via LMTP
+ *     MUMTA_LMTP_PROXY        Load balancers sending a PROXY protocol
+ *                             header with the client address in front of
+ *                             their connections, e.g. "192.0.2.10";
+ *                             other peers are taken as clients
+ *
+ * Limits per source only apply to TCP sockets, e.g. from a socket unit
+ * with ListenStream=24.
+ */
+struct settings {
+    struct network {
+        rmrf::net::prefix_key_t key;
+        uint8_t prefix_length;
+    };
+
+    ::ev::tstamp loop_budget;
+    double lmtp_rate;
+    uint32_t lmtp_connections;
+    std::vector<network> lmtp_allow;
+    std::vector<network> lmtp_deny;
+    std::vector<network> lmtp_proxy;
+};
+
+/**
+ * Read the settings from the environment.
+ *
+ * @throws settings_exception if a variable has an invalid value
+ */
+settings read_settings();
+
+}
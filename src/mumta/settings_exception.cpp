@@ -0,0 +1,13 @@
+#include "mumta/settings_exception.hpp"
+
+namespace rmrf::mumta {
+
+settings_exception::settings_exception(const std::string &cause_) : cause(cause_) {
+    // NOP
+}
+
+const char *settings_exception::what() const throw() {
+    return this->cause.c_str();
+}
+
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <exception>
+#include <string>
+
+namespace rmrf::mumta {
+
+class settings_exception : public std::exception {
+private:
+    std::string cause;
+public:
+    explicit settings_exception(const std::string &cause_);
+    virtual const char *what() const throw();
+};
+
+}
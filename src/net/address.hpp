@@ -150,7 +150,7 @@ static constexpr long long parse_address_component(const char (&str)[N], size_t
 template <int base, unsigned max_value, size_t N>
 static constexpr int parse_inet_component_base(const char (&str)[N], size_t idx)
 {
-    return parse_address_component<base, '.', max_value>(str, idx);
+    return static_cast<int>(parse_address_component<base, '.', max_value>(str, idx));
 }
 
 template <unsigned max_value, size_t N>
@@ -197,7 +197,7 @@ static constexpr int parse_inet_component_canonical(const char (&str)[N], size_t
         return -1;
     }
 
-    return parse_address_component<10, '.', 255, 3>(str, idx);
+    return static_cast<int>(parse_address_component<10, '.', 255, 3>(str, idx));
 }
 
 //
@@ -206,7 +206,7 @@ static constexpr int parse_inet_component_canonical(const char (&str)[N], size_t
 template <size_t N>
 static constexpr int parse_inet6_hexlet(const char (&str)[N], size_t idx)
 {
-    return parse_address_component<16, ':', 0xFFFF, 4>(str, idx);
+    return static_cast<int>(parse_address_component<16, ':', 0xFFFF, 4>(str, idx));
 }
 
 template <size_t N>
@@ -217,7 +217,7 @@ static constexpr int inet_addr_canonical_at(const char (&str)[N], ssize_t idx, i
     ssize_t sep2 = rfind_chr(str, sep3 - 1, '.');
     ssize_t sep1 = rfind_chr(str, sep2 - 1, '.');
 
-    if (sep3 < idx + 1 || sep2 < idx + 1 || sep1 < idx + 1 || rfind_chr(str, sep1 - 1, '.') >= idx) {
+    if (sep3 <= idx || sep2 <= idx || sep1 <= idx || rfind_chr(str, sep1 - 1, '.') >= idx) {
         return -1;
     }
 
@@ -226,7 +226,7 @@ static constexpr int inet_addr_canonical_at(const char (&str)[N], ssize_t idx, i
     long long c3 = parse_inet_component_canonical(str, sep2 + 1);
     long long c4 = parse_inet_component_canonical(str, sep3 + 1);
 
-    if (c1 < 0 || c1 < 0 || c2 < 0 || c3 < 0) {
+    if (c1 < 0 || c2 < 0 || c3 < 0 || c4 < 0) {
         return -1;
     }
 
@@ -310,8 +310,8 @@ static constexpr void inet6_array_to_saddr(std::array<uint16_t, 8> const &ip6_co
     for (size_t i = 0; i < ip6_comps.size(); i++) {
         uint16_t hexlet = ip6_comps[i];
 
-        in6.s6_addr[i * 2] = hexlet >> 8;
-        in6.s6_addr[i * 2 + 1] = hexlet & 0xff;
+        in6.s6_addr[i * 2] = static_cast<uint8_t>(hexlet >> 8);
+        in6.s6_addr[i * 2 + 1] = static_cast<uint8_t>(hexlet & 0xff);
     }
 }
 
@@ -323,7 +323,7 @@ static constexpr void rshift_array(std::array<T, N> &a, size_t from, size_t shif
     }
 
     for (ssize_t pos = N - 1; pos >= static_cast<ssize_t>(from + shift); pos--) {
-        if (pos - shift >= 0) {
+        if (pos >= static_cast<ssize_t>(shift)) {
             a[pos] = a[pos - shift];
             a[pos - shift] = 0;
         } else {
@@ -369,8 +369,8 @@ static constexpr int inet6_aton(const char (&str)[N], struct in6_addr &in6)
         if ((i == 6 || (i < 6 && shortener_pos != -1)) && inet_addr_canonical_at(str, idx, v4_addr) != -1) {
             v4_addr = net_to_host(v4_addr);
 
-            comps[i++] = (v4_addr >> 16) & 0xffff;
-            comps[i++] = v4_addr & 0xffff;
+            comps[i++] = static_cast<uint16_t>((v4_addr >> 16) & 0xffff);
+            comps[i++] = static_cast<uint16_t>(v4_addr & 0xffff);
 
             if (shortener_pos != -1) {
                 rshift_array(comps, shortener_pos, comps.size() - i);
@@ -403,7 +403,7 @@ static constexpr int inet6_aton(const char (&str)[N], struct in6_addr &in6)
                 return -1;
             }
 
-            comps[i] = hexlet;
+            comps[i] = static_cast<uint16_t>(hexlet);
 
             ssize_t next_sep = find_chr(str, idx, ':');
 
@@ -479,8 +479,120 @@ static constexpr bool is_valid_ip6addr(const char (&str)[N])
     return details::inet6_aton(str, in6) != -1;
 }
 
+//
+// A network given by an address and the number of leading bits significant.
+//
+struct cidr4 {
+    struct in_addr address;
+    uint8_t prefix_length;
+
+    constexpr bool contains(struct in_addr in) const
+    {
+        const uint32_t mask = prefix_length ? ~uint32_t{0} << (32 - prefix_length) : 0;
+
+        return !((details::net_to_host(in.s_addr) ^ details::net_to_host(address.s_addr)) & mask);
+    }
+};
+
+struct cidr6 {
+    struct in6_addr address;
+    uint8_t prefix_length;
+
+    constexpr bool contains(const struct in6_addr &in) const
+    {
+        for (size_t i = 0; i < 16; i++) {
+            const size_t bits = i * 8 < prefix_length ? prefix_length - i * 8 : 0;
+            const uint8_t mask = static_cast<uint8_t>(bits >= 8 ? 0xff : 0xff00 >> bits);
+
+            if ((in.s6_addr[i] ^ address.s6_addr[i]) & mask) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+};
+
+namespace details {
+
+template <size_t N>
+struct fixed_string {
+    char str[N];
+};
+
+//
+// Copy the first M chars of a string into a new, null terminated array.
+//
+template <size_t M, size_t N>
+static constexpr fixed_string<M + 1> string_prefix(const char (&str)[N])
+{
+    fixed_string<M + 1> res = {};
+
+    for (size_t i = 0; i < M && i < N; i++) {
+        res.str[i] = str[i];
+    }
+
+    return res;
 }
 
+//
+// Parse the prefix length after the slash. Leading zeros are not allowed.
+//
+template <size_t N>
+static constexpr int parse_prefix_length(const char (&str)[N], ssize_t slash, int max_length)
+{
+    if (slash < 0 || static_cast<size_t>(slash) + 2 > N - 1) {
+        return -1;
+    }
+
+    const size_t idx = static_cast<size_t>(slash) + 1;
+
+    if ((N - 1 - idx) > 1 && str[idx] == '0') {
+        return -1;
+    }
+
+    long long res = parse_address_component<10, '\0', 128, 3>(str, idx);
+
+    return res > max_length ? -1 : static_cast<int>(res);
+}
+
+template <size_t N>
+static constexpr bool is_canonical_ip4addr(const char (&str)[N])
+{
+    in_addr_t s_addr = 0;
+
+    return inet_addr_canonical(str, s_addr) != -1;
+}
+
+static constexpr bool host_bits_clear(const cidr4 &net)
+{
+    const uint32_t mask = net.prefix_length ? ~uint32_t{0} << (32 - net.prefix_length) : 0;
+
+    return !(net_to_host(net.address.s_addr) & ~mask);
+}
+
+static constexpr bool host_bits_clear(const cidr6 &net)
+{
+    for (size_t i = 0; i < 16; i++) {
+        const size_t bits = i * 8 < net.prefix_length ? net.prefix_length - i * 8 : 0;
+        const uint8_t mask = static_cast<uint8_t>(bits >= 8 ? 0xff : 0xff00 >> bits);
+
+        if (net.address.s6_addr[i] & ~mask) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+}
+
+}
+
+// String literal operator templates are a GNU extension
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+
 template <typename CharT, CharT... Cs>
 static constexpr auto operator"" _ipaddr()
 {
@@ -513,6 +625,54 @@ static constexpr auto operator"" _ip6()
     return rmrf::net::inet_pton<AF_INET6>(str);
 }
 
+//
+// Network literals like "192.0.2.0/24"_cidr4 or "2001:db8::/32"_cidr6.
+// Addresses need to be in canonical form and must not have host bits set.
+//
+template <typename CharT, CharT... Cs>
+static constexpr auto operator"" _cidr4()
+{
+    constexpr char str[] = {Cs..., 0};
+    constexpr ssize_t slash = rmrf::net::details::find_chr(str, 0, '/');
+
+    static_assert(slash > 0, "CIDR notation requires a prefix length.");
+
+    constexpr auto addr = rmrf::net::details::string_prefix<static_cast<size_t>(slash)>(str);
+    constexpr int prefix_length = rmrf::net::details::parse_prefix_length(str, slash, 32);
+
+    static_assert(rmrf::net::details::is_canonical_ip4addr(addr.str), "Invalid IPv4 address format.");
+    static_assert(prefix_length >= 0, "Invalid IPv4 prefix length.");
+
+    constexpr rmrf::net::cidr4 net = {rmrf::net::inet_pton<AF_INET>(addr.str), static_cast<uint8_t>(prefix_length)};
+
+    static_assert(rmrf::net::details::host_bits_clear(net), "Host bits set in IPv4 network.");
+
+    return net;
+}
+
+template <typename CharT, CharT... Cs>
+static constexpr auto operator"" _cidr6()
+{
+    constexpr char str[] = {Cs..., 0};
+    constexpr ssize_t slash = rmrf::net::details::find_chr(str, 0, '/');
+
+    static_assert(slash > 0, "CIDR notation requires a prefix length.");
+
+    constexpr auto addr = rmrf::net::details::string_prefix<static_cast<size_t>(slash)>(str);
+    constexpr int prefix_length = rmrf::net::details::parse_prefix_length(str, slash, 128);
+
+    static_assert(rmrf::net::is_valid_ip6addr(addr.str), "Invalid IPv6 address format.");
+    static_assert(prefix_length >= 0, "Invalid IPv6 prefix length.");
+
+    constexpr rmrf::net::cidr6 net = {rmrf::net::inet_pton<AF_INET6>(addr.str), static_cast<uint8_t>(prefix_length)};
+
+    static_assert(rmrf::net::details::host_bits_clear(net), "Host bits set in IPv6 network.");
+
+    return net;
+}
+
+#pragma GCC diagnostic pop
+
 static constexpr uint16_t operator "" _ipport(unsigned long long port)
 {
     if (port > 65535) {
@@ -0,0 +1,249 @@
+#include "net/admission_filter.hpp"
+
+#include <netinet/in.h>
+
+#include <algorithm>
+
+namespace rmrf::net {
+
+namespace {
+
+uint64_t mix(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ull;
+    h ^= h >> 33;
+
+    return h;
+}
+
+}
+
+admission_filter::admission_filter(const admission_limits &limits_, size_t table_size) :
+    limits{limits_},
+    epoch{std::chrono::steady_clock::now()},
+    table{},
+    table_mask{0},
+    total_active{0},
+    exempt_networks{},
+    blocked_networks{}
+{
+    size_t size = 64;
+
+    while (size < table_size) {
+        size <<= 1;
+    }
+
+    this->table = std::vector<slot>(size);
+    this->table_mask = size - 1;
+
+    for (auto &s : this->table) {
+        s.tag.store(0, std::memory_order_relaxed);
+        s.state.store(0, std::memory_order_relaxed);
+        s.active.store(0, std::memory_order_relaxed);
+    }
+}
+
+admission_filter::~admission_filter() {
+    // NOP
+}
+
+void admission_filter::exempt(prefix_key_t key, unsigned length) {
+    this->exempt_networks.insert(key, length, true);
+}
+
+void admission_filter::exempt(const cidr4 &net) {
+    this->exempt_networks.insert(net, true);
+}
+
+void admission_filter::exempt(const cidr6 &net) {
+    this->exempt_networks.insert(net, true);
+}
+
+void admission_filter::block(prefix_key_t key, unsigned length) {
+    this->blocked_networks.insert(key, length, true);
+}
+
+uint32_t admission_filter::get_active_connections() const {
+    return this->total_active.load(std::memory_order_relaxed);
+}
+
+uint32_t admission_filter::now_ms() const {
+    const auto elapsed = std::chrono::steady_clock::now() - this->epoch;
+    return static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count());
+}
+
+bool admission_filter::get_key(const struct sockaddr *peer, prefix_key_t &key) {
+    if (AF_INET == peer->sa_family) {
+        key = make_prefix_key(reinterpret_cast<const struct sockaddr_in *>(peer)->sin_addr);
+        return true;
+    }
+
+    if (AF_INET6 == peer->sa_family) {
+        key = make_prefix_key(reinterpret_cast<const struct sockaddr_in6 *>(peer)->sin6_addr);
+        return true;
+    }
+
+    return false;
+}
+
+uint64_t admission_filter::fingerprint(prefix_key_t key, unsigned length) {
+    if (length < 128) {
+        key &= length ? ~prefix_key_t{0} << (128 - length) : 0;
+    }
+
+    // A full round after each part, as a host and its network must not
+    // differ by just the length bits; 0 marks free slots
+    uint64_t h = mix(static_cast<uint64_t>(key >> 64) ^ 0x9e3779b97f4a7c15ull);
+    h = mix(h ^ static_cast<uint64_t>(key));
+    h = mix(h ^ length);
+
+    return h ? h : 1;
+}
+
+admission_filter::slot *admission_filter::find_slot(uint64_t fp, bool create) {
+    const size_t start = fp & this->table_mask;
+    slot *victim = nullptr;
+    uint32_t victim_age = 0;
+    const uint32_t now = this->now_ms();
+
+    for (size_t i = 0; i < max_probes; i++) {
+        slot &s = this->table[(start + i) & this->table_mask];
+        uint64_t tag = s.tag.load(std::memory_order_acquire);
+
+        if (tag == fp) {
+            return &s;
+        }
+
+        if (!create) {
+            continue;
+        }
+
+        if (!tag) {
+            if (s.tag.compare_exchange_strong(tag, fp, std::memory_order_acq_rel)) {
+                return &s;
+            }
+
+            if (tag == fp) {
+                return &s;
+            }
+        }
+
+        // Remember the longest idle source without open connections
+        if (!s.active.load(std::memory_order_relaxed)) {
+            const uint32_t age = now - static_cast<uint32_t>(s.state.load(std::memory_order_relaxed) >> 32);
+
+            if (!victim || age > victim_age) {
+                victim = &s;
+                victim_age = age;
+            }
+        }
+    }
+
+    if (!victim) {
+        return nullptr;
+    }
+
+    // A zero state reads as a full bucket for the new owner
+    victim->tag.store(fp, std::memory_order_release);
+    victim->state.store(0, std::memory_order_release);
+
+    return victim;
+}
+
+bool admission_filter::take_token(slot &s, double rate, double burst) {
+    if (rate <= 0) {
+        return true;
+    }
+
+    // State: last refill in ms since epoch (high) and milli tokens (low)
+    const uint32_t now = this->now_ms();
+    const double capacity = std::max(burst, 1.0) * 1000;
+    uint64_t state = s.state.load(std::memory_order_relaxed);
+
+    for (;;) {
+        const uint32_t last = static_cast<uint32_t>(state >> 32);
+        const uint32_t tokens = static_cast<uint32_t>(state);
+        // Milli tokens per ms equals tokens per second
+        const double refilled = !state ? capacity : std::min(capacity, tokens + static_cast<double>(now - last) * rate);
+
+        const bool allowed = refilled >= 1000;
+        const uint32_t remaining = static_cast<uint32_t>(allowed ? refilled - 1000 : refilled);
+        const uint64_t next = (static_cast<uint64_t>(now) << 32) | remaining;
+
+        if (s.state.compare_exchange_weak(state, next ? next : 1, std::memory_order_relaxed)) {
+            return allowed;
+        }
+    }
+}
+
+admission_verdict admission_filter::admit(const struct sockaddr *peer) {
+    prefix_key_t key = 0;
+
+    if (!get_key(peer, key)) {
+        // Local sockets are not subject to source limits
+        this->total_active.fetch_add(1, std::memory_order_relaxed);
+        return admission_verdict::accept;
+    }
+
+    if (this->blocked_networks.contains(key)) {
+        return admission_verdict::reject;
+    }
+
+    const bool exempt = this->exempt_networks.contains(key);
+
+    if (!exempt && this->limits.total_concurrent &&
+        this->total_active.load(std::memory_order_relaxed) >= this->limits.total_concurrent) {
+        return admission_verdict::reject;
+    }
+
+    slot *address_slot = this->find_slot(fingerprint(key, 128), true);
+
+    if (!exempt) {
+        // The dual stack listener reports IPv4 clients as v4-mapped IPv6
+        const bool is_v4 = AF_INET == peer->sa_family ||
+            IN6_IS_ADDR_V4MAPPED(&reinterpret_cast<const struct sockaddr_in6 *>(peer)->sin6_addr);
+        const unsigned prefix_length = is_v4 ? 96u + this->limits.ipv4_prefix_length : this->limits.ipv6_prefix_length;
+        slot *prefix_slot = this->find_slot(fingerprint(key, prefix_length), true);
+
+        if (address_slot && this->limits.per_address_concurrent &&
+            address_slot->active.load(std::memory_order_relaxed) >= this->limits.per_address_concurrent) {
+            return admission_verdict::reject;
+        }
+
+        const bool address_ok = !address_slot || this->take_token(*address_slot, this->limits.per_address_rate, this->limits.per_address_burst);
+        const bool prefix_ok = !prefix_slot || this->take_token(*prefix_slot, this->limits.per_prefix_rate, this->limits.per_prefix_burst);
+
+        if (!address_ok || !prefix_ok) {
+            return this->limits.tarpit_on_rate ? admission_verdict::tarpit : admission_verdict::reject;
+        }
+    }
+
+    if (address_slot) {
+        address_slot->active.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    this->total_active.fetch_add(1, std::memory_order_relaxed);
+
+    return admission_verdict::accept;
+}
+
+void admission_filter::release(const struct sockaddr *peer) {
+    this->total_active.fetch_sub(1, std::memory_order_relaxed);
+
+    prefix_key_t key = 0;
+
+    if (!get_key(peer, key)) {
+        return;
+    }
+
+    if (slot *s = this->find_slot(fingerprint(key, 128), false)) {
+        uint32_t active = s->active.load(std::memory_order_relaxed);
+
+        while (active && !s->active.compare_exchange_weak(active, active - 1, std::memory_order_relaxed)) {
+        }
+    }
+}
+
+}
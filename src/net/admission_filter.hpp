@@ -0,0 +1,122 @@
+#pragma once
+
+#include <sys/socket.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "net/prefix_table.hpp"
+
+namespace rmrf::net {
+
+enum class admission_verdict : uint8_t {
+    accept,
+    reject,
+    tarpit
+};
+
+struct admission_limits {
+    /** New connections per second and burst allowed per source address */
+    double per_address_rate;
+    double per_address_burst;
+    /** New connections per second and burst allowed per source network */
+    double per_prefix_rate;
+    double per_prefix_burst;
+    /** Network sizes the per prefix bucket is kept for */
+    uint8_t ipv4_prefix_length;
+    uint8_t ipv6_prefix_length;
+    /** Open connections allowed per source address and in total; 0 disables */
+    uint32_t per_address_concurrent;
+    uint32_t total_concurrent;
+    /** Tarpit sources that exceed their rate instead of closing right away */
+    bool tarpit_on_rate;
+};
+
+/**
+ * This class decides whether a freshly accepted connection may proceed.
+ *
+ * Sources are tracked with token buckets per address and per network in a
+ * fixed size open addressing table. Each slot is a handful of atomics and is
+ * updated lock free, so the filter can be shared between listeners.
+ * The table is approximate by design: sources are identified by a 64 bit
+ * fingerprint and idle sources get evicted when the table runs full.
+ */
+class admission_filter {
+public:
+    typedef std::shared_ptr<admission_filter> ptr_type;
+
+private:
+    struct slot {
+        std::atomic<uint64_t> tag;
+        std::atomic<uint64_t> state;
+        std::atomic<uint32_t> active;
+    };
+
+    static constexpr size_t max_probes = 8;
+
+    const admission_limits limits;
+    const std::chrono::steady_clock::time_point epoch;
+
+    std::vector<slot> table;
+    size_t table_mask;
+
+    std::atomic<uint32_t> total_active;
+
+    prefix_table<bool> exempt_networks;
+    prefix_table<bool> blocked_networks;
+
+public:
+    /**
+     * @param limits_ The limits to enforce
+     * @param table_size The number of sources tracked; rounded up to a power of two
+     */
+    explicit admission_filter(const admission_limits &limits_, size_t table_size = 16384);
+    ~admission_filter();
+
+    admission_filter(const admission_filter &) = delete;
+    admission_filter &operator=(const admission_filter &) = delete;
+
+    /**
+     * Never limit connections from this network, e.g. mynetworks.
+     * Configure before the filter is in use.
+     */
+    void exempt(prefix_key_t key, unsigned length);
+    void exempt(const cidr4 &net);
+    void exempt(const cidr6 &net);
+
+    /**
+     * Always reject connections from this network.
+     * Configure before the filter is in use.
+     */
+    void block(prefix_key_t key, unsigned length);
+
+    /**
+     * Check a new connection. Accepted connections count against the
+     * concurrency limits until release() is called for them.
+     *
+     * @param peer The source address of the connection
+     * @return The verdict for the connection
+     */
+    admission_verdict admit(const struct sockaddr *peer);
+
+    /**
+     * Give back the concurrency slot of an accepted connection.
+     */
+    void release(const struct sockaddr *peer);
+
+    uint32_t get_active_connections() const;
+
+private:
+    uint32_t now_ms() const;
+    slot *find_slot(uint64_t fingerprint, bool create);
+    bool take_token(slot &s, double rate, double burst);
+
+    static bool get_key(const struct sockaddr *peer, prefix_key_t &key);
+    static uint64_t fingerprint(prefix_key_t key, unsigned length);
+};
+
+}
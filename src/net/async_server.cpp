@@ -14,16 +14,39 @@
 namespace rmrf::net {
 
 async_server_socket::async_server_socket(auto_fd&& socket_fd) :
-		socket(std::forward<auto_fd>(socket_fd)), on_accept{}, on_error{}, io{} {
+		socket(std::forward<auto_fd>(socket_fd)), on_accept{}, on_error{}, io{}, resume_timer{} {
     // This constructor got a constructed socket as an argument
     // and forwards it to libev
     io.set<async_server_socket, &async_server_socket::cb_ev>(this);
     io.start(this->socket.get(), ::ev::READ);
+    resume_timer.set<async_server_socket, &async_server_socket::cb_resume>(this);
 }
 
 async_server_socket::~async_server_socket() {
     // Remove this socket from libev ...
 	io.stop();
+	resume_timer.stop();
+}
+
+auto_fd async_server_socket::release() {
+	io.stop();
+	resume_timer.stop();
+	return std::move(this->socket);
+}
+
+void async_server_socket::pause(::ev::tstamp seconds) {
+	io.stop();
+	resume_timer.stop();
+	resume_timer.start(seconds, 0);
+}
+
+void async_server_socket::cb_resume(::ev::timer &w, int events) {
+	(void) w;
+	(void) events;
+
+	if (this->socket.valid()) {
+		io.start(this->socket.get(), ::ev::READ);
+	}
 }
 
 void async_server_socket::cb_ev(::ev::io &w, int events) {
@@ -47,12 +70,12 @@ void async_server_socket::cb_ev(::ev::io &w, int events) {
 	}
 }
 
-inline void async_server_socket::set_accept_handler(
+void async_server_socket::set_accept_handler(
 		const accept_handler_type &value) {
 	on_accept = value;
 }
 
-inline async_server_socket::accept_handler_type async_server_socket::get_accept_handler() const {
+async_server_socket::accept_handler_type async_server_socket::get_accept_handler() const {
 	return on_accept;
 }
 
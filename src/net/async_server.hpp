@@ -23,16 +23,30 @@ private:
     error_handler_type on_error;
 
     ::ev::io io;
+    ::ev::timer resume_timer;
 
 public:
     async_server_socket(auto_fd &&fd);
     ~async_server_socket();
 
-	accept_handler_type get_accept_handler() const;
-	void set_accept_handler(const accept_handler_type &value);
+    /**
+     * Stop accepting and hand out the listening socket, e.g. to pass it on
+     * to another process.
+     */
+    auto_fd release();
+
+    /**
+     * Stop accepting for the given time, e.g. while the process is out of
+     * descriptors. Pending connections wait in the backlog meanwhile.
+     */
+    void pause(::ev::tstamp seconds);
+
+    accept_handler_type get_accept_handler() const;
+    void set_accept_handler(const accept_handler_type &value);
 
 private:
     void cb_ev(::ev::io &w, int events);
+    void cb_resume(::ev::timer &w, int events);
 };
 
 }
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <vector>
+
+namespace rmrf::net {
+
+/**
+ * A free list of equally sized memory blocks.
+ *
+ * The block size is fixed by the first allocation; requests of other sizes
+ * go straight to the global allocator. Blocks are never returned to the
+ * system before the pool itself is gone.
+ */
+class block_pool {
+public:
+    typedef std::shared_ptr<block_pool> ptr_type;
+
+private:
+    std::mutex m;
+    size_t block_size;
+    size_t max_free;
+    std::vector<void *> free_blocks;
+
+public:
+    /**
+     * @param max_free_ The number of blocks to keep for reuse at most
+     */
+    explicit block_pool(size_t max_free_ = 1024) : m{}, block_size{0}, max_free{max_free_}, free_blocks{} {
+        // NOP
+    }
+
+    ~block_pool() {
+        for (void *block : this->free_blocks) {
+            ::operator delete(block);
+        }
+    }
+
+    block_pool(const block_pool &) = delete;
+    block_pool &operator=(const block_pool &) = delete;
+
+    void *allocate(size_t size) {
+        {
+            std::lock_guard<std::mutex> lock(this->m);
+
+            if (!this->block_size) {
+                this->block_size = size;
+            }
+
+            if (size == this->block_size && !this->free_blocks.empty()) {
+                void *block = this->free_blocks.back();
+                this->free_blocks.pop_back();
+                return block;
+            }
+        }
+
+        return ::operator new(size);
+    }
+
+    void deallocate(void *block, size_t size) {
+        {
+            std::lock_guard<std::mutex> lock(this->m);
+
+            if (size == this->block_size && this->free_blocks.size() < this->max_free) {
+                this->free_blocks.push_back(block);
+                return;
+            }
+        }
+
+        ::operator delete(block);
+    }
+};
+
+/**
+ * An allocator drawing from a block_pool, e.g. for std::allocate_shared.
+ * Each copy keeps the pool alive.
+ */
+template <typename T>
+class pool_allocator {
+public:
+    typedef T value_type;
+
+    block_pool::ptr_type pool;
+
+    explicit pool_allocator(const block_pool::ptr_type &pool_) : pool{pool_} {}
+
+    template <typename U>
+    pool_allocator(const pool_allocator<U> &other) : pool{other.pool} {}
+
+    T *allocate(size_t n) {
+        return static_cast<T *>(this->pool->allocate(n * sizeof(T)));
+    }
+
+    void deallocate(T *p, size_t n) {
+        this->pool->deallocate(p, n * sizeof(T));
+    }
+
+    template <typename U>
+    bool operator==(const pool_allocator<U> &other) const {
+        return this->pool == other.pool;
+    }
+
+    template <typename U>
+    bool operator!=(const pool_allocator<U> &other) const {
+        return this->pool != other.pool;
+    }
+};
+
+}
@@ -9,12 +9,16 @@
 
 namespace rmrf::net {
 
-connection_client::connection_client() : in_data_cb{} {
+connection_client::connection_client() : in_data_cb{}, closed_cb{} {
 
 }
 
-inline void connection_client::set_incomming_data_callback(const incomming_data_cb &cb) {
+void connection_client::set_incomming_data_callback(const incomming_data_cb &cb) {
 	this->in_data_cb = cb;
 }
 
+void connection_client::set_closed_callback(const closed_cb_type &cb) {
+	this->closed_cb = cb;
+}
+
 }
@@ -16,8 +16,10 @@ namespace rmrf::net {
 class connection_client : public std::enable_shared_from_this<connection_client> {
 public:
 	typedef std::function<void(const std::string&)> incomming_data_cb;
+	typedef std::function<void()> closed_cb_type;
 protected:
 	incomming_data_cb in_data_cb;
+	closed_cb_type closed_cb;
 public:
 	connection_client();
 
@@ -32,6 +34,20 @@ public:
 	 * @param cb The callback function to register [void(std::string data)]
 	 */
 	void set_incomming_data_callback(const incomming_data_cb &cb);
+
+	/**
+	 * Use this method in order to get notified when the connection was
+	 * closed, by the peer or by close(). Whoever holds the client should
+	 * drop it then.
+	 */
+	void set_closed_callback(const closed_cb_type &cb);
+
+	/**
+	 * Use this method in order to close the connection right away, e.g.
+	 * after the peer sent something unrecoverable. Data not yet written is
+	 * lost. The closed callback is called.
+	 */
+	virtual void close() = 0;
 };
 
 }
@@ -9,7 +9,7 @@
 
 namespace rmrf::net {
 
-static std::string::size_type default_eol_search(const std::string& data, std::string::size_type start_position) {
+std::string::size_type default_eol_search(const std::string& data, std::string::size_type start_position) {
 	const std::string::size_type s = data.size();
 	for (std::string::size_type i = start_position; i < s; i++) {
 		switch (data[i]) {
@@ -53,7 +53,7 @@ void connection_line_buffer::conn_data_in_cb(const std::string& data_in) {
 
 	std::string::size_type strpos = 0;
 
-	while(strpos != std::string::npos) {
+	while(strpos < data_in.length()) {
 		std::string::size_type nextpos = this->search(data_in, strpos);
 		if (nextpos == std::string::npos) {
 			this->data += data_in.substr(strpos, data_in.length() - strpos);
@@ -62,7 +62,8 @@ void connection_line_buffer::conn_data_in_cb(const std::string& data_in) {
 			this->found_next_line_cb(this->data + data_in.substr(strpos, nextpos - strpos), true);
 			this->data = std::string("");
 		}
-		strpos = nextpos;
+		// Continue behind the line break, the search would find it again
+		strpos = nextpos + 1;
 	}
 
 	if (this->data.length() > this->max) {
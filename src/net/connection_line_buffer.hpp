@@ -17,7 +17,12 @@ namespace rmrf::net {
 
 typedef std::function<std::string::size_type(const std::string&, std::string::size_type)> eol_search_t;
 
-static std::string::size_type default_eol_search(const std::string& data, std::string::size_type start_position);
+/**
+ * Find the end of the next line, accepting "\r\n", "\n" and a lone "\r".
+ *
+ * @return The position of the last character of the line break or npos
+ */
+std::string::size_type default_eol_search(const std::string& data, std::string::size_type start_position);
 
 class connection_line_buffer {
 public:
@@ -29,7 +34,7 @@ private:
 	std::string::size_type max;
 	std::string data;
 public:
-	connection_line_buffer(std::shared_ptr<connection_client> c, found_next_line_cb_t found_next_line_cb_, std::string::size_type max_line_size, eol_search_t search_lb = default_eol_search);
+	connection_line_buffer(std::shared_ptr<connection_client> c, found_next_line_cb_t found_next_line_cb_, std::string::size_type max_line_size, eol_search_t search_lb);
 	connection_line_buffer(std::shared_ptr<connection_client> c, found_next_line_cb_t found_next_line_cb_, std::string::size_type max_line_size);
 private:
 	void conn_data_in_cb(const std::string& data_in);
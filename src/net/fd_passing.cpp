@@ -0,0 +1,95 @@
+#include "net/fd_passing.hpp"
+
+#include <errno.h>
+#include <string.h>
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include "net/netio_exception.hpp"
+
+namespace rmrf::net {
+
+void send_fds(int sock, const std::vector<int> &fds, std::string_view message) {
+    // At least one byte of payload has to go along with the control data
+    if (message.empty() || fds.size() > max_passed_fds) {
+        throw netio_exception("Invalid descriptor message.");
+    }
+
+    iovec iov = {};
+    iov.iov_base = const_cast<char *>(message.data());
+    iov.iov_len = message.size();
+
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int) * max_passed_fds)] = {};
+    msghdr msg = {};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+
+    if (!fds.empty()) {
+        msg.msg_control = control;
+        msg.msg_controllen = CMSG_SPACE(sizeof(int) * fds.size());
+
+        cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int) * fds.size());
+        memcpy(CMSG_DATA(cmsg), fds.data(), sizeof(int) * fds.size());
+    }
+
+    ssize_t sent;
+
+    do {
+        sent = sendmsg(sock, &msg, MSG_NOSIGNAL);
+    } while (sent < 0 && errno == EINTR);
+
+    if (sent < 0) {
+        throw netio_exception(std::string("Failed to pass descriptors: ") + strerror(errno));
+    }
+}
+
+std::string receive_fds(int sock, std::vector<auto_fd> &fds) {
+    char buffer[4096];
+    iovec iov = {};
+    iov.iov_base = buffer;
+    iov.iov_len = sizeof(buffer);
+
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int) * max_passed_fds)] = {};
+    msghdr msg = {};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    ssize_t received;
+
+    do {
+        received = recvmsg(sock, &msg, MSG_CMSG_CLOEXEC);
+    } while (received < 0 && errno == EINTR);
+
+    if (received < 0) {
+        throw netio_exception(std::string("Failed to receive descriptors: ") + strerror(errno));
+    }
+
+    // Take ownership first so nothing leaks if the message is bad
+    for (cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) {
+            continue;
+        }
+
+        const size_t count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+
+        for (size_t i = 0; i < count; i++) {
+            int fd;
+            memcpy(&fd, CMSG_DATA(cmsg) + i * sizeof(int), sizeof(int));
+            fds.emplace_back(fd);
+        }
+    }
+
+    if (msg.msg_flags & (MSG_TRUNC | MSG_CTRUNC)) {
+        throw netio_exception("Received a truncated descriptor message.");
+    }
+
+    return std::string(buffer, static_cast<size_t>(received));
+}
+
+}
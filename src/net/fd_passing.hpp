@@ -0,0 +1,29 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "net/async_fd.hpp"
+
+namespace rmrf::net {
+
+/**
+ * The most descriptors passed with a single message.
+ */
+constexpr size_t max_passed_fds = 64;
+
+/**
+ * Send a message along with the given descriptors over a connected UNIX
+ * domain socket (SCM_RIGHTS). The message must not be empty. The
+ * descriptors stay open on our side.
+ */
+void send_fds(int sock, const std::vector<int> &fds, std::string_view message);
+
+/**
+ * Receive one message sent by send_fds. Passed descriptors are appended to
+ * fds with FD_CLOEXEC set. An empty message means the peer went away.
+ */
+std::string receive_fds(int sock, std::vector<auto_fd> &fds);
+
+}
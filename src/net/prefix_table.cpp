@@ -0,0 +1,72 @@
+#include "net/prefix_table.hpp"
+
+#include <arpa/inet.h>
+
+#include <cstdlib>
+
+namespace rmrf::net {
+
+prefix_key_t make_prefix_key(const struct in_addr &in)
+{
+    // ::ffff:a.b.c.d
+    return (prefix_key_t{0xffff} << 32) | details::net_to_host(in.s_addr);
+}
+
+prefix_key_t make_prefix_key(const struct in6_addr &in6)
+{
+    prefix_key_t key = 0;
+
+    for (size_t i = 0; i < 16; i++) {
+        key = (key << 8) | in6.s6_addr[i];
+    }
+
+    return key;
+}
+
+bool parse_cidr(const std::string &text, prefix_key_t &key, uint8_t &prefix_length)
+{
+    const size_t slash = text.find('/');
+    const std::string address = text.substr(0, slash);
+
+    unsigned long length = 0;
+    bool has_length = std::string::npos != slash;
+
+    if (has_length) {
+        const std::string digits = text.substr(slash + 1);
+
+        if (digits.empty() || digits.size() > 3 || digits.find_first_not_of("0123456789") != std::string::npos) {
+            return false;
+        }
+
+        length = std::strtoul(digits.c_str(), nullptr, 10);
+    }
+
+    struct in_addr in = {};
+    struct in6_addr in6 = {};
+
+    if (1 == ::inet_pton(AF_INET, address.c_str(), &in)) {
+        if (length > 32) {
+            return false;
+        }
+
+        key = make_prefix_key(in);
+        prefix_length = static_cast<uint8_t>(96 + (has_length ? length : 32));
+    } else if (1 == ::inet_pton(AF_INET6, address.c_str(), &in6)) {
+        if (length > 128) {
+            return false;
+        }
+
+        key = make_prefix_key(in6);
+        prefix_length = static_cast<uint8_t>(has_length ? length : 128);
+    } else {
+        return false;
+    }
+
+    if (prefix_length < 128) {
+        key &= prefix_length ? ~prefix_key_t{0} << (128 - prefix_length) : 0;
+    }
+
+    return true;
+}
+
+}
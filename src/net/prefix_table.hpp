@@ -0,0 +1,283 @@
+#pragma once
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "net/address.hpp"
+
+namespace rmrf::net {
+
+/**
+ * Addresses are matched as 128 bit keys; IPv4 uses the IPv4-mapped range.
+ */
+__extension__ typedef unsigned __int128 prefix_key_t;
+
+prefix_key_t make_prefix_key(const struct in_addr &in);
+prefix_key_t make_prefix_key(const struct in6_addr &in6);
+
+/**
+ * Parse a network in CIDR notation at runtime, e.g. from configuration.
+ * A plain address is taken as a host route.
+ *
+ * @param text The network, like "192.0.2.0/24" or "2001:db8::/32"
+ * @param key The network as key with the host bits cleared
+ * @param prefix_length The prefix length in key bits
+ * @return false if the text is not a valid network
+ */
+bool parse_cidr(const std::string &text, prefix_key_t &key, uint8_t &prefix_length);
+
+/**
+ * A longest prefix match table mapping networks to values.
+ *
+ * The networks are kept in a path compressed binary trie whose nodes live
+ * in one contiguous vector, so a lookup walks at most one node per distinct
+ * branch point. IPv4 and IPv6 networks share one table.
+ */
+template <typename T>
+class prefix_table {
+private:
+    static constexpr uint32_t no_node = UINT32_MAX;
+
+    struct node {
+        prefix_key_t key;
+        uint8_t length;
+        bool has_value;
+        uint32_t child[2];
+        T value;
+    };
+
+    std::vector<node> nodes;
+    uint32_t root;
+    size_t entries;
+
+    static prefix_key_t mask(prefix_key_t key, unsigned length)
+    {
+        return length ? key & (~prefix_key_t{0} << (128 - length)) : 0;
+    }
+
+    static unsigned bit(prefix_key_t key, unsigned pos)
+    {
+        return static_cast<unsigned>(key >> (127 - pos)) & 1;
+    }
+
+    static unsigned common_length(prefix_key_t a, prefix_key_t b)
+    {
+        const prefix_key_t diff = a ^ b;
+        const uint64_t high = static_cast<uint64_t>(diff >> 64);
+        const uint64_t low = static_cast<uint64_t>(diff);
+
+        if (high) {
+            return static_cast<unsigned>(__builtin_clzll(high));
+        }
+
+        return low ? 64 + static_cast<unsigned>(__builtin_clzll(low)) : 128;
+    }
+
+    uint32_t add_node(prefix_key_t key, unsigned length)
+    {
+        this->nodes.push_back(node{key, static_cast<uint8_t>(length), false, {no_node, no_node}, T{}});
+        return static_cast<uint32_t>(this->nodes.size() - 1);
+    }
+
+    void set_value(uint32_t idx, const T &value)
+    {
+        if (!this->nodes[idx].has_value) {
+            this->entries++;
+        }
+
+        this->nodes[idx].has_value = true;
+        this->nodes[idx].value = value;
+    }
+
+public:
+    prefix_table() : nodes{}, root{no_node}, entries{0} {};
+
+    /**
+     * Add a network or replace the value stored for it.
+     */
+    void insert(prefix_key_t key, unsigned length, const T &value)
+    {
+        length = length > 128 ? 128 : length;
+        key = mask(key, length);
+
+        if (no_node == this->root) {
+            this->root = this->add_node(key, length);
+            this->set_value(this->root, value);
+            return;
+        }
+
+        uint32_t parent = no_node;
+        unsigned side = 0;
+        uint32_t idx = this->root;
+
+        for (;;) {
+            const prefix_key_t node_key = this->nodes[idx].key;
+            const unsigned node_length = this->nodes[idx].length;
+            unsigned common = common_length(node_key, key);
+            common = common < node_length ? common : node_length;
+            common = common < length ? common : length;
+
+            if (common < node_length) {
+                // Split the compressed path where the new network branches off
+                const uint32_t mid = this->add_node(mask(key, common), common);
+                this->nodes[mid].child[bit(node_key, common)] = idx;
+
+                if (common == length) {
+                    this->set_value(mid, value);
+                } else {
+                    const uint32_t leaf = this->add_node(key, length);
+                    this->set_value(leaf, value);
+                    this->nodes[mid].child[bit(key, common)] = leaf;
+                }
+
+                if (no_node == parent) {
+                    this->root = mid;
+                } else {
+                    this->nodes[parent].child[side] = mid;
+                }
+
+                return;
+            }
+
+            if (node_length == length) {
+                this->set_value(idx, value);
+                return;
+            }
+
+            side = bit(key, node_length);
+            const uint32_t next = this->nodes[idx].child[side];
+
+            if (no_node == next) {
+                const uint32_t leaf = this->add_node(key, length);
+                this->set_value(leaf, value);
+                this->nodes[idx].child[side] = leaf;
+                return;
+            }
+
+            parent = idx;
+            idx = next;
+        }
+    }
+
+    void insert(const cidr4 &net, const T &value)
+    {
+        this->insert(make_prefix_key(net.address), 96u + net.prefix_length, value);
+    }
+
+    void insert(const cidr6 &net, const T &value)
+    {
+        this->insert(make_prefix_key(net.address), net.prefix_length, value);
+    }
+
+    /**
+     * Find the value of the most specific network containing the key.
+     *
+     * @return The value or nullptr if no network matches
+     */
+    const T *lookup(prefix_key_t key) const
+    {
+        const T *best = nullptr;
+        uint32_t idx = this->root;
+
+        while (no_node != idx) {
+            const node &n = this->nodes[idx];
+
+            if (mask(key, n.length) != n.key) {
+                break;
+            }
+
+            if (n.has_value) {
+                best = &n.value;
+            }
+
+            if (n.length >= 128) {
+                break;
+            }
+
+            idx = n.child[bit(key, n.length)];
+        }
+
+        return best;
+    }
+
+    const T *lookup(const struct in_addr &in) const
+    {
+        return this->lookup(make_prefix_key(in));
+    }
+
+    const T *lookup(const struct in6_addr &in6) const
+    {
+        return this->lookup(make_prefix_key(in6));
+    }
+
+    /**
+     * Look up the address of an AF_INET or AF_INET6 socket address.
+     */
+    const T *lookup(const struct sockaddr *addr) const
+    {
+        if (AF_INET == addr->sa_family) {
+            return this->lookup(reinterpret_cast<const struct sockaddr_in *>(addr)->sin_addr);
+        }
+
+        if (AF_INET6 == addr->sa_family) {
+            return this->lookup(reinterpret_cast<const struct sockaddr_in6 *>(addr)->sin6_addr);
+        }
+
+        return nullptr;
+    }
+
+    bool contains(prefix_key_t key) const
+    {
+        return nullptr != this->lookup(key);
+    }
+
+    /**
+     * Remove the value stored for exactly this network.
+     */
+    void remove(prefix_key_t key, unsigned length)
+    {
+        length = length > 128 ? 128 : length;
+        key = mask(key, length);
+        uint32_t idx = this->root;
+
+        while (no_node != idx) {
+            node &n = this->nodes[idx];
+
+            if (mask(key, n.length) != n.key || n.length > length) {
+                return;
+            }
+
+            if (n.length == length) {
+                if (n.has_value) {
+                    n.has_value = false;
+                    n.value = T{};
+                    this->entries--;
+                }
+
+                return;
+            }
+
+            idx = n.child[bit(key, n.length)];
+        }
+    }
+
+    size_t size() const
+    {
+        return this->entries;
+    }
+
+    void clear()
+    {
+        this->nodes.clear();
+        this->root = no_node;
+        this->entries = 0;
+    }
+};
+
+}
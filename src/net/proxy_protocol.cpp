@@ -0,0 +1,208 @@
+#include "net/proxy_protocol.hpp"
+
+#include <arpa/inet.h>
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+namespace rmrf::net {
+
+static constexpr uint8_t proxy_v2_signature[12] = {
+    0x0d, 0x0a, 0x0d, 0x0a, 0x00, 0x0d, 0x0a, 0x51, 0x55, 0x49, 0x54, 0x0a
+};
+
+static constexpr char proxy_v1_signature[] = "PROXY ";
+
+static bool parse_port(std::string_view text, uint16_t &port) {
+    if (text.empty() || text.size() > 5 || (text.size() > 1 && text[0] == '0')) {
+        return false;
+    }
+
+    uint32_t value = 0;
+
+    for (char c : text) {
+        if (c < '0' || c > '9') {
+            return false;
+        }
+
+        value = value * 10 + static_cast<uint32_t>(c - '0');
+    }
+
+    if (value > 65535) {
+        return false;
+    }
+
+    port = static_cast<uint16_t>(value);
+    return true;
+}
+
+static bool make_address(int family, std::string_view text, std::string_view port_text, socketaddr &address) {
+    // inet_pton needs a terminated string; addresses are short
+    char buffer[INET6_ADDRSTRLEN] = {};
+    uint16_t port = 0;
+
+    if (text.size() >= sizeof(buffer) || !parse_port(port_text, port)) {
+        return false;
+    }
+
+    std::memcpy(buffer, text.data(), text.size());
+
+    if (family == AF_INET) {
+        sockaddr_in in = {};
+        in.sin_family = AF_INET;
+        in.sin_port = htons(port);
+
+        if (inet_pton(AF_INET, buffer, &in.sin_addr) != 1) {
+            return false;
+        }
+
+        address = socketaddr{in};
+    } else {
+        sockaddr_in6 in6 = {};
+        in6.sin6_family = AF_INET6;
+        in6.sin6_port = htons(port);
+
+        if (inet_pton(AF_INET6, buffer, &in6.sin6_addr) != 1) {
+            return false;
+        }
+
+        address = socketaddr{in6};
+    }
+
+    return true;
+}
+
+static proxy_parse_status parse_proxy_v1(const uint8_t *data, size_t length, proxy_header &header) {
+    const std::string_view text{reinterpret_cast<const char *>(data), std::min(length, proxy_v1_max_length)};
+    const size_t eol = text.find("\r\n");
+
+    if (eol == std::string_view::npos) {
+        return length >= proxy_v1_max_length ? proxy_parse_status::invalid : proxy_parse_status::incomplete;
+    }
+
+    std::string_view fields[6];
+    size_t count = 0;
+    std::string_view line = text.substr(0, eol);
+
+    while (!line.empty() && count < 6) {
+        const size_t blank = line.find(' ');
+        fields[count++] = line.substr(0, blank);
+        line = blank == std::string_view::npos ? std::string_view{} : line.substr(blank + 1);
+    }
+
+    if (!line.empty() || count < 2 || fields[0] != "PROXY") {
+        return proxy_parse_status::invalid;
+    }
+
+    header.local = false;
+    header.has_addresses = false;
+    header.length = eol + 2;
+
+    if (fields[1] == "UNKNOWN") {
+        return proxy_parse_status::done;
+    }
+
+    const int family = fields[1] == "TCP4" ? AF_INET : fields[1] == "TCP6" ? AF_INET6 : AF_UNSPEC;
+
+    if (family == AF_UNSPEC || count != 6) {
+        return proxy_parse_status::invalid;
+    }
+
+    if (!make_address(family, fields[2], fields[4], header.source) ||
+        !make_address(family, fields[3], fields[5], header.destination)) {
+        return proxy_parse_status::invalid;
+    }
+
+    header.has_addresses = true;
+    return proxy_parse_status::done;
+}
+
+static proxy_parse_status parse_proxy_v2(const uint8_t *data, size_t length, proxy_header &header) {
+    if (length < 16) {
+        return proxy_parse_status::incomplete;
+    }
+
+    const uint8_t version = data[12] >> 4;
+    const uint8_t command = data[12] & 0x0f;
+    const uint8_t family = data[13] >> 4;
+    const uint8_t transport = data[13] & 0x0f;
+    const size_t payload = static_cast<size_t>(data[14]) << 8 | data[15];
+
+    if (version != 2 || command > 1 || 16 + payload > proxy_max_length) {
+        return proxy_parse_status::invalid;
+    }
+
+    if (length < 16 + payload) {
+        return proxy_parse_status::incomplete;
+    }
+
+    const uint8_t *p = data + 16;
+    header.local = command == 0;
+    header.has_addresses = false;
+    header.length = 16 + payload;
+
+    // LOCAL connections and unknown protocols keep the real peer
+    if (header.local || transport != 1) {
+        return proxy_parse_status::done;
+    }
+
+    if (family == 1) {
+        if (payload < 12) {
+            return proxy_parse_status::invalid;
+        }
+
+        sockaddr_in src = {};
+        sockaddr_in dst = {};
+        src.sin_family = dst.sin_family = AF_INET;
+        std::memcpy(&src.sin_addr, p, 4);
+        std::memcpy(&dst.sin_addr, p + 4, 4);
+        std::memcpy(&src.sin_port, p + 8, 2);
+        std::memcpy(&dst.sin_port, p + 10, 2);
+
+        header.source = socketaddr{src};
+        header.destination = socketaddr{dst};
+        header.has_addresses = true;
+    } else if (family == 2) {
+        if (payload < 36) {
+            return proxy_parse_status::invalid;
+        }
+
+        sockaddr_in6 src = {};
+        sockaddr_in6 dst = {};
+        src.sin6_family = dst.sin6_family = AF_INET6;
+        std::memcpy(&src.sin6_addr, p, 16);
+        std::memcpy(&dst.sin6_addr, p + 16, 16);
+        std::memcpy(&src.sin6_port, p + 32, 2);
+        std::memcpy(&dst.sin6_port, p + 34, 2);
+
+        header.source = socketaddr{src};
+        header.destination = socketaddr{dst};
+        header.has_addresses = true;
+    }
+
+    return proxy_parse_status::done;
+}
+
+proxy_parse_status parse_proxy_header(const uint8_t *data, size_t length, proxy_header &header) {
+    const size_t v2_prefix = std::min(length, sizeof(proxy_v2_signature));
+
+    if (length && data[0] == proxy_v2_signature[0]) {
+        if (std::memcmp(data, proxy_v2_signature, v2_prefix) != 0) {
+            return proxy_parse_status::invalid;
+        }
+
+        return v2_prefix < sizeof(proxy_v2_signature) ? proxy_parse_status::incomplete : parse_proxy_v2(data, length, header);
+    }
+
+    const size_t v1_prefix = std::min(length, sizeof(proxy_v1_signature) - 1);
+
+    if (std::memcmp(data, proxy_v1_signature, v1_prefix) != 0) {
+        return proxy_parse_status::invalid;
+    }
+
+    return v1_prefix < sizeof(proxy_v1_signature) - 1 ? proxy_parse_status::incomplete : parse_proxy_v1(data, length, header);
+}
+
+}
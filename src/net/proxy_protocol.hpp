@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "net/socketaddress.hpp"
+
+namespace rmrf::net {
+
+enum class proxy_parse_status : uint8_t {
+    incomplete,
+    done,
+    invalid
+};
+
+/**
+ * The connection information passed by a load balancer in front of us.
+ */
+struct proxy_header {
+    /** True if the balancer connected on its own behalf, e.g. for health checks */
+    bool local;
+    /** True if source and destination carry an address */
+    bool has_addresses;
+    socketaddr source;
+    socketaddr destination;
+    /** The number of bytes the header takes up on the wire */
+    size_t length;
+};
+
+/**
+ * The longest PROXY protocol v1 header.
+ */
+constexpr size_t proxy_v1_max_length = 107;
+
+/**
+ * The longest header accepted at all; v2 headers may announce up to 64 KiB
+ * of TLVs, but balancers only send a few hundred bytes in practice.
+ */
+constexpr size_t proxy_max_length = 536;
+
+/**
+ * Parse a PROXY protocol v1 or v2 header at the start of the given data.
+ *
+ * The data is only read, so the header can be parsed straight from a
+ * MSG_PEEK of the socket and consumed once complete.
+ *
+ * @param data The data received so far
+ * @param length The number of bytes received so far
+ * @param header The parsed header, valid when done is returned
+ * @return Whether the header is complete, needs more data or is broken
+ */
+proxy_parse_status parse_proxy_header(const uint8_t *data, size_t length, proxy_header &header);
+
+}
@@ -4,11 +4,15 @@
 #include <sys/socket.h>
 #include <sys/un.h>
 
+#include <arpa/inet.h>
 #include <netinet/in.h>
 #include <netinet/ip.h>
 #include <netinet/ip6.h>
 
+#include <cstddef>
+#include <cstring>
 #include <functional>
+#include <string>
 
 #include "macros.hpp"
 #include "net/netio_exception.hpp"
@@ -116,6 +120,63 @@ COMPILER_RESTORE("-Weffc++");
         }
     };
 
+    /**
+     * Use this constructor for addresses filled in by the kernel, e.g. by
+     * accept(). The given length is kept, as it is significant for UNIX
+     * domain sockets.
+     */
+    socketaddr(const sockaddr_storage *other, socklen_t length) : addr{}, len{} {
+        if (length > sizeof(addr)) {
+            throw netio_exception("Invalid length of sockaddr structure.");
+        }
+
+        memcpy(&addr, other, length);
+        len = length;
+    }
+
+    /**
+     * Use this method in order to get the address of a UNIX domain socket
+     * in the file system.
+     */
+    static socketaddr unix_path(const std::string& path) {
+        socketaddr sa{};
+        sockaddr_un *un = reinterpret_cast<sockaddr_un*>(&sa.addr);
+
+        if (path.empty() || path.size() >= sizeof(un->sun_path)) {
+            throw netio_exception("Invalid UNIX socket path '" + path + "'.");
+        }
+
+        un->sun_family = AF_UNIX;
+        memcpy(un->sun_path, path.data(), path.size());
+        sa.len = static_cast<socklen_t>(offsetof(sockaddr_un, sun_path) + path.size() + 1);
+        return sa;
+    }
+
+    /**
+     * Use this method in order to get the address of a UNIX domain socket in
+     * the abstract namespace (Linux only). Such sockets have no file and
+     * vanish with their last descriptor. The length of the address is part
+     * of the name, so it is kept exact.
+     */
+    static socketaddr unix_abstract(const std::string& name) {
+        socketaddr sa{};
+        sockaddr_un *un = reinterpret_cast<sockaddr_un*>(&sa.addr);
+
+        if (name.size() >= sizeof(un->sun_path)) {
+            throw netio_exception("Invalid abstract UNIX socket name '" + name + "'.");
+        }
+
+        un->sun_family = AF_UNIX;
+        memcpy(un->sun_path + 1, name.data(), name.size());
+        sa.len = static_cast<socklen_t>(offsetof(sockaddr_un, sun_path) + 1 + name.size());
+        return sa;
+    }
+
+    bool is_abstract() const {
+        return addr.ss_family == AF_UNIX && len > offsetof(sockaddr_un, sun_path) &&
+            reinterpret_cast<const sockaddr_un*>(&addr)->sun_path[0] == '\0';
+    }
+
     int family() const {
         return addr.ss_family;
     }
@@ -137,6 +198,48 @@ COMPILER_RESTORE("-Weffc++");
         return len;
     }
 
+    /**
+     * Use this method in order to get the port of an IP address.
+     *
+     * @return The port in host byte order or 0 for other families
+     */
+    uint16_t port() const {
+        switch (addr.ss_family) {
+        case AF_INET:
+            return ntohs(reinterpret_cast<const sockaddr_in*>(&addr)->sin_port);
+        case AF_INET6:
+            return ntohs(reinterpret_cast<const sockaddr_in6*>(&addr)->sin6_port);
+        default:
+            return 0;
+        }
+    }
+
+    /**
+     * Use this method in order to format the address for display.
+     * IP addresses are given numerically, UNIX sockets by path.
+     */
+    std::string str() const {
+        char buffer[INET6_ADDRSTRLEN] = {};
+
+        switch (addr.ss_family) {
+        case AF_INET:
+            inet_ntop(AF_INET, &reinterpret_cast<const sockaddr_in*>(&addr)->sin_addr, buffer, sizeof(buffer));
+            return buffer;
+        case AF_INET6:
+            inet_ntop(AF_INET6, &reinterpret_cast<const sockaddr_in6*>(&addr)->sin6_addr, buffer, sizeof(buffer));
+            return buffer;
+        case AF_UNIX:
+            if (this->is_abstract()) {
+                return "@" + std::string(reinterpret_cast<const sockaddr_un*>(&addr)->sun_path + 1,
+                    len - offsetof(sockaddr_un, sun_path) - 1);
+            }
+
+            return reinterpret_cast<const sockaddr_un*>(&addr)->sun_path;
+        default:
+            return std::string{};
+        }
+    }
+
 };
 
 }
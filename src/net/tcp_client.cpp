@@ -16,17 +16,22 @@
 #include <utility>
 #include <deque>
 
+#include <cerrno>
+
 #include "net/netio_exception.hpp"
 #include "net/socketaddress.hpp"
+#include "service/metrics.hpp"
+#include "service/trace.hpp"
 
 namespace rmrf::net {
 
-tcp_client::tcp_client(const destructor_cb_type destructor_cb_, auto_fd&& socket_fd, std::string peer_address_, uint16_t port_) :
+tcp_client::tcp_client(const destructor_cb_type destructor_cb_, auto_fd&& socket_fd, const socketaddr& peer_) :
 		connection_client{},
 		destructor_cb(destructor_cb_),
-		peer_address(peer_address_), port(port_),
+		peer(peer_), local{},
 		net_socket(std::forward<auto_fd>(socket_fd)),
-		io{}, write_queue{} {
+		io{}, write_queue{}, connecting{false}, close_when_written{false},
+		bytes_received{0}, bytes_sent{0} {
 	io.set<tcp_client, &tcp_client::cb_ev>(this);
 	io.start(this->net_socket.get(), ::ev::READ);
 	// TODO log created client
@@ -35,11 +40,15 @@ tcp_client::tcp_client(const destructor_cb_type destructor_cb_, auto_fd&& socket
 tcp_client::tcp_client(const std::string& peer_address_, const std::string& service_or_port, int ip_addr_family) :
 		connection_client{},
 		destructor_cb(nullptr),
-		peer_address(peer_address_),
-		port(0),
+		peer{},
+		local{},
 		net_socket(nullfd),
 		io{},
-		write_queue{} {
+		write_queue{},
+		connecting{false},
+		close_when_written{false},
+		bytes_received{0},
+		bytes_sent{0} {
 	if (!(ip_addr_family == AF_INET || ip_addr_family == AF_INET6)) {
 		throw netio_exception("Invalid IP address family.");
 	}
@@ -93,28 +102,14 @@ tcp_client::tcp_client(const std::string& peer_address_, const std::string& serv
 			if(connect(socket_candidate.get(), socket_identifier.ptr(), socket_identifier.size()) == 0) {
 				status = 0;
 				this->net_socket = std::forward<auto_fd>(socket_candidate);
+				this->peer = socket_identifier;
 				fcntl(this->net_socket.get(), F_SETFL, fcntl(this->net_socket.get(), F_GETFL, 0) | O_NONBLOCK);
 
-				// Hier bin ich mir nicht sicher, wie ich das am besten mache. Auch mit socketaddr und type cast ist das irgendwie doof.
-				// Das Problem besteht darin, dass erst nach erfolgreichem connect der Port auf dieser Seite bekannt ist.
-				socketaddr sa_local;
-				socklen_t sa_local_len = sizeof(sockaddr_storage);
-				if (getsockname(this->net_socket.get(), sa_local.ptr(), &sa_local_len))
-				{
-					// Update length field after the internal structure was modified
-					// TODO: Maybe make this an internal method in socketaddr to update the size
-					sa_local = sa_local.ptr();
-					//The pointer casts are safe due to operator overloading in socketaddr ...
-					switch(sa_local.family()) {
-						case AF_INET:
-							this->port = ntohs(((sockaddr_in*)sa_local)->sin_port);
-							break;
-						case AF_INET6:
-							this->port = ntohs(((sockaddr_in6*)sa_local)->sin6_port);
-							break;
-						default:
-							throw netio_exception("Invalid/unexpected local socket address type");
-					}
+				// The local port is only known after a successful connect
+				sockaddr_storage sa_local = {};
+				socklen_t sa_local_len = sizeof(sa_local);
+				if (getsockname(this->net_socket.get(), (sockaddr*)&sa_local, &sa_local_len) == 0) {
+					this->local = &sa_local;
 				}
 			}
 		}
@@ -127,6 +122,26 @@ tcp_client::tcp_client(const std::string& peer_address_, const std::string& serv
 	//TODO log connected client
 }
 
+tcp_client::tcp_client(const socketaddr& peer_, ::ev::loop_ref loop_) :
+		connection_client{},
+		destructor_cb(nullptr),
+		peer(peer_), local{},
+		net_socket(socket(peer_.family(), SOCK_STREAM | SOCK_NONBLOCK, 0)),
+		io{loop_}, write_queue{}, connecting{true}, close_when_written{false},
+		bytes_received{0}, bytes_sent{0} {
+	if (!this->net_socket.valid()) {
+		throw netio_exception("Failed to request socket fd from kernel.");
+	}
+
+	if (connect(this->net_socket.get(), this->peer.ptr(), this->peer.size()) != 0 && errno != EINPROGRESS) {
+		throw netio_exception("Failed to connect to " + this->peer.str() + ".");
+	}
+
+	// The socket becomes writable once the handshake is done
+	io.set<tcp_client, &tcp_client::cb_ev>(this);
+	io.start(this->net_socket.get(), ::ev::READ | ::ev::WRITE);
+}
+
 tcp_client::tcp_client(const std::string& peer_address_, const std::string& service_or_port) :
 		tcp_client(peer_address_, service_or_port, AF_UNSPEC) { }
 
@@ -135,10 +150,51 @@ tcp_client::tcp_client(const std::string& peer_address_, const uint16_t port_) :
 
 tcp_client::~tcp_client() {
 	if(destructor_cb != nullptr)
-		destructor_cb(exit_status_t::NO_ERROR);
+		destructor_cb(exit_status_t::NO_ERROR, this->peer);
 	io.stop();
 }
 
+bool tcp_client::is_closed() const {
+	return !this->net_socket.valid();
+}
+
+bool tcp_client::is_idle() const {
+	return !this->connecting && this->write_queue.empty();
+}
+
+auto_fd tcp_client::release() {
+	this->io.stop();
+	return std::move(this->net_socket);
+}
+
+void tcp_client::shutdown_after_write() {
+	this->close_when_written = true;
+	this->io.set(::ev::READ | ::ev::WRITE);
+}
+
+uint64_t tcp_client::get_bytes_received() const {
+	return this->bytes_received;
+}
+
+uint64_t tcp_client::get_bytes_sent() const {
+	return this->bytes_sent;
+}
+
+void tcp_client::close() {
+	if (!this->net_socket.valid()) {
+		return;
+	}
+
+	this->io.stop();
+	this->net_socket = auto_fd{};
+
+	// The owner may drop us from within the callback, so leave no trace
+	closed_cb_type cb = this->closed_cb;
+	if (cb) {
+		cb();
+	}
+}
+
 void tcp_client::write_data(const std::string& data) {
 	// Create NICBuffer from data
 	this->write_queue.push_back(iorecord{data.c_str(), data.size()});
@@ -150,36 +206,91 @@ inline std::string buffer_to_string(char* buffer, ssize_t bufflen)
     return std::string(buffer, (size_t)bufflen);
 }
 
+bool tcp_client::finish_connect() {
+	int error = 0;
+	socklen_t error_len = sizeof(error);
+
+	if (getsockopt(this->net_socket.get(), SOL_SOCKET, SO_ERROR, &error, &error_len) != 0 || error != 0) {
+		this->close();
+		return false;
+	}
+
+	this->connecting = false;
+
+	sockaddr_storage sa_local = {};
+	socklen_t sa_local_len = sizeof(sa_local);
+	if (getsockname(this->net_socket.get(), (sockaddr*)&sa_local, &sa_local_len) == 0) {
+		this->local = &sa_local;
+	}
+
+	return true;
+}
+
 void tcp_client::cb_ev(::ev::io &w, int events) {
+	// The callbacks below may drop the last reference to us
+	std::shared_ptr<connection_client> self = this->weak_from_this().lock();
+
 	if (events & ::ev::ERROR) {
 		// Handle errors
 		// Log and throw?
 		return;
 	}
 
+	if (this->connecting && !this->finish_connect()) {
+		return;
+	}
+
 	if (events & ::ev::READ) {
 		// notify incomming_data_cb
 		char buffer[1024];
 
 		ssize_t n_read_bytes = recv(w.fd, buffer, sizeof(buffer), 0);
 		if(n_read_bytes < 0) {
-			throw netio_exception("Failed to read from network socket.");
+			if (errno == EAGAIN || errno == EINTR) {
+				return;
+			}
+
+			// E.g. reset by the peer; that ends the connection just like EOF
+			this->close();
+			return;
 		}
 
 		if(n_read_bytes == 0) {
-			// TODO find a way to properly announce the closed connection
-			delete this;
-		} else {
+			this->close();
+			return;
+		}
+
+		RMRF_TRACE("net.read", n_read_bytes);
+
+		static auto &received_total = rmrf::metrics::get_counter(
+			"rmrf_net_received_bytes_total", "Bytes received by all clients");
+		this->bytes_received += static_cast<uint64_t>(n_read_bytes);
+		received_total.add(static_cast<uint64_t>(n_read_bytes));
+
+		if (this->in_data_cb) {
 			this->in_data_cb(buffer_to_string(buffer, n_read_bytes));
 		}
+
+		if (this->is_closed()) {
+			return;
+		}
 	}
 
 	if (events & ::ev::WRITE) {
 		// Handle sending data
 		push_write_queue(w);
+
+		if (this->is_closed()) {
+			return;
+		}
 	}
 
 	if (write_queue.empty()) {
+		if (this->close_when_written) {
+			this->close();
+			return;
+		}
+
 		io.set(::ev::READ);
 	} else {
 		io.set(::ev::READ | ::ev::WRITE);
@@ -196,20 +307,35 @@ void tcp_client::push_write_queue(::ev::io &w) {
 	ssize_t written = write(w.fd, buffer.ptr(), buffer.size());
 
 	if (written >= 0) {
+		static auto &sent_total = rmrf::metrics::get_counter(
+			"rmrf_net_sent_bytes_total", "Bytes sent by all clients");
+		RMRF_TRACE("net.write", written);
 		buffer.advance((size_t)written);
-	} else if (errno != EAGAIN) {
-		throw netio_exception("Failed to write latest buffer content.");
+		this->bytes_sent += static_cast<uint64_t>(written);
+		sent_total.add(static_cast<uint64_t>(written));
+	} else if (errno != EAGAIN && errno != EINTR) {
+		// The peer went away (EPIPE, ECONNRESET); what is left cannot be sent
+		this->close();
+		return;
 	}
 
 	this->write_queue.push_front(buffer);
 }
 
-inline std::string tcp_client::get_peer_address() {
-	return this->peer_address;
+std::string tcp_client::get_peer_address() const {
+	return this->peer.str();
+}
+
+uint16_t tcp_client::get_port() const {
+	return this->peer.port();
+}
+
+const socketaddr& tcp_client::get_peer() const {
+	return this->peer;
 }
 
-inline uint16_t tcp_client::get_port() {
-	return this->port;
+const socketaddr& tcp_client::get_local() const {
+	return this->local;
 }
 
 }
@@ -18,6 +18,7 @@
 #include "net/async_fd.hpp"
 #include "net/connection_client.hpp"
 #include "net/ioqueue.hpp"
+#include "net/socketaddress.hpp"
 
 namespace rmrf::net {
 
@@ -26,28 +27,77 @@ enum class exit_status_t : uint16_t {
 	TIMEOUT = 1
 };
 
-class tcp_client : public connection_client, std::enable_shared_from_this<tcp_client> {
+class tcp_client : public connection_client {
 public:
-	typedef std::function<void(exit_status_t)> destructor_cb_type;
+	typedef std::function<void(exit_status_t, const socketaddr&)> destructor_cb_type;
 private:
 	const destructor_cb_type destructor_cb;
-	const std::string peer_address;
 
-	uint16_t port;
+	socketaddr peer;
+	socketaddr local;
 	auto_fd net_socket;
 	::ev::io io;
 	ioqueue write_queue;
+	bool connecting;
+	bool close_when_written;
+	uint64_t bytes_received;
+	uint64_t bytes_sent;
 public:
-	tcp_client(const destructor_cb_type destructor_cb_, auto_fd&& socket_fd, std::string peer_address_, uint16_t port_);
+	tcp_client(const destructor_cb_type destructor_cb_, auto_fd&& socket_fd, const socketaddr& peer_);
 	tcp_client(const std::string& peer_address_, const uint16_t port_);
 	tcp_client(const std::string& peer_address_, const std::string& service_or_port);
 	tcp_client(const std::string& peer_address_, const std::string& service_or_port, int ip_addr_family);
+
+	/**
+	 * Use this constructor in order to connect to the given address without
+	 * blocking the event loop. Data written before the connection is
+	 * established gets queued. If the connection fails the client is closed.
+	 *
+	 * @param loop_ The loop to run on, e.g. one owned by a worker thread
+	 */
+	explicit tcp_client(const socketaddr& peer_, ::ev::loop_ref loop_ = ::ev::get_default_loop());
 	virtual ~tcp_client();
+
+	tcp_client(const tcp_client&) = delete;
+	tcp_client& operator=(const tcp_client&) = delete;
+
 	virtual void write_data(const std::string& data);
-	std::string get_peer_address();
-	uint16_t get_port();
+	virtual void close();
+
+	bool is_closed() const;
+
+	/**
+	 * A client is idle when all data written to it went out.
+	 */
+	bool is_idle() const;
+
+	/**
+	 * Use this method in order to take the connection away from the event
+	 * loop, e.g. to pass it on to another process. Data still queued for
+	 * writing is lost, so only release idle clients. The closed callback is
+	 * not called.
+	 */
+	auto_fd release();
+
+	/**
+	 * Use this method in order to close the connection as soon as all data
+	 * written so far went out.
+	 */
+	void shutdown_after_write();
+
+	uint64_t get_bytes_received() const;
+	uint64_t get_bytes_sent() const;
+
+	/**
+	 * The peer address is only formatted when this method is called.
+	 */
+	std::string get_peer_address() const;
+	uint16_t get_port() const;
+	const socketaddr& get_peer() const;
+	const socketaddr& get_local() const;
 private:
 	void cb_ev(::ev::io &w, int events);
+	bool finish_connect();
 	void push_write_queue(::ev::io &w);
 };
 
@@ -6,6 +6,7 @@
  */
 #include "net/tcp_server_socket.hpp"
 
+#include <errno.h>
 #include <fcntl.h>
 #include <stdlib.h>
 #include <string.h>
@@ -20,51 +21,161 @@
 
 #include <functional>
 
+#include "lib/ev/loop_monitor.hpp"
 #include "macros.hpp"
+#include "net/proxy_protocol.hpp"
 #include "net/socketaddress.hpp"
 #include "net/tcp_client.hpp"
+#include "service/log.hpp"
+#include "service/metrics.hpp"
+#include "service/trace.hpp"
 
 
 namespace rmrf::net {
 
-tcp_server_socket::tcp_server_socket(const socketaddr& socket_identifier, incoming_client_listener_type client_listener_) :
-	ss{nullptr}, client_listener(client_listener_), number_of_connected_clients(0) {
-	auto_fd socket_fd{socket(socket_identifier.family(), SOCK_STREAM, 0)};
+// How long to stop accepting while the process is out of descriptors
+static constexpr ::ev::tstamp accept_backoff = 0.1;
+
+// How often to look at a PROXY header that arrived only in part
+static constexpr ::ev::tstamp proxy_retry_interval = 0.01;
+
+static rmrf::metrics::counter &connections_total(const char *verdict) {
+	return rmrf::metrics::get_counter("rmrf_net_connections_total",
+		"Connections accepted by all listeners, by admission verdict",
+		std::string{"verdict=\""} + verdict + "\"");
+}
+
+static rmrf::metrics::gauge &clients_gauge() {
+	static auto &clients = rmrf::metrics::get_gauge("rmrf_net_clients",
+		"Clients currently connected to any listener");
+	return clients;
+}
+
+/**
+ * A connection that was accepted from a balancer but has not yet sent its
+ * PROXY protocol header.
+ */
+struct tcp_server_socket::proxy_pending {
+	tcp_server_socket *owner;
+	auto_fd fd;
+	socketaddr peer;
+	::ev::io io;
+	::ev::timer timer;
+	::ev::timer retry;
+
+	proxy_pending(tcp_server_socket *owner_, auto_fd&& fd_, const socketaddr& peer_) :
+		owner{owner_}, fd{std::forward<auto_fd>(fd_)}, peer{peer_}, io{}, timer{}, retry{} {
+		// NOP
+	}
+
+	proxy_pending(const proxy_pending&) = delete;
+	proxy_pending& operator=(const proxy_pending&) = delete;
+
+	void cb_io(::ev::io &w, int events) {
+		(void)w;
+		(void)events;
+		this->owner->cb_proxy_readable(*this);
+	}
+
+	void cb_timer(::ev::timer &w, int events) {
+		(void)w;
+		(void)events;
+		this->owner->cb_proxy_timeout(*this);
+	}
+
+	void cb_retry(::ev::timer &w, int events) {
+		(void)w;
+		(void)events;
+		this->owner->cb_proxy_readable(*this);
+	}
+};
+
+auto_fd bind_listener(const socketaddr& socket_identifier, mode_t unix_permissions) {
+	auto_fd socket_fd{socket(socket_identifier.family(), SOCK_STREAM | SOCK_CLOEXEC, 0)};
 	if(!socket_fd.valid()) {
 		// TODO implement propper error handling
 		throw netio_exception("Failed to create socket fd.");
 	}
 
+	const int on = 1;
+	const int off = 0;
+	const bool unix_file = socket_identifier.family() == AF_UNIX && !socket_identifier.is_abstract();
+	const std::string unix_path = unix_file ? socket_identifier.str() : std::string{};
+
+	if (socket_identifier.family() == AF_INET6 || socket_identifier.family() == AF_INET) {
+		// Restarts must not fail on connections of the last run in TIME_WAIT
+		setsockopt(socket_fd.get(), SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+	}
+
+	if (socket_identifier.family() == AF_INET6) {
+		// Accept IPv4 as mapped addresses too, independent of the system default
+		setsockopt(socket_fd.get(), IPPROTO_IPV6, IPV6_V6ONLY, &off, sizeof(off));
+	}
+
+	if (unix_file) {
+		// A socket file nobody listens on any more is left over from a crash
+		struct stat st = {};
+		if (lstat(unix_path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode)) {
+			auto_fd probe{socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)};
+			if (probe.valid() && connect(probe.get(), socket_identifier.ptr(), socket_identifier.size()) != 0 && errno == ECONNREFUSED) {
+				unlink(unix_path.c_str());
+			}
+		}
+	}
+
 	if (bind(socket_fd.get(), socket_identifier.ptr(), socket_identifier.size()) != 0) {
-		std::string msg = "Failed to bind to all addresses (FIXME)";
+		std::string msg = "Failed to bind to " + socket_identifier.str() + ": " + strerror(errno);
 
 		if (socket_identifier.family() == AF_INET6 || socket_identifier.family() == AF_INET) {
-			// TODO find a nice way to check for the port
-			/*
-			 if (port < 1024) {
-			 	 msg += "\nYou tried to bind to a port smaller than 1024. Are you root?";
-			 }
-			 */
+			if (errno == EACCES && socket_identifier.port() < 1024) {
+				msg += "\nYou tried to bind to a port smaller than 1024. Are you root?";
+			}
 		}
 		throw netio_exception(msg);
 	}
 
-	// Append the non blocking flag to the file state of the socket fd.
-	// This might be linux only. We should check that
-	fcntl(socket_fd.get(), F_SETFL, fcntl(socket_fd.get(), F_GETFL, 0) | O_NONBLOCK);
-	if (listen(socket_fd.get(), 5) == -1) {
+	// Nobody can connect before listen(), so the permissions are in place in time
+	if (unix_file && unix_permissions && chmod(unix_path.c_str(), unix_permissions) != 0) {
+		unlink(unix_path.c_str());
+		throw netio_exception("Failed to set permissions of " + unix_path + ": " + strerror(errno));
+	}
+
+	if (listen(socket_fd.get(), SOMAXCONN) == -1) {
 		throw netio_exception("Failed to enable listening mode for raw socket");
 	}
 
-	this->ss = std::make_shared<async_server_socket>(std::forward<auto_fd>(socket_fd));
+	return socket_fd;
+}
+
+tcp_server_socket::tcp_server_socket(auto_fd&& listening_fd, incoming_client_listener_type client_listener_) :
+	ss{nullptr}, client_pool{std::make_shared<block_pool>()}, client_listener(client_listener_),
+	number_of_connected_clients{std::make_shared<std::atomic_uint32_t>(0)},
+	filter{}, tarpitted{}, tarpit_timer{}, tarpit_delay{0},
+	proxy_enabled{false}, proxy_timeout{0}, proxy_trusted{}, proxy_waiting{},
+	unix_path{} {
+	// Append the non blocking flag to the file state of the socket fd.
+	// This might be linux only. We should check that
+	fcntl(listening_fd.get(), F_SETFL, fcntl(listening_fd.get(), F_GETFL, 0) | O_NONBLOCK);
+
+	this->ss = std::make_shared<async_server_socket>(std::forward<auto_fd>(listening_fd));
 
 	using namespace std::placeholders;
 	this->ss->set_accept_handler(std::bind(&tcp_server_socket::await_raw_socket_incomming, this, _1, _2));
+}
 
+tcp_server_socket::tcp_server_socket(const socketaddr& socket_identifier, incoming_client_listener_type client_listener_,
+		mode_t unix_permissions) :
+		tcp_server_socket{bind_listener(socket_identifier, unix_permissions), client_listener_} {
+	if (socket_identifier.family() == AF_UNIX && !socket_identifier.is_abstract()) {
+		this->unix_path = socket_identifier.str();
+	}
 }
 
+tcp_server_socket::tcp_server_socket(const socketaddr& socket_identifier, incoming_client_listener_type client_listener_) :
+		tcp_server_socket{socket_identifier, client_listener_, 0} { }
+
 static inline socketaddr get_ipv6_socketaddr(const uint16_t port) {
-	sockaddr_in6 addr;
+	sockaddr_in6 addr = {};
 	addr.sin6_family = AF_INET6;
 	addr.sin6_port = htons(port);
 	addr.sin6_addr = IN6ADDR_ANY_INIT;
@@ -75,37 +186,264 @@ static inline socketaddr get_ipv6_socketaddr(const uint16_t port) {
 tcp_server_socket::tcp_server_socket(const uint16_t port, incoming_client_listener_type client_listener_) :
 		tcp_server_socket{get_ipv6_socketaddr(port), client_listener_} { }
 
+tcp_server_socket::~tcp_server_socket() {
+	this->tarpit_timer.stop();
+
+	if (!this->unix_path.empty()) {
+		unlink(this->unix_path.c_str());
+	}
+
+	for (auto& [fd, pending] : this->proxy_waiting) {
+		MARK_UNUSED(fd);
+		pending->io.stop();
+		pending->timer.stop();
+		pending->retry.stop();
+	}
+}
+
+void tcp_server_socket::set_admission_filter(const admission_filter::ptr_type& filter_, ::ev::tstamp tarpit_delay_) {
+	this->filter = filter_;
+	this->tarpit_delay = tarpit_delay_;
+}
+
+void tcp_server_socket::set_proxy_protocol(bool enabled_, ::ev::tstamp timeout_,
+		const std::shared_ptr<const prefix_table<bool>>& trusted_) {
+	this->proxy_enabled = enabled_;
+	this->proxy_timeout = timeout_;
+	this->proxy_trusted = trusted_;
+}
+
+static void reset_connection(auto_fd&& client_fd) {
+	// Send a RST instead of a FIN so no TIME_WAIT state is kept on our side
+	struct linger lin = {1, 0};
+	setsockopt(client_fd.get(), SOL_SOCKET, SO_LINGER, &lin, sizeof(lin));
+	auto_fd discard{std::forward<auto_fd>(client_fd)};
+}
+
 
 void tcp_server_socket::await_raw_socket_incomming(async_server_socket::self_ptr_type ass, const auto_fd& socket) {
-	MARK_UNUSED(ass);
+	static auto &histogram = rmrf::ev::callback_histogram("net.accept");
+	rmrf::ev::callback_probe probe{histogram};
+	RMRF_TRACE_SCOPE("net.accept", socket.get());
 
-	struct sockaddr_in client_addr;
+	sockaddr_storage client_addr = {};
 	socklen_t client_len = sizeof(client_addr);
-	int client_fd_raw = accept(socket.get(), (struct sockaddr *)&client_addr, &client_len);
+	int client_fd_raw = accept4(socket.get(), (struct sockaddr *)&client_addr, &client_len, SOCK_NONBLOCK | SOCK_CLOEXEC);
 
 	if(client_fd_raw < 0) {
-		throw netio_exception("Unable to bind incoming client");
+		switch (errno) {
+		case EAGAIN:
+		case ECONNABORTED:
+		case EINTR:
+			// Another process took the connection or the client gave up already
+			return;
+		case EMFILE:
+		case ENFILE:
+		case ENOBUFS:
+		case ENOMEM:
+			// Connections wait in the backlog until descriptors are freed
+			rmrf::log::error("Out of resources to accept clients, pausing", {{"error", strerror(errno)}});
+			ass->pause(accept_backoff);
+			return;
+		default:
+			rmrf::log::error("Failed to accept client", {{"error", strerror(errno)}});
+			return;
+		}
 	}
 
-	fcntl(client_fd_raw, F_SETFL, fcntl(client_fd_raw, F_GETFL, 0) | O_NONBLOCK);
+	auto_fd client_fd{client_fd_raw};
 
-	const std::string address = inet_ntoa(client_addr.sin_addr);
-	const uint16_t port = ntohs(client_addr.sin_port);
+	// The address is kept raw; it only gets formatted when somebody asks
+	const socketaddr peer{&client_addr, client_len};
 
-	// Generate client object from fd and announce it
-	this->number_of_connected_clients++;
-	using namespace std::placeholders;
-	this->client_listener(tcp_client(std::bind(&tcp_server_socket::client_destructed_cb, this, _1), auto_fd(client_fd_raw), address, port));
+	if (this->proxy_enabled && (!this->proxy_trusted || this->proxy_trusted->lookup(peer.ptr()))) {
+		this->await_proxy_header(std::move(client_fd), peer);
+		return;
+	}
+
+	this->admit_client(std::move(client_fd), peer);
 }
 
-int tcp_server_socket::get_number_of_connected_clients() const {
-	return this->number_of_connected_clients;
+void tcp_server_socket::admit_client(auto_fd&& client_fd, const socketaddr& peer) {
+	static auto &accepted_total = connections_total("accepted");
+	static auto &tarpitted_total = connections_total("tarpitted");
+	static auto &rejected_total = connections_total("rejected");
+
+	// Decide on the connection before any client state gets allocated
+	if (this->filter) {
+		switch (this->filter->admit(peer.ptr())) {
+		case admission_verdict::accept:
+			break;
+		case admission_verdict::tarpit:
+			tarpitted_total.add();
+			this->tarpit(std::forward<auto_fd>(client_fd));
+			return;
+		case admission_verdict::reject:
+			rejected_total.add();
+			reset_connection(std::forward<auto_fd>(client_fd));
+			return;
+		default:
+			rejected_total.add();
+			reset_connection(std::forward<auto_fd>(client_fd));
+			return;
+		}
+	}
+
+	accepted_total.add();
+	this->client_listener(this->make_client(std::forward<auto_fd>(client_fd), peer, true));
+}
+
+std::shared_ptr<tcp_client> tcp_server_socket::make_client(auto_fd&& client_fd, const socketaddr& peer, bool admitted) {
+	// Construct the client in place in a recycled block
+	(*this->number_of_connected_clients)++;
+	clients_gauge().add();
+
+	// The client may outlive us, so it keeps what it reports back to alive.
+	// Adopted connections were never counted by the filter.
+	tcp_client::destructor_cb_type destructed = [
+		connected = this->number_of_connected_clients,
+		filter = admitted ? this->filter : admission_filter::ptr_type{}
+	](exit_status_t exit_status, const socketaddr& client_peer) {
+		MARK_UNUSED(exit_status);
+
+		if (filter) {
+			filter->release(client_peer.ptr());
+		}
+
+		(*connected)--;
+		clients_gauge().sub();
+	};
+
+	return std::allocate_shared<tcp_client>(
+		pool_allocator<tcp_client>{this->client_pool},
+		destructed,
+		std::forward<auto_fd>(client_fd),
+		peer);
+}
+
+std::shared_ptr<tcp_client> tcp_server_socket::adopt_client(auto_fd&& client_fd) {
+	sockaddr_storage client_addr = {};
+	socklen_t client_len = sizeof(client_addr);
+
+	if (getpeername(client_fd.get(), (struct sockaddr *)&client_addr, &client_len) != 0) {
+		throw netio_exception("Unable to adopt client: " + std::string(strerror(errno)));
+	}
+
+	fcntl(client_fd.get(), F_SETFL, fcntl(client_fd.get(), F_GETFL, 0) | O_NONBLOCK);
+	return this->make_client(std::forward<auto_fd>(client_fd), socketaddr{&client_addr, client_len}, false);
+}
+
+auto_fd tcp_server_socket::release_listener() {
+	// The new owner keeps using the socket file
+	this->unix_path.clear();
+	return this->ss->release();
+}
+
+void tcp_server_socket::await_proxy_header(auto_fd&& client_fd, const socketaddr& peer) {
+	// Bound the number of descriptors silent balancer connections can pin
+	static constexpr size_t max_waiting = 1024;
+
+	if (this->proxy_waiting.size() >= max_waiting) {
+		reset_connection(std::forward<auto_fd>(client_fd));
+		return;
+	}
+
+	const int fd = client_fd.get();
+	auto pending = std::make_unique<proxy_pending>(this, std::forward<auto_fd>(client_fd), peer);
+	pending->io.set<proxy_pending, &proxy_pending::cb_io>(pending.get());
+	pending->io.start(fd, ::ev::READ);
+	pending->timer.set<proxy_pending, &proxy_pending::cb_timer>(pending.get());
+	pending->timer.start(this->proxy_timeout, 0);
+	pending->retry.set<proxy_pending, &proxy_pending::cb_retry>(pending.get());
+	this->proxy_waiting.emplace(fd, std::move(pending));
+}
+
+void tcp_server_socket::cb_proxy_readable(proxy_pending& pending) {
+	uint8_t buffer[proxy_max_length];
+	const int fd = pending.fd.get();
+
+	// Peek so nothing past the header is taken away from the client
+	const ssize_t received = recv(fd, buffer, sizeof(buffer), MSG_PEEK);
+
+	if (received < 0 && errno == EAGAIN) {
+		return;
+	}
+
+	proxy_header header{};
+	proxy_parse_status status = proxy_parse_status::invalid;
+
+	if (received > 0) {
+		status = parse_proxy_header(buffer, static_cast<size_t>(received), header);
+	}
+
+	if (status == proxy_parse_status::incomplete) {
+		// What we peeked stays in the socket and keeps it readable, so
+		// the watcher would fire right away again; look again shortly
+		pending.io.stop();
+		pending.retry.start(proxy_retry_interval, 0);
+		return;
+	}
+
+	pending.io.stop();
+	pending.timer.stop();
+	pending.retry.stop();
+
+	auto node = this->proxy_waiting.extract(fd);
+	auto_fd client_fd{std::move(node.mapped()->fd)};
+
+	if (status != proxy_parse_status::done ||
+			recv(fd, buffer, header.length, 0) != static_cast<ssize_t>(header.length)) {
+		reset_connection(std::move(client_fd));
+		return;
+	}
+
+	// Health checks and unknown protocols keep the balancer as the peer
+	this->admit_client(std::move(client_fd), header.has_addresses ? header.source : node.mapped()->peer);
+}
+
+void tcp_server_socket::cb_proxy_timeout(proxy_pending& pending) {
+	pending.io.stop();
+	pending.retry.stop();
+
+	auto node = this->proxy_waiting.extract(pending.fd.get());
+	reset_connection(std::move(node.mapped()->fd));
 }
 
-void tcp_server_socket::client_destructed_cb(exit_status_t exit_status) {
-	MARK_UNUSED(exit_status);
+void tcp_server_socket::tarpit(auto_fd&& client_fd) {
+	// Bound the number of descriptors a flood can pin
+	static constexpr size_t max_tarpitted = 1024;
 
-	this->number_of_connected_clients--;
+	if (this->tarpit_delay <= 0 || this->tarpitted.size() >= max_tarpitted) {
+		reset_connection(std::forward<auto_fd>(client_fd));
+		return;
+	}
+
+	const ::ev::tstamp now = ::ev::now(::ev::get_default_loop());
+	this->tarpitted.emplace_back(now + this->tarpit_delay, std::forward<auto_fd>(client_fd));
+
+	if (!this->tarpit_timer.is_active()) {
+		this->tarpit_timer.set<tcp_server_socket, &tcp_server_socket::cb_tarpit>(this);
+		this->tarpit_timer.start(this->tarpit_delay, 1.0);
+	}
+}
+
+void tcp_server_socket::cb_tarpit(::ev::timer &w, int events) {
+	MARK_UNUSED(events);
+
+	const ::ev::tstamp now = ::ev::now(::ev::get_default_loop());
+
+	while (!this->tarpitted.empty() && this->tarpitted.front().first <= now) {
+		reset_connection(std::move(this->tarpitted.front().second));
+		this->tarpitted.pop_front();
+	}
+
+	if (this->tarpitted.empty()) {
+		w.stop();
+	}
+}
+
+int tcp_server_socket::get_number_of_connected_clients() const {
+	return static_cast<int>(this->number_of_connected_clients->load());
 }
 
 }
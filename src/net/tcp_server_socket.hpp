@@ -8,30 +8,128 @@
 #pragma once
 
 #include <atomic>
+#include <deque>
+#include <map>
 #include <memory>
+#include <string>
+#include <utility>
 
+#include <sys/types.h>
+
+#include <ev++.h>
+
+#include "net/admission_filter.hpp"
 #include "net/async_server.hpp"
+#include "net/client_pool.hpp"
 #include "net/netio_exception.hpp"
+#include "net/prefix_table.hpp"
 #include "net/socketaddress.hpp"
 #include "net/tcp_client.hpp"
 
 namespace rmrf::net {
 
+/**
+ * Create a socket listening on the given address. Stale UNIX domain socket
+ * files are replaced.
+ *
+ * @param unix_permissions The mode of the socket file; 0 keeps the umask
+ */
+auto_fd bind_listener(const socketaddr& socket_identifier, mode_t unix_permissions = 0);
 
 class tcp_server_socket : public std::enable_shared_from_this<tcp_server_socket>{
 public:
-	typedef std::function<void(tcp_client)> incoming_client_listener_type;
+	typedef std::function<void(std::shared_ptr<tcp_client>)> incoming_client_listener_type;
 private:
 	async_server_socket::self_ptr_type ss;
+	block_pool::ptr_type client_pool;
 	incoming_client_listener_type client_listener;
-	std::atomic_uint32_t number_of_connected_clients;
+	// Shared with the clients, as they may outlive the listener
+	std::shared_ptr<std::atomic_uint32_t> number_of_connected_clients;
+
+	admission_filter::ptr_type filter;
+	std::deque<std::pair<::ev::tstamp, auto_fd>> tarpitted;
+	::ev::timer tarpit_timer;
+	::ev::tstamp tarpit_delay;
+
+	struct proxy_pending;
+	bool proxy_enabled;
+	::ev::tstamp proxy_timeout;
+	std::shared_ptr<const prefix_table<bool>> proxy_trusted;
+	std::map<int, std::unique_ptr<proxy_pending>> proxy_waiting;
+
+	std::string unix_path;
 public:
+	/**
+	 * Listen on the given port on all IPv6 and IPv4 addresses.
+	 */
 	tcp_server_socket(const uint16_t port, incoming_client_listener_type client_listener_);
 	tcp_server_socket(const socketaddr& socket_identifier, incoming_client_listener_type client_listener_);
+
+	/**
+	 * Use this constructor in order to listen on a UNIX domain socket. A
+	 * stale socket file is replaced and removed again on destruction.
+	 * Abstract addresses (see socketaddr::unix_abstract) have no file.
+	 *
+	 * @param unix_permissions The mode of the socket file; 0 keeps the umask
+	 */
+	tcp_server_socket(const socketaddr& socket_identifier, incoming_client_listener_type client_listener_, mode_t unix_permissions);
+
+	/**
+	 * Use this constructor in order to take over a socket that is already
+	 * bound and listening, e.g. one passed in by the service manager.
+	 */
+	tcp_server_socket(auto_fd&& listening_fd, incoming_client_listener_type client_listener_);
+	~tcp_server_socket();
 	int get_number_of_connected_clients() const;
+
+	/**
+	 * Use this method in order to check new connections before any client
+	 * state is set up for them. Rejected connections get reset right away,
+	 * tarpitted ones are held open without being read for the given delay.
+	 *
+	 * @param filter_ The filter to apply; it may be shared between sockets
+	 * @param tarpit_delay_ The time in seconds to hold tarpitted connections
+	 */
+	void set_admission_filter(const admission_filter::ptr_type& filter_, ::ev::tstamp tarpit_delay_ = 15.0);
+
+	/**
+	 * Use this method in order to expect a PROXY protocol (v1 or v2) header
+	 * in front of every connection accepted from a load balancer. The peer
+	 * address handed to the admission filter and the client is then the one
+	 * announced by the balancer. Connections that do not send a valid header
+	 * within the timeout are reset.
+	 *
+	 * @param enabled_ Whether to parse the header at all
+	 * @param timeout_ The time in seconds a balancer gets to send the header
+	 * @param trusted_ The balancer networks; when set, other peers are
+	 *                 treated as direct clients that send no header
+	 */
+	void set_proxy_protocol(bool enabled_, ::ev::tstamp timeout_ = 3.0,
+			const std::shared_ptr<const prefix_table<bool>>& trusted_ = nullptr);
+
+	/**
+	 * Use this method in order to stop accepting and take the listening
+	 * socket, e.g. to pass it on to another process. The socket file of a
+	 * UNIX domain socket is left in place for the new owner.
+	 */
+	auto_fd release_listener();
+
+	/**
+	 * Use this method in order to take over a connection established
+	 * elsewhere, e.g. handed over by a previous instance. The client is
+	 * returned instead of being announced to the listener, as it is usually
+	 * in the middle of a conversation. Admission checks are skipped.
+	 */
+	std::shared_ptr<tcp_client> adopt_client(auto_fd&& client_fd);
 private:
 	void await_raw_socket_incomming(async_server_socket::self_ptr_type ass, const auto_fd& socket);
-	void client_destructed_cb(exit_status_t exit_status);
+	void admit_client(auto_fd&& client_fd, const socketaddr& peer);
+	std::shared_ptr<tcp_client> make_client(auto_fd&& client_fd, const socketaddr& peer, bool admitted);
+	void await_proxy_header(auto_fd&& client_fd, const socketaddr& peer);
+	void cb_proxy_readable(proxy_pending& pending);
+	void cb_proxy_timeout(proxy_pending& pending);
+	void tarpit(auto_fd&& client_fd);
+	void cb_tarpit(::ev::timer &w, int events);
 };
 
 }
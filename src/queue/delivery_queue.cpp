@@ -0,0 +1,662 @@
+#include "queue/delivery_queue.hpp"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <functional>
+
+#include "macros.hpp"
+#include "lib/ev/loop_monitor.hpp"
+#include "queue/queue_exception.hpp"
+#include "queue/sync_directory.hpp"
+#include "service/metrics.hpp"
+
+namespace rmrf::queue {
+
+namespace {
+
+constexpr size_t journal_header_size = 1 + 4;
+
+constexpr char journal_add_record = 'A';
+constexpr char journal_defer_record = 'D';
+constexpr char journal_remove_record = 'R';
+
+bool write_all(int fd, const void *buf, size_t length) {
+    const uint8_t *p = static_cast<const uint8_t *>(buf);
+
+    while (length) {
+        ssize_t written = ::write(fd, p, length);
+
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            return false;
+        }
+
+        p += written;
+        length -= static_cast<size_t>(written);
+    }
+
+    return true;
+}
+
+template<typename T>
+void put_raw(std::string &out, const T &value) {
+    out.append(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+template<typename T>
+bool get_raw(std::string_view &in, T &value) {
+    if (in.size() < sizeof(T)) {
+        return false;
+    }
+
+    memcpy(&value, in.data(), sizeof(T));
+    in.remove_prefix(sizeof(T));
+    return true;
+}
+
+void put_string(std::string &out, std::string_view value) {
+    put_raw(out, static_cast<uint32_t>(value.size()));
+    out.append(value);
+}
+
+bool get_string(std::string_view &in, std::string_view &value) {
+    uint32_t length;
+
+    if (!get_raw(in, length) || in.size() < length) {
+        return false;
+    }
+
+    value = in.substr(0, length);
+    in.remove_prefix(length);
+    return true;
+}
+
+void put_recipients(std::string &out, const std::vector<std::string> &recipients) {
+    put_raw(out, static_cast<uint32_t>(recipients.size()));
+
+    for (const std::string &rcpt : recipients) {
+        put_string(out, rcpt);
+    }
+}
+
+bool get_recipients(std::string_view &in, std::vector<std::string> &recipients) {
+    uint32_t count;
+
+    if (!get_raw(in, count)) {
+        return false;
+    }
+
+    recipients.clear();
+    recipients.reserve(std::min<size_t>(count, in.size() / sizeof(uint32_t)));
+
+    for (uint32_t i = 0; i < count; i++) {
+        std::string_view rcpt;
+
+        if (!get_string(in, rcpt)) {
+            return false;
+        }
+
+        recipients.emplace_back(rcpt);
+    }
+
+    return true;
+}
+
+void put_entry(std::string &out, const queue_entry &entry, std::string_view domain) {
+    put_raw(out, entry.id);
+    put_raw(out, entry.created);
+    put_raw(out, entry.next_attempt);
+    put_raw(out, entry.attempts);
+    put_string(out, domain);
+    put_string(out, entry.message);
+    put_string(out, entry.sender);
+    put_recipients(out, entry.recipients);
+}
+
+void put_record(std::string &out, char type, const std::string &payload) {
+    out.push_back(type);
+    put_raw(out, static_cast<uint32_t>(payload.size()));
+    out.append(payload);
+}
+
+// The timing heap is a min heap on the due time
+bool later(const std::pair<int64_t, uint64_t> &a, const std::pair<int64_t, uint64_t> &b) {
+    return a > b;
+}
+
+::ev::tstamp now() {
+    return ::ev::now(::ev::get_default_loop());
+}
+
+}
+
+delivery_queue::delivery_queue(const std::string &directory_, const queue_limits &limits_) :
+    directory{directory_},
+    limits{limits_},
+    journal{}, journal_records{0}, journal_synced{true},
+    entries{}, domains{}, domain_index{}, timing_heap{}, ring{}, throttled{}, staged{},
+    next_id{1}, active{0}, running{false}, pumping{false},
+    jitter{static_cast<std::minstd_rand::result_type>(getpid())},
+    dispatch_cb{}, expire_cb{}, wakeup{},
+    entries_gauge{"rmrf_queue_entries", "Entries waiting in or being delivered from the queue",
+        [this]() { return static_cast<double>(this->entries.size()); }, "queue=\"" + directory_ + "\""},
+    active_gauge{"rmrf_queue_active", "Deliveries currently in progress",
+        [this]() { return static_cast<double>(this->active); }, "queue=\"" + directory_ + "\""}
+{
+    if (mkdir(this->directory.c_str(), 0700) != 0 && errno != EEXIST) {
+        throw queue_exception("Failed to create queue directory '" + this->directory + "': " + strerror(errno));
+    }
+
+    this->wakeup.set<delivery_queue, &delivery_queue::cb_wakeup>(this);
+
+    this->replay_journal();
+    this->rewrite_journal();
+}
+
+delivery_queue::~delivery_queue() {
+    this->wakeup.stop();
+}
+
+void delivery_queue::set_dispatch_callback(const entry_cb_t &cb) {
+    this->dispatch_cb = cb;
+}
+
+void delivery_queue::set_expire_callback(const entry_cb_t &cb) {
+    this->expire_cb = cb;
+}
+
+void delivery_queue::start() {
+    this->running = true;
+    this->pump();
+}
+
+uint64_t delivery_queue::enqueue(std::string_view domain, std::string_view message, std::string_view sender,
+    const std::vector<std::string> &recipients)
+{
+    const int64_t t = static_cast<int64_t>(now());
+    const uint64_t id = this->next_id++;
+    const uint32_t d = this->intern_domain(domain);
+
+    queue_entry &entry = this->entries.emplace(id, queue_entry{
+        id, d, entry_state::waiting, 0, t, t, std::string{message}, std::string{sender}, recipients
+    }).first->second;
+
+    std::string payload;
+    put_entry(payload, entry, this->domains[d].name);
+    this->append_journal(journal_add_record, payload);
+    this->staged.push_back(id);
+
+    return id;
+}
+
+void delivery_queue::commit() {
+    this->sync();
+
+    for (uint64_t id : this->staged) {
+        this->make_ready(this->entries.at(id));
+    }
+
+    this->staged.clear();
+    this->pump();
+}
+
+void delivery_queue::rollback() {
+    std::vector<uint64_t> dropped;
+    dropped.swap(this->staged);
+
+    for (uint64_t id : dropped) {
+        this->entries.erase(id);
+    }
+
+    try {
+        std::string payload;
+
+        for (uint64_t id : dropped) {
+            payload.clear();
+            put_raw(payload, id);
+            this->append_journal(journal_remove_record, payload);
+        }
+
+        this->sync();
+    } catch (const queue_exception &) {
+        // The entries must not come back on replay, so leave them out of a fresh journal
+        this->rewrite_journal();
+    }
+}
+
+void delivery_queue::delivered(uint64_t id) {
+    auto it = this->entries.find(id);
+
+    if (it == this->entries.end() || it->second.state != entry_state::active) {
+        return;
+    }
+
+    this->remove(id);
+    this->pump();
+}
+
+void delivery_queue::deferred(uint64_t id, const std::vector<std::string> &remaining) {
+    auto it = this->entries.find(id);
+
+    if (it == this->entries.end() || it->second.state != entry_state::active) {
+        return;
+    }
+
+    queue_entry &entry = it->second;
+    const int64_t t = static_cast<int64_t>(now());
+
+    if (remaining.empty()) {
+        this->remove(id);
+        this->pump();
+        return;
+    }
+
+    entry.recipients = remaining;
+
+    if (t - entry.created >= this->limits.max_lifetime) {
+        if (this->expire_cb) {
+            this->expire_cb(entry);
+        }
+
+        this->remove(id);
+        this->pump();
+        return;
+    }
+
+    domain_state &dom = this->domains[entry.domain];
+    dom.active--;
+    this->active--;
+
+    entry.state = entry_state::waiting;
+    entry.attempts++;
+    entry.next_attempt = t + this->backoff(entry.attempts);
+
+    std::string payload;
+    put_raw(payload, entry.id);
+    put_raw(payload, entry.next_attempt);
+    put_raw(payload, entry.attempts);
+    put_recipients(payload, entry.recipients);
+    this->append_journal(journal_defer_record, payload);
+
+    this->timing_heap.emplace_back(entry.next_attempt, entry.id);
+    std::push_heap(this->timing_heap.begin(), this->timing_heap.end(), later);
+
+    this->activate(entry.domain);
+    this->pump();
+}
+
+void delivery_queue::sync() {
+    if (this->journal_synced) {
+        return;
+    }
+
+    static auto &fsync_seconds = rmrf::metrics::get_histogram("rmrf_queue_fsync_seconds",
+        "Time spent waiting for queue files to reach the disk", "file=\"journal\"");
+    const uint64_t fsync_start = rmrf::metrics::now_ns();
+
+    if (fdatasync(this->journal.get()) != 0) {
+        throw queue_exception(std::string("Failed to sync queue journal: ") + strerror(errno));
+    }
+
+    fsync_seconds.record_since(fsync_start);
+    this->journal_synced = true;
+}
+
+void delivery_queue::compact() {
+    this->rewrite_journal();
+}
+
+size_t delivery_queue::size() const {
+    return this->entries.size();
+}
+
+uint32_t delivery_queue::get_active_count() const {
+    return this->active;
+}
+
+const std::string &delivery_queue::get_domain_name(const queue_entry &entry) const {
+    return this->domains[entry.domain].name;
+}
+
+void delivery_queue::replay_journal() {
+    const std::string path = this->directory + "/journal";
+    rmrf::net::auto_fd fd{::open(path.c_str(), O_RDONLY | O_CLOEXEC)};
+
+    std::string data;
+    struct stat st = {};
+
+    // Read the journal in one go; it is parsed in place
+    if (fd.valid() && fstat(fd.get(), &st) == 0 && st.st_size > 0) {
+        data.resize(static_cast<size_t>(st.st_size));
+        size_t filled = 0;
+        ssize_t n;
+
+        while (filled < data.size() && (n = ::read(fd.get(), &data[filled], data.size() - filled)) > 0) {
+            filled += static_cast<size_t>(n);
+        }
+
+        data.resize(filled);
+    }
+
+    std::string_view in{data};
+
+    while (in.size() >= journal_header_size) {
+        char type = in[0];
+        uint32_t length;
+        memcpy(&length, in.data() + 1, sizeof(length));
+
+        if (in.size() < journal_header_size + length) {
+            // Torn write at the end of the journal, ignore it
+            break;
+        }
+
+        std::string_view payload = in.substr(journal_header_size, length);
+        in.remove_prefix(journal_header_size + length);
+
+        uint64_t id;
+
+        if (!get_raw(payload, id)) {
+            continue;
+        }
+
+        this->next_id = std::max(this->next_id, id + 1);
+
+        if (type == journal_add_record) {
+            queue_entry entry{id, 0, entry_state::waiting, 0, 0, 0, {}, {}, {}};
+            std::string_view domain;
+            std::string_view message;
+            std::string_view sender;
+
+            if (!get_raw(payload, entry.created) || !get_raw(payload, entry.next_attempt) ||
+                !get_raw(payload, entry.attempts) || !get_string(payload, domain) ||
+                !get_string(payload, message) || !get_string(payload, sender) ||
+                !get_recipients(payload, entry.recipients)) {
+                continue;
+            }
+
+            entry.domain = this->intern_domain(domain);
+            entry.message = message;
+            entry.sender = sender;
+            this->entries.insert_or_assign(id, std::move(entry));
+        } else if (type == journal_defer_record) {
+            auto it = this->entries.find(id);
+
+            if (it == this->entries.end()) {
+                continue;
+            }
+
+            queue_entry &entry = it->second;
+            int64_t next_attempt;
+            uint32_t attempts;
+
+            if (!get_raw(payload, next_attempt) || !get_raw(payload, attempts) ||
+                !get_recipients(payload, entry.recipients)) {
+                continue;
+            }
+
+            entry.next_attempt = next_attempt;
+            entry.attempts = attempts;
+        } else if (type == journal_remove_record) {
+            this->entries.erase(id);
+        }
+    }
+
+    // Entries that are due go out oldest first, the others wait for their time
+    const int64_t t = static_cast<int64_t>(now());
+    std::vector<timer_slot> due;
+
+    this->timing_heap.reserve(this->entries.size());
+
+    for (const auto &[id, entry] : this->entries) {
+        if (entry.next_attempt <= t) {
+            due.emplace_back(entry.next_attempt, id);
+        } else {
+            this->timing_heap.emplace_back(entry.next_attempt, id);
+        }
+    }
+
+    std::make_heap(this->timing_heap.begin(), this->timing_heap.end(), later);
+    std::sort(due.begin(), due.end());
+
+    for (const timer_slot &slot : due) {
+        this->make_ready(this->entries.at(slot.second));
+    }
+}
+
+void delivery_queue::append_journal(char type, const std::string &payload) {
+    std::string record;
+    record.reserve(journal_header_size + payload.size());
+    put_record(record, type, payload);
+
+    if (!write_all(this->journal.get(), record.data(), record.size())) {
+        throw queue_exception(std::string("Failed to write queue journal: ") + strerror(errno));
+    }
+
+    this->journal_synced = false;
+
+    // Keep the journal from growing without bounds
+    if (++this->journal_records > 2 * this->entries.size() + 1024) {
+        this->rewrite_journal();
+    }
+}
+
+void delivery_queue::rewrite_journal() {
+    const std::string path = this->directory + "/journal";
+    const std::string tmp_path = path + ".new";
+
+    std::string data;
+    std::string payload;
+
+    for (const auto &[id, entry] : this->entries) {
+        MARK_UNUSED(id);
+
+        payload.clear();
+        put_entry(payload, entry, this->domains[entry.domain].name);
+        put_record(data, journal_add_record, payload);
+    }
+
+    static auto &fsync_seconds = rmrf::metrics::get_histogram("rmrf_queue_fsync_seconds",
+        "Time spent waiting for queue files to reach the disk", "file=\"journal\"");
+
+    rmrf::net::auto_fd fd{::open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600)};
+
+    if (!fd.valid() || !write_all(fd.get(), data.data(), data.size())) {
+        throw queue_exception("Failed to write queue journal '" + tmp_path + "': " + strerror(errno));
+    }
+
+    const uint64_t fsync_start = rmrf::metrics::now_ns();
+
+    if (fsync(fd.get()) != 0) {
+        throw queue_exception("Failed to write queue journal '" + tmp_path + "': " + strerror(errno));
+    }
+
+    fsync_seconds.record_since(fsync_start);
+    fd.close();
+
+    if (rename(tmp_path.c_str(), path.c_str()) != 0) {
+        throw queue_exception("Failed to replace queue journal '" + path + "': " + strerror(errno));
+    }
+
+    sync_directory(this->directory);
+
+    this->journal = rmrf::net::auto_fd{::open(path.c_str(), O_WRONLY | O_APPEND | O_CLOEXEC)};
+
+    if (!this->journal.valid()) {
+        throw queue_exception("Failed to open queue journal '" + path + "': " + strerror(errno));
+    }
+
+    this->journal_records = this->entries.size();
+    this->journal_synced = true;
+}
+
+uint32_t delivery_queue::intern_domain(std::string_view domain) {
+    std::string name{domain};
+    std::transform(name.begin(), name.end(), name.begin(), [](char c) {
+        return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+    });
+
+    auto it = this->domain_index.find(name);
+
+    if (it != this->domain_index.end()) {
+        return it->second;
+    }
+
+    const uint32_t d = static_cast<uint32_t>(this->domains.size());
+    this->domains.push_back(domain_state{name, {}, 0, this->limits.per_domain_burst, now(), false});
+    this->domain_index.emplace(std::move(name), d);
+    return d;
+}
+
+void delivery_queue::make_ready(queue_entry &entry) {
+    entry.state = entry_state::ready;
+    this->domains[entry.domain].ready.push_back(entry.id);
+    this->activate(entry.domain);
+}
+
+void delivery_queue::activate(uint32_t domain) {
+    domain_state &dom = this->domains[domain];
+
+    if (!dom.in_ring && !dom.ready.empty()) {
+        dom.in_ring = true;
+        this->ring.push_back(domain);
+    }
+}
+
+void delivery_queue::remove(uint64_t id) {
+    queue_entry &entry = this->entries.at(id);
+
+    if (entry.state == entry_state::active) {
+        this->domains[entry.domain].active--;
+        this->active--;
+        this->activate(entry.domain);
+    }
+
+    std::string payload;
+    put_raw(payload, id);
+    this->entries.erase(id);
+    this->append_journal(journal_remove_record, payload);
+}
+
+void delivery_queue::pump() {
+    // Entries finished from within the dispatch callback are picked up by the running loop
+    if (!this->running || !this->dispatch_cb || this->pumping) {
+        return;
+    }
+
+    this->pumping = true;
+    const ::ev::tstamp t = now();
+
+    while (!this->ring.empty() && this->active < this->limits.total_concurrency) {
+        const uint32_t d = this->ring.front();
+        this->ring.pop_front();
+
+        domain_state &dom = this->domains[d];
+
+        if (dom.ready.empty() || dom.active >= this->limits.per_domain_concurrency) {
+            dom.in_ring = false;
+            continue;
+        }
+
+        if (this->limits.per_domain_rate > 0) {
+            dom.tokens = std::min(this->limits.per_domain_burst, dom.tokens + (t - dom.refilled) * this->limits.per_domain_rate);
+            dom.refilled = t;
+
+            if (dom.tokens < 1.0) {
+                // Rate limited domains sit out until the timer hands them a token
+                dom.in_ring = false;
+                this->throttled.push_back(d);
+                continue;
+            }
+
+            dom.tokens -= 1.0;
+        }
+
+        const uint64_t id = dom.ready.front();
+        dom.ready.pop_front();
+
+        // One entry per domain and turn keeps the domains fair to each other
+        this->ring.push_back(d);
+
+        queue_entry &entry = this->entries.at(id);
+        entry.state = entry_state::active;
+        dom.active++;
+        this->active++;
+
+        this->dispatch_cb(entry);
+    }
+
+    this->pumping = false;
+    this->arm_timer();
+}
+
+void delivery_queue::arm_timer() {
+    ::ev::tstamp due = -1;
+
+    if (!this->timing_heap.empty()) {
+        due = static_cast<::ev::tstamp>(this->timing_heap.front().first);
+    }
+
+    if (!this->throttled.empty() && this->limits.per_domain_rate > 0) {
+        const ::ev::tstamp refill = now() + 1.0 / this->limits.per_domain_rate;
+        due = due < 0 ? refill : std::min(due, refill);
+    }
+
+    this->wakeup.stop();
+
+    if (due >= 0) {
+        this->wakeup.start(std::max(0.0, due - now()), 0);
+    }
+}
+
+int64_t delivery_queue::backoff(uint32_t attempts) {
+    const double delay = std::min<double>(this->limits.max_backoff,
+        std::ldexp(this->limits.min_backoff, static_cast<int>(std::min<uint32_t>(attempts - 1, 32))));
+
+    // Spread retries by up to a tenth so deferred bursts do not come back as one
+    std::uniform_real_distribution<double> spread{0.9, 1.1};
+    return static_cast<int64_t>(delay * spread(this->jitter));
+}
+
+void delivery_queue::cb_wakeup(::ev::timer &w, int events) {
+    MARK_UNUSED(w);
+    MARK_UNUSED(events);
+
+    static auto &histogram = rmrf::ev::callback_histogram("queue.wakeup");
+    rmrf::ev::callback_probe probe{histogram};
+
+    const int64_t t = static_cast<int64_t>(now());
+
+    while (!this->timing_heap.empty() && this->timing_heap.front().first <= t) {
+        std::pop_heap(this->timing_heap.begin(), this->timing_heap.end(), later);
+        const timer_slot slot = this->timing_heap.back();
+        this->timing_heap.pop_back();
+
+        // Slots of removed or rescheduled entries are dropped lazily
+        auto it = this->entries.find(slot.second);
+
+        if (it != this->entries.end() && it->second.state == entry_state::waiting && it->second.next_attempt == slot.first) {
+            this->make_ready(it->second);
+        }
+    }
+
+    std::vector<uint32_t> resumed;
+    resumed.swap(this->throttled);
+
+    for (uint32_t d : resumed) {
+        this->activate(d);
+    }
+
+    this->pump();
+}
+
+}
@@ -0,0 +1,209 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <random>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <ev++.h>
+
+#include "net/async_fd.hpp"
+#include "service/metrics.hpp"
+
+namespace rmrf::queue {
+
+struct queue_limits {
+    /** Deliveries in progress per destination domain and in total */
+    uint32_t per_domain_concurrency;
+    uint32_t total_concurrency;
+    /** Deliveries started per second and burst allowed per destination domain; a rate of 0 disables */
+    double per_domain_rate;
+    double per_domain_burst;
+    /** Seconds before the first retry; doubled with every further attempt */
+    uint32_t min_backoff;
+    uint32_t max_backoff;
+    /** Seconds after which an entry that still fails is given up */
+    uint32_t max_lifetime;
+};
+
+enum class entry_state : uint8_t {
+    waiting,
+    ready,
+    active
+};
+
+/**
+ * The recipients of a spooled message at one destination domain.
+ */
+struct queue_entry {
+    uint64_t id;
+    uint32_t domain;
+    entry_state state;
+    uint32_t attempts;
+    /** Wall clock seconds of creation and of the next delivery attempt */
+    int64_t created;
+    int64_t next_attempt;
+    /** The reference of the spooled message, e.g. its file name */
+    std::string message;
+    std::string sender;
+    std::vector<std::string> recipients;
+};
+
+/**
+ * The queue manager scheduling deliveries and retries.
+ *
+ * Entries due for delivery wait in a queue per destination domain. Domains
+ * are served round-robin, one entry per turn, within their concurrency and
+ * rate limits, so a large backlog to one domain cannot starve the others.
+ * Deferred entries wait in a timing heap until their backoff has passed.
+ *
+ * All changes are recorded in a journal of compact binary records. It is
+ * replayed on open, so a restart restores the queue without looking at the
+ * spooled messages. New entries are staged until commit() flushed the
+ * journal, so several of them go to disk with a single flush and none is
+ * dispatched before it is durable; rollback() drops them instead.
+ */
+class delivery_queue {
+public:
+    typedef std::function<void(const queue_entry &)> entry_cb_t;
+
+private:
+    struct domain_state {
+        std::string name;
+        std::deque<uint64_t> ready;
+        uint32_t active;
+        double tokens;
+        ::ev::tstamp refilled;
+        bool in_ring;
+    };
+
+    typedef std::pair<int64_t, uint64_t> timer_slot;
+
+    const std::string directory;
+    const queue_limits limits;
+
+    rmrf::net::auto_fd journal;
+    size_t journal_records;
+    bool journal_synced;
+
+    std::unordered_map<uint64_t, queue_entry> entries;
+    std::vector<domain_state> domains;
+    std::unordered_map<std::string, uint32_t> domain_index;
+    std::vector<timer_slot> timing_heap;
+    std::deque<uint32_t> ring;
+    std::vector<uint32_t> throttled;
+    std::vector<uint64_t> staged;
+
+    uint64_t next_id;
+    uint32_t active;
+    bool running;
+    bool pumping;
+    std::minstd_rand jitter;
+
+    entry_cb_t dispatch_cb;
+    entry_cb_t expire_cb;
+    ::ev::timer wakeup;
+
+    rmrf::metrics::callback_gauge entries_gauge;
+    rmrf::metrics::callback_gauge active_gauge;
+
+public:
+    /**
+     * Open (or create) the queue state in the given directory.
+     *
+     * @param directory_ The directory holding the journal
+     * @param limits_ The scheduling limits to enforce
+     * @throws queue_exception if the directory cannot be used
+     */
+    delivery_queue(const std::string &directory_, const queue_limits &limits_);
+    ~delivery_queue();
+
+    delivery_queue(const delivery_queue &) = delete;
+    delivery_queue &operator=(const delivery_queue &) = delete;
+
+    /**
+     * Use this method in order to receive the entries to deliver. Every
+     * dispatched entry has to be answered with delivered() or deferred().
+     */
+    void set_dispatch_callback(const entry_cb_t &cb);
+
+    /**
+     * Use this method in order to get notified about entries that are given
+     * up after their lifetime, e.g. to send a bounce.
+     */
+    void set_expire_callback(const entry_cb_t &cb);
+
+    /**
+     * Stage a spooled message for the recipients at one domain. The entry
+     * is dispatched and survives a crash only once commit() returned.
+     *
+     * @return The id of the new entry
+     * @throws queue_exception if the journal could not be written
+     */
+    uint64_t enqueue(std::string_view domain, std::string_view message, std::string_view sender,
+        const std::vector<std::string> &recipients);
+
+    /**
+     * Finish a dispatched entry.
+     */
+    void delivered(uint64_t id);
+
+    /**
+     * Retry a dispatched entry later for the recipients that are left.
+     */
+    void deferred(uint64_t id, const std::vector<std::string> &remaining);
+
+    /**
+     * Start dispatching. Call this once the event loop is set up.
+     */
+    void start();
+
+    /**
+     * Flush all journal records written so far to disk and release the
+     * staged entries for delivery. Call this before acknowledging queued
+     * messages; on failure the staged entries are kept for rollback().
+     *
+     * @throws queue_exception if the journal could not be synced
+     */
+    void commit();
+
+    /**
+     * Drop all staged entries, e.g. when a message could not be queued for
+     * all of its domains and the client is going to retry it.
+     *
+     * @throws queue_exception if the journal could not be written
+     */
+    void rollback();
+
+    /**
+     * Rewrite the journal with only the live entries.
+     */
+    void compact();
+
+    size_t size() const;
+    uint32_t get_active_count() const;
+    const std::string &get_domain_name(const queue_entry &entry) const;
+
+private:
+    void replay_journal();
+    void append_journal(char type, const std::string &payload);
+    void rewrite_journal();
+    void sync();
+
+    uint32_t intern_domain(std::string_view domain);
+    void make_ready(queue_entry &entry);
+    void activate(uint32_t domain);
+    void remove(uint64_t id);
+    void pump();
+    void arm_timer();
+    int64_t backoff(uint32_t attempts);
+
+    void cb_wakeup(::ev::timer &w, int events);
+};
+
+}
@@ -0,0 +1,113 @@
+#include "queue/message_spool.hpp"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+
+#include "net/async_fd.hpp"
+#include "queue/queue_exception.hpp"
+#include "queue/sync_directory.hpp"
+#include "service/metrics.hpp"
+#include "service/trace.hpp"
+
+namespace rmrf::queue {
+
+message_spool::message_spool(const std::string &directory_) :
+    directory{directory_}, counter{0}
+{
+    if (mkdir(this->directory.c_str(), 0700) != 0 && errno != EEXIST) {
+        throw queue_exception("Failed to create spool directory '" + this->directory + "': " + strerror(errno));
+    }
+}
+
+std::string message_spool::store(std::string_view message) {
+    RMRF_TRACE_SCOPE("spool.store", message.size());
+
+    // Unique across restarts as long as the clock does not run backwards
+    char name[64];
+    snprintf(name, sizeof(name), "%" PRIx64 "-%x-%" PRIx64,
+        static_cast<uint64_t>(time(nullptr)), static_cast<unsigned>(getpid()), ++this->counter);
+
+    const std::string path = this->directory + "/" + name;
+    const std::string tmp_path = path + ".tmp";
+
+    rmrf::net::auto_fd fd{::open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600)};
+    const char *p = message.data();
+    size_t length = message.size();
+
+    while (fd.valid() && length) {
+        ssize_t written = ::write(fd.get(), p, length);
+
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+
+        if (written < 0) {
+            break;
+        }
+
+        p += written;
+        length -= static_cast<size_t>(written);
+    }
+
+    static auto &fsync_seconds = rmrf::metrics::get_histogram("rmrf_queue_fsync_seconds",
+        "Time spent waiting for queue files to reach the disk", "file=\"spool\"");
+    const uint64_t fsync_start = rmrf::metrics::now_ns();
+
+    if (!fd.valid() || length || fsync(fd.get()) != 0) {
+        const std::string cause = strerror(errno);
+        unlink(tmp_path.c_str());
+        throw queue_exception("Failed to write spool file '" + tmp_path + "': " + cause);
+    }
+
+    fsync_seconds.record_since(fsync_start);
+    fd.close();
+
+    if (rename(tmp_path.c_str(), path.c_str()) != 0) {
+        const std::string cause = strerror(errno);
+        unlink(tmp_path.c_str());
+        throw queue_exception("Failed to store spool file '" + path + "': " + cause);
+    }
+
+    // The rename itself has to reach the disk before anyone relies on the file
+    sync_directory(this->directory);
+
+    return name;
+}
+
+std::optional<std::string> message_spool::load(std::string_view name) const {
+    const std::string path = this->directory + "/" + std::string(name);
+    rmrf::net::auto_fd fd{::open(path.c_str(), O_RDONLY | O_CLOEXEC)};
+    struct stat st = {};
+
+    if (!fd.valid() || fstat(fd.get(), &st) != 0) {
+        return std::nullopt;
+    }
+
+    std::string data(static_cast<size_t>(st.st_size), '\0');
+    size_t filled = 0;
+    ssize_t n;
+
+    while (filled < data.size() && (n = ::read(fd.get(), &data[filled], data.size() - filled)) > 0) {
+        filled += static_cast<size_t>(n);
+    }
+
+    if (filled != data.size()) {
+        return std::nullopt;
+    }
+
+    return data;
+}
+
+void message_spool::remove(std::string_view name) {
+    unlink((this->directory + "/" + std::string(name)).c_str());
+}
+
+}
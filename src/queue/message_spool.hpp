@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace rmrf::queue {
+
+/**
+ * The files holding the messages referenced by queue entries.
+ *
+ * Messages are written to a temporary file, synced and renamed into place,
+ * and the directory is synced, so a stored message is complete and present
+ * after a crash once store() returned.
+ */
+class message_spool {
+private:
+    const std::string directory;
+    uint64_t counter;
+
+public:
+    /**
+     * @param directory_ The directory holding the message files
+     * @throws queue_exception if the directory cannot be used
+     */
+    explicit message_spool(const std::string &directory_);
+
+    /**
+     * Store a message.
+     *
+     * @return The name the message can be loaded by
+     * @throws queue_exception if the message could not be written
+     */
+    std::string store(std::string_view message);
+
+    std::optional<std::string> load(std::string_view name) const;
+    void remove(std::string_view name);
+};
+
+}
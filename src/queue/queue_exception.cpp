@@ -0,0 +1,13 @@
+#include "queue/queue_exception.hpp"
+
+namespace rmrf::queue {
+
+queue_exception::queue_exception(const std::string &cause_) : cause(cause_) {
+    // NOP
+}
+
+const char *queue_exception::what() const throw() {
+    return this->cause.c_str();
+}
+
+}
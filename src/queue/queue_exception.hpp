@@ -0,0 +1,16 @@
+#pragma once
+
+#include <exception>
+#include <string>
+
+namespace rmrf::queue {
+
+class queue_exception : public std::exception {
+private:
+    std::string cause;
+public:
+    explicit queue_exception(const std::string &cause_);
+    virtual const char *what() const throw();
+};
+
+}
@@ -0,0 +1,22 @@
+#include "queue/sync_directory.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+
+#include "net/async_fd.hpp"
+#include "queue/queue_exception.hpp"
+
+namespace rmrf::queue {
+
+void sync_directory(const std::string &path) {
+    rmrf::net::auto_fd fd{::open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC)};
+
+    if (!fd.valid() || fsync(fd.get()) != 0) {
+        throw queue_exception("Failed to sync directory '" + path + "': " + strerror(errno));
+    }
+}
+
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <string>
+
+namespace rmrf::queue {
+
+/**
+ * Flush a directory to disk, so files renamed into it survive a crash.
+ *
+ * @throws queue_exception if the directory cannot be synced
+ */
+void sync_directory(const std::string &path);
+
+}
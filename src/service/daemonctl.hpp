@@ -1,15 +1,53 @@
 #pragma once
 
+#include <sys/types.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
 #include "macros.hpp"
 
+struct dctl_socket {
+    int fd;
+    std::string name;
+};
+
 ATTR_NONNULL_ALL
 void dctl_status_msg(const char* msg);
 
 ATTR_NONNULL_ALL
 void dctl_status_err(const char* msg);
 
+/**
+ * Send the status line to the service manager right away. The functions
+ * above log the message and leave coalescing status updates to the log
+ * writer, which then calls this.
+ */
+ATTR_NONNULL_ALL
+void dctl_notify_status(const char* msg);
+
 void dctl_status_ready();
 void dctl_status_reload();
 void dctl_status_shutdown();
 
 void dctl_watchdog_refresh();
+
+/**
+ * Get the interval in microseconds at which the service manager expects
+ * watchdog refreshes, or 0 if there is no watchdog.
+ */
+uint64_t dctl_watchdog_interval();
+
+/**
+ * Get the sockets passed in by the service manager (LISTEN_FDS protocol).
+ * The descriptors are owned by the caller; the environment is cleared so
+ * child processes do not pick them up again.
+ */
+std::vector<dctl_socket> dctl_listen_fds();
+
+/**
+ * Tell the service manager that another process took over as main process,
+ * e.g. after handing over all sockets to an upgraded instance.
+ */
+void dctl_status_mainpid(pid_t pid);
@@ -2,6 +2,12 @@
 
 #ifdef __FreeBSD__
 
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cstdlib>
+#include <sstream>
+
 ATTR_WEAK
 void dctl_status_msg(const char* msg) {
     (void)msg;
@@ -12,6 +18,11 @@ void dctl_status_err(const char* msg) {
     (void)msg;
 }
 
+ATTR_WEAK
+void dctl_notify_status(const char* msg) {
+    (void)msg;
+}
+
 ATTR_WEAK
 void dctl_status_ready() {
 
@@ -32,4 +43,48 @@ void dctl_watchdog_refresh() {
 
 }
 
+ATTR_WEAK
+uint64_t dctl_watchdog_interval() {
+    return 0;
+}
+
+// Socket activators outside of systemd speak the same environment protocol
+ATTR_WEAK
+std::vector<dctl_socket> dctl_listen_fds() {
+    std::vector<dctl_socket> sockets;
+    const char *pid = getenv("LISTEN_PID");
+    const char *fds = getenv("LISTEN_FDS");
+
+    if (!pid || !fds || strtol(pid, nullptr, 10) != getpid()) {
+        return sockets;
+    }
+
+    const char *fdnames = getenv("LISTEN_FDNAMES");
+    std::istringstream names{fdnames ? fdnames : ""};
+    const long count = strtol(fds, nullptr, 10);
+
+    for (long i = 0; i < count; i++) {
+        const int fd = static_cast<int>(3 + i);
+        std::string name;
+
+        if (!std::getline(names, name, ':') || name.empty()) {
+            name = "unknown";
+        }
+
+        fcntl(fd, F_SETFD, fcntl(fd, F_GETFD) | FD_CLOEXEC);
+        sockets.push_back(dctl_socket{fd, name});
+    }
+
+    unsetenv("LISTEN_PID");
+    unsetenv("LISTEN_FDS");
+    unsetenv("LISTEN_FDNAMES");
+
+    return sockets;
+}
+
+ATTR_WEAK
+void dctl_status_mainpid(pid_t pid) {
+    (void)pid;
+}
+
 #endif
@@ -4,18 +4,25 @@
 
 #include <systemd/sd-daemon.h>
 
-#include <iostream>
+#include <fcntl.h>
+
+#include <cstdlib>
+
+#include "service/log.hpp"
 
 ATTR_NONNULL_ALL
 void dctl_status_msg(const char* msg) {
-    sd_notifyf(0, "STATUS=%s", msg);
-    std::cout << SD_INFO << "STATUS=" << msg << std::endl;
+    rmrf::log::status(rmrf::log::level::info, msg);
 }
 
 ATTR_NONNULL_ALL
 void dctl_status_err(const char* msg) {
+    rmrf::log::status(rmrf::log::level::error, msg);
+}
+
+ATTR_NONNULL_ALL
+void dctl_notify_status(const char* msg) {
     sd_notifyf(0, "STATUS=%s", msg);
-    std::cerr << SD_ERR << "STATUS=" << msg << std::endl;
 }
 
 void dctl_status_ready() {
@@ -34,4 +41,37 @@ void dctl_watchdog_refresh() {
     sd_notify(0, "WATCHDOG=1");
 }
 
+uint64_t dctl_watchdog_interval() {
+    uint64_t usec = 0;
+    return sd_watchdog_enabled(0, &usec) > 0 ? usec : 0;
+}
+
+std::vector<dctl_socket> dctl_listen_fds() {
+    std::vector<dctl_socket> sockets;
+    char **names = nullptr;
+    const int count = sd_listen_fds_with_names(1, &names);
+
+    for (int i = 0; i < count; i++) {
+        const int fd = SD_LISTEN_FDS_START + i;
+
+        // Passed descriptors survive exec unless we say otherwise
+        fcntl(fd, F_SETFD, fcntl(fd, F_GETFD) | FD_CLOEXEC);
+        sockets.push_back(dctl_socket{fd, names && names[i] ? names[i] : "unknown"});
+    }
+
+    if (names) {
+        for (int i = 0; i < count; i++) {
+            free(names[i]);
+        }
+
+        free(names);
+    }
+
+    return sockets;
+}
+
+void dctl_status_mainpid(pid_t pid) {
+    sd_notifyf(0, "MAINPID=%lu", static_cast<unsigned long>(pid));
+}
+
 #endif
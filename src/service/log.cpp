@@ -0,0 +1,733 @@
+#include "service/log.hpp"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "service/daemonctl.hpp"
+
+namespace rmrf::log {
+
+namespace {
+
+// Longer messages and values are cut off, so every record fits a ring easily
+constexpr size_t max_text = 1024;
+constexpr size_t max_fields = 16;
+
+// Records are padded to this alignment; pad markers fit into the gap
+constexpr size_t record_alignment = 8;
+constexpr uint32_t pad_marker = 0x80000000u;
+
+// Status lines are passed on no more often than this
+constexpr auto status_interval = std::chrono::milliseconds{100};
+constexpr auto write_interval = std::chrono::milliseconds{10};
+
+std::atomic<uint8_t> max_level{static_cast<uint8_t>(level::info)};
+
+struct record_header {
+    uint32_t size;
+    uint8_t lvl;
+    uint8_t field_count;
+    uint16_t message_length;
+    uint64_t timestamp_us;
+};
+
+/**
+ * A single producer, single consumer byte ring. Positions only ever grow;
+ * the producer publishes records with a release store of head.
+ */
+class ring {
+public:
+    static constexpr size_t capacity = 256 * 1024;
+
+private:
+    std::unique_ptr<uint8_t[]> data;
+    alignas(64) std::atomic<size_t> head;
+    alignas(64) std::atomic<size_t> tail;
+
+public:
+    std::atomic<uint64_t> dropped;
+    std::atomic<bool> orphaned;
+
+    ring() : data{new uint8_t[capacity]}, head{0}, tail{0}, dropped{0}, orphaned{false} {
+        // NOP
+    }
+
+    /**
+     * Get room for a record of the given (aligned) size, or nullptr if the
+     * ring is full. The record is published by commit().
+     */
+    uint8_t *reserve(size_t size, size_t &end) {
+        const size_t h = this->head.load(std::memory_order_relaxed);
+        const size_t t = this->tail.load(std::memory_order_acquire);
+        const size_t offset = h % capacity;
+        const size_t pad = offset + size > capacity ? capacity - offset : 0;
+
+        if (capacity - (h - t) < pad + size) {
+            return nullptr;
+        }
+
+        // Records never wrap; the rest of the buffer is skipped instead
+        if (pad) {
+            const uint32_t marker = pad_marker | static_cast<uint32_t>(pad);
+            memcpy(this->data.get() + offset, &marker, sizeof(marker));
+        }
+
+        end = h + pad + size;
+        return this->data.get() + (h + pad) % capacity;
+    }
+
+    void commit(size_t end) {
+        this->head.store(end, std::memory_order_release);
+    }
+
+    /**
+     * Get the next record or nullptr if there is none. It stays valid until
+     * release() is called.
+     */
+    const uint8_t *peek() {
+        const size_t h = this->head.load(std::memory_order_acquire);
+
+        for (;;) {
+            const size_t t = this->tail.load(std::memory_order_relaxed);
+
+            if (t == h) {
+                return nullptr;
+            }
+
+            uint32_t size;
+            memcpy(&size, this->data.get() + t % capacity, sizeof(size));
+
+            if (!(size & pad_marker)) {
+                return this->data.get() + t % capacity;
+            }
+
+            this->tail.store(t + (size & ~pad_marker), std::memory_order_release);
+        }
+    }
+
+    void release(size_t size) {
+        this->tail.store(this->tail.load(std::memory_order_relaxed) + size, std::memory_order_release);
+    }
+};
+
+/**
+ * Gives up the ring of a thread when it exits; the writer drains it.
+ */
+struct ring_holder {
+    std::shared_ptr<ring> owned;
+
+    ring_holder() : owned{} {
+        // NOP
+    }
+
+    ~ring_holder() {
+        if (this->owned) {
+            this->owned->orphaned.store(true, std::memory_order_release);
+        }
+    }
+
+    ring_holder(const ring_holder &) = delete;
+    ring_holder &operator=(const ring_holder &) = delete;
+};
+
+/**
+ * Where formatted records go.
+ */
+class sink {
+private:
+    int fd;
+    bool own_fd;
+    bool syslog_prefix;
+    int journal;
+    std::string identifier;
+
+    std::string text;
+    std::vector<std::string> entries;
+
+public:
+    sink() : fd{STDERR_FILENO}, own_fd{false}, syslog_prefix{false}, journal{-1}, identifier{}, text{}, entries{} {
+        // systemd tells us when stderr is connected to the journal
+        const char *stream = getenv("JOURNAL_STREAM");
+        struct stat st = {};
+
+        if (stream && fstat(STDERR_FILENO, &st) == 0) {
+            this->syslog_prefix = std::to_string(st.st_dev) + ":" + std::to_string(st.st_ino) == stream;
+        }
+
+#ifdef __linux__
+        // The native protocol keeps the fields of a record apart
+        if (this->syslog_prefix) {
+            this->journal = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+            sockaddr_un addr = {};
+            addr.sun_family = AF_UNIX;
+            strncpy(addr.sun_path, "/run/systemd/journal/socket", sizeof(addr.sun_path) - 1);
+
+            if (this->journal >= 0 && connect(this->journal, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0) {
+                close(this->journal);
+                this->journal = -1;
+            }
+
+            this->identifier = program_invocation_short_name;
+        }
+#endif
+    }
+
+    ~sink() {
+        if (this->own_fd) {
+            close(this->fd);
+        }
+
+        if (this->journal >= 0) {
+            close(this->journal);
+        }
+    }
+
+    sink(const sink &) = delete;
+    sink &operator=(const sink &) = delete;
+
+    bool open_file(const std::string &path) {
+        const int file = ::open(path.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0640);
+
+        if (file < 0) {
+            return false;
+        }
+
+        this->flush();
+
+        if (this->own_fd) {
+            close(this->fd);
+        }
+
+        if (this->journal >= 0) {
+            close(this->journal);
+            this->journal = -1;
+        }
+
+        this->fd = file;
+        this->own_fd = true;
+        this->syslog_prefix = false;
+        return true;
+    }
+
+    void add(const uint8_t *record) {
+        record_header header;
+        memcpy(&header, record, sizeof(header));
+
+        const uint8_t *p = record + sizeof(header);
+        const std::string_view message{reinterpret_cast<const char *>(p), header.message_length};
+        p += header.message_length;
+
+        if (this->journal >= 0) {
+            this->add_journal(header, message, p);
+        } else {
+            this->add_text(header, message, p);
+        }
+    }
+
+    void flush() {
+        this->flush_text();
+        this->flush_journal();
+    }
+
+private:
+    template<typename F>
+    static const uint8_t *each_field(const uint8_t *p, const record_header &header, F cb) {
+        for (uint8_t i = 0; i < header.field_count; i++) {
+            const char *key;
+            field_type type;
+            memcpy(&key, p, sizeof(key));
+            memcpy(&type, p + sizeof(key), sizeof(type));
+            p += sizeof(key) + sizeof(type);
+
+            std::string value;
+
+            switch (type) {
+            case field_type::text: {
+                uint16_t length;
+                memcpy(&length, p, sizeof(length));
+                value.assign(reinterpret_cast<const char *>(p + sizeof(length)), length);
+                p += sizeof(length) + length;
+                break;
+            }
+            case field_type::sint: {
+                int64_t v;
+                memcpy(&v, p, sizeof(v));
+                value = std::to_string(v);
+                p += sizeof(v);
+                break;
+            }
+            case field_type::uint: {
+                uint64_t v;
+                memcpy(&v, p, sizeof(v));
+                value = std::to_string(v);
+                p += sizeof(v);
+                break;
+            }
+            case field_type::real: {
+                double v;
+                memcpy(&v, p, sizeof(v));
+                char buffer[32];
+                snprintf(buffer, sizeof(buffer), "%g", v);
+                value = buffer;
+                p += sizeof(v);
+                break;
+            }
+            default:
+                return p;
+            }
+
+            cb(key, value);
+        }
+
+        return p;
+    }
+
+    static std::string_view trim(std::string_view message) {
+        while (!message.empty() && (message.back() == '\n' || message.back() == ' ')) {
+            message.remove_suffix(1);
+        }
+
+        return message;
+    }
+
+    void add_text(const record_header &header, std::string_view message, const uint8_t *p) {
+        static const char *const names[] = {"emerg", "alert", "crit", "error", "warning", "notice", "info", "debug"};
+
+        if (this->syslog_prefix) {
+            // The journal adds its own timestamps
+            this->text.append("<").append(std::to_string(header.lvl)).append(">");
+        } else {
+            char stamp[40];
+            const time_t seconds = static_cast<time_t>(header.timestamp_us / 1000000);
+            struct tm tm = {};
+            gmtime_r(&seconds, &tm);
+            const size_t length = strftime(stamp, sizeof(stamp), "%Y-%m-%dT%H:%M:%S", &tm);
+            snprintf(stamp + length, sizeof(stamp) - length, ".%06lluZ ", static_cast<unsigned long long>(header.timestamp_us % 1000000));
+            this->text.append(stamp).append(names[header.lvl & 7]).append(" ");
+        }
+
+        this->text.append(trim(message));
+
+        each_field(p, header, [this](const char *key, const std::string &value) {
+            const bool quote = value.empty() || value.find_first_of(" \"=\n") != std::string::npos;
+            this->text.append(" ").append(key).append("=");
+
+            if (!quote) {
+                this->text.append(value);
+                return;
+            }
+
+            this->text.push_back('"');
+
+            for (char c : value) {
+                if (c == '"' || c == '\\') {
+                    this->text.push_back('\\');
+                }
+
+                this->text.push_back(c == '\n' ? ' ' : c);
+            }
+
+            this->text.push_back('"');
+        });
+
+        this->text.push_back('\n');
+    }
+
+    void add_journal(const record_header &header, std::string_view message, const uint8_t *p) {
+        std::string entry = "PRIORITY=" + std::to_string(header.lvl) + "\nSYSLOG_IDENTIFIER=" + this->identifier +
+            "\nSOURCE_REALTIME_TIMESTAMP=" + std::to_string(header.timestamp_us) + "\nMESSAGE=";
+
+        for (char c : trim(message)) {
+            entry.push_back(c == '\n' ? ' ' : c);
+        }
+
+        entry.push_back('\n');
+
+        each_field(p, header, [&entry](const char *key, const std::string &value) {
+            // Journal field names are upper case letters, digits and underscores
+            for (const char *k = key; *k; k++) {
+                const char c = *k;
+                entry.push_back(c >= 'a' && c <= 'z' ? static_cast<char>(c - 'a' + 'A') : ((c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9')) ? c : '_');
+            }
+
+            entry.push_back('=');
+
+            for (char c : value) {
+                entry.push_back(c == '\n' ? ' ' : c);
+            }
+
+            entry.push_back('\n');
+        });
+
+        this->entries.push_back(std::move(entry));
+    }
+
+    void flush_text() {
+        size_t done = 0;
+
+        while (done < this->text.size()) {
+            const ssize_t written = ::write(this->fd, this->text.data() + done, this->text.size() - done);
+
+            if (written < 0 && errno == EINTR) {
+                continue;
+            }
+
+            if (written <= 0) {
+                break;
+            }
+
+            done += static_cast<size_t>(written);
+        }
+
+        this->text.clear();
+    }
+
+    void flush_journal() {
+#ifdef __linux__
+        // One datagram per record, handed to the kernel in batches
+        constexpr size_t batch = 64;
+        size_t done = 0;
+
+        while (done < this->entries.size()) {
+            const size_t count = std::min(batch, this->entries.size() - done);
+            iovec iov[batch];
+            mmsghdr msgs[batch];
+
+            for (size_t i = 0; i < count; i++) {
+                iov[i].iov_base = this->entries[done + i].data();
+                iov[i].iov_len = this->entries[done + i].size();
+                msgs[i] = mmsghdr{};
+                msgs[i].msg_hdr.msg_iov = &iov[i];
+                msgs[i].msg_hdr.msg_iovlen = 1;
+            }
+
+            const int sent = sendmmsg(this->journal, msgs, static_cast<unsigned int>(count), 0);
+
+            if (sent <= 0) {
+                // The journal is overloaded; these records are lost
+                break;
+            }
+
+            done += static_cast<size_t>(sent);
+        }
+#endif
+
+        this->entries.clear();
+    }
+};
+
+/**
+ * Owns the background thread formatting and writing all records.
+ */
+class writer {
+private:
+    std::mutex lock;
+    std::condition_variable wakeup;
+    std::condition_variable flushed;
+    std::vector<std::shared_ptr<ring>> rings;
+    uint64_t generation;
+    bool stopping;
+    bool flush_requested;
+    bool status_dirty;
+    std::string status_line;
+    std::atomic<uint64_t> dropped_total;
+
+    // Producers never wait for the output, only open_file() does
+    std::mutex sink_lock;
+    sink out;
+
+    std::thread thread;
+
+public:
+    writer() :
+        lock{}, wakeup{}, flushed{}, rings{}, generation{0}, stopping{false}, flush_requested{false},
+        status_dirty{false}, status_line{}, dropped_total{0}, sink_lock{}, out{}, thread{}
+    {
+        this->thread = std::thread{&writer::run, this};
+    }
+
+    ~writer() {
+        {
+            std::lock_guard<std::mutex> guard{this->lock};
+            this->stopping = true;
+        }
+
+        this->wakeup.notify_one();
+        this->thread.join();
+    }
+
+    writer(const writer &) = delete;
+    writer &operator=(const writer &) = delete;
+
+    std::shared_ptr<ring> add_ring() {
+        auto r = std::make_shared<ring>();
+        std::lock_guard<std::mutex> guard{this->lock};
+        this->rings.push_back(r);
+        return r;
+    }
+
+    void notify() {
+        this->wakeup.notify_one();
+    }
+
+    void set_status(std::string_view line) {
+        std::lock_guard<std::mutex> guard{this->lock};
+        this->status_line.assign(line);
+        this->status_dirty = true;
+    }
+
+    bool open_file(const std::string &path) {
+        std::lock_guard<std::mutex> guard{this->sink_lock};
+        return this->out.open_file(path);
+    }
+
+    void flush() {
+        std::unique_lock<std::mutex> guard{this->lock};
+
+        // The pass running right now may have missed the latest records
+        const uint64_t target = this->generation + 2;
+        this->flush_requested = true;
+        this->wakeup.notify_one();
+        this->flushed.wait(guard, [this, target]() {
+            return this->generation >= target || this->stopping;
+        });
+    }
+
+    uint64_t get_dropped() {
+        return this->dropped_total.load(std::memory_order_relaxed);
+    }
+
+private:
+    void run() {
+        std::unique_lock<std::mutex> guard{this->lock};
+        auto last_status = std::chrono::steady_clock::now() - status_interval;
+
+        for (;;) {
+            const bool stop = this->stopping;
+            const auto now = std::chrono::steady_clock::now();
+            const std::vector<std::shared_ptr<ring>> snapshot = this->rings;
+
+            // Only the latest status line within an interval gets sent
+            std::string status_update;
+            const bool send_status = this->status_dirty &&
+                (stop || this->flush_requested || now - last_status >= status_interval);
+
+            if (send_status) {
+                status_update.swap(this->status_line);
+                this->status_dirty = false;
+                last_status = now;
+            }
+
+            this->flush_requested = false;
+            guard.unlock();
+
+            {
+                std::lock_guard<std::mutex> sink_guard{this->sink_lock};
+                this->drain(snapshot);
+            }
+
+            if (send_status) {
+                dctl_notify_status(status_update.c_str());
+            }
+
+            guard.lock();
+
+            // Threads that are gone cannot produce anything any more
+            this->rings.erase(std::remove_if(this->rings.begin(), this->rings.end(), [](const std::shared_ptr<ring> &r) {
+                return r->orphaned.load(std::memory_order_acquire) && !r->peek();
+            }), this->rings.end());
+
+            this->generation++;
+            this->flushed.notify_all();
+
+            if (stop) {
+                return;
+            }
+
+            this->wakeup.wait_for(guard, write_interval);
+        }
+    }
+
+    void drain(const std::vector<std::shared_ptr<ring>> &snapshot) {
+        uint64_t dropped = 0;
+
+        for (const auto &r : snapshot) {
+            const uint8_t *record;
+
+            while ((record = r->peek())) {
+                uint32_t size;
+                memcpy(&size, record, sizeof(size));
+                this->out.add(record);
+                r->release(size);
+            }
+
+            dropped += r->dropped.exchange(0, std::memory_order_relaxed);
+        }
+
+        if (dropped) {
+            this->dropped_total.fetch_add(dropped, std::memory_order_relaxed);
+
+            char line[96];
+            const int length = snprintf(line, sizeof(line), "Dropped %llu log records, the writer could not keep up",
+                static_cast<unsigned long long>(dropped));
+            this->write_overflow_notice(std::string_view{line, static_cast<size_t>(length)});
+        }
+
+        this->out.flush();
+    }
+
+    void write_overflow_notice(std::string_view message) {
+        // Formatted directly, as our own rings may be full too
+        alignas(record_header) uint8_t record[sizeof(record_header) + 128] = {};
+        record_header header = {};
+        header.lvl = static_cast<uint8_t>(level::warning);
+        header.message_length = static_cast<uint16_t>(std::min<size_t>(message.size(), 128));
+        header.timestamp_us = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count());
+        memcpy(record, &header, sizeof(header));
+        memcpy(record + sizeof(header), message.data(), header.message_length);
+        this->out.add(record);
+    }
+};
+
+writer &get_writer() {
+    // Destroyed after main returns, which writes out what is left
+    static writer instance;
+    return instance;
+}
+
+ring &local_ring() {
+    thread_local ring_holder holder;
+
+    if (!holder.owned) {
+        holder.owned = get_writer().add_ring();
+    }
+
+    return *holder.owned;
+}
+
+size_t field_size(const field &f) {
+    const size_t fixed = sizeof(const char *) + sizeof(field_type);
+    return fixed + (f.type == field_type::text ? sizeof(uint16_t) + std::min(f.text.size(), max_text) : sizeof(uint64_t));
+}
+
+uint8_t *put(uint8_t *p, const void *src, size_t length) {
+    memcpy(p, src, length);
+    return p + length;
+}
+
+}
+
+void write(level lvl, std::string_view message, std::initializer_list<field> fields) {
+    if (static_cast<uint8_t>(lvl) > max_level.load(std::memory_order_relaxed)) {
+        return;
+    }
+
+    message = message.substr(0, max_text);
+
+    const size_t count = std::min(fields.size(), max_fields);
+    size_t size = sizeof(record_header) + message.size();
+
+    for (size_t i = 0; i < count; i++) {
+        size += field_size(fields.begin()[i]);
+    }
+
+    size = (size + record_alignment - 1) / record_alignment * record_alignment;
+
+    ring &r = local_ring();
+    size_t end = 0;
+    uint8_t *p = r.reserve(size, end);
+
+    if (!p) {
+        r.dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    timespec ts = {};
+    clock_gettime(CLOCK_REALTIME, &ts);
+
+    record_header header = {};
+    header.size = static_cast<uint32_t>(size);
+    header.lvl = static_cast<uint8_t>(lvl);
+    header.field_count = static_cast<uint8_t>(count);
+    header.message_length = static_cast<uint16_t>(message.size());
+    header.timestamp_us = static_cast<uint64_t>(ts.tv_sec) * 1000000 + static_cast<uint64_t>(ts.tv_nsec / 1000);
+
+    p = put(p, &header, sizeof(header));
+    p = put(p, message.data(), message.size());
+
+    for (size_t i = 0; i < count; i++) {
+        const field &f = fields.begin()[i];
+        p = put(p, &f.key, sizeof(f.key));
+        p = put(p, &f.type, sizeof(f.type));
+
+        switch (f.type) {
+        case field_type::text: {
+            const uint16_t length = static_cast<uint16_t>(std::min(f.text.size(), max_text));
+            p = put(p, &length, sizeof(length));
+            p = put(p, f.text.data(), length);
+            break;
+        }
+        case field_type::sint:
+            p = put(p, &f.sint, sizeof(f.sint));
+            break;
+        case field_type::uint:
+            p = put(p, &f.uint, sizeof(f.uint));
+            break;
+        case field_type::real:
+            p = put(p, &f.real, sizeof(f.real));
+            break;
+        default:
+            break;
+        }
+    }
+
+    r.commit(end);
+
+    // Errors should show up right away, everything else waits for the next batch
+    if (lvl <= level::error) {
+        get_writer().notify();
+    }
+}
+
+void set_level(level lvl) {
+    max_level.store(static_cast<uint8_t>(lvl), std::memory_order_relaxed);
+}
+
+void status(level lvl, std::string_view message) {
+    write(lvl, message);
+    get_writer().set_status(message.substr(0, message.find('\n')));
+}
+
+bool open_file(const std::string &path) {
+    return get_writer().open_file(path);
+}
+
+void flush() {
+    get_writer().flush();
+}
+
+uint64_t get_dropped_count() {
+    return get_writer().get_dropped();
+}
+
+}
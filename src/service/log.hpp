@@ -0,0 +1,124 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+namespace rmrf::log {
+
+/**
+ * The severities, numbered like syslog and the journal do.
+ */
+enum class level : uint8_t {
+    error = 3,
+    warning = 4,
+    notice = 5,
+    info = 6,
+    debug = 7
+};
+
+enum class field_type : uint8_t {
+    sint,
+    uint,
+    real,
+    text
+};
+
+/**
+ * A key/value pair attached to a log record. Keys have to be string
+ * literals, as only the pointer is kept; values are copied.
+ */
+struct field {
+    const char *key;
+    field_type type;
+    int64_t sint;
+    uint64_t uint;
+    double real;
+    std::string_view text;
+
+    template<size_t N, typename T, std::enable_if_t<std::is_integral_v<T> && std::is_signed_v<T>, int> = 0>
+    field(const char (&key_)[N], T value) :
+        key{key_}, type{field_type::sint}, sint{value}, uint{0}, real{0}, text{}
+    {
+        // NOP
+    }
+
+    template<size_t N, typename T, std::enable_if_t<std::is_integral_v<T> && !std::is_signed_v<T>, int> = 0>
+    field(const char (&key_)[N], T value) :
+        key{key_}, type{field_type::uint}, sint{0}, uint{value}, real{0}, text{}
+    {
+        // NOP
+    }
+
+    template<size_t N, typename T, std::enable_if_t<std::is_floating_point_v<T>, int> = 0>
+    field(const char (&key_)[N], T value) :
+        key{key_}, type{field_type::real}, sint{0}, uint{0}, real{value}, text{}
+    {
+        // NOP
+    }
+
+    template<size_t N, typename T, std::enable_if_t<std::is_convertible_v<const T &, std::string_view>, int> = 0>
+    field(const char (&key_)[N], const T &value) :
+        key{key_}, type{field_type::text}, sint{0}, uint{0}, real{0}, text{value}
+    {
+        // NOP
+    }
+};
+
+/**
+ * Queue a record for the background writer. This never blocks and takes no
+ * locks: records go into a ring buffer owned by the calling thread and are
+ * dropped (and counted) if the writer cannot keep up.
+ *
+ *     rmrf::log::write(rmrf::log::level::info, "Accepted client", {{"peer", peer.str()}, {"fd", fd}});
+ */
+void write(level lvl, std::string_view message, std::initializer_list<field> fields = {});
+
+inline void error(std::string_view message, std::initializer_list<field> fields = {}) {
+    write(level::error, message, fields);
+}
+
+inline void warning(std::string_view message, std::initializer_list<field> fields = {}) {
+    write(level::warning, message, fields);
+}
+
+inline void info(std::string_view message, std::initializer_list<field> fields = {}) {
+    write(level::info, message, fields);
+}
+
+inline void debug(std::string_view message, std::initializer_list<field> fields = {}) {
+    write(level::debug, message, fields);
+}
+
+/**
+ * Records less severe than the given level are discarded right away.
+ */
+void set_level(level lvl);
+
+/**
+ * Log the status line and pass it on to the service manager. Status updates
+ * in quick succession are coalesced, only the last one is sent.
+ */
+void status(level lvl, std::string_view message);
+
+/**
+ * Write to the given file instead of the journal or stderr.
+ *
+ * @return false if the file could not be opened
+ */
+bool open_file(const std::string &path);
+
+/**
+ * Wait until everything logged so far was written out.
+ */
+void flush();
+
+/**
+ * The number of records dropped because a ring buffer was full.
+ */
+uint64_t get_dropped_count();
+
+}
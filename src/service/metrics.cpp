@@ -0,0 +1,315 @@
+#include "service/metrics.hpp"
+
+#include <time.h>
+
+#include <iomanip>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace rmrf::metrics {
+
+namespace {
+
+enum class metric_kind : uint8_t {
+    counter,
+    gauge,
+    histogram
+};
+
+struct family {
+    std::string help;
+    metric_kind kind;
+    std::map<std::string, std::unique_ptr<counter>> counters;
+    std::map<std::string, std::unique_ptr<gauge>> gauges;
+    std::map<std::string, std::unique_ptr<histogram>> histograms;
+    std::map<uint64_t, std::pair<std::string, std::function<double()>>> callbacks;
+};
+
+struct registry {
+    std::mutex lock;
+    std::map<std::string, family> families;
+    std::vector<std::function<void(std::ostream &)>> collectors;
+    uint64_t next_callback_id;
+
+    registry() : lock{}, families{}, collectors{}, next_callback_id{0} {
+        // NOP
+    }
+};
+
+// Metrics get looked up during static initialisation of other units already
+registry &get_registry() {
+    static registry instance;
+    return instance;
+}
+
+// The Prometheus buckets histograms are exported with, in seconds
+constexpr double export_bounds[] = {
+    1e-6, 2.5e-6, 5e-6, 1e-5, 2.5e-5, 5e-5, 1e-4, 2.5e-4, 5e-4,
+    1e-3, 2.5e-3, 5e-3, 1e-2, 2.5e-2, 5e-2, 0.1, 0.25, 0.5, 1, 2.5, 5, 10
+};
+
+family &get_family(const std::string &name, const std::string &help, metric_kind kind) {
+    auto [it, created] = get_registry().families.try_emplace(name, family{help, kind, {}, {}, {}, {}});
+
+    if (!created && it->second.kind != kind) {
+        throw std::invalid_argument("Metric " + name + " registered with different types");
+    }
+
+    return it->second;
+}
+
+template<typename T>
+T &get_metric(std::map<std::string, std::unique_ptr<T>> &metrics, const std::string &labels) {
+    auto &metric = metrics[labels];
+
+    if (!metric) {
+        metric = std::make_unique<T>();
+    }
+
+    return *metric;
+}
+
+void write_sample(std::ostream &out, const std::string &name, const std::string &labels, double value) {
+    out << name;
+
+    if (!labels.empty()) {
+        out << "{" << labels << "}";
+    }
+
+    out << " " << value << "\n";
+}
+
+void write_histogram(std::ostream &out, const std::string &name, const std::string &labels, const histogram &h) {
+    std::array<uint64_t, histogram::bucket_count> buckets;
+    const uint64_t sum = h.snapshot(buckets);
+    const std::string prefix = labels.empty() ? "" : labels + ",";
+
+    uint64_t count = 0;
+    size_t bucket = 0;
+
+    // Buckets reaching past a bound are counted with the next one
+    for (double bound : export_bounds) {
+        const uint64_t bound_ns = static_cast<uint64_t>(bound * 1e9);
+
+        for (; bucket < histogram::bucket_count && histogram::upper_bound(bucket) <= bound_ns + 1; bucket++) {
+            count += buckets[bucket];
+        }
+
+        out << name << "_bucket{" << prefix << "le=\"" << bound << "\"} " << count << "\n";
+    }
+
+    for (; bucket < histogram::bucket_count; bucket++) {
+        count += buckets[bucket];
+    }
+
+    out << name << "_bucket{" << prefix << "le=\"+Inf\"} " << count << "\n";
+    write_sample(out, name + "_sum", labels, static_cast<double>(sum) / 1e9);
+    write_sample(out, name + "_count", labels, static_cast<double>(count));
+}
+
+}
+
+size_t detail::local_shard() {
+    static std::atomic<size_t> next{0};
+    thread_local const size_t shard = next.fetch_add(1, std::memory_order_relaxed) % shard_count;
+    return shard;
+}
+
+uint64_t now_ns() {
+    timespec ts = {};
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000 + static_cast<uint64_t>(ts.tv_nsec);
+}
+
+counter::counter() : shards{} {
+    // NOP
+}
+
+uint64_t counter::value() const {
+    uint64_t total = 0;
+
+    for (const auto &s : this->shards) {
+        total += s.value.load(std::memory_order_relaxed);
+    }
+
+    return total;
+}
+
+gauge::gauge() : shards{} {
+    // NOP
+}
+
+int64_t gauge::value() const {
+    int64_t total = 0;
+
+    for (const auto &s : this->shards) {
+        total += s.value.load(std::memory_order_relaxed);
+    }
+
+    return total;
+}
+
+histogram::histogram() : shards{} {
+    // NOP
+}
+
+histogram::~histogram() {
+    for (auto &s : this->shards) {
+        delete s.load(std::memory_order_relaxed);
+    }
+}
+
+histogram::shard &histogram::get_shard() {
+    std::atomic<shard *> &slot = this->shards[detail::local_shard()];
+    shard *s = slot.load(std::memory_order_acquire);
+
+    if (s) {
+        return *s;
+    }
+
+    // Another thread on the same shard may win the race; then ours goes away
+    shard *created = new shard{};
+
+    if (slot.compare_exchange_strong(s, created, std::memory_order_acq_rel)) {
+        return *created;
+    }
+
+    delete created;
+    return *s;
+}
+
+size_t histogram::bucket_of(uint64_t ns) {
+    constexpr uint64_t linear = uint64_t{1} << sub_bucket_bits;
+
+    if (ns < linear) {
+        return ns;
+    }
+
+    const unsigned exponent = 63u - static_cast<unsigned>(__builtin_clzll(ns));
+
+    if (exponent > max_exponent) {
+        return bucket_count - 1;
+    }
+
+    const unsigned shift = exponent - sub_bucket_bits;
+    const size_t sub = (ns >> shift) & (linear - 1);
+    return (static_cast<size_t>(shift + 1) << sub_bucket_bits) + sub;
+}
+
+uint64_t histogram::upper_bound(size_t bucket) {
+    const size_t group = bucket >> sub_bucket_bits;
+    const uint64_t sub = bucket & ((size_t{1} << sub_bucket_bits) - 1);
+
+    if (!group) {
+        return sub + 1;
+    }
+
+    const unsigned shift = static_cast<unsigned>(group - 1);
+    return (((uint64_t{1} << sub_bucket_bits) + sub + 1) << shift);
+}
+
+uint64_t histogram::snapshot(std::array<uint64_t, bucket_count> &buckets) const {
+    uint64_t sum = 0;
+    buckets.fill(0);
+
+    for (const auto &slot : this->shards) {
+        const shard *s = slot.load(std::memory_order_acquire);
+
+        if (!s) {
+            continue;
+        }
+
+        for (size_t i = 0; i < bucket_count; i++) {
+            buckets[i] += s->buckets[i].load(std::memory_order_relaxed);
+        }
+
+        sum += s->sum.load(std::memory_order_relaxed);
+    }
+
+    return sum;
+}
+
+counter &get_counter(const std::string &name, const std::string &help, const std::string &labels) {
+    std::lock_guard<std::mutex> guard{get_registry().lock};
+    return get_metric(get_family(name, help, metric_kind::counter).counters, labels);
+}
+
+gauge &get_gauge(const std::string &name, const std::string &help, const std::string &labels) {
+    std::lock_guard<std::mutex> guard{get_registry().lock};
+    return get_metric(get_family(name, help, metric_kind::gauge).gauges, labels);
+}
+
+histogram &get_histogram(const std::string &name, const std::string &help, const std::string &labels) {
+    std::lock_guard<std::mutex> guard{get_registry().lock};
+    return get_metric(get_family(name, help, metric_kind::histogram).histograms, labels);
+}
+
+callback_gauge::callback_gauge(const std::string &name, const std::string &help, std::function<double()> cb,
+    const std::string &labels) :
+    id{0}
+{
+    std::lock_guard<std::mutex> guard{get_registry().lock};
+    this->id = ++get_registry().next_callback_id;
+    get_family(name, help, metric_kind::gauge).callbacks.emplace(this->id, std::make_pair(labels, std::move(cb)));
+}
+
+callback_gauge::~callback_gauge() {
+    std::lock_guard<std::mutex> guard{get_registry().lock};
+
+    for (auto &[name, f] : get_registry().families) {
+        (void)name;
+
+        if (f.callbacks.erase(this->id)) {
+            break;
+        }
+    }
+}
+
+void add_collector(std::function<void(std::ostream &)> collector) {
+    std::lock_guard<std::mutex> guard{get_registry().lock};
+    get_registry().collectors.push_back(std::move(collector));
+}
+
+void write_prometheus(std::ostream &out) {
+    std::vector<std::function<void(std::ostream &)>> extra;
+
+    {
+        std::lock_guard<std::mutex> guard{get_registry().lock};
+        out << std::setprecision(12);
+
+        for (const auto &[name, f] : get_registry().families) {
+            static const char *const types[] = {"counter", "gauge", "histogram"};
+            out << "# HELP " << name << " " << f.help << "\n";
+            out << "# TYPE " << name << " " << types[static_cast<size_t>(f.kind)] << "\n";
+
+            for (const auto &[labels, c] : f.counters) {
+                write_sample(out, name, labels, static_cast<double>(c->value()));
+            }
+
+            for (const auto &[labels, g] : f.gauges) {
+                write_sample(out, name, labels, static_cast<double>(g->value()));
+            }
+
+            for (const auto &[id, cb] : f.callbacks) {
+                (void)id;
+                write_sample(out, name, cb.first, cb.second());
+            }
+
+            for (const auto &[labels, h] : f.histograms) {
+                write_histogram(out, name, labels, *h);
+            }
+        }
+
+        extra = get_registry().collectors;
+    }
+
+    // Collectors may take locks of their own
+    for (const auto &collector : extra) {
+        collector(out);
+    }
+}
+
+}
@@ -0,0 +1,174 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <ostream>
+#include <string>
+
+namespace rmrf::metrics {
+
+/**
+ * Updates go to one of this many slots, picked per thread, so threads do
+ * not fight over cache lines. Reading sums up all slots.
+ */
+constexpr size_t shard_count = 16;
+
+namespace detail {
+
+size_t local_shard();
+
+template<typename T>
+struct alignas(64) padded {
+    std::atomic<T> value{0};
+};
+
+}
+
+/**
+ * A monotonically increasing count.
+ */
+class counter {
+private:
+    std::array<detail::padded<uint64_t>, shard_count> shards;
+
+public:
+    counter();
+
+    counter(const counter &) = delete;
+    counter &operator=(const counter &) = delete;
+
+    inline void add(uint64_t n = 1) {
+        this->shards[detail::local_shard()].value.fetch_add(n, std::memory_order_relaxed);
+    }
+
+    uint64_t value() const;
+};
+
+/**
+ * A value going up and down, e.g. the number of open connections.
+ */
+class gauge {
+private:
+    std::array<detail::padded<int64_t>, shard_count> shards;
+
+public:
+    gauge();
+
+    gauge(const gauge &) = delete;
+    gauge &operator=(const gauge &) = delete;
+
+    inline void add(int64_t n = 1) {
+        this->shards[detail::local_shard()].value.fetch_add(n, std::memory_order_relaxed);
+    }
+
+    inline void sub(int64_t n = 1) {
+        this->add(-n);
+    }
+
+    int64_t value() const;
+};
+
+/**
+ * A latency histogram in nanoseconds with HDR-style buckets: every power of
+ * two is split into 16 linear steps, so values are kept within 6.25 %.
+ * The buckets of a shard are only allocated once a thread records into it.
+ */
+class histogram {
+public:
+    static constexpr unsigned sub_bucket_bits = 4;
+    static constexpr unsigned max_exponent = 40;
+    static constexpr size_t bucket_count = (max_exponent - sub_bucket_bits + 2) << sub_bucket_bits;
+
+private:
+    struct shard {
+        std::array<std::atomic<uint64_t>, bucket_count> buckets{};
+        std::atomic<uint64_t> sum{0};
+    };
+
+    std::array<std::atomic<shard *>, shard_count> shards;
+
+    shard &get_shard();
+
+public:
+    histogram();
+    ~histogram();
+
+    histogram(const histogram &) = delete;
+    histogram &operator=(const histogram &) = delete;
+
+    static size_t bucket_of(uint64_t ns);
+    static uint64_t upper_bound(size_t bucket);
+
+    inline void record(uint64_t ns) {
+        shard &s = this->get_shard();
+        s.buckets[bucket_of(ns)].fetch_add(1, std::memory_order_relaxed);
+        s.sum.fetch_add(ns, std::memory_order_relaxed);
+    }
+
+    /**
+     * Record the time passed since the given now_ns() reading.
+     */
+    inline void record_since(uint64_t start_ns);
+
+    /**
+     * Sum up all shards.
+     *
+     * @param buckets Receives bucket_count counts
+     * @return The sum of all recorded values
+     */
+    uint64_t snapshot(std::array<uint64_t, bucket_count> &buckets) const;
+};
+
+/**
+ * A monotonic clock reading in nanoseconds.
+ */
+uint64_t now_ns();
+
+inline void histogram::record_since(uint64_t start_ns) {
+    this->record(now_ns() - start_ns);
+}
+
+/**
+ * Get the metric of the given name and labels, creating it on first use.
+ * The reference stays valid for the lifetime of the program, so look it up
+ * once and keep it.
+ *
+ * @param labels Prometheus labels without braces, e.g. command="MAIL"
+ */
+counter &get_counter(const std::string &name, const std::string &help, const std::string &labels = "");
+gauge &get_gauge(const std::string &name, const std::string &help, const std::string &labels = "");
+histogram &get_histogram(const std::string &name, const std::string &help, const std::string &labels = "");
+
+/**
+ * A gauge read through a callback when metrics are collected, for values
+ * that are cheaper to look up than to track, e.g. queue depths. It is
+ * removed again when this object goes away.
+ */
+class callback_gauge {
+private:
+    uint64_t id;
+
+public:
+    callback_gauge(const std::string &name, const std::string &help, std::function<double()> cb,
+        const std::string &labels = "");
+    ~callback_gauge();
+
+    callback_gauge(const callback_gauge &) = delete;
+    callback_gauge &operator=(const callback_gauge &) = delete;
+};
+
+/**
+ * Add a function writing further metrics in Prometheus text format.
+ */
+void add_collector(std::function<void(std::ostream &)> collector);
+
+/**
+ * Write all metrics in Prometheus text format.
+ */
+void write_prometheus(std::ostream &out);
+
+}
@@ -0,0 +1,41 @@
+#include "service/metrics_server.hpp"
+
+#include <sstream>
+#include <string>
+
+#include "service/metrics.hpp"
+
+namespace rmrf::metrics {
+
+metrics_server::metrics_server(const rmrf::net::socketaddr &address, mode_t unix_permissions) :
+    clients{}, listener{}
+{
+    using namespace std::placeholders;
+    this->listener = std::make_unique<rmrf::net::tcp_server_socket>(address,
+        std::bind(&metrics_server::accept_client, this, _1), unix_permissions);
+}
+
+metrics_server::~metrics_server() {
+    // Clients report back to the listener when they go away, so they go first
+    this->clients.clear();
+    this->listener.reset();
+}
+
+void metrics_server::accept_client(std::shared_ptr<rmrf::net::tcp_client> client) {
+    std::ostringstream body;
+    write_prometheus(body);
+
+    const std::string text = body.str();
+    const rmrf::net::tcp_client *raw = client.get();
+
+    client->set_closed_callback([this, raw]() {
+        this->clients.erase(raw);
+    });
+
+    client->write_data("HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: " +
+        std::to_string(text.size()) + "\r\n\r\n" + text);
+    client->shutdown_after_write();
+    this->clients.emplace(raw, std::move(client));
+}
+
+}
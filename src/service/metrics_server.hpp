@@ -0,0 +1,38 @@
+#pragma once
+
+#include <sys/types.h>
+
+#include <memory>
+#include <unordered_map>
+
+#include "net/socketaddress.hpp"
+#include "net/tcp_client.hpp"
+#include "net/tcp_server_socket.hpp"
+
+namespace rmrf::metrics {
+
+/**
+ * Serves all metrics in Prometheus text format on a local socket:
+ *
+ *     curl --unix-socket /run/mumta/metrics http://localhost/metrics
+ *
+ * Every connection gets a single HTTP response right away and is closed
+ * once it went out; the request itself is not looked at.
+ */
+class metrics_server {
+private:
+    std::unordered_map<const rmrf::net::tcp_client *, std::shared_ptr<rmrf::net::tcp_client>> clients;
+    std::unique_ptr<rmrf::net::tcp_server_socket> listener;
+
+public:
+    explicit metrics_server(const rmrf::net::socketaddr &address, mode_t unix_permissions = 0660);
+    ~metrics_server();
+
+    metrics_server(const metrics_server &) = delete;
+    metrics_server &operator=(const metrics_server &) = delete;
+
+private:
+    void accept_client(std::shared_ptr<rmrf::net::tcp_client> client);
+};
+
+}
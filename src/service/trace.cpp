@@ -0,0 +1,210 @@
+#include "service/trace.hpp"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "service/metrics.hpp"
+
+namespace rmrf::trace {
+
+namespace {
+
+static_assert((ring_capacity & (ring_capacity - 1)) == 0, "ring_capacity has to be a power of two");
+
+/**
+ * The fields are atomics only so a dump may read them while the owning
+ * thread keeps writing; on the usual targets these are plain moves.
+ */
+struct slot {
+    std::atomic<uint64_t> timestamp;
+    std::atomic<uint64_t> name;
+    std::atomic<uint64_t> arg;
+    std::atomic<uint64_t> ph;
+};
+
+struct ring {
+    const uint32_t tid;
+    std::atomic<uint64_t> head;
+    std::unique_ptr<slot[]> slots;
+
+    explicit ring(uint32_t tid_) : tid{tid_}, head{0}, slots{new slot[ring_capacity]} {
+        // NOP
+    }
+};
+
+struct registry {
+    std::mutex lock;
+    std::vector<std::shared_ptr<ring>> rings;
+
+    registry() : lock{}, rings{} {
+        // NOP
+    }
+};
+
+registry &get_registry() {
+    static registry instance;
+    return instance;
+}
+
+thread_local ring *local_ring = nullptr;
+
+ring &get_local_ring() {
+    if (!local_ring) {
+        registry &r = get_registry();
+        std::lock_guard<std::mutex> guard{r.lock};
+
+        r.rings.push_back(std::make_shared<ring>(static_cast<uint32_t>(r.rings.size() + 1)));
+        local_ring = r.rings.back().get();
+    }
+
+    return *local_ring;
+}
+
+struct record {
+    uint64_t timestamp;
+    const char *name;
+    uint64_t arg;
+    phase ph;
+    uint32_t tid;
+};
+
+/**
+ * Copy the entries of a ring that survive the copy itself.
+ */
+void collect(const ring &rg, std::vector<record> &out) {
+    const uint64_t head = rg.head.load(std::memory_order_acquire);
+    const uint64_t first = head > ring_capacity ? head - ring_capacity : 0;
+    const size_t start = out.size();
+
+    for (uint64_t i = first; i < head; i++) {
+        const slot &s = rg.slots[i & (ring_capacity - 1)];
+        out.push_back(record{
+            s.timestamp.load(std::memory_order_relaxed),
+            reinterpret_cast<const char *>(s.name.load(std::memory_order_relaxed)),
+            s.arg.load(std::memory_order_relaxed),
+            static_cast<phase>(s.ph.load(std::memory_order_relaxed)),
+            rg.tid
+        });
+    }
+
+    // Whatever the owner wrote meanwhile may have replaced what we copied,
+    // including the entry it might be in the middle of writing right now
+    std::atomic_thread_fence(std::memory_order_acquire);
+    const uint64_t now = rg.head.load(std::memory_order_relaxed);
+
+    if (now + 1 > first + ring_capacity) {
+        const uint64_t lost = std::min(now + 1 - ring_capacity - first, head - first);
+        out.erase(out.begin() + static_cast<ptrdiff_t>(start),
+            out.begin() + static_cast<ptrdiff_t>(start + lost));
+    }
+}
+
+void write_string(std::ostream &out, const char *text) {
+    out << '"';
+
+    for (const char *c = text; *c; c++) {
+        if (*c == '"' || *c == '\\') {
+            out << '\\';
+        }
+
+        out << *c;
+    }
+
+    out << '"';
+}
+
+}
+
+void emit(const char *name, phase ph, uint64_t arg) {
+    ring &rg = get_local_ring();
+    const uint64_t index = rg.head.load(std::memory_order_relaxed);
+    slot &s = rg.slots[index & (ring_capacity - 1)];
+
+    s.timestamp.store(rmrf::metrics::now_ns(), std::memory_order_relaxed);
+    s.name.store(reinterpret_cast<uint64_t>(name), std::memory_order_relaxed);
+    s.arg.store(arg, std::memory_order_relaxed);
+    s.ph.store(static_cast<uint64_t>(ph), std::memory_order_relaxed);
+
+    rg.head.store(index + 1, std::memory_order_release);
+}
+
+void write_chrome_json(std::ostream &out) {
+    std::vector<record> records;
+
+    {
+        registry &r = get_registry();
+        std::lock_guard<std::mutex> guard{r.lock};
+
+        for (const auto &rg : r.rings) {
+            collect(*rg, records);
+        }
+    }
+
+    std::stable_sort(records.begin(), records.end(), [](const record &a, const record &b) {
+        return a.timestamp < b.timestamp;
+    });
+
+    const pid_t pid = getpid();
+    bool first = true;
+
+    out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+
+    for (const auto &rec : records) {
+        out << (first ? "\n" : ",\n") << "{\"name\":";
+        write_string(out, rec.name);
+
+        switch (rec.ph) {
+        case phase::begin:
+            out << ",\"ph\":\"B\"";
+            break;
+        case phase::end:
+            out << ",\"ph\":\"E\"";
+            break;
+        case phase::instant:
+            out << ",\"ph\":\"i\",\"s\":\"t\"";
+            break;
+        default:
+            break;
+        }
+
+        // Microseconds with the nanoseconds as fraction
+        char ts[32];
+        snprintf(ts, sizeof(ts), "%llu.%03llu",
+            static_cast<unsigned long long>(rec.timestamp / 1000), static_cast<unsigned long long>(rec.timestamp % 1000));
+        out << ",\"ts\":" << ts << ",\"pid\":" << pid << ",\"tid\":" << rec.tid;
+
+        if (rec.ph != phase::end) {
+            out << ",\"args\":{\"arg\":" << rec.arg << "}";
+        }
+
+        out << "}";
+        first = false;
+    }
+
+    out << "\n]}\n";
+}
+
+std::string dump(const std::string &directory) {
+    const std::string path = directory + "/trace-" + std::to_string(getpid()) + "-" +
+        std::to_string(time(nullptr)) + ".json";
+    std::ofstream out{path, std::ios::out | std::ios::trunc};
+
+    if (!out) {
+        return std::string{};
+    }
+
+    write_chrome_json(out);
+    out.close();
+
+    return out ? path : std::string{};
+}
+
+}
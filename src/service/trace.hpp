@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+/**
+ * Trace points for the hot paths. They only exist in builds made with
+ * `make TRACE=1`; otherwise the macros expand to nothing and their
+ * arguments are not even evaluated.
+ *
+ *     RMRF_TRACE_SCOPE("lmtp.parse", data.size());
+ *     RMRF_TRACE("net.read", n_read_bytes);
+ *
+ * Names have to be string literals, as only the pointer is recorded.
+ */
+#if defined(RMRF_TRACE_ENABLED)
+
+#define RMRF_TRACE_CONCAT_(a, b) a##b
+#define RMRF_TRACE_CONCAT(a, b) RMRF_TRACE_CONCAT_(a, b)
+
+#define RMRF_TRACE(name, arg) \
+    ::rmrf::trace::emit((name), ::rmrf::trace::phase::instant, ::rmrf::trace::to_arg(arg))
+#define RMRF_TRACE_SCOPE(name, arg) \
+    ::rmrf::trace::scope RMRF_TRACE_CONCAT(rmrf_trace_scope_, __LINE__){(name), ::rmrf::trace::to_arg(arg)}
+
+#else
+
+#define RMRF_TRACE(name, arg) ((void)0)
+#define RMRF_TRACE_SCOPE(name, arg) ((void)0)
+
+#endif
+
+namespace rmrf::trace {
+
+enum class phase : uint8_t {
+    begin,
+    end,
+    instant
+};
+
+/**
+ * Trace arguments are sizes, counts and descriptors of whatever type.
+ */
+template<typename T>
+constexpr uint64_t to_arg(T value) {
+    return static_cast<uint64_t>(value);
+}
+
+/**
+ * Every thread records into a ring of this many entries of 32 bytes each,
+ * overwriting the oldest ones. Rings stay around after their thread ended.
+ */
+constexpr size_t ring_capacity = 16384;
+
+/**
+ * Append a record to the ring of the calling thread. This takes no locks
+ * except when a thread records for the first time.
+ */
+void emit(const char *name, phase ph, uint64_t arg);
+
+/**
+ * Records a begin event on construction and the matching end event once
+ * the enclosing block is left.
+ */
+class scope {
+private:
+    const char *name;
+
+public:
+    scope(const char *name_, uint64_t arg) : name{name_} {
+        emit(this->name, phase::begin, arg);
+    }
+    ~scope() {
+        emit(this->name, phase::end, 0);
+    }
+
+    scope(const scope &) = delete;
+    scope &operator=(const scope &) = delete;
+};
+
+/**
+ * Write what all rings currently hold in the Chrome trace event format,
+ * which chrome://tracing and Perfetto both load. Threads keep recording
+ * meanwhile; entries overwritten during the copy are left out.
+ */
+void write_chrome_json(std::ostream &out);
+
+/**
+ * Write a trace file named after the process and the time into the given
+ * directory.
+ *
+ * @return The path of the file written or an empty string on failure
+ */
+std::string dump(const std::string &directory);
+
+}
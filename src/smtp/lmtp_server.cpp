@@ -0,0 +1,417 @@
+#include "smtp/lmtp_server.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <optional>
+
+#include "lib/ev/loop_monitor.hpp"
+#include "service/trace.hpp"
+
+namespace rmrf::smtp {
+
+namespace {
+
+// Commands are short; anything longer is garbage or an attack
+constexpr size_t max_command_line = 2048;
+
+bool iprefix(std::string_view text, std::string_view prefix) {
+    return text.size() >= prefix.size() && std::equal(prefix.begin(), prefix.end(), text.begin(), [](char a, char b) {
+        auto upper = [](char c) {
+            return (c >= 'a' && c <= 'z') ? static_cast<char>(c - 'a' + 'A') : c;
+        };
+
+        return upper(a) == upper(b);
+    });
+}
+
+/**
+ * Split "FROM:<path> params" into the path and the parameters.
+ */
+std::optional<std::string_view> parse_path(std::string_view arg, std::string_view keyword, std::string_view &params) {
+    if (!iprefix(arg, keyword)) {
+        return std::nullopt;
+    }
+
+    arg.remove_prefix(keyword.size());
+
+    while (!arg.empty() && arg.front() == ' ') {
+        arg.remove_prefix(1);
+    }
+
+    const size_t close = arg.find('>');
+
+    if (arg.empty() || arg.front() != '<' || close == std::string_view::npos) {
+        return std::nullopt;
+    }
+
+    params = arg.substr(close + 1);
+    return arg.substr(1, close - 1);
+}
+
+void append_reply(std::string &out, const smtp_reply &reply) {
+    const std::string code = std::to_string(reply.code);
+    size_t start = 0;
+
+    // Every line but the last one carries a dash after the code
+    for (;;) {
+        const size_t eol = reply.text.find('\n', start);
+        out.append(code).push_back(eol == std::string::npos ? ' ' : '-');
+        out.append(reply.text, start, eol == std::string::npos ? std::string::npos : eol - start).append("\r\n");
+
+        if (eol == std::string::npos) {
+            break;
+        }
+
+        start = eol + 1;
+    }
+}
+
+}
+
+struct lmtp_server::session {
+    lmtp_server *server;
+    std::shared_ptr<rmrf::net::tcp_client> conn;
+    std::string in;
+    bool announced;
+    bool greeted;
+    bool has_mail;
+    bool in_data;
+    bool too_big;
+    bool quitting;
+    envelope env;
+    std::string message;
+
+    session(lmtp_server *server_, std::shared_ptr<rmrf::net::tcp_client> conn_) :
+        server{server_}, conn{conn_}, in{},
+        announced{false}, greeted{false}, has_mail{false}, in_data{false}, too_big{false}, quitting{false},
+        env{}, message{}
+    {
+        // NOP
+    }
+
+    session(const session &) = delete;
+    session &operator=(const session &) = delete;
+
+    bool is_idle() const {
+        return !this->has_mail && !this->quitting && this->in.empty() && this->conn->is_idle();
+    }
+
+    void announce() {
+        this->announced = true;
+        this->conn->write_data("220 " + this->server->hostname + " LMTP server ready\r\n");
+    }
+
+    void reset() {
+        this->has_mail = false;
+        this->in_data = false;
+        this->too_big = false;
+        this->env.sender.clear();
+        this->env.recipients.clear();
+        this->message.clear();
+    }
+
+    void data_in(const std::string &data) {
+        static auto &histogram = rmrf::ev::callback_histogram("lmtp.session");
+        rmrf::ev::callback_probe probe{histogram};
+        RMRF_TRACE_SCOPE("lmtp.parse", data.size());
+
+        this->in += data;
+
+        // Clients have to wait for the greeting, so anything sent before is kept for later
+        if (!this->announced) {
+            if (this->in.size() > max_command_line) {
+                this->conn->close();
+            }
+
+            return;
+        }
+
+        std::string out;
+        size_t start = 0;
+        size_t eol;
+
+        while (!this->quitting && (eol = this->in.find('\n', start)) != std::string::npos) {
+            std::string_view line{this->in.data() + start, eol - start};
+            start = eol + 1;
+
+            if (!line.empty() && line.back() == '\r') {
+                line.remove_suffix(1);
+            }
+
+            if (this->in_data) {
+                this->data_line(line, out);
+            } else {
+                this->command(line, out);
+            }
+        }
+
+        this->in.erase(0, start);
+
+        if (!this->in_data && this->in.size() > max_command_line) {
+            append_reply(out, smtp_reply{500, "5.5.2 Line too long"});
+            this->in.clear();
+        } else if (this->in_data && this->in.size() > this->server->max_message_size) {
+            this->too_big = true;
+            this->message.clear();
+            this->in.clear();
+        }
+
+        // All replies to a pipelined batch go out together
+        if (!out.empty()) {
+            this->conn->write_data(out);
+        }
+
+        // Anything pipelined behind QUIT is ignored
+        if (this->quitting) {
+            this->in.clear();
+            this->conn->shutdown_after_write();
+        }
+    }
+
+    void data_line(std::string_view line, std::string &out) {
+        if (line == ".") {
+            this->finish_message(out);
+            return;
+        }
+
+        if (!line.empty() && line.front() == '.') {
+            line.remove_prefix(1);
+        }
+
+        if (this->too_big) {
+            return;
+        }
+
+        if (this->message.size() + line.size() + 2 > this->server->max_message_size) {
+            this->too_big = true;
+            this->message.clear();
+            return;
+        }
+
+        this->message.append(line).append("\r\n");
+    }
+
+    void finish_message(std::string &out) {
+        const size_t count = this->env.recipients.size();
+        std::vector<smtp_reply> replies;
+
+        if (this->too_big) {
+            replies.assign(count, smtp_reply{552, "5.3.4 Message too big"});
+        } else {
+            replies = this->server->handler(this->env, this->message);
+        }
+
+        replies.resize(count, smtp_reply{451, "4.3.0 No status for recipient"});
+
+        for (const smtp_reply &reply : replies) {
+            append_reply(out, reply);
+        }
+
+        this->reset();
+    }
+
+    void command(std::string_view line, std::string &out) {
+        const std::string_view verb = line.substr(0, line.find(' '));
+        const std::string_view arg = verb.size() < line.size() ? line.substr(verb.size() + 1) : std::string_view{};
+        std::string_view params;
+
+        if (iprefix(verb, "LHLO") && verb.size() == 4) {
+            if (arg.empty()) {
+                append_reply(out, smtp_reply{501, "5.5.4 LHLO requires a domain"});
+                return;
+            }
+
+            this->greeted = true;
+            this->reset();
+            append_reply(out, smtp_reply{250, this->server->hostname + "\nPIPELINING\nENHANCEDSTATUSCODES\n8BITMIME\nSIZE " +
+                std::to_string(this->server->max_message_size)});
+        } else if ((iprefix(verb, "HELO") || iprefix(verb, "EHLO")) && verb.size() == 4) {
+            append_reply(out, smtp_reply{500, "5.5.1 This is LMTP, use LHLO"});
+        } else if (iprefix(verb, "MAIL") && verb.size() == 4) {
+            if (!this->greeted) {
+                append_reply(out, smtp_reply{503, "5.5.1 Send LHLO first"});
+                return;
+            }
+
+            if (this->has_mail) {
+                append_reply(out, smtp_reply{503, "5.5.1 Nested MAIL command"});
+                return;
+            }
+
+            auto path = parse_path(arg, "FROM:", params);
+
+            if (!path) {
+                append_reply(out, smtp_reply{501, "5.5.4 Syntax: MAIL FROM:<address>"});
+                return;
+            }
+
+            const size_t size_param = params.find("SIZE=");
+
+            if (size_param != std::string_view::npos &&
+                std::strtoull(std::string(params.substr(size_param + 5)).c_str(), nullptr, 10) > this->server->max_message_size) {
+                append_reply(out, smtp_reply{552, "5.3.4 Message too big"});
+                return;
+            }
+
+            this->has_mail = true;
+            this->env.sender = *path;
+            append_reply(out, smtp_reply{250, "2.1.0 Sender OK"});
+        } else if (iprefix(verb, "RCPT") && verb.size() == 4) {
+            if (!this->has_mail) {
+                append_reply(out, smtp_reply{503, "5.5.1 Need MAIL command"});
+                return;
+            }
+
+            auto path = parse_path(arg, "TO:", params);
+
+            if (!path || path->empty()) {
+                append_reply(out, smtp_reply{501, "5.1.3 Bad recipient address syntax"});
+                return;
+            }
+
+            this->env.recipients.emplace_back(*path);
+            append_reply(out, smtp_reply{250, "2.1.5 Recipient OK"});
+        } else if (iprefix(verb, "DATA") && verb.size() == 4) {
+            if (this->env.recipients.empty()) {
+                append_reply(out, smtp_reply{503, "5.5.1 Need RCPT command"});
+                return;
+            }
+
+            this->in_data = true;
+            append_reply(out, smtp_reply{354, "Start mail input; end with <CRLF>.<CRLF>"});
+        } else if (iprefix(verb, "RSET") && verb.size() == 4) {
+            this->reset();
+            append_reply(out, smtp_reply{250, "2.0.0 OK"});
+        } else if (iprefix(verb, "NOOP") && verb.size() == 4) {
+            append_reply(out, smtp_reply{250, "2.0.0 OK"});
+        } else if (iprefix(verb, "VRFY") && verb.size() == 4) {
+            append_reply(out, smtp_reply{252, "2.5.0 Cannot verify the user"});
+        } else if (iprefix(verb, "QUIT") && verb.size() == 4) {
+            append_reply(out, smtp_reply{221, "2.0.0 " + this->server->hostname + " closing connection"});
+            this->quitting = true;
+        } else {
+            append_reply(out, smtp_reply{500, "5.5.1 Unknown command"});
+        }
+    }
+};
+
+lmtp_server::lmtp_server(const rmrf::net::socketaddr &address, std::string_view hostname_, message_handler_t handler_,
+    mode_t unix_permissions, size_t max_message_size_) :
+    hostname{hostname_}, max_message_size{max_message_size_}, handler{handler_},
+    sessions{}, listener{}, held{false}
+{
+    using namespace std::placeholders;
+    this->listener = std::make_unique<rmrf::net::tcp_server_socket>(address,
+        std::bind(&lmtp_server::accept_client, this, _1), unix_permissions);
+}
+
+lmtp_server::lmtp_server(rmrf::net::auto_fd &&listening_fd, std::string_view hostname_, message_handler_t handler_,
+    size_t max_message_size_) :
+    hostname{hostname_}, max_message_size{max_message_size_}, handler{handler_},
+    sessions{}, listener{}, held{false}
+{
+    using namespace std::placeholders;
+    this->listener = std::make_unique<rmrf::net::tcp_server_socket>(std::move(listening_fd),
+        std::bind(&lmtp_server::accept_client, this, _1));
+}
+
+lmtp_server::~lmtp_server() {
+    // Clients report back to the listener when they go away, so they go first
+    this->sessions.clear();
+    this->listener.reset();
+}
+
+size_t lmtp_server::get_session_count() const {
+    return this->sessions.size();
+}
+
+rmrf::net::tcp_server_socket &lmtp_server::get_listener() {
+    return *this->listener;
+}
+
+rmrf::net::auto_fd lmtp_server::release_listener() {
+    return this->listener->release_listener();
+}
+
+void lmtp_server::hold() {
+    this->held = true;
+}
+
+void lmtp_server::resume() {
+    this->held = false;
+
+    std::vector<const rmrf::net::tcp_client *> waiting;
+
+    for (const auto &[client, s] : this->sessions) {
+        if (!s->announced) {
+            waiting.push_back(client);
+        }
+    }
+
+    // Handling early input may close a session, so look each one up again
+    for (const rmrf::net::tcp_client *client : waiting) {
+        auto it = this->sessions.find(client);
+
+        if (it == this->sessions.end()) {
+            continue;
+        }
+
+        it->second->announce();
+
+        if (!it->second->in.empty()) {
+            it->second->data_in("");
+        }
+    }
+}
+
+std::vector<lmtp_server::idle_connection> lmtp_server::release_idle() {
+    std::vector<idle_connection> released;
+
+    for (auto it = this->sessions.begin(); it != this->sessions.end();) {
+        if (!it->second->is_idle()) {
+            ++it;
+            continue;
+        }
+
+        released.push_back(idle_connection{it->second->conn->release(), it->second->greeted});
+        it = this->sessions.erase(it);
+    }
+
+    return released;
+}
+
+void lmtp_server::adopt(idle_connection &&connection) {
+    session &s = this->add_session(this->listener->adopt_client(std::move(connection.fd)));
+    s.announced = true;
+    s.greeted = connection.greeted;
+}
+
+lmtp_server::session &lmtp_server::add_session(const std::shared_ptr<rmrf::net::tcp_client> &client) {
+    const rmrf::net::tcp_client *raw = client.get();
+    auto s = std::make_unique<session>(this, client);
+    session *sp = s.get();
+
+    client->set_incomming_data_callback([sp](const std::string &data) {
+        sp->data_in(data);
+    });
+    client->set_closed_callback([this, raw]() {
+        this->client_closed(raw);
+    });
+
+    this->sessions.emplace(raw, std::move(s));
+    return *sp;
+}
+
+void lmtp_server::accept_client(std::shared_ptr<rmrf::net::tcp_client> client) {
+    session &s = this->add_session(client);
+
+    if (!this->held) {
+        s.announce();
+    }
+}
+
+void lmtp_server::client_closed(const rmrf::net::tcp_client *client) {
+    this->sessions.erase(client);
+}
+
+}
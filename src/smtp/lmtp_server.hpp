@@ -0,0 +1,116 @@
+#pragma once
+
+#include <sys/types.h>
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "net/socketaddress.hpp"
+#include "net/tcp_client.hpp"
+#include "net/tcp_server_socket.hpp"
+#include "smtp/smtp_client.hpp"
+
+namespace rmrf::smtp {
+
+/**
+ * An LMTP (RFC 2033) endpoint for local MTAs and clients.
+ *
+ * Commands may be pipelined; all replies to one batch of input go out in a
+ * single write. After DATA one reply per accepted recipient is sent, so the
+ * sender learns the outcome for every recipient separately.
+ */
+class lmtp_server {
+public:
+    typedef std::shared_ptr<lmtp_server> ptr_type;
+
+    /**
+     * Called with every received message. It has to return one reply per
+     * recipient of the envelope, in order.
+     */
+    typedef std::function<std::vector<smtp_reply>(const envelope &, const std::string &)> message_handler_t;
+
+    /**
+     * A connection between two transactions, as handed over on restarts.
+     */
+    struct idle_connection {
+        rmrf::net::auto_fd fd;
+        bool greeted;
+    };
+
+private:
+    struct session;
+
+    const std::string hostname;
+    const size_t max_message_size;
+    message_handler_t handler;
+
+    std::unordered_map<const rmrf::net::tcp_client *, std::unique_ptr<session>> sessions;
+    std::unique_ptr<rmrf::net::tcp_server_socket> listener;
+    bool held;
+
+public:
+    /**
+     * @param address The address to listen on, typically a UNIX domain socket
+     * @param hostname_ The name announced in the greeting
+     * @param handler_ The handler taking over received messages
+     * @param unix_permissions The mode of the socket file for UNIX domain sockets
+     * @param max_message_size_ The largest message accepted in bytes
+     */
+    lmtp_server(const rmrf::net::socketaddr &address, std::string_view hostname_, message_handler_t handler_,
+        mode_t unix_permissions = 0660, size_t max_message_size_ = 64 * 1024 * 1024);
+
+    /**
+     * Use this constructor in order to serve on a socket that is already
+     * listening, e.g. one passed in by the service manager.
+     */
+    lmtp_server(rmrf::net::auto_fd &&listening_fd, std::string_view hostname_, message_handler_t handler_,
+        size_t max_message_size_ = 64 * 1024 * 1024);
+    ~lmtp_server();
+
+    lmtp_server(const lmtp_server &) = delete;
+    lmtp_server &operator=(const lmtp_server &) = delete;
+
+    size_t get_session_count() const;
+
+    /**
+     * The socket accepting new clients, e.g. to set an admission filter.
+     */
+    rmrf::net::tcp_server_socket &get_listener();
+
+    /**
+     * Stop accepting and hand out the listening socket.
+     */
+    rmrf::net::auto_fd release_listener();
+
+    /**
+     * Keep accepting, but hold back the greeting of new clients until
+     * resume() is called, e.g. while the state is not read yet. Clients do
+     * not send commands before they were greeted.
+     */
+    void hold();
+    void resume();
+
+    /**
+     * Hand out all connections that are neither inside a transaction nor
+     * waiting for replies to be sent. Busy connections are kept.
+     */
+    std::vector<idle_connection> release_idle();
+
+    /**
+     * Continue serving a connection released by another instance. No
+     * greeting is sent, as the client already got one.
+     */
+    void adopt(idle_connection &&connection);
+
+private:
+    void accept_client(std::shared_ptr<rmrf::net::tcp_client> client);
+    session &add_session(const std::shared_ptr<rmrf::net::tcp_client> &client);
+    void client_closed(const rmrf::net::tcp_client *client);
+};
+
+}
@@ -0,0 +1,538 @@
+#include "smtp/smtp_client.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+
+#include "lib/ev/loop_monitor.hpp"
+#include "service/trace.hpp"
+
+namespace rmrf::smtp {
+
+namespace {
+
+bool iequals(std::string_view a, std::string_view b) {
+    return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(), [](char ca, char cb) {
+        auto upper = [](char c) {
+            return (c >= 'a' && c <= 'z') ? static_cast<char>(c - 'a' + 'A') : c;
+        };
+
+        return upper(ca) == upper(cb);
+    });
+}
+
+bool is_digit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+std::string_view first_word(std::string_view line) {
+    return line.substr(0, line.find(' '));
+}
+
+bool has_8bit(std::string_view message) {
+    return std::any_of(message.begin(), message.end(), [](char c) {
+        return static_cast<unsigned char>(c) >= 0x80;
+    });
+}
+
+// Guards against servers that never terminate a line
+constexpr size_t max_reply_line = 64 * 1024;
+
+}
+
+bool smtp_reply::positive() const {
+    return this->code >= 200 && this->code < 400;
+}
+
+bool smtp_reply::transient() const {
+    return this->code < 500;
+}
+
+bool delivery_result::delivered() const {
+    return this->mail.positive() && this->data.positive() &&
+        std::any_of(this->recipients.begin(), this->recipients.end(), [](const smtp_reply &r) {
+            return r.positive();
+        });
+}
+
+smtp_reply_parser::smtp_reply_parser(reply_cb_t reply_cb_) :
+    reply_cb{reply_cb_}, buffer{}, current{0, {}}
+{
+    // NOP
+}
+
+void smtp_reply_parser::feed(const std::string &data) {
+    RMRF_TRACE_SCOPE("smtp.parse", data.size());
+    this->buffer += data;
+
+    size_t start = 0;
+    size_t eol;
+
+    while ((eol = this->buffer.find('\n', start)) != std::string::npos) {
+        std::string_view line{this->buffer.data() + start, eol - start};
+        start = eol + 1;
+
+        if (!line.empty() && line.back() == '\r') {
+            line.remove_suffix(1);
+        }
+
+        const bool valid = line.size() >= 3 && is_digit(line[0]) && is_digit(line[1]) && is_digit(line[2]) &&
+            (line.size() == 3 || line[3] == ' ' || line[3] == '-');
+        const bool last = !valid || line.size() == 3 || line[3] == ' ';
+
+        if (!this->current.text.empty()) {
+            this->current.text += '\n';
+        }
+
+        if (valid) {
+            this->current.code = static_cast<uint16_t>((line[0] - '0') * 100 + (line[1] - '0') * 10 + (line[2] - '0'));
+            this->current.text.append(line.size() > 4 ? line.substr(4) : std::string_view{});
+        } else {
+            this->current.code = 0;
+            this->current.text.append(line);
+        }
+
+        if (last) {
+            smtp_reply reply{this->current.code, std::move(this->current.text)};
+            this->current = smtp_reply{0, {}};
+            this->reply_cb(reply);
+        }
+    }
+
+    this->buffer.erase(0, start);
+
+    if (this->buffer.size() > max_reply_line) {
+        this->buffer.clear();
+        this->reply_cb(smtp_reply{0, "Reply line too long"});
+    }
+}
+
+smtp_client::smtp_client(std::shared_ptr<rmrf::net::connection_client> conn_, const smtp_timeouts &timeouts_) :
+    conn{conn_},
+    parser{std::bind(&smtp_client::handle_reply, this, std::placeholders::_1)},
+    timeouts{timeouts_}, reply_timer{},
+    helo_name{}, capabilities{}, max_size{0},
+    expected{}, outbox{}, current{}, ready_cb{},
+    ready{false}, needs_reset{false}, broken{false}
+{
+    this->conn->set_incomming_data_callback(std::bind(&smtp_client::conn_data_in_cb, this, std::placeholders::_1));
+    this->reply_timer.set<smtp_client, &smtp_client::cb_timeout>(this);
+}
+
+smtp_client::~smtp_client() {
+    this->reply_timer.stop();
+}
+
+void smtp_client::start(std::string_view helo_name_, ready_cb_t cb) {
+    this->helo_name = helo_name_;
+    this->ready_cb = cb;
+    this->expected.emplace_back(stage::greeting, rmrf::metrics::now_ns());
+    this->arm_timer();
+}
+
+void smtp_client::send(const envelope &env, std::shared_ptr<const std::string> message, delivery_cb_t cb) {
+    if (!this->ready || this->current) {
+        const smtp_reply unavailable{421, "Session not available"};
+        cb(delivery_result{unavailable, std::vector<smtp_reply>(env.recipients.size(), unavailable), unavailable});
+        return;
+    }
+
+    if (this->max_size && message->size() > this->max_size) {
+        const smtp_reply too_big{552, "Message exceeds the size limit of the server"};
+        cb(delivery_result{too_big, std::vector<smtp_reply>(env.recipients.size(), too_big), too_big});
+        return;
+    }
+
+    this->current = std::make_unique<transaction>(transaction{env, message, cb, delivery_result{}, 0});
+    this->current->result.recipients.reserve(env.recipients.size());
+
+    // The reset of a reused session costs no extra round trip when pipelined
+    if (this->needs_reset) {
+        this->enqueue(stage::rset, "RSET\r\n");
+        this->needs_reset = false;
+    }
+
+    std::string mail = "MAIL FROM:<" + env.sender + ">";
+
+    if (this->has_capability("SIZE")) {
+        mail += " SIZE=" + std::to_string(message->size());
+    }
+
+    if (this->has_capability("8BITMIME") && has_8bit(*message)) {
+        mail += " BODY=8BITMIME";
+    }
+
+    this->enqueue(stage::mail, mail + "\r\n");
+
+    for (const std::string &rcpt : env.recipients) {
+        this->enqueue(stage::rcpt, "RCPT TO:<" + rcpt + ">\r\n");
+    }
+
+    if (this->has_capability("CHUNKING")) {
+        // The whole message goes out as one chunk right behind the envelope
+        std::string chunk = "BDAT " + std::to_string(message->size()) + " LAST\r\n";
+        chunk.reserve(chunk.size() + message->size());
+        chunk += *message;
+        this->enqueue(stage::bdat, std::move(chunk));
+    } else {
+        this->enqueue(stage::data, "DATA\r\n");
+    }
+
+    this->flush();
+}
+
+void smtp_client::quit() {
+    if (this->broken) {
+        return;
+    }
+
+    this->ready = false;
+    this->enqueue(stage::quit, "QUIT\r\n");
+    this->flush();
+}
+
+void smtp_client::connection_lost() {
+    this->fail(smtp_reply{421, "Connection lost"});
+}
+
+void smtp_client::abort(const smtp_reply &reply) {
+    if (this->broken) {
+        return;
+    }
+
+    // The callbacks of fail() may drop the last reference to us
+    ptr_type self = this->shared_from_this();
+    this->fail(reply);
+}
+
+bool smtp_client::is_ready() const {
+    return this->ready;
+}
+
+bool smtp_client::is_busy() const {
+    return this->current != nullptr;
+}
+
+bool smtp_client::has_capability(std::string_view name) const {
+    return std::any_of(this->capabilities.begin(), this->capabilities.end(), [name](const std::string &cap) {
+        return iequals(first_word(cap), name);
+    });
+}
+
+void smtp_client::conn_data_in_cb(const std::string &data) {
+    static auto &histogram = rmrf::ev::callback_histogram("smtp.client");
+    rmrf::ev::callback_probe probe{histogram};
+
+    // Callbacks may drop the last reference to us while replies are parsed
+    ptr_type self = this->shared_from_this();
+    this->parser.feed(data);
+}
+
+void smtp_client::handle_reply(const smtp_reply &reply) {
+    if (this->broken) {
+        return;
+    }
+
+    if (reply.code == 0 || reply.code == 421 || this->expected.empty()) {
+        // Malformed, unsolicited or a shutdown notice: the session is over
+        this->fail(reply);
+        return;
+    }
+
+    const auto [s, sent] = this->expected.front();
+    this->expected.pop_front();
+    command_histogram(s).record_since(sent);
+
+    switch (s) {
+    case stage::greeting:
+        if (!reply.positive()) {
+            this->fail(reply);
+            return;
+        }
+
+        this->enqueue(stage::ehlo, "EHLO " + this->helo_name + "\r\n");
+        break;
+    case stage::ehlo:
+        this->handle_ehlo(reply);
+        break;
+    case stage::helo:
+        if (!reply.positive()) {
+            this->fail(reply);
+            return;
+        }
+
+        this->ready = true;
+        break;
+    case stage::rset:
+        break;
+    case stage::mail:
+        this->current->result.mail = reply;
+        break;
+    case stage::rcpt:
+        this->current->result.recipients.push_back(reply);
+
+        if (reply.positive()) {
+            this->current->accepted++;
+        }
+
+        break;
+    case stage::data:
+        this->handle_data(reply);
+        break;
+    case stage::data_end:
+    case stage::bdat:
+        this->finish_transaction(reply);
+        break;
+    case stage::quit:
+        break;
+    default:
+        break;
+    }
+
+    if (this->ready && this->ready_cb) {
+        ready_cb_t cb = std::move(this->ready_cb);
+        this->ready_cb = nullptr;
+        cb(true, reply);
+    }
+
+    this->flush();
+
+    // The next reply gets the full timeout of its command
+    this->arm_timer();
+}
+
+void smtp_client::handle_ehlo(const smtp_reply &reply) {
+    if (!reply.positive()) {
+        this->enqueue(stage::helo, "HELO " + this->helo_name + "\r\n");
+        return;
+    }
+
+    this->capabilities.clear();
+
+    // The first line only carries the name of the server
+    size_t start = reply.text.find('\n');
+
+    while (start != std::string::npos) {
+        const size_t end = reply.text.find('\n', start + 1);
+        this->capabilities.emplace_back(reply.text, start + 1, end == std::string::npos ? std::string::npos : end - start - 1);
+        start = end;
+    }
+
+    for (const std::string &cap : this->capabilities) {
+        if (iequals(first_word(cap), "SIZE") && cap.size() > 5) {
+            this->max_size = std::strtoull(cap.c_str() + 5, nullptr, 10);
+        }
+    }
+
+    this->ready = true;
+}
+
+void smtp_client::handle_data(const smtp_reply &reply) {
+    if (reply.code != 354) {
+        this->finish_transaction(reply);
+        return;
+    }
+
+    // A pipelined DATA may be accepted although every recipient was refused
+    if (this->current->accepted && this->current->result.mail.positive()) {
+        this->enqueue(stage::data_end, dot_stuff(*this->current->message));
+    } else {
+        this->enqueue(stage::data_end, ".\r\n");
+    }
+}
+
+void smtp_client::finish_transaction(const smtp_reply &data_reply) {
+    std::unique_ptr<transaction> tx = std::move(this->current);
+    tx->result.data = data_reply;
+    this->needs_reset = true;
+    tx->cb(tx->result);
+}
+
+void smtp_client::fail(const smtp_reply &reply) {
+    // The callbacks below may drop the last reference to us
+    std::shared_ptr<rmrf::net::connection_client> connection = this->conn;
+
+    this->broken = true;
+    this->ready = false;
+    this->reply_timer.stop();
+    this->expected.clear();
+    this->outbox.clear();
+
+    if (this->ready_cb) {
+        ready_cb_t cb = std::move(this->ready_cb);
+        this->ready_cb = nullptr;
+        cb(false, reply);
+    }
+
+    if (this->current) {
+        transaction &tx = *this->current;
+
+        if (!tx.result.mail.code) {
+            tx.result.mail = reply;
+        }
+
+        tx.result.recipients.resize(tx.env.recipients.size(), reply);
+        this->finish_transaction(reply);
+    }
+
+    // Nothing sensible can follow on this connection; closing it also
+    // makes the owner drop the session instead of waiting for it forever
+    connection->close();
+}
+
+// Reply latency as seen by us, i.e. including the round trip
+rmrf::metrics::histogram &smtp_client::command_histogram(stage s) {
+    static constexpr size_t stage_count = static_cast<size_t>(stage::quit) + 1;
+    static rmrf::metrics::histogram *histograms[stage_count] = {};
+
+    const size_t index = static_cast<size_t>(s);
+    auto &h = histograms[index];
+
+    if (!h) {
+        const char *name = "unknown";
+
+        switch (s) {
+        case stage::greeting:
+            name = "greeting";
+            break;
+        case stage::ehlo:
+            name = "EHLO";
+            break;
+        case stage::helo:
+            name = "HELO";
+            break;
+        case stage::rset:
+            name = "RSET";
+            break;
+        case stage::mail:
+            name = "MAIL";
+            break;
+        case stage::rcpt:
+            name = "RCPT";
+            break;
+        case stage::data:
+            name = "DATA";
+            break;
+        case stage::data_end:
+            name = "DATA_END";
+            break;
+        case stage::bdat:
+            name = "BDAT";
+            break;
+        case stage::quit:
+            name = "QUIT";
+            break;
+        default:
+            break;
+        }
+
+        h = &rmrf::metrics::get_histogram("rmrf_smtp_command_seconds",
+            "Time from sending an SMTP command until its reply arrived",
+            std::string{"command=\""} + name + "\"");
+    }
+
+    return *h;
+}
+
+void smtp_client::enqueue(stage s, std::string &&data) {
+    this->outbox.emplace_back(s, std::move(data));
+}
+
+void smtp_client::flush() {
+    const bool waiting = !this->expected.empty();
+    const bool pipelining = this->has_capability("PIPELINING");
+    const uint64_t now = rmrf::metrics::now_ns();
+    std::string batch;
+
+    while (!this->outbox.empty()) {
+        // Without PIPELINING every command waits for the previous reply
+        if (!pipelining && !this->expected.empty()) {
+            break;
+        }
+
+        auto &[s, data] = this->outbox.front();
+        batch += data;
+        this->expected.emplace_back(s, now);
+        this->outbox.pop_front();
+
+        if (!pipelining) {
+            break;
+        }
+    }
+
+    if (!batch.empty()) {
+        this->conn->write_data(batch);
+    }
+
+    if (!waiting) {
+        this->arm_timer();
+    }
+}
+
+void smtp_client::arm_timer() {
+    this->reply_timer.stop();
+
+    if (this->broken || this->expected.empty()) {
+        return;
+    }
+
+    this->reply_timer.start(this->timeout_of(this->expected.front().first), 0);
+}
+
+::ev::tstamp smtp_client::timeout_of(stage s) const {
+    switch (s) {
+    case stage::greeting:
+        return this->timeouts.greeting;
+    case stage::data:
+        return this->timeouts.data;
+    case stage::data_end:
+    case stage::bdat:
+        return this->timeouts.data_end;
+    case stage::ehlo:
+    case stage::helo:
+    case stage::rset:
+    case stage::mail:
+    case stage::rcpt:
+    case stage::quit:
+        return this->timeouts.command;
+    default:
+        return this->timeouts.command;
+    }
+}
+
+void smtp_client::cb_timeout(::ev::timer &w, int events) {
+    (void)w;
+    (void)events;
+
+    static auto &histogram = rmrf::ev::callback_histogram("smtp.client_timeout");
+    rmrf::ev::callback_probe probe{histogram};
+
+    this->abort(smtp_reply{421, "Timeout waiting for the server"});
+}
+
+std::string dot_stuff(std::string_view message) {
+    std::string out;
+    out.reserve(message.size() + message.size() / 64 + 5);
+
+    size_t start = 0;
+
+    while (start < message.size()) {
+        size_t end = message.find('\n', start);
+        end = end == std::string_view::npos ? message.size() : end + 1;
+
+        if (message[start] == '.') {
+            out += '.';
+        }
+
+        out.append(message.substr(start, end - start));
+        start = end;
+    }
+
+    if (!out.empty() && out.back() != '\n') {
+        out += "\r\n";
+    }
+
+    out += ".\r\n";
+    return out;
+}
+
+}
@@ -0,0 +1,214 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <ev++.h>
+
+#include "net/connection_client.hpp"
+#include "service/metrics.hpp"
+
+namespace rmrf::smtp {
+
+/**
+ * A complete, possibly multi-line, server reply.
+ */
+struct smtp_reply {
+    /** The reply code or 0 if the reply was malformed */
+    uint16_t code;
+    /** The text of all lines, joined by newlines */
+    std::string text;
+
+    bool positive() const;
+    bool transient() const;
+};
+
+/**
+ * Splits the stream of server data into replies.
+ */
+class smtp_reply_parser {
+public:
+    typedef std::function<void(const smtp_reply &)> reply_cb_t;
+
+private:
+    reply_cb_t reply_cb;
+    std::string buffer;
+    smtp_reply current;
+
+public:
+    explicit smtp_reply_parser(reply_cb_t reply_cb_);
+
+    void feed(const std::string &data);
+};
+
+struct envelope {
+    std::string sender;
+    std::vector<std::string> recipients;
+};
+
+/**
+ * Seconds to wait for the replies of the server.
+ */
+struct smtp_timeouts {
+    /** Connecting and the greeting */
+    ::ev::tstamp greeting;
+    /** EHLO, HELO, RSET, MAIL, RCPT and QUIT */
+    ::ev::tstamp command;
+    /** The 354 reply to DATA */
+    ::ev::tstamp data;
+    /** Sending the message and the final reply to it, also for BDAT */
+    ::ev::tstamp data_end;
+};
+
+/**
+ * The timeouts recommended by RFC 5321, section 4.5.3.2.
+ */
+constexpr smtp_timeouts rfc5321_timeouts{300, 300, 120, 600};
+
+/**
+ * The replies collected for a single mail transaction.
+ */
+struct delivery_result {
+    smtp_reply mail;
+    std::vector<smtp_reply> recipients;
+    smtp_reply data;
+
+    /** True if the message was accepted for at least one recipient */
+    bool delivered() const;
+};
+
+/**
+ * An asynchronous SMTP/ESMTP client engine for a single session.
+ *
+ * With PIPELINING the envelope of a message is written as one batch, so a
+ * transaction costs a single round trip for MAIL, RCPT and the message body
+ * when the server also offers CHUNKING (BDAT) and two round trips otherwise.
+ * Once a transaction is complete the session can be reused for the next
+ * message; an RSET is pipelined in front of it.
+ *
+ * Every reply has to arrive within the timeout of its command, the greeting
+ * within the greeting timeout from start() on. Otherwise the session fails
+ * as if the connection was lost.
+ */
+class smtp_client : public std::enable_shared_from_this<smtp_client> {
+public:
+    typedef std::shared_ptr<smtp_client> ptr_type;
+
+    typedef std::function<void(bool, const smtp_reply &)> ready_cb_t;
+    typedef std::function<void(const delivery_result &)> delivery_cb_t;
+
+private:
+    enum class stage : uint8_t {
+        greeting,
+        ehlo,
+        helo,
+        rset,
+        mail,
+        rcpt,
+        data,
+        data_end,
+        bdat,
+        quit
+    };
+
+    struct transaction {
+        envelope env;
+        std::shared_ptr<const std::string> message;
+        delivery_cb_t cb;
+        delivery_result result;
+        size_t accepted;
+    };
+
+    std::shared_ptr<rmrf::net::connection_client> conn;
+    smtp_reply_parser parser;
+    const smtp_timeouts timeouts;
+    ::ev::timer reply_timer;
+
+    std::string helo_name;
+    std::vector<std::string> capabilities;
+    uint64_t max_size;
+
+    /** The commands awaiting a reply and when they were sent */
+    std::deque<std::pair<stage, uint64_t>> expected;
+    std::deque<std::pair<stage, std::string>> outbox;
+    std::unique_ptr<transaction> current;
+    ready_cb_t ready_cb;
+    bool ready;
+    bool needs_reset;
+    bool broken;
+
+public:
+    explicit smtp_client(std::shared_ptr<rmrf::net::connection_client> conn_,
+        const smtp_timeouts &timeouts_ = rfc5321_timeouts);
+    ~smtp_client();
+
+    smtp_client(const smtp_client &) = delete;
+    smtp_client &operator=(const smtp_client &) = delete;
+
+    /**
+     * Wait for the greeting and introduce ourselves with EHLO, falling back
+     * to HELO for servers without ESMTP support.
+     *
+     * @param helo_name_ The name of this host
+     * @param cb The callback to invoke once the session is ready or failed
+     */
+    void start(std::string_view helo_name_, ready_cb_t cb);
+
+    /**
+     * Send a message. Only one transaction may be in progress at a time.
+     *
+     * @param env The sender and recipients
+     * @param message The message with CRLF line endings, not dot-stuffed
+     * @param cb The callback to invoke with the replies of the transaction
+     */
+    void send(const envelope &env, std::shared_ptr<const std::string> message, delivery_cb_t cb);
+
+    /**
+     * End the session. The server closes the connection afterwards.
+     */
+    void quit();
+
+    /**
+     * Use this method in order to fail the session once the connection is
+     * gone. A pending transaction is completed with a transient error.
+     */
+    void connection_lost();
+
+    /**
+     * Give up on the session, e.g. because the owner waited too long for
+     * it. A pending transaction is completed with the given reply.
+     */
+    void abort(const smtp_reply &reply);
+
+    bool is_ready() const;
+    bool is_busy() const;
+    bool has_capability(std::string_view name) const;
+
+private:
+    void conn_data_in_cb(const std::string &data);
+    void handle_reply(const smtp_reply &reply);
+    void handle_ehlo(const smtp_reply &reply);
+    void handle_data(const smtp_reply &reply);
+    void finish_transaction(const smtp_reply &data_reply);
+    void fail(const smtp_reply &reply);
+    void enqueue(stage s, std::string &&data);
+    void flush();
+    void arm_timer();
+    ::ev::tstamp timeout_of(stage s) const;
+    void cb_timeout(::ev::timer &w, int events);
+
+    static rmrf::metrics::histogram &command_histogram(stage s);
+};
+
+/**
+ * Escape lines starting with a dot and terminate the message for DATA.
+ */
+std::string dot_stuff(std::string_view message);
+
+}
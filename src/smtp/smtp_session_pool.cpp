@@ -0,0 +1,338 @@
+#include "smtp/smtp_session_pool.hpp"
+
+#include <algorithm>
+
+#include "lib/ev/loop_monitor.hpp"
+#include "macros.hpp"
+#include "net/netio_exception.hpp"
+
+namespace rmrf::smtp {
+
+smtp_session_pool::smtp_session_pool(const session_limits &limits_, std::string_view helo_name_) :
+    limits{limits_}, helo_name{helo_name_},
+    destinations{}, closing{}, idle_timer{}
+{
+    this->idle_timer.set<smtp_session_pool, &smtp_session_pool::cb_idle>(this);
+}
+
+smtp_session_pool::~smtp_session_pool() {
+    this->idle_timer.stop();
+}
+
+std::string smtp_session_pool::key_of(const rmrf::net::socketaddr &address) {
+    return address.str() + "/" + std::to_string(address.port());
+}
+
+void smtp_session_pool::deliver(const rmrf::net::socketaddr &mx, const envelope &env,
+    std::shared_ptr<const std::string> message, smtp_client::delivery_cb_t cb)
+{
+    destination &dest = this->destinations.try_emplace(key_of(mx), destination{mx, {}, {}}).first->second;
+    dest.waiting.push_back(queued_message{env, std::move(message), std::move(cb)});
+    this->schedule(dest);
+}
+
+void smtp_session_pool::close_idle() {
+    for (auto &[key, dest] : this->destinations) {
+        MARK_UNUSED(key);
+
+        std::vector<const session *> idle;
+
+        for (const auto &s : dest.sessions) {
+            if (s->client->is_ready() && !s->busy) {
+                idle.push_back(s.get());
+            }
+        }
+
+        for (const session *s : idle) {
+            this->retire(dest, s);
+        }
+    }
+}
+
+size_t smtp_session_pool::get_session_count() const {
+    size_t count = 0;
+
+    for (const auto &[key, dest] : this->destinations) {
+        MARK_UNUSED(key);
+        count += dest.sessions.size();
+    }
+
+    return count;
+}
+
+size_t smtp_session_pool::get_waiting_count() const {
+    size_t count = 0;
+
+    for (const auto &[key, dest] : this->destinations) {
+        MARK_UNUSED(key);
+        count += dest.waiting.size();
+    }
+
+    return count;
+}
+
+void smtp_session_pool::schedule(destination &dest) {
+    size_t connecting = 0;
+
+    for (size_t i = 0; i < dest.sessions.size() && !dest.waiting.empty(); i++) {
+        session &s = *dest.sessions[i];
+
+        if (!s.client->is_ready()) {
+            connecting++;
+        } else if (!s.busy) {
+            queued_message msg = std::move(dest.waiting.front());
+            dest.waiting.pop_front();
+            this->run(s, std::move(msg));
+        }
+    }
+
+    // Only open as many sessions as there are messages nobody takes care of yet
+    while (dest.waiting.size() > connecting && dest.sessions.size() < this->limits.max_sessions_per_destination) {
+        const size_t before = dest.sessions.size();
+        this->open_session(dest);
+
+        if (dest.sessions.size() == before) {
+            break;
+        }
+
+        connecting++;
+    }
+}
+
+void smtp_session_pool::open_session(destination &dest) {
+    std::shared_ptr<rmrf::net::tcp_client> conn;
+
+    try {
+        conn = std::make_shared<rmrf::net::tcp_client>(dest.address);
+    } catch (const rmrf::net::netio_exception &e) {
+        if (dest.sessions.empty()) {
+            this->fail_waiting(dest, smtp_reply{421, e.what()});
+        }
+
+        return;
+    }
+
+    auto s = std::make_shared<session>(session{conn, std::make_shared<smtp_client>(conn, this->limits.timeouts),
+        key_of(dest.address), 0, ::ev::now(::ev::get_default_loop()), false});
+    const session *raw = s.get();
+
+    // The connection may outlive a session the pool already dropped
+    conn->set_closed_callback([this, weak = std::weak_ptr<session>{s}]() {
+        if (std::shared_ptr<session> alive = weak.lock()) {
+            this->session_closed(alive.get());
+        }
+    });
+
+    dest.sessions.push_back(s);
+
+    s->client->start(this->helo_name, [this, raw](bool ok, const smtp_reply &reply) {
+        this->session_ready(raw, ok, reply);
+    });
+
+    if (!this->idle_timer.is_active()) {
+        this->idle_timer.start(1.0, 1.0);
+    }
+}
+
+void smtp_session_pool::run(session &s, queued_message &&msg) {
+    const session *raw = &s;
+    s.busy = true;
+    s.since = ::ev::now(::ev::get_default_loop());
+
+    s.client->send(msg.env, std::move(msg.message), [this, raw, cb = std::move(msg.cb)](const delivery_result &result) {
+        this->session_done(raw, result, cb);
+    });
+}
+
+void smtp_session_pool::fail_waiting(destination &dest, const smtp_reply &reply) {
+    // The callbacks may queue new messages to the same destination
+    std::deque<queued_message> failed;
+    failed.swap(dest.waiting);
+
+    for (const queued_message &msg : failed) {
+        msg.cb(delivery_result{reply, std::vector<smtp_reply>(msg.env.recipients.size(), reply), reply});
+    }
+}
+
+void smtp_session_pool::retire(destination &dest, const session *s) {
+    auto it = std::find_if(dest.sessions.begin(), dest.sessions.end(), [s](const auto &p) {
+        return p.get() == s;
+    });
+
+    if (it == dest.sessions.end()) {
+        return;
+    }
+
+    std::shared_ptr<session> retired = std::move(*it);
+    dest.sessions.erase(it);
+
+    // Keep the session until the server has seen the QUIT and hung up
+    retired->client->quit();
+    retired->since = ::ev::now(::ev::get_default_loop());
+    this->closing.push_back(std::move(retired));
+
+    if (!this->idle_timer.is_active()) {
+        this->idle_timer.start(1.0, 1.0);
+    }
+}
+
+std::shared_ptr<smtp_session_pool::session> smtp_session_pool::find(const session *s) const {
+    auto dest = this->destinations.find(s->key);
+
+    if (dest == this->destinations.end()) {
+        return nullptr;
+    }
+
+    for (const auto &p : dest->second.sessions) {
+        if (p.get() == s) {
+            return p;
+        }
+    }
+
+    return nullptr;
+}
+
+void smtp_session_pool::session_ready(const session *s, bool ok, const smtp_reply &reply) {
+    std::shared_ptr<session> self = this->find(s);
+
+    if (!self) {
+        return;
+    }
+
+    destination &dest = this->destinations.at(self->key);
+
+    if (ok) {
+        self->since = ::ev::now(::ev::get_default_loop());
+        this->schedule(dest);
+        return;
+    }
+
+    dest.sessions.erase(std::find(dest.sessions.begin(), dest.sessions.end(), self));
+
+    // Without a working session the destination is considered unreachable
+    const bool reachable = std::any_of(dest.sessions.begin(), dest.sessions.end(), [](const auto &p) {
+        return p->client->is_ready();
+    });
+
+    if (!reachable) {
+        this->fail_waiting(dest, reply);
+    }
+}
+
+void smtp_session_pool::session_done(const session *s, const delivery_result &result, const smtp_client::delivery_cb_t &cb) {
+    std::shared_ptr<session> self = this->find(s);
+
+    if (self) {
+        self->busy = false;
+        self->sent++;
+        self->since = ::ev::now(::ev::get_default_loop());
+    }
+
+    cb(result);
+
+    if (!self || !self->client->is_ready()) {
+        return;
+    }
+
+    destination &dest = this->destinations.at(self->key);
+
+    if (self->sent >= this->limits.max_messages_per_session) {
+        this->retire(dest, s);
+    }
+
+    this->schedule(dest);
+
+    if (!this->idle_timer.is_active()) {
+        this->idle_timer.start(1.0, 1.0);
+    }
+}
+
+void smtp_session_pool::session_closed(const session *s) {
+    std::shared_ptr<session> self = this->find(s);
+
+    auto closed = std::find_if(this->closing.begin(), this->closing.end(), [s](const auto &p) {
+        return p.get() == s;
+    });
+
+    if (closed != this->closing.end()) {
+        self = std::move(*closed);
+        this->closing.erase(closed);
+        return;
+    }
+
+    if (!self) {
+        return;
+    }
+
+    // Fails a transaction in progress; the callbacks still find the session
+    self->client->connection_lost();
+
+    destination &dest = this->destinations.at(self->key);
+    auto it = std::find(dest.sessions.begin(), dest.sessions.end(), self);
+
+    if (it != dest.sessions.end()) {
+        dest.sessions.erase(it);
+    }
+
+    if (!dest.waiting.empty()) {
+        this->schedule(dest);
+    }
+}
+
+void smtp_session_pool::cb_idle(::ev::timer &w, int events) {
+    MARK_UNUSED(events);
+
+    static auto &histogram = rmrf::ev::callback_histogram("smtp.pool_idle");
+    rmrf::ev::callback_probe probe{histogram};
+
+    const ::ev::tstamp now = ::ev::now(::ev::get_default_loop());
+
+    // Sessions the server did not hang up on after QUIT are dropped as well
+    this->closing.erase(std::remove_if(this->closing.begin(), this->closing.end(), [now, this](const auto &p) {
+        return p->conn->is_closed() || now - p->since > this->limits.idle_timeout;
+    }), this->closing.end());
+
+    // Aborting fails the session, which takes it out of the destination
+    std::vector<std::shared_ptr<session>> stuck;
+
+    for (const auto &[key, dest] : this->destinations) {
+        MARK_UNUSED(key);
+
+        for (const auto &s : dest.sessions) {
+            if ((!s->client->is_ready() && now - s->since > this->limits.connect_timeout) ||
+                (s->busy && now - s->since > this->limits.transaction_timeout)) {
+                stuck.push_back(s);
+            }
+        }
+    }
+
+    for (const auto &s : stuck) {
+        s->client->abort(smtp_reply{421, s->busy ? "Transaction timed out" : "Connection timed out"});
+    }
+
+    for (auto dest = this->destinations.begin(); dest != this->destinations.end();) {
+        std::vector<const session *> expired;
+
+        for (const auto &s : dest->second.sessions) {
+            if (s->client->is_ready() && !s->busy && now - s->since > this->limits.idle_timeout) {
+                expired.push_back(s.get());
+            }
+        }
+
+        for (const session *s : expired) {
+            this->retire(dest->second, s);
+        }
+
+        if (dest->second.sessions.empty() && dest->second.waiting.empty()) {
+            dest = this->destinations.erase(dest);
+        } else {
+            ++dest;
+        }
+    }
+
+    if (this->destinations.empty() && this->closing.empty()) {
+        w.stop();
+    }
+}
+
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <cstddef>
+#include <deque>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <ev++.h>
+
+#include "net/socketaddress.hpp"
+#include "net/tcp_client.hpp"
+#include "smtp/smtp_client.hpp"
+
+namespace rmrf::smtp {
+
+struct session_limits {
+    /** Sessions kept open to a single destination */
+    size_t max_sessions_per_destination;
+    /** Messages sent over one session before it gets replaced */
+    size_t max_messages_per_session;
+    /** Seconds an unused session is kept open for the next message */
+    ::ev::tstamp idle_timeout;
+    /** Seconds a session may take to connect and introduce itself */
+    ::ev::tstamp connect_timeout;
+    /** Seconds a session may take for a whole transaction */
+    ::ev::tstamp transaction_timeout;
+    /** How long to wait for each reply of the server */
+    smtp_timeouts timeouts;
+};
+
+/**
+ * This class delivers messages over a cache of established SMTP sessions.
+ *
+ * Sessions are kept per destination (the address of an MX) and reused for
+ * every message queued to it, so bulk delivery to one provider needs only
+ * a handful of long-lived connections. Messages wait in a per destination
+ * queue while all sessions are busy and the session limit is reached.
+ *
+ * Besides the reply timeouts of the clients, sessions still connecting or
+ * busy beyond their limits are aborted, so a server that stalls cannot keep
+ * its messages from being deferred.
+ */
+class smtp_session_pool {
+public:
+    typedef std::shared_ptr<smtp_session_pool> ptr_type;
+
+private:
+    struct session {
+        std::shared_ptr<rmrf::net::tcp_client> conn;
+        smtp_client::ptr_type client;
+        std::string key;
+        size_t sent;
+        /** When the session started connecting, its last transaction or idling */
+        ::ev::tstamp since;
+        bool busy;
+    };
+
+    struct queued_message {
+        envelope env;
+        std::shared_ptr<const std::string> message;
+        smtp_client::delivery_cb_t cb;
+    };
+
+    struct destination {
+        rmrf::net::socketaddr address;
+        std::deque<queued_message> waiting;
+        std::vector<std::shared_ptr<session>> sessions;
+    };
+
+    const session_limits limits;
+    const std::string helo_name;
+
+    std::map<std::string, destination> destinations;
+    std::vector<std::shared_ptr<session>> closing;
+    ::ev::timer idle_timer;
+
+public:
+    smtp_session_pool(const session_limits &limits_, std::string_view helo_name_);
+    ~smtp_session_pool();
+
+    smtp_session_pool(const smtp_session_pool &) = delete;
+    smtp_session_pool &operator=(const smtp_session_pool &) = delete;
+
+    /**
+     * Queue a message for delivery to the given MX.
+     *
+     * @param mx The address and port of the mail exchanger
+     * @param env The sender and recipients
+     * @param message The message with CRLF line endings
+     * @param cb The callback to invoke with the outcome of the transaction
+     */
+    void deliver(const rmrf::net::socketaddr &mx, const envelope &env,
+        std::shared_ptr<const std::string> message, smtp_client::delivery_cb_t cb);
+
+    /**
+     * Send QUIT on all sessions that are not in use.
+     */
+    void close_idle();
+
+    size_t get_session_count() const;
+    size_t get_waiting_count() const;
+
+private:
+    static std::string key_of(const rmrf::net::socketaddr &address);
+
+    void schedule(destination &dest);
+    void open_session(destination &dest);
+    void run(session &s, queued_message &&msg);
+    void fail_waiting(destination &dest, const smtp_reply &reply);
+    void retire(destination &dest, const session *s);
+    std::shared_ptr<session> find(const session *s) const;
+
+    void session_ready(const session *s, bool ok, const smtp_reply &reply);
+    void session_done(const session *s, const delivery_result &result, const smtp_client::delivery_cb_t &cb);
+    void session_closed(const session *s);
+
+    void cb_idle(::ev::timer &w, int events);
+};
+
+}
@@ -27,6 +27,12 @@ namespace rmrf::test {
 		}
 	}
 
+	void loopback_connection_client::close() {
+		if(this->closed_cb != nullptr) {
+			this->closed_cb();
+		}
+	}
+
 	void loopback_connection_client::send_data_to_incomming_data_cb(const std::string& data) {
 		if(this->in_data_cb != nullptr) {
 			this->in_data_cb(data);
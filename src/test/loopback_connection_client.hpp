@@ -38,6 +38,12 @@ public:
 	 */
 	virtual void write_data(const std::string& data);
 
+	/**
+	 * This method only notifies the closed callback, as if the module under
+	 * test hung up.
+	 */
+	virtual void close();
+
 	/**
 	 * This method sends data to the connections incoming data callback.
 	 * Use it to mimic a remote client sending data.
@@ -0,0 +1,131 @@
+#include "ui/background_task.hpp"
+
+#include <algorithm>
+
+namespace rmrf::ui {
+
+background_task::background_task(const std::string &operation_, const job_type &job_) :
+    operation{operation_},
+    job{job_},
+    total_work{0},
+    current_work{0},
+    cancel_requested{false},
+    state{task_state::pending},
+    description_seq{0},
+    description{}
+{
+    for (auto &c : this->description) {
+        c.store('\0', std::memory_order_relaxed);
+    }
+}
+
+background_task::~background_task() {
+    // NOP
+}
+
+int background_task::get_total_work() const {
+    return this->total_work.load(std::memory_order_relaxed);
+}
+
+int background_task::get_current_work() const {
+    return this->current_work.load(std::memory_order_relaxed);
+}
+
+std::shared_ptr<std::string> background_task::get_operation_description() const {
+    return std::make_shared<std::string>(this->operation);
+}
+
+std::shared_ptr<std::string> background_task::get_current_job_description() const {
+    auto result = std::make_shared<std::string>();
+    result->reserve(description_size);
+
+    for (;;) {
+        const uint32_t before = this->description_seq.load(std::memory_order_acquire);
+
+        if (before & 1) {
+            continue;
+        }
+
+        result->clear();
+
+        for (const auto &c : this->description) {
+            const char value = c.load(std::memory_order_relaxed);
+
+            if (!value) {
+                break;
+            }
+
+            result->push_back(value);
+        }
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+
+        if (this->description_seq.load(std::memory_order_relaxed) == before) {
+            return result;
+        }
+    }
+}
+
+bool background_task::is_done() const {
+    return this->get_state() > task_state::running;
+}
+
+task_state background_task::get_state() const {
+    return this->state.load(std::memory_order_acquire);
+}
+
+void background_task::cancel() {
+    this->cancel_requested.store(true, std::memory_order_release);
+}
+
+bool background_task::is_cancelled() const {
+    return this->cancel_requested.load(std::memory_order_acquire);
+}
+
+void background_task::set_total_work(int total) {
+    this->total_work.store(total, std::memory_order_relaxed);
+}
+
+void background_task::set_current_work(int current) {
+    this->current_work.store(current, std::memory_order_relaxed);
+}
+
+void background_task::advance(int steps) {
+    this->current_work.fetch_add(steps, std::memory_order_relaxed);
+}
+
+void background_task::set_job_description(const std::string &text) {
+    // Only the worker running the job writes, so a plain increment suffices
+    const uint32_t seq = this->description_seq.load(std::memory_order_relaxed);
+    this->description_seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    const size_t length = std::min(text.size(), description_size - 1);
+
+    for (size_t i = 0; i < description_size; i++) {
+        this->description[i].store(i < length ? text[i] : '\0', std::memory_order_relaxed);
+    }
+
+    this->description_seq.store(seq + 2, std::memory_order_release);
+}
+
+void background_task::execute() {
+    task_state expected = task_state::pending;
+
+    if (this->is_cancelled() || !this->state.compare_exchange_strong(expected, task_state::running)) {
+        this->state.store(task_state::cancelled, std::memory_order_release);
+        return;
+    }
+
+    try {
+        this->job(*this);
+        this->state.store(this->is_cancelled() ? task_state::cancelled : task_state::finished, std::memory_order_release);
+    } catch (...) {
+        this->state.store(task_state::failed, std::memory_order_release);
+    }
+
+    // Release whatever the job captured
+    this->job = job_type{};
+}
+
+}
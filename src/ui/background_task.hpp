@@ -0,0 +1,89 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+
+#include "ui/progress_indicator.hpp"
+
+namespace rmrf::ui {
+
+enum class task_state : uint8_t {
+    pending,
+    running,
+    finished,
+    cancelled,
+    failed
+};
+
+/**
+ * A long running operation executed by a task_pool.
+ *
+ * All state observed by the UI is kept in atomics, so sampling the progress
+ * while the job runs on a worker thread never takes a lock. The job itself
+ * is expected to poll is_cancelled() between its steps.
+ */
+class background_task : public progress_indicator {
+public:
+    typedef background_task self_type;
+    typedef std::shared_ptr<self_type> ptr_type;
+    typedef std::function<void(background_task &)> job_type;
+
+private:
+    static constexpr size_t description_size = 120;
+
+    const std::string operation;
+    job_type job;
+
+    std::atomic<int> total_work;
+    std::atomic<int> current_work;
+    std::atomic<bool> cancel_requested;
+    std::atomic<task_state> state;
+
+    // Seqlock protected copy of the current step's description
+    std::atomic<uint32_t> description_seq;
+    std::array<std::atomic<char>, description_size> description;
+
+public:
+    /**
+     * @param operation_ A description of the whole operation
+     * @param job_ The work to do. It is run exactly once on a worker thread.
+     */
+    background_task(const std::string &operation_, const job_type &job_);
+    virtual ~background_task();
+
+    background_task(const background_task &) = delete;
+    background_task &operator=(const background_task &) = delete;
+
+    virtual int get_total_work() const override;
+    virtual int get_current_work() const override;
+    virtual std::shared_ptr<std::string> get_operation_description() const override;
+    virtual std::shared_ptr<std::string> get_current_job_description() const override;
+    virtual bool is_done() const override;
+
+    task_state get_state() const;
+
+    /**
+     * Ask the job to stop. Pending tasks are dropped without being run;
+     * running ones stop the next time they check is_cancelled().
+     */
+    void cancel();
+    bool is_cancelled() const;
+
+    /**
+     * These methods are meant to be called by the job while it runs.
+     */
+    void set_total_work(int total);
+    void set_current_work(int current);
+    void advance(int steps = 1);
+    void set_job_description(const std::string &text);
+
+private:
+    friend class task_pool;
+    void execute();
+};
+
+}
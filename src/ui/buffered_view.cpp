@@ -0,0 +1,42 @@
+#include "ui/buffered_view.hpp"
+
+#include <atomic>
+
+namespace rmrf::ui {
+
+buffered_view::buffered_view(const std::shared_ptr<view> &parent, nccpp::Window &window_) :
+    view{parent},
+    window(window_),
+    content{}
+{
+    // NOP
+}
+
+buffered_view::~buffered_view() {
+    // NOP
+}
+
+void buffered_view::publish(render_buffer::ptr_type buffer) {
+    std::atomic_store(&this->content, std::move(buffer));
+    this->damage();
+}
+
+render_buffer::ptr_type buffered_view::get_content() const {
+    return std::atomic_load(&this->content);
+}
+
+bool buffered_view::render() {
+    auto buffer = this->get_content();
+
+    this->window.erase();
+
+    if (buffer) {
+        buffer->replay(this->window);
+    }
+
+    this->window.outrefresh();
+
+    return true;
+}
+
+}
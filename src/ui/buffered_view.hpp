@@ -0,0 +1,45 @@
+#pragma once
+
+#include <memory>
+
+#include "lib/nccpp/Window.hpp"
+
+#include "ui/render_buffer.hpp"
+#include "ui/view.hpp"
+
+namespace rmrf::ui {
+
+/**
+ * This view shows the most recent render_buffer handed to it.
+ *
+ * Content can be published from any thread: the layout work happens on the
+ * publishing thread and the view only replays the finished commands when
+ * the display draws the next frame.
+ */
+class buffered_view : public view {
+private:
+    nccpp::Window &window;
+    render_buffer::ptr_type content;
+
+public:
+    /**
+     * @param parent The parent view. This may be null if there is none.
+     * @param window_ The window to draw into; it needs to outlive the view
+     */
+    buffered_view(const std::shared_ptr<view> &parent, nccpp::Window &window_);
+    virtual ~buffered_view();
+
+    buffered_view(const buffered_view &) = delete;
+    buffered_view &operator=(const buffered_view &) = delete;
+
+    /**
+     * Replace the content of the view. This may be called from any thread.
+     */
+    void publish(render_buffer::ptr_type buffer);
+
+    render_buffer::ptr_type get_content() const;
+
+    bool render() override;
+};
+
+}
@@ -1,12 +1,14 @@
 #include "ui/display.hpp"
 
+#include <algorithm>
+
 #include "lib/ncurses/ncurses.hpp"
 
 #include "ui/view.hpp"
 
 namespace rmrf::ui {
 
-display::display() : m{} {
+display::display() : m{}, views{}, frame_requested{false} {
     initscr();
     raw();
     cbreak();
@@ -19,8 +21,89 @@ display::~display() {
 }
 
 void display::clear() {
-    this->sync([](const display::ptr_type &) {
-        ::clear();
+    this->sync([](const display::ptr_type &self) {
+        // Only blank our own idea of the screen; doupdate sends the difference
+        ::werase(stdscr);
+        ::wnoutrefresh(stdscr);
+
+        for (const auto &entry : self->views) {
+            if (auto v = entry.lock()) {
+                v->damage();
+            }
+        }
+    });
+
+    this->request_frame();
+}
+
+void display::add_view(const std::shared_ptr<view> &v) {
+    this->sync([&v](const display::ptr_type &self) {
+        self->views.push_back(v);
+        v->attach(self);
+    });
+}
+
+void display::remove_view(const std::shared_ptr<view> &v) {
+    this->sync([&v](const display::ptr_type &self) {
+        self->views.erase(std::remove_if(self->views.begin(), self->views.end(),
+            [&v](const std::weak_ptr<view> &entry) {
+                auto other = entry.lock();
+                return !other || other == v;
+            }), self->views.end());
+        v->attach(nullptr);
+    });
+}
+
+void display::request_frame() {
+    this->frame_requested.store(true, std::memory_order_release);
+}
+
+bool display::frame_pending() const {
+    return this->frame_requested.load(std::memory_order_acquire);
+}
+
+bool display::sample_progress() {
+    return this->sync([](const display::ptr_type &self) {
+        bool active = false;
+
+        for (const auto &entry : self->views) {
+            if (auto v = entry.lock()) {
+                active |= v->sample_progress();
+            }
+        }
+
+        return active;
+    });
+}
+
+bool display::flush_frame() {
+    if (!this->frame_requested.exchange(false, std::memory_order_acq_rel)) {
+        return false;
+    }
+
+    return this->sync([](const display::ptr_type &self) {
+        bool drawn = false;
+
+        for (auto it = self->views.begin(); it != self->views.end();) {
+            auto v = it->lock();
+
+            if (!v) {
+                it = self->views.erase(it);
+                continue;
+            }
+
+            if (v->take_damage()) {
+                drawn |= v->render();
+            }
+
+            ++it;
+        }
+
+        // Also covers content staged directly via wnoutrefresh;
+        // doupdate sends nothing when the screen is unchanged
+        ::doupdate();
+
+        return drawn;
     });
 }
 
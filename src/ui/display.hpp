@@ -1,8 +1,10 @@
 #pragma once
 
+#include <atomic>
 #include <functional>
 #include <memory>
 #include <shared_mutex>
+#include <vector>
 
 #include "progress_indicator.hpp"
 #include "ui_context.hpp"
@@ -10,6 +12,8 @@
 
 namespace rmrf::ui {
 
+class view;
+
 /**
  * This class is designed to be the first level adapter to curses.
  * It implements some basic information handling and a registry for
@@ -25,6 +29,9 @@ private:
     typedef std::lock_guard<mutex_type> lock_type;
     mutable mutex_type m;
 
+    std::vector<std::weak_ptr<view>> views;
+    std::atomic<bool> frame_requested;
+
 public:
     display();
     virtual ~display();
@@ -38,8 +45,53 @@ public:
     }
 
 public:
+    /**
+     * Blank the screen and schedule all registered views to be redrawn.
+     */
     void clear();
 
+    /**
+     * Register a view to be drawn by the frame scheduler.
+     *
+     * @param v The view to register. The display only keeps a weak reference.
+     */
+    void add_view(const std::shared_ptr<view> &v);
+
+    /**
+     * Unregister a view from the frame scheduler.
+     *
+     * @param v The view to remove
+     */
+    void remove_view(const std::shared_ptr<view> &v);
+
+    /**
+     * Ask for a frame to be drawn on the next call to flush_frame.
+     * Any number of requests before that are coalesced into a single frame.
+     * This may be called from any thread.
+     */
+    void request_frame();
+
+    /**
+     * @return true if there are damaged views waiting to be drawn
+     */
+    bool frame_pending() const;
+
+    /**
+     * Let all registered views sample the progress of their running operations.
+     *
+     * @return true if any operation is still running
+     */
+    bool sample_progress();
+
+    /**
+     * Draw all damaged views into their windows and push the combined
+     * changes to the terminal with a single doupdate.
+     * This should be called once per event loop iteration.
+     *
+     * @return true if any view was drawn
+     */
+    bool flush_frame();
+
 };
 
 }
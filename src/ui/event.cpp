@@ -12,6 +12,10 @@ std::shared_ptr<ui_context> event::get_sender() const {
     return this->event_sender;
 }
 
+const char *event::get_event_description() const {
+    return "event";
+}
+
 bool event::has_been_handled() const {
     return this->handled;
 }
@@ -41,9 +41,9 @@ public:
      * This does not need to be translated due to its purpose beeing
      * debugging.
      *
-     * @return A pointer to the description string
+     * @return A static description string
      */
-    std::shared_ptr<std::string> get_event_description() const;
+    virtual const char *get_event_description() const;
     /**
      * Use this function in order to check if the event has been handled yet.
      *
@@ -0,0 +1,142 @@
+#include "ui/event_bus.hpp"
+
+#include <algorithm>
+
+namespace rmrf::ui {
+
+const char *describe_event(const event_data &data) {
+    switch (data.index()) {
+    case event_bus::type_index<events::key>:
+        return "key";
+    case event_bus::type_index<events::resize>:
+        return "resize";
+    case event_bus::type_index<events::new_mail>:
+        return "new mail";
+    case event_bus::type_index<events::flags_changed>:
+        return "flags changed";
+    case event_bus::type_index<events::new_child>:
+        return "new child";
+    default:
+        return "unknown";
+    }
+}
+
+event_bus::event_bus() :
+    table{}, added{}, next_id{1}, dispatching{false}, needs_compaction{false},
+    queue{}, current{}, arena{},
+    inbox_mutex{}, inbox{}
+{
+    // NOP
+}
+
+event_bus::~event_bus() {
+    // NOP
+}
+
+event_bus::subscription_id event_bus::add_subscription(size_t type, handler_type &&handler) {
+    const subscription_id id = this->next_id++;
+
+    // Growing the table while iterating it would move the running handler
+    if (this->dispatching) {
+        this->added.emplace_back(type, subscription{id, std::move(handler)});
+    } else {
+        this->table[type].push_back(subscription{id, std::move(handler)});
+    }
+
+    return id;
+}
+
+void event_bus::unsubscribe(subscription_id id) {
+    for (auto &subscriptions : this->table) {
+        for (auto &s : subscriptions) {
+            if (s.id == id) {
+                s.id = 0;
+                this->needs_compaction = true;
+                return;
+            }
+        }
+    }
+
+    this->added.erase(std::remove_if(this->added.begin(), this->added.end(),
+        [id](const std::pair<size_t, subscription> &entry) {
+            return entry.second.id == id;
+        }), this->added.end());
+}
+
+std::string_view event_bus::intern(std::string_view text) {
+    return this->arena.intern(text);
+}
+
+bool event_bus::has_pending() {
+    if (!this->queue.empty()) {
+        return true;
+    }
+
+    std::lock_guard<std::mutex> lock(this->inbox_mutex);
+    return !this->inbox.empty();
+}
+
+void event_bus::deliver(bus_event &ev) {
+    const auto &subscriptions = this->table[ev.data.index()];
+
+    for (size_t i = 0; i < subscriptions.size() && !ev.handled; i++) {
+        if (subscriptions[i].id) {
+            subscriptions[i].handler(ev);
+        }
+    }
+}
+
+size_t event_bus::dispatch() {
+    {
+        std::lock_guard<std::mutex> lock(this->inbox_mutex);
+        this->queue.insert(this->queue.end(), this->inbox.begin(), this->inbox.end());
+        this->inbox.clear();
+    }
+
+    size_t delivered = 0;
+    this->dispatching = true;
+
+    for (size_t round = 0; round < max_rounds && !this->queue.empty(); round++) {
+        // Swapping keeps the capacity of both buffers
+        this->current.swap(this->queue);
+
+        for (auto &ev : this->current) {
+            this->deliver(ev);
+            delivered++;
+        }
+
+        this->current.clear();
+    }
+
+    this->dispatching = false;
+
+    for (auto &entry : this->added) {
+        this->table[entry.first].push_back(std::move(entry.second));
+    }
+
+    this->added.clear();
+
+    if (this->needs_compaction) {
+        this->compact();
+    }
+
+    // Events left over for the next frame may still reference the pool
+    if (this->queue.empty()) {
+        this->arena.reset();
+    }
+
+    return delivered;
+}
+
+void event_bus::compact() {
+    for (auto &subscriptions : this->table) {
+        subscriptions.erase(std::remove_if(subscriptions.begin(), subscriptions.end(),
+            [](const subscription &s) {
+                return !s.id;
+            }), subscriptions.end());
+    }
+
+    this->needs_compaction = false;
+}
+
+}
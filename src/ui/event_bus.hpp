@@ -0,0 +1,206 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "ui/frame_arena.hpp"
+#include "ui/ui_context.hpp"
+
+namespace rmrf::ui {
+
+class view;
+
+/**
+ * The events that can be sent through an event_bus.
+ *
+ * Text members point into the bus' frame_arena and stay valid until the
+ * frame they were published in has been dispatched.
+ */
+namespace events {
+
+struct key {
+    int code;
+};
+
+struct resize {
+    int lines;
+    int cols;
+};
+
+struct new_mail {
+    std::string_view mailbox;
+    uint32_t uid;
+};
+
+struct flags_changed {
+    std::string_view mailbox;
+    uint32_t uid;
+    uint32_t flags;
+};
+
+struct new_child {
+    view *child;
+};
+
+}
+
+typedef std::variant<
+    events::key,
+    events::resize,
+    events::new_mail,
+    events::flags_changed,
+    events::new_child
+> event_data;
+
+/**
+ * A single event travelling through the bus. The sender is not owned.
+ */
+struct bus_event {
+    const ui_context *sender;
+    event_data data;
+    bool handled;
+};
+
+/**
+ * Use this function in order to get a human readable description of an
+ * event's type for debugging. The result is a static string.
+ */
+const char *describe_event(const event_data &data);
+
+/**
+ * This class delivers events to the views interested in them.
+ *
+ * Events are stored by value in reused queues and subscribers are kept in a
+ * table indexed by event type, so publishing and dispatching an event does
+ * not allocate once the bus warmed up. Dispatch happens once per frame on
+ * the UI thread.
+ */
+class event_bus {
+public:
+    typedef uint32_t subscription_id;
+    typedef std::function<void(bus_event &)> handler_type;
+
+    static constexpr size_t event_types = std::variant_size_v<event_data>;
+
+    /**
+     * Events published while dispatching are delivered in the same frame,
+     * but only for this many rounds to break up event storms.
+     */
+    static constexpr size_t max_rounds = 8;
+
+private:
+    struct subscription {
+        subscription_id id;
+        handler_type handler;
+    };
+
+    std::array<std::vector<subscription>, event_types> table;
+    std::vector<std::pair<size_t, subscription>> added;
+    subscription_id next_id;
+    bool dispatching;
+    bool needs_compaction;
+
+    std::vector<bus_event> queue;
+    std::vector<bus_event> current;
+    frame_arena arena;
+
+    std::mutex inbox_mutex;
+    std::vector<bus_event> inbox;
+
+    template<typename E, typename... Ts>
+    static constexpr size_t index_of(const std::variant<Ts...> *) {
+        constexpr bool matches[] = {std::is_same_v<E, Ts>...};
+
+        for (size_t i = 0; i < sizeof...(Ts); i++) {
+            if (matches[i]) {
+                return i;
+            }
+        }
+
+        return sizeof...(Ts);
+    }
+
+public:
+    /**
+     * The slot of an event type in the subscription table.
+     */
+    template<typename E>
+    static constexpr size_t type_index = index_of<E>(static_cast<const event_data *>(nullptr));
+
+    event_bus();
+    ~event_bus();
+
+    event_bus(const event_bus &) = delete;
+    event_bus &operator=(const event_bus &) = delete;
+
+    /**
+     * Register a handler for one event type. A handler may mark the event as
+     * handled to keep it from later subscribers.
+     *
+     * @return An id to pass to unsubscribe
+     */
+    template<typename E>
+    subscription_id subscribe(std::function<void(const E &, bus_event &)> handler) {
+        static_assert(type_index<E> < event_types, "Not an event type of the bus");
+
+        return this->add_subscription(type_index<E>, [h = std::move(handler)](bus_event &ev) {
+            h(*std::get_if<E>(&ev.data), ev);
+        });
+    }
+
+    /**
+     * Remove a handler. This may be called from within a handler.
+     */
+    void unsubscribe(subscription_id id);
+
+    /**
+     * Queue an event for the next dispatch. UI thread only.
+     */
+    template<typename E>
+    void publish(const ui_context *sender, E &&payload) {
+        this->queue.push_back(bus_event{sender, event_data{std::forward<E>(payload)}, false});
+    }
+
+    /**
+     * Queue an event from any thread. Such events must not carry text
+     * obtained from intern(), as the arena is owned by the UI thread.
+     */
+    template<typename E>
+    void post(const ui_context *sender, E &&payload) {
+        std::lock_guard<std::mutex> lock(this->inbox_mutex);
+        this->inbox.push_back(bus_event{sender, event_data{std::forward<E>(payload)}, false});
+    }
+
+    /**
+     * Copy text into the current frame's pool so it can be referenced by an
+     * event. UI thread only.
+     */
+    std::string_view intern(std::string_view text);
+
+    /**
+     * @return true if there are events waiting to be dispatched
+     */
+    bool has_pending();
+
+    /**
+     * Deliver all queued events and recycle the frame's pool.
+     *
+     * @return The number of events delivered
+     */
+    size_t dispatch();
+
+private:
+    subscription_id add_subscription(size_t type, handler_type &&handler);
+    void deliver(bus_event &ev);
+    void compact();
+};
+
+}
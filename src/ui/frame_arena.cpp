@@ -0,0 +1,57 @@
+#include "ui/frame_arena.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+namespace rmrf::ui {
+
+frame_arena::frame_arena() : blocks{}, current{0}, offset{0} {
+    // NOP
+}
+
+frame_arena::~frame_arena() {
+    // NOP
+}
+
+void *frame_arena::allocate(size_t size, size_t alignment) {
+    while (this->current < this->blocks.size()) {
+        block &b = this->blocks[this->current];
+        const uintptr_t base = reinterpret_cast<uintptr_t>(b.data.get());
+        const uintptr_t aligned = (base + this->offset + alignment - 1) & ~(uintptr_t{alignment} - 1);
+        const size_t start = aligned - base;
+
+        if (start + size <= b.size) {
+            this->offset = start + size;
+            return b.data.get() + start;
+        }
+
+        this->current++;
+        this->offset = 0;
+    }
+
+    const size_t size_needed = std::max(block_size, size + alignment);
+    this->blocks.push_back(block{std::make_unique<char[]>(size_needed), size_needed});
+    this->current = this->blocks.size() - 1;
+    this->offset = 0;
+
+    return this->allocate(size, alignment);
+}
+
+std::string_view frame_arena::intern(std::string_view text) {
+    if (text.empty()) {
+        return std::string_view{};
+    }
+
+    char *copy = static_cast<char *>(this->allocate(text.size(), 1));
+    std::memcpy(copy, text.data(), text.size());
+
+    return std::string_view{copy, text.size()};
+}
+
+void frame_arena::reset() {
+    this->current = 0;
+    this->offset = 0;
+}
+
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+namespace rmrf::ui {
+
+/**
+ * A bump allocator for data that only lives until the end of the current
+ * frame, such as the text carried by events.
+ *
+ * reset() keeps the blocks already obtained, so once the arena has grown to
+ * the size a frame needs no further heap allocations take place.
+ */
+class frame_arena {
+private:
+    static constexpr size_t block_size = 4096;
+
+    struct block {
+        std::unique_ptr<char[]> data;
+        size_t size;
+    };
+
+    std::vector<block> blocks;
+    size_t current;
+    size_t offset;
+
+public:
+    frame_arena();
+    ~frame_arena();
+
+    frame_arena(const frame_arena &) = delete;
+    frame_arena &operator=(const frame_arena &) = delete;
+
+    /**
+     * Get uninitialised memory valid until the next reset.
+     *
+     * @param size The number of bytes needed
+     * @param alignment The alignment needed; a power of two
+     */
+    void *allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+
+    /**
+     * Copy a string into the arena.
+     *
+     * @return A view of the copy, valid until the next reset
+     */
+    std::string_view intern(std::string_view text);
+
+    /**
+     * Release everything allocated since the last reset.
+     */
+    void reset();
+};
+
+}
@@ -0,0 +1,118 @@
+#include "ui/hexdump_view.hpp"
+
+#include <algorithm>
+
+#include "lib/ncurses/ncurses.hpp"
+
+namespace rmrf::ui {
+
+hexdump_view::hexdump_view(const std::shared_ptr<view> &parent, nccpp::Subwindow &window_, utils::byte_source::ptr_type source_, size_t bytes_per_line_) :
+    view{parent},
+    window(window_),
+    source{source_},
+    bytes_per_line{std::max<size_t>(bytes_per_line_, 1)},
+    top_line{0},
+    visible_lines{0},
+    text{}
+{
+    this->resize();
+}
+
+hexdump_view::~hexdump_view() {
+    // NOP
+}
+
+off_t hexdump_view::get_top_offset() const {
+    return this->top_line.load(std::memory_order_relaxed) * static_cast<off_t>(this->bytes_per_line);
+}
+
+off_t hexdump_view::get_line_count() const {
+    const off_t bpl = static_cast<off_t>(this->bytes_per_line);
+    return (this->source->get_size() + bpl - 1) / bpl;
+}
+
+void hexdump_view::set_top_line(off_t line) {
+    const off_t max_top = std::max<off_t>(this->get_line_count() - this->visible_lines.load(std::memory_order_relaxed), 0);
+    line = std::clamp<off_t>(line, 0, max_top);
+
+    if (line != this->top_line.exchange(line, std::memory_order_relaxed)) {
+        this->damage();
+    }
+}
+
+void hexdump_view::scroll(ssize_t lines) {
+    this->set_top_line(this->top_line.load(std::memory_order_relaxed) + lines);
+}
+
+void hexdump_view::move_page(ssize_t pages) {
+    this->scroll(pages * std::max<off_t>(this->visible_lines.load(std::memory_order_relaxed), 1));
+}
+
+void hexdump_view::jump_to(off_t offset) {
+    this->set_top_line(offset / static_cast<off_t>(this->bytes_per_line));
+}
+
+void hexdump_view::data_arrived(off_t offset, size_t length) {
+    const off_t first = this->get_top_offset();
+    const off_t last = first + this->visible_lines.load(std::memory_order_relaxed) * static_cast<off_t>(this->bytes_per_line);
+
+    if (offset < last && offset + static_cast<off_t>(length) > first) {
+        this->damage();
+    }
+}
+
+void hexdump_view::resize() {
+    int lines = 0;
+    int cols = 0;
+    this->window.get_maxyx(lines, cols);
+
+    this->visible_lines.store(std::max(lines, 0), std::memory_order_relaxed);
+    this->set_top_line(this->top_line.load(std::memory_order_relaxed));
+    this->damage();
+}
+
+bool hexdump_view::render() {
+    const off_t lines = this->visible_lines.load(std::memory_order_relaxed);
+    const off_t start = this->get_top_offset();
+    const off_t size = this->source->get_size();
+    const off_t screen = lines * static_cast<off_t>(this->bytes_per_line);
+
+    this->window.erase();
+
+    if (lines > 0 && start < size) {
+        const off_t end = std::min(size, start + screen) - 1;
+
+        // Formats only the visible lines; missing pages get requested
+        utils::hexdump_to_buffer(
+            this->text,
+            this->bytes_per_line, 8, 1, 1,
+            start, end, 0,
+            true, false,
+            this->source->make_getspan()
+        );
+
+        // Fetch the next screen ahead of time
+        this->source->request(start + screen, static_cast<size_t>(screen));
+
+        WINDOW *handle = this->window.get_handle();
+        int y = 0;
+        size_t pos = 0;
+
+        while (pos < this->text.size() && y < lines) {
+            size_t eol = this->text.find('\n', pos);
+
+            if (std::string::npos == eol) {
+                eol = this->text.size();
+            }
+
+            ::mvwaddnstr(handle, y++, 0, this->text.data() + pos, static_cast<int>(eol - pos));
+            pos = eol + 1;
+        }
+    }
+
+    this->window.outrefresh();
+
+    return true;
+}
+
+}
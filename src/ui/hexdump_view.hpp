@@ -0,0 +1,80 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <sys/types.h>
+
+#include "lib/nccpp/Subwindow.hpp"
+
+#include "utils/byte_source.hpp"
+
+#include "ui/view.hpp"
+
+namespace rmrf::ui {
+
+/**
+ * This view shows a hexdump of a byte_source.
+ *
+ * Only the lines visible in the subwindow are formatted, so opening the raw
+ * view of a huge message costs the same as opening a small one. Bytes the
+ * source does not have yet are shown as unknown and get filled in when
+ * data_arrived() reports them.
+ */
+class hexdump_view : public view {
+private:
+    nccpp::Subwindow &window;
+    utils::byte_source::ptr_type source;
+    const size_t bytes_per_line;
+
+    std::atomic<off_t> top_line;
+    std::atomic<off_t> visible_lines;
+
+    std::string text;
+
+public:
+    /**
+     * @param parent The parent view. This may be null if there is none.
+     * @param window_ The subwindow to draw into; it needs to outlive the view
+     * @param source_ The bytes to display
+     * @param bytes_per_line_ The number of bytes shown per line
+     */
+    hexdump_view(const std::shared_ptr<view> &parent, nccpp::Subwindow &window_, utils::byte_source::ptr_type source_, size_t bytes_per_line_ = 16);
+    virtual ~hexdump_view();
+
+    hexdump_view(const hexdump_view &) = delete;
+    hexdump_view &operator=(const hexdump_view &) = delete;
+
+    /**
+     * @return The offset of the first byte shown
+     */
+    off_t get_top_offset() const;
+
+    void scroll(ssize_t lines);
+    void move_page(ssize_t pages);
+
+    /**
+     * Bring the line containing the given offset to the top.
+     */
+    void jump_to(off_t offset);
+
+    /**
+     * Notify the view that the source received new data.
+     * This may be called from any thread.
+     */
+    void data_arrived(off_t offset, size_t length);
+
+    /**
+     * Notify the view that the size of its window changed.
+     */
+    void resize();
+
+    bool render() override;
+
+private:
+    off_t get_line_count() const;
+    void set_top_line(off_t line);
+};
+
+}
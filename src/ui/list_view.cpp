@@ -0,0 +1,256 @@
+#include "ui/list_view.hpp"
+
+#include <algorithm>
+
+namespace rmrf::ui {
+
+list_view::list_view(const std::shared_ptr<view> &parent, nccpp::Window &window_, std::shared_ptr<list_source> source_) :
+    view{parent},
+    window(window_),
+    source{source_},
+    count{0}, top{0}, cursor{0},
+    height{0}, width{0},
+    rows{}, dirty{}, pending_scroll{0},
+    visible_range_cb{}
+{
+    this->count = this->source->get_row_count();
+    this->resize();
+}
+
+list_view::~list_view() {
+    // NOP
+}
+
+size_t list_view::get_cursor() const {
+    return this->cursor;
+}
+
+size_t list_view::get_top() const {
+    return this->top;
+}
+
+void list_view::mark_index(size_t index) {
+    if (index >= this->top && index - this->top < this->height) {
+        this->dirty[index - this->top] = true;
+        this->damage();
+    }
+}
+
+void list_view::mark_all() {
+    std::fill(this->dirty.begin(), this->dirty.end(), true);
+    this->pending_scroll = 0;
+    this->damage();
+}
+
+void list_view::set_top(size_t new_top) {
+    const size_t max_top = this->count > this->height ? this->count - this->height : 0;
+    new_top = std::min(new_top, max_top);
+
+    if (new_top == this->top) {
+        return;
+    }
+
+    const size_t distance = new_top > this->top ? new_top - this->top : this->top - new_top;
+
+    if (distance >= this->height) {
+        this->top = new_top;
+        this->mark_all();
+        this->notify_visible_range();
+        return;
+    }
+
+    // Keep the rows that stay visible and only fetch the exposed ones
+    if (new_top > this->top) {
+        std::rotate(this->rows.begin(), this->rows.begin() + static_cast<ssize_t>(distance), this->rows.end());
+        std::rotate(this->dirty.begin(), this->dirty.begin() + static_cast<ssize_t>(distance), this->dirty.end());
+        std::fill(this->dirty.end() - static_cast<ssize_t>(distance), this->dirty.end(), true);
+        this->pending_scroll += static_cast<int>(distance);
+    } else {
+        std::rotate(this->rows.rbegin(), this->rows.rbegin() + static_cast<ssize_t>(distance), this->rows.rend());
+        std::rotate(this->dirty.rbegin(), this->dirty.rbegin() + static_cast<ssize_t>(distance), this->dirty.rend());
+        std::fill(this->dirty.begin(), this->dirty.begin() + static_cast<ssize_t>(distance), true);
+        this->pending_scroll -= static_cast<int>(distance);
+    }
+
+    this->top = new_top;
+    this->damage();
+    this->notify_visible_range();
+}
+
+void list_view::set_cursor(size_t new_cursor) {
+    if (!this->count) {
+        this->cursor = 0;
+        return;
+    }
+
+    new_cursor = std::min(new_cursor, this->count - 1);
+
+    if (new_cursor == this->cursor) {
+        return;
+    }
+
+    this->mark_index(this->cursor);
+    this->cursor = new_cursor;
+
+    if (this->cursor < this->top) {
+        this->set_top(this->cursor);
+    } else if (this->cursor - this->top >= this->height) {
+        this->set_top(this->cursor - this->height + 1);
+    }
+
+    this->mark_index(this->cursor);
+}
+
+void list_view::move_cursor(ssize_t delta) {
+    if (delta < 0) {
+        const size_t amount = static_cast<size_t>(-delta);
+        this->set_cursor(amount > this->cursor ? 0 : this->cursor - amount);
+    } else {
+        this->set_cursor(this->cursor + static_cast<size_t>(delta));
+    }
+}
+
+void list_view::move_page(ssize_t pages) {
+    this->move_cursor(pages * static_cast<ssize_t>(std::max<size_t>(this->height, 1)));
+}
+
+void list_view::jump_to(size_t index) {
+    if (!this->count) {
+        return;
+    }
+
+    index = std::min(index, this->count - 1);
+
+    // Center the target when it is far off screen
+    if (index < this->top || index - this->top >= this->height) {
+        this->set_top(index > this->height / 2 ? index - this->height / 2 : 0);
+    }
+
+    this->set_cursor(index);
+}
+
+void list_view::scroll(ssize_t delta) {
+    if (delta < 0) {
+        const size_t amount = static_cast<size_t>(-delta);
+        this->set_top(amount > this->top ? 0 : this->top - amount);
+    } else {
+        this->set_top(this->top + static_cast<size_t>(delta));
+    }
+
+    // Drag the selection along if it left the screen
+    if (this->cursor < this->top) {
+        this->set_cursor(this->top);
+    } else if (this->height && this->cursor - this->top >= this->height) {
+        this->set_cursor(this->top + this->height - 1);
+    }
+}
+
+void list_view::rows_changed(size_t first, size_t last) {
+    const size_t from = std::max(first, this->top);
+    const size_t to = std::min(last + 1, this->top + this->height);
+
+    for (size_t index = from; index < to; index++) {
+        this->dirty[index - this->top] = true;
+    }
+
+    if (from < to) {
+        this->damage();
+    }
+}
+
+void list_view::invalidate() {
+    this->count = this->source->get_row_count();
+
+    const size_t max_top = this->count > this->height ? this->count - this->height : 0;
+    this->top = std::min(this->top, max_top);
+    this->cursor = this->count ? std::min(this->cursor, this->count - 1) : 0;
+
+    this->mark_all();
+    this->notify_visible_range();
+}
+
+void list_view::resize() {
+    int lines = 0;
+    int cols = 0;
+    this->window.get_maxyx(lines, cols);
+
+    this->height = lines > 0 ? static_cast<size_t>(lines) : 0;
+    this->width = cols > 0 ? static_cast<size_t>(cols) : 0;
+
+    this->rows.resize(this->height, list_row{{}, A_NORMAL});
+    this->dirty.assign(this->height, true);
+
+    this->invalidate();
+}
+
+void list_view::set_visible_range_callback(const visible_range_cb_t &cb) {
+    this->visible_range_cb = cb;
+    this->notify_visible_range();
+}
+
+void list_view::notify_visible_range() {
+    if (this->visible_range_cb) {
+        this->visible_range_cb(this->top, std::min(this->top + this->height, this->count));
+    }
+}
+
+bool list_view::render() {
+    bool drawn = false;
+
+    if (this->pending_scroll) {
+        // Only allow scrolling here: with scrollok set, writing the bottom
+        // right cell of a full width last row would scroll the window too
+        ::scrollok(this->window.get_handle(), TRUE);
+        this->window.scroll(this->pending_scroll);
+        ::scrollok(this->window.get_handle(), FALSE);
+        this->pending_scroll = 0;
+        drawn = true;
+    }
+
+    for (size_t y = 0; y < this->height; y++) {
+        if (!this->dirty[y]) {
+            continue;
+        }
+
+        this->dirty[y] = false;
+        drawn = true;
+
+        const size_t index = this->top + y;
+        this->window.move(static_cast<int>(y), 0);
+
+        if (index < this->count) {
+            list_row &row = this->rows[y];
+            this->source->get_row(index, row);
+
+            attr_t attributes = row.attributes;
+
+            if (index == this->cursor) {
+                attributes |= A_REVERSE;
+            }
+
+            this->window.attrset(static_cast<int>(attributes));
+
+            // Extend the selection highlight over the full line
+            if (index == this->cursor) {
+                this->window.hline(' ', static_cast<int>(this->width));
+            }
+
+            this->window.addnstr(row.text, std::min(row.text.size(), this->width));
+            this->window.attrset(A_NORMAL);
+
+            if (index == this->cursor) {
+                continue;
+            }
+        }
+
+        this->window.clrtoeol();
+    }
+
+    if (drawn) {
+        this->window.outrefresh();
+    }
+
+    return drawn;
+}
+
+}
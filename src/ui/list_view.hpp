@@ -0,0 +1,152 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "lib/nccpp/Window.hpp"
+#include "lib/ncurses/ncurses.hpp"
+
+#include "ui/view.hpp"
+
+namespace rmrf::ui {
+
+/**
+ * The content of a single row as displayed by a list_view.
+ */
+struct list_row {
+    std::string text;
+    attr_t attributes;
+};
+
+/**
+ * This interface provides random access to the rows shown in a list_view.
+ *
+ * Implementations are expected to answer get_row() from an index or cursor
+ * into the underlying data without touching any other rows.
+ */
+class list_source {
+public:
+    list_source() {};
+    virtual ~list_source() {};
+
+    /**
+     * @return The total number of rows available
+     */
+    virtual size_t get_row_count() const = 0;
+
+    /**
+     * Fill in the content of a row. The row passed in is reused between
+     * calls so implementations can avoid allocations.
+     *
+     * @param index The index of the row to fetch
+     * @param row The row to fill
+     */
+    virtual void get_row(size_t index, list_row &row) const = 0;
+};
+
+/**
+ * This view displays an arbitrarily long list of rows.
+ *
+ * Only the rows visible in the window are ever materialised, so memory and
+ * redraw cost depend on the window height only, not on the number of rows.
+ * Scrolling by less than a screen reuses the rows already fetched and lets
+ * the terminal scroll its contents instead of repainting them.
+ */
+class list_view : public view {
+public:
+    typedef std::function<void(size_t, size_t)> visible_range_cb_t;
+
+private:
+    nccpp::Window &window;
+    std::shared_ptr<list_source> source;
+
+    size_t count;
+    size_t top;
+    size_t cursor;
+    size_t height;
+    size_t width;
+
+    std::vector<list_row> rows;
+    std::vector<bool> dirty;
+    int pending_scroll;
+
+    visible_range_cb_t visible_range_cb;
+
+public:
+    /**
+     * @param parent The parent view. This may be null if there is none.
+     * @param window_ The window to draw into; it needs to outlive the view
+     * @param source_ The source of the rows to display
+     */
+    list_view(const std::shared_ptr<view> &parent, nccpp::Window &window_, std::shared_ptr<list_source> source_);
+    virtual ~list_view();
+
+    list_view(const list_view &) = delete;
+    list_view &operator=(const list_view &) = delete;
+
+    size_t get_cursor() const;
+    size_t get_top() const;
+
+    /**
+     * Move the selection by the given number of rows, scrolling as needed.
+     */
+    void move_cursor(ssize_t delta);
+
+    /**
+     * Move the selection by the given number of screens.
+     */
+    void move_page(ssize_t pages);
+
+    /**
+     * Select the given row and bring it into view.
+     */
+    void jump_to(size_t index);
+
+    /**
+     * Scroll the visible area without moving the selection unless it would
+     * leave the screen.
+     */
+    void scroll(ssize_t delta);
+
+    /**
+     * Notify the view that the content of some rows changed.
+     */
+    void rows_changed(size_t first, size_t last);
+
+    /**
+     * Notify the view that rows were added or removed.
+     */
+    void invalidate();
+
+    /**
+     * Notify the view that the size of its window changed.
+     */
+    void resize();
+
+    /**
+     * Get notified about the range of rows currently visible,
+     * e.g. to prefetch the data needed to open them.
+     */
+    void set_visible_range_callback(const visible_range_cb_t &cb);
+
+    /**
+     * Draw all rows that changed since the last call into the window.
+     * The display calls this as part of its frame; when used standalone
+     * call doupdate() afterwards to get the rows onto the terminal.
+     *
+     * @return true if anything was drawn
+     */
+    bool render() override;
+
+private:
+    void set_top(size_t new_top);
+    void set_cursor(size_t new_cursor);
+    void mark_index(size_t index);
+    void mark_all();
+    void notify_visible_range();
+};
+
+}
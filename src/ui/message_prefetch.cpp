@@ -0,0 +1,39 @@
+#include "ui/message_prefetch.hpp"
+
+#include <algorithm>
+#include <vector>
+
+namespace rmrf::ui {
+
+void prefetch_visible_messages(list_view &view, const std::shared_ptr<rmrf::cache::message_cache> &cache,
+    const row_key_cb_t &key_of, const rmrf::cache::message_cache::fetch_cb_t &fetch)
+{
+    view.set_visible_range_callback([cache, key_of, fetch](size_t first, size_t last) {
+        const size_t page = last - first;
+        std::vector<rmrf::cache::message_key> candidates;
+        candidates.reserve(3 * page);
+
+        // The visible rows go first, so they get fetched first
+        for (size_t index = first; index < last + page; index++) {
+            std::optional<rmrf::cache::message_key> key = key_of(index);
+
+            if (!key) {
+                break;
+            }
+
+            candidates.push_back(std::move(*key));
+        }
+
+        for (size_t index = first; index > first - std::min(first, page); index--) {
+            std::optional<rmrf::cache::message_key> key = key_of(index - 1);
+
+            if (key) {
+                candidates.push_back(std::move(*key));
+            }
+        }
+
+        cache->prefetch(candidates, fetch);
+    });
+}
+
+}
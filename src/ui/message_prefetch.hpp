@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <optional>
+
+#include "cache/message_cache.hpp"
+#include "ui/list_view.hpp"
+
+namespace rmrf::ui {
+
+/**
+ * Maps a row of a message list to the message shown in it. Rows past the
+ * end of the list map to nothing.
+ */
+typedef std::function<std::optional<rmrf::cache::message_key>(size_t)> row_key_cb_t;
+
+/**
+ * Keep the bodies of the messages shown in a list_view in the cache, so
+ * opening one needs no round trip to the server. The rows a screen above
+ * and below are requested as well, as scrolling goes there next.
+ *
+ * @param view The message list; this takes over its visible range callback
+ * @param cache The cache to prefetch into
+ * @param key_of The message shown in a row
+ * @param fetch Request a body from the server, e.g. by imap_client::fetch_body()
+ *              and then hand it to message_cache::put()
+ */
+void prefetch_visible_messages(list_view &view, const std::shared_ptr<rmrf::cache::message_cache> &cache,
+    const row_key_cb_t &key_of, const rmrf::cache::message_cache::fetch_cb_t &fetch);
+
+}
@@ -2,4 +2,8 @@
 
 namespace rmrf::ui {
 
+const char *new_child_event::get_event_description() const {
+    return "new child";
+}
+
 }
@@ -8,6 +8,8 @@
 namespace rmrf::ui {
 
 class new_child_event : public event {
+public:
+    virtual const char *get_event_description() const override;
 };
 
 }
@@ -0,0 +1,40 @@
+#include "ui/progress_indicator.hpp"
+
+namespace rmrf::ui {
+
+int progress_indicator::get_progress() const {
+    const long long total = this->get_total_work();
+    const long long current = this->get_current_work();
+
+    if (total <= 0) {
+        return 0;
+    }
+
+    if (current >= total) {
+        return 100;
+    }
+
+    return static_cast<int>(current * 100 / total);
+}
+
+int progress_indicator::get_total_work() const {
+    return 0;
+}
+
+int progress_indicator::get_current_work() const {
+    return 0;
+}
+
+std::shared_ptr<std::string> progress_indicator::get_operation_description() const {
+    return std::make_shared<std::string>();
+}
+
+std::shared_ptr<std::string> progress_indicator::get_current_job_description() const {
+    return std::make_shared<std::string>();
+}
+
+bool progress_indicator::is_done() const {
+    return false;
+}
+
+}
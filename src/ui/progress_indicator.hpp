@@ -37,6 +37,11 @@ public:
      * description of the current step.
      */
     virtual std::shared_ptr<std::string> get_current_job_description() const;
+    /**
+     * This method shall be used in order to check whether
+     * the operation is over and the indicator can be dropped.
+     */
+    virtual bool is_done() const;
 };
 
 }
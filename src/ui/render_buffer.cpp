@@ -0,0 +1,168 @@
+#include "ui/render_buffer.hpp"
+
+#include <algorithm>
+
+namespace rmrf::ui {
+
+render_buffer::render_buffer() : commands{}, text_pool{}, lines{0} {
+    // NOP
+}
+
+render_buffer::~render_buffer() {
+    // NOP
+}
+
+void render_buffer::move(int y, int x) {
+    this->commands.push_back(command{render_op::move, y, x, 0, 0, 0});
+    this->lines = std::max(this->lines, y + 1);
+}
+
+void render_buffer::attrset(attr_t attributes) {
+    this->commands.push_back(command{render_op::attr_set, 0, 0, static_cast<int>(attributes), 0, 0});
+}
+
+void render_buffer::add_text(std::string_view text) {
+    if (text.empty()) {
+        return;
+    }
+
+    // Consecutive text is merged into one addnstr on replay
+    if (!this->commands.empty() && render_op::text == this->commands.back().op &&
+        this->commands.back().offset + this->commands.back().length == this->text_pool.size()) {
+        this->commands.back().length += static_cast<uint32_t>(text.size());
+    } else {
+        this->commands.push_back(command{render_op::text, 0, 0, 0,
+            static_cast<uint32_t>(this->text_pool.size()), static_cast<uint32_t>(text.size())});
+    }
+
+    this->text_pool.append(text);
+}
+
+void render_buffer::hline(chtype ch, int n) {
+    this->commands.push_back(command{render_op::hline, 0, 0, static_cast<int>(ch), static_cast<uint32_t>(n), 0});
+}
+
+void render_buffer::clrtoeol() {
+    this->commands.push_back(command{render_op::clear_to_eol, 0, 0, 0, 0, 0});
+}
+
+void render_buffer::erase() {
+    this->commands.push_back(command{render_op::erase, 0, 0, 0, 0, 0});
+}
+
+int render_buffer::add_lines(int y, int x, std::string_view text, attr_t attributes) {
+    this->attrset(attributes);
+
+    while (!text.empty()) {
+        const size_t eol = text.find('\n');
+        const std::string_view line = text.substr(0, eol);
+
+        this->move(y++, x);
+        this->add_text(line);
+        this->clrtoeol();
+
+        if (std::string_view::npos == eol) {
+            break;
+        }
+
+        text.remove_prefix(eol + 1);
+    }
+
+    this->attrset(A_NORMAL);
+
+    return y;
+}
+
+int render_buffer::add_wrapped(int y, int x, int width, std::string_view text, attr_t attributes) {
+    if (width <= 0) {
+        return y;
+    }
+
+    const size_t limit = static_cast<size_t>(width);
+    this->attrset(attributes);
+
+    while (!text.empty()) {
+        const size_t eol = text.find('\n');
+        std::string_view paragraph = text.substr(0, eol);
+
+        do {
+            size_t cut = paragraph.size();
+
+            if (cut > limit) {
+                // Break at the last blank that fits, or hard split long words
+                const size_t blank = paragraph.rfind(' ', limit);
+                cut = (std::string_view::npos == blank || !blank) ? limit : blank;
+            }
+
+            this->move(y++, x);
+            this->add_text(paragraph.substr(0, cut));
+            this->clrtoeol();
+
+            paragraph.remove_prefix(cut);
+
+            while (!paragraph.empty() && ' ' == paragraph.front()) {
+                paragraph.remove_prefix(1);
+            }
+        } while (!paragraph.empty());
+
+        if (std::string_view::npos == eol) {
+            break;
+        }
+
+        text.remove_prefix(eol + 1);
+    }
+
+    this->attrset(A_NORMAL);
+
+    return y;
+}
+
+int render_buffer::get_lines() const {
+    return this->lines;
+}
+
+bool render_buffer::empty() const {
+    return this->commands.empty();
+}
+
+void render_buffer::clear() {
+    this->commands.clear();
+    this->text_pool.clear();
+    this->lines = 0;
+}
+
+void render_buffer::replay(nccpp::Window &window) const {
+    for (const auto &cmd : this->commands) {
+        switch (cmd.op) {
+        case render_op::move:
+            window.move(cmd.y, cmd.x);
+            break;
+
+        case render_op::attr_set:
+            window.attrset(cmd.value);
+            break;
+
+        case render_op::text:
+            // Straight from the pool; no temporary string on the UI thread
+            ::waddnstr(window.get_handle(), this->text_pool.data() + cmd.offset, static_cast<int>(cmd.length));
+            break;
+
+        case render_op::hline:
+            window.hline(static_cast<chtype>(cmd.value), static_cast<int>(cmd.offset));
+            break;
+
+        case render_op::clear_to_eol:
+            window.clrtoeol();
+            break;
+
+        case render_op::erase:
+            window.erase();
+            break;
+
+        default:
+            break;
+        }
+    }
+}
+
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "lib/nccpp/Window.hpp"
+#include "lib/ncurses/ncurses.hpp"
+
+namespace rmrf::ui {
+
+enum class render_op : uint8_t {
+    move,
+    attr_set,
+    text,
+    hline,
+    clear_to_eol,
+    erase
+};
+
+/**
+ * A recorded list of drawing operations.
+ *
+ * Building a render_buffer does not touch any curses state, so previews,
+ * wrapped text, colouring and hexdumps can be laid out on any thread. Only
+ * replay() needs to run on the UI thread while holding the display.
+ */
+class render_buffer {
+public:
+    typedef render_buffer self_type;
+    typedef std::shared_ptr<const self_type> ptr_type;
+
+private:
+    struct command {
+        render_op op;
+        int y;
+        int x;
+        int value;
+        uint32_t offset;
+        uint32_t length;
+    };
+
+    std::vector<command> commands;
+    std::string text_pool;
+    int lines;
+
+public:
+    render_buffer();
+    ~render_buffer();
+
+    void move(int y, int x);
+    void attrset(attr_t attributes);
+    void add_text(std::string_view text);
+    void hline(chtype ch, int n);
+    void clrtoeol();
+    void erase();
+
+    /**
+     * Place multi line text (like a hexdump) line by line starting at the
+     * given row. Each line is cleared to its end.
+     *
+     * @return The row after the last line placed
+     */
+    int add_lines(int y, int x, std::string_view text, attr_t attributes = A_NORMAL);
+
+    /**
+     * Word wrap text to the given width starting at the given row.
+     * Words longer than a line are split.
+     *
+     * @return The row after the last line placed
+     */
+    int add_wrapped(int y, int x, int width, std::string_view text, attr_t attributes = A_NORMAL);
+
+    /**
+     * @return The number of rows covered by the commands recorded so far
+     */
+    int get_lines() const;
+    bool empty() const;
+    void clear();
+
+    /**
+     * Draw the recorded commands into the window. UI thread only.
+     */
+    void replay(nccpp::Window &window) const;
+};
+
+}
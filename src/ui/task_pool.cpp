@@ -0,0 +1,96 @@
+#include "ui/task_pool.hpp"
+
+#include <algorithm>
+
+namespace rmrf::ui {
+
+task_pool::task_pool(size_t threads) :
+    m{}, cv{}, pending{}, running{}, stopping{false}, completion_cb{}, workers{}
+{
+    if (!threads) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    for (size_t i = 0; i < threads; i++) {
+        this->workers.emplace_back(&task_pool::run, this);
+    }
+}
+
+task_pool::~task_pool() {
+    this->cancel_all();
+
+    {
+        std::lock_guard<std::mutex> lock(this->m);
+        this->stopping = true;
+    }
+
+    this->cv.notify_all();
+
+    for (auto &worker : this->workers) {
+        worker.join();
+    }
+}
+
+void task_pool::set_completion_callback(const completion_cb_t &cb) {
+    std::lock_guard<std::mutex> lock(this->m);
+    this->completion_cb = cb;
+}
+
+background_task::ptr_type task_pool::submit(const std::string &operation, const background_task::job_type &job) {
+    auto task = std::make_shared<background_task>(operation, job);
+
+    {
+        std::lock_guard<std::mutex> lock(this->m);
+        this->pending.push_back(task);
+    }
+
+    this->cv.notify_one();
+
+    return task;
+}
+
+void task_pool::cancel_all() {
+    std::lock_guard<std::mutex> lock(this->m);
+
+    for (auto &task : this->pending) {
+        task->cancel();
+    }
+
+    for (auto &task : this->running) {
+        task->cancel();
+    }
+}
+
+void task_pool::run() {
+    for (;;) {
+        background_task::ptr_type task;
+        completion_cb_t cb;
+
+        {
+            std::unique_lock<std::mutex> lock(this->m);
+            this->cv.wait(lock, [this] { return this->stopping || !this->pending.empty(); });
+
+            if (this->pending.empty()) {
+                return;
+            }
+
+            task = std::move(this->pending.front());
+            this->pending.pop_front();
+            this->running.push_back(task);
+        }
+
+        task->execute();
+
+        {
+            std::lock_guard<std::mutex> lock(this->m);
+            this->running.erase(std::find(this->running.begin(), this->running.end(), task));
+            cb = this->completion_cb;
+        }
+
+        if (cb) {
+            cb(task);
+        }
+    }
+}
+
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ui/background_task.hpp"
+
+namespace rmrf::ui {
+
+/**
+ * This class runs background_tasks like folder syncs, index rebuilds,
+ * bulk moves or attachment saves on a fixed set of worker threads.
+ */
+class task_pool {
+public:
+    /**
+     * Called on the worker thread once a task is over, e.g. to wake the UI loop.
+     */
+    typedef std::function<void(const background_task::ptr_type &)> completion_cb_t;
+
+private:
+    std::mutex m;
+    std::condition_variable cv;
+    std::deque<background_task::ptr_type> pending;
+    std::vector<background_task::ptr_type> running;
+    bool stopping;
+    completion_cb_t completion_cb;
+    std::vector<std::thread> workers;
+
+public:
+    /**
+     * @param threads The number of workers; 0 picks one per hardware thread
+     */
+    explicit task_pool(size_t threads = 0);
+    ~task_pool();
+
+    task_pool(const task_pool &) = delete;
+    task_pool &operator=(const task_pool &) = delete;
+
+    /**
+     * Set the callback invoked when a task finished, failed or was cancelled.
+     * This should be set before submitting tasks.
+     */
+    void set_completion_callback(const completion_cb_t &cb);
+
+    /**
+     * Queue a job for execution.
+     *
+     * @param operation A description of the operation
+     * @param job The work to do
+     * @return The task, usable as progress_indicator and for cancellation
+     */
+    background_task::ptr_type submit(const std::string &operation, const background_task::job_type &job);
+
+    /**
+     * Cancel all pending and running tasks.
+     */
+    void cancel_all();
+
+private:
+    void run();
+};
+
+}
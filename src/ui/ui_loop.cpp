@@ -0,0 +1,175 @@
+#include "ui/ui_loop.hpp"
+
+#include <signal.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include "lib/ncurses/ncurses.hpp"
+
+namespace rmrf::ui {
+
+static constexpr ::ev::tstamp progress_interval = 1.0 / 15;
+
+ui_loop::ui_loop(const display::ptr_type &disp_, ::ev::loop_ref loop_) :
+    disp{disp_},
+    loop{loop_},
+    e_stdin{loop_},
+    e_winch{loop_},
+    e_frame{loop_},
+    e_wakeup{loop_},
+    e_progress{loop_},
+    monitor{"ui", 0.1, loop_},
+    key_cb{},
+    resize_cb{},
+    bus{}
+{
+    // Never let getch wait; readiness is reported by the loop instead
+    this->disp->sync([](const display::ptr_type &) {
+        ::nodelay(stdscr, TRUE);
+    });
+
+    this->e_stdin.set<ui_loop, &ui_loop::cb_stdin>(this);
+    this->e_stdin.set(STDIN_FILENO, ::ev::READ);
+    this->e_stdin.start();
+
+    this->e_winch.set<ui_loop, &ui_loop::cb_winch>(this);
+    this->e_winch.set(SIGWINCH);
+    this->e_winch.start();
+
+    this->e_frame.set<ui_loop, &ui_loop::cb_frame>(this);
+    this->e_frame.start();
+
+    this->e_wakeup.set<ui_loop, &ui_loop::cb_wakeup>(this);
+    this->e_wakeup.start();
+
+    // Only runs while some view shows running operations
+    this->e_progress.set<ui_loop, &ui_loop::cb_progress>(this);
+    this->e_progress.set(progress_interval, progress_interval);
+}
+
+ui_loop::~ui_loop() {
+    this->e_progress.stop();
+    this->e_wakeup.stop();
+    this->e_frame.stop();
+    this->e_winch.stop();
+    this->e_stdin.stop();
+}
+
+void ui_loop::set_key_callback(const key_cb_t &cb) {
+    this->key_cb = cb;
+}
+
+void ui_loop::set_resize_callback(const resize_cb_t &cb) {
+    this->resize_cb = cb;
+}
+
+event_bus &ui_loop::get_event_bus() {
+    return this->bus;
+}
+
+void ui_loop::run() {
+    // Draw the initial frame before waiting for the first event
+    this->disp->flush_frame();
+    this->loop.run(0);
+}
+
+void ui_loop::stop() {
+    this->loop.break_loop(::ev::ALL);
+}
+
+void ui_loop::wakeup() {
+    this->e_wakeup.send();
+}
+
+void ui_loop::cb_stdin(::ev::io &w, int events) {
+    (void)w;
+    (void)events;
+
+    // Drain everything that is buffered so a burst of keys costs one frame
+    for (;;) {
+        int ch = this->disp->sync([](const display::ptr_type &) {
+            return ::getch();
+        });
+
+        if (ERR == ch) {
+            break;
+        }
+
+        if (KEY_RESIZE == ch) {
+            this->handle_resize();
+            continue;
+        }
+
+        this->bus.publish(nullptr, events::key{ch});
+
+        if (this->key_cb && !this->key_cb(ch)) {
+            this->stop();
+            break;
+        }
+    }
+}
+
+void ui_loop::cb_winch(::ev::sig &w, int events) {
+    (void)w;
+    (void)events;
+
+    // libev owns SIGWINCH now, so tell curses about the new size ourselves
+    struct winsize ws{};
+
+    if (::ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) < 0 || !ws.ws_row || !ws.ws_col) {
+        return;
+    }
+
+    this->disp->sync([&ws](const display::ptr_type &) {
+        ::resize_term(ws.ws_row, ws.ws_col);
+    });
+
+    this->handle_resize();
+}
+
+void ui_loop::cb_frame(::ev::prepare &w, int events) {
+    (void)w;
+    (void)events;
+
+    this->bus.dispatch();
+    this->disp->flush_frame();
+
+    if (!this->e_progress.is_active() && this->disp->sample_progress()) {
+        this->e_progress.again();
+    }
+}
+
+void ui_loop::cb_progress(::ev::timer &w, int events) {
+    (void)events;
+
+    if (!this->disp->sample_progress()) {
+        w.stop();
+    }
+}
+
+void ui_loop::cb_wakeup(::ev::async &w, int events) {
+    (void)w;
+    (void)events;
+
+    // Nothing to do; the prepare watcher dispatches posted events
+    // and flushes the frame before sleeping
+}
+
+void ui_loop::handle_resize() {
+    int lines = 0;
+    int cols = 0;
+
+    this->disp->sync([&lines, &cols](const display::ptr_type &) {
+        getmaxyx(stdscr, lines, cols);
+    });
+
+    if (this->resize_cb) {
+        this->resize_cb(lines, cols);
+    }
+
+    this->bus.publish(nullptr, events::resize{lines, cols});
+
+    this->disp->clear();
+}
+
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <ev++.h>
+
+#include <functional>
+#include <memory>
+
+#include "lib/ev/loop_monitor.hpp"
+
+#include "ui/display.hpp"
+#include "ui/event_bus.hpp"
+
+namespace rmrf::ui {
+
+/**
+ * This class drives a display from a libev loop.
+ *
+ * Keyboard input is read whenever stdin becomes readable, terminal resizes
+ * arrive as signals and all damaged views are drawn once per loop iteration
+ * right before the loop goes back to sleep. Network clients registered on the
+ * same loop (e.g. the IMAP engine on top of tcp_client) are serviced in
+ * between, so neither side ever blocks the other.
+ */
+class ui_loop {
+public:
+    /**
+     * Called for every key read from the terminal.
+     * Return false to leave the loop.
+     */
+    typedef std::function<bool(int)> key_cb_t;
+    typedef std::function<void(int, int)> resize_cb_t;
+
+private:
+    display::ptr_type disp;
+    ::ev::loop_ref loop;
+
+    ::ev::io e_stdin;
+    ::ev::sig e_winch;
+    ::ev::prepare e_frame;
+    ::ev::async e_wakeup;
+    ::ev::timer e_progress;
+
+    // Frames are drawn once per iteration, so lag shows right away. It is
+    // logged, so the log must not go to the terminal we draw on.
+    rmrf::ev::loop_monitor monitor;
+
+    key_cb_t key_cb;
+    resize_cb_t resize_cb;
+
+    event_bus bus;
+
+public:
+    /**
+     * @param disp_ The display to drive
+     * @param loop_ The loop to run on. tcp_client uses the default loop.
+     */
+    explicit ui_loop(const display::ptr_type &disp_, ::ev::loop_ref loop_ = ::ev::get_default_loop());
+    ~ui_loop();
+
+    ui_loop(const ui_loop &) = delete;
+    ui_loop &operator=(const ui_loop &) = delete;
+
+    void set_key_callback(const key_cb_t &cb);
+    void set_resize_callback(const resize_cb_t &cb);
+
+    /**
+     * Keys and resizes are published on this bus and all events queued
+     * on it are dispatched once per frame before drawing.
+     */
+    event_bus &get_event_bus();
+
+    /**
+     * Run the loop until stop() is called or the key callback asks to quit.
+     */
+    void run();
+
+    /**
+     * Leave the loop after the current iteration.
+     */
+    void stop();
+
+    /**
+     * Wake the loop from another thread, e.g. from a task_pool's completion
+     * callback, so the pending frame gets drawn.
+     */
+    void wakeup();
+
+private:
+    void cb_stdin(::ev::io &w, int events);
+    void cb_winch(::ev::sig &w, int events);
+    void cb_frame(::ev::prepare &w, int events);
+    void cb_wakeup(::ev::async &w, int events);
+    void cb_progress(::ev::timer &w, int events);
+
+    void handle_resize();
+};
+
+}
@@ -2,7 +2,9 @@
 
 namespace rmrf::ui {
 
-view::view(const std::shared_ptr<view> &parent) : parent_view{parent}, child_views{} {
+view::view(const std::shared_ptr<view> &parent) :
+    parent_view{parent}, child_views{}, progress_indicators{}, damaged{true}, owner{}
+{
     if (this->parent_view) {
         this->parent_view->add_child(this->shared_from_this());
     }
@@ -22,6 +24,59 @@ std::shared_ptr<view> view::get_parent() const {
     return this->parent_view;
 }
 
+void view::damage() {
+    if (this->damaged.exchange(true, std::memory_order_acq_rel)) {
+        return;
+    }
+
+    if (auto d = this->owner.lock()) {
+        d->request_frame();
+    }
+}
+
+bool view::is_damaged() const {
+    return this->damaged.load(std::memory_order_acquire);
+}
+
+bool view::take_damage() {
+    return this->damaged.exchange(false, std::memory_order_acq_rel);
+}
+
+void view::attach(const std::shared_ptr<display> &d) {
+    this->owner = d;
+
+    if (d && this->is_damaged()) {
+        d->request_frame();
+    }
+}
+
+void view::add_progress_indicator(const std::shared_ptr<progress_indicator> &progress) {
+    this->progress_indicators.push_back(progress);
+    this->damage();
+}
+
+const std::list<std::shared_ptr<progress_indicator>> &view::get_progress_indicators() const {
+    return this->progress_indicators;
+}
+
+bool view::sample_progress() {
+    if (this->progress_indicators.empty()) {
+        return false;
+    }
+
+    // Draw once more after the last operation ended so it disappears
+    this->progress_indicators.remove_if([](const std::shared_ptr<progress_indicator> &p) {
+        return p->is_done();
+    });
+    this->damage();
+
+    return !this->progress_indicators.empty();
+}
+
+bool view::render() {
+    return false;
+}
+
 void view::add_child(const std::shared_ptr<view> &child) {
     this->child_views.push_back(child);
 }
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <atomic>
 #include <functional>
 #include <memory>
 #include <shared_mutex>
@@ -18,9 +19,16 @@ class view : public ui_context, std::enable_shared_from_this<view> {
 private:
     std::shared_ptr<view> parent_view;
     std::list<std::shared_ptr<view>> child_views;
+    std::list<std::shared_ptr<progress_indicator>> progress_indicators;
+    std::atomic<bool> damaged;
+    std::weak_ptr<display> owner;
 private:
     void add_child(const std::shared_ptr<view> &child);
     void remove_child(const std::shared_ptr<view> &child);
+
+    friend class display;
+    void attach(const std::shared_ptr<display> &d);
+    bool take_damage();
 public:
     /**
      * This method will be called when an operation is taking place. It may add
@@ -28,7 +36,25 @@ public:
      *
      * @param progress The progress_indicator from the new running task to add
      */
-//    virtual void add_progress_indicator(const std::shared_ptr<progress_indicator> &progress);
+    virtual void add_progress_indicator(const std::shared_ptr<progress_indicator> &progress);
+
+    /**
+     * Use this method in order to get the progress indicators of operations that
+     * are still running. Those that finished were dropped by the last call to
+     * sample_progress.
+     *
+     * @return The list of indicators
+     */
+    const std::list<std::shared_ptr<progress_indicator>> &get_progress_indicators() const;
+
+    /**
+     * This method will be called by the display at frame rate while operations
+     * are running. It drops finished indicators and damages the view so the
+     * new progress gets drawn. Sampling only reads the indicators' counters.
+     *
+     * @return True if any operation is still running
+     */
+    virtual bool sample_progress();
 
     /**
      * This method will be called on a regular basis when the view needs to be updated
@@ -48,6 +74,24 @@ public:
      * @param event The event that caused the update.
      */
 //    virtual void schedule_update(const std::shared_ptr<event> &event);
+    /**
+     * Mark this view as needing to be redrawn and ask the display it is
+     * registered with for a new frame. Calling this repeatedly before the
+     * next frame is cheap; all damage is drawn in a single pass.
+     */
+    void damage();
+    /**
+     * @return true if this view needs to be redrawn in the next frame
+     */
+    bool is_damaged() const;
+    /**
+     * This method will be called by the display when the view was damaged.
+     * Implementations should only draw what changed and stage it with
+     * wnoutrefresh; the display does the final doupdate.
+     *
+     * @return true if anything was drawn
+     */
+    virtual bool render();
     /**
      * Use this method in order to retrieve the parent of this view.
      * @warn Keep in mind that this might be null.
@@ -0,0 +1,182 @@
+#include "utils/byte_source.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <system_error>
+
+#include "net/async_fd.hpp"
+
+namespace rmrf::utils {
+
+hexdump_getspan_t byte_source::make_getspan() {
+    return [this](off_t offset, size_t length) {
+        return this->get_span(offset, length);
+    };
+}
+
+mapped_byte_source::mapped_byte_source(const std::string &path) : data{nullptr}, length{0} {
+    rmrf::net::auto_fd fd{::open(path.c_str(), O_RDONLY | O_CLOEXEC)};
+
+    if (!fd.valid()) {
+        throw std::system_error(errno, std::generic_category(), "Failed to open " + path);
+    }
+
+    struct stat st{};
+
+    if (::fstat(fd.get(), &st) < 0) {
+        throw std::system_error(errno, std::generic_category(), "Failed to stat " + path);
+    }
+
+    this->length = static_cast<size_t>(st.st_size);
+
+    if (!this->length) {
+        return;
+    }
+
+    void *mapping = ::mmap(nullptr, this->length, PROT_READ, MAP_PRIVATE, fd.get(), 0);
+
+    if (MAP_FAILED == mapping) {
+        throw std::system_error(errno, std::generic_category(), "Failed to map " + path);
+    }
+
+    ::madvise(mapping, this->length, MADV_RANDOM);
+    this->data = static_cast<const uint8_t *>(mapping);
+}
+
+mapped_byte_source::~mapped_byte_source() {
+    if (this->data) {
+        ::munmap(const_cast<uint8_t *>(this->data), this->length);
+    }
+}
+
+off_t mapped_byte_source::get_size() const {
+    return static_cast<off_t>(this->length);
+}
+
+hexdump_span mapped_byte_source::get_span(off_t offset, size_t length_) {
+    if (offset < 0) {
+        return hexdump_span{nullptr, std::min(length_, static_cast<size_t>(-offset)), hexdump_data_t::non_existent};
+    }
+
+    if (static_cast<size_t>(offset) >= this->length) {
+        return hexdump_span{nullptr, length_, hexdump_data_t::non_existent};
+    }
+
+    return hexdump_span{this->data + offset, std::min(length_, this->length - static_cast<size_t>(offset)), hexdump_data_t::non_existent};
+}
+
+paged_byte_source::paged_byte_source(off_t size_, size_t page_size_, const range_cb_t &fetch_cb_) :
+    size{size_},
+    page_size{std::max<size_t>(page_size_, 1)},
+    m{},
+    pages{},
+    requested{},
+    fetch_cb{fetch_cb_},
+    arrival_cb{}
+{
+    // NOP
+}
+
+paged_byte_source::~paged_byte_source() {
+    // NOP
+}
+
+void paged_byte_source::set_arrival_callback(const range_cb_t &cb) {
+    std::lock_guard<std::mutex> lock(this->m);
+    this->arrival_cb = cb;
+}
+
+void paged_byte_source::provide(off_t offset, const std::string &data) {
+    range_cb_t cb;
+
+    {
+        std::lock_guard<std::mutex> lock(this->m);
+
+        for (size_t pos = 0; pos < data.size(); pos += this->page_size) {
+            const off_t page = offset + static_cast<off_t>(pos);
+            const size_t length = std::min(this->page_size, data.size() - pos);
+
+            // Pages handed out once are never modified again
+            if (!this->pages.count(page)) {
+                this->pages.emplace(page, std::vector<uint8_t>(data.begin() + static_cast<ssize_t>(pos),
+                    data.begin() + static_cast<ssize_t>(pos + length)));
+            }
+
+            this->requested.erase(page);
+        }
+
+        cb = this->arrival_cb;
+    }
+
+    if (cb) {
+        cb(offset, data.size());
+    }
+}
+
+off_t paged_byte_source::get_size() const {
+    return this->size;
+}
+
+hexdump_span paged_byte_source::get_span(off_t offset, size_t length) {
+    if (offset < 0) {
+        return hexdump_span{nullptr, std::min(length, static_cast<size_t>(-offset)), hexdump_data_t::non_existent};
+    }
+
+    if (offset >= this->size) {
+        return hexdump_span{nullptr, length, hexdump_data_t::non_existent};
+    }
+
+    const off_t step = static_cast<off_t>(this->page_size);
+    const off_t page = offset - offset % step;
+    const size_t in_page = static_cast<size_t>(offset - page);
+    length = std::min({length, this->page_size - in_page, static_cast<size_t>(this->size - offset)});
+
+    {
+        std::lock_guard<std::mutex> lock(this->m);
+        auto it = this->pages.find(page);
+
+        if (it != this->pages.end()) {
+            const auto &bytes = it->second;
+
+            if (in_page >= bytes.size()) {
+                return hexdump_span{nullptr, length, hexdump_data_t::non_existent};
+            }
+
+            return hexdump_span{bytes.data() + in_page, std::min(length, bytes.size() - in_page), hexdump_data_t::non_existent};
+        }
+    }
+
+    this->request_page(page);
+
+    return hexdump_span{nullptr, length, hexdump_data_t::unknown};
+}
+
+void paged_byte_source::request(off_t offset, size_t length) {
+    const off_t step = static_cast<off_t>(this->page_size);
+    const off_t end = std::min(this->size, offset + static_cast<off_t>(length));
+
+    for (off_t page = std::max<off_t>(offset, 0) / step * step; page < end; page += step) {
+        this->request_page(page);
+    }
+}
+
+void paged_byte_source::request_page(off_t page_offset) {
+    {
+        std::lock_guard<std::mutex> lock(this->m);
+
+        if (this->pages.count(page_offset) || !this->requested.insert(page_offset).second) {
+            return;
+        }
+    }
+
+    if (this->fetch_cb) {
+        const size_t length = std::min(this->page_size, static_cast<size_t>(this->size - page_offset));
+        this->fetch_cb(page_offset, length);
+    }
+}
+
+}
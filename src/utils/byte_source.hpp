@@ -0,0 +1,132 @@
+#pragma once
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "utils/hexdump.hpp"
+
+namespace rmrf::utils {
+
+/**
+ * Random access to a possibly large blob of bytes that may not be
+ * available completely yet, e.g. the raw source of a message.
+ */
+class byte_source {
+public:
+    typedef std::shared_ptr<byte_source> ptr_type;
+
+    byte_source() {};
+    virtual ~byte_source() {};
+
+    /**
+     * @return The total size in bytes
+     */
+    virtual off_t get_size() const = 0;
+
+    /**
+     * Get the bytes at the given offset. Bytes not available yet are
+     * reported as hexdump_data_t::unknown. Returned data stays valid for
+     * the lifetime of the source.
+     */
+    virtual hexdump_span get_span(off_t offset, size_t length) = 0;
+
+    /**
+     * Hint that the given range will be needed soon.
+     */
+    virtual void request(off_t offset, size_t length) {
+        (void)offset;
+        (void)length;
+    };
+
+    /**
+     * Adapt this source for use with the hexdump formatter.
+     */
+    hexdump_getspan_t make_getspan();
+};
+
+/**
+ * A byte_source backed by a read only memory mapping of a file.
+ */
+class mapped_byte_source : public byte_source {
+private:
+    const uint8_t *data;
+    size_t length;
+
+public:
+    /**
+     * @param path The file to map
+     * @throws std::system_error if the file can not be mapped
+     */
+    explicit mapped_byte_source(const std::string &path);
+    virtual ~mapped_byte_source();
+
+    mapped_byte_source(const mapped_byte_source &) = delete;
+    mapped_byte_source &operator=(const mapped_byte_source &) = delete;
+
+    virtual off_t get_size() const override;
+    virtual hexdump_span get_span(off_t offset, size_t length) override;
+};
+
+/**
+ * A byte_source whose content arrives in pages, e.g. via partial fetches
+ * over IMAP.
+ *
+ * Reading a page that is missing asks for it through the fetch callback
+ * once and reports its bytes as unknown until provide() was called.
+ * All methods may be called from any thread.
+ */
+class paged_byte_source : public byte_source {
+public:
+    typedef std::function<void(off_t, size_t)> range_cb_t;
+
+private:
+    const off_t size;
+    const size_t page_size;
+
+    mutable std::mutex m;
+    std::map<off_t, std::vector<uint8_t>> pages;
+    std::set<off_t> requested;
+
+    range_cb_t fetch_cb;
+    range_cb_t arrival_cb;
+
+public:
+    /**
+     * @param size_ The total size of the data
+     * @param page_size_ The size of the pages to fetch
+     * @param fetch_cb_ Called with page aligned ranges that need fetching
+     */
+    paged_byte_source(off_t size_, size_t page_size_, const range_cb_t &fetch_cb_);
+    virtual ~paged_byte_source();
+
+    paged_byte_source(const paged_byte_source &) = delete;
+    paged_byte_source &operator=(const paged_byte_source &) = delete;
+
+    /**
+     * Get notified when a range became available, e.g. to redraw.
+     */
+    void set_arrival_callback(const range_cb_t &cb);
+
+    /**
+     * Store fetched data. The offset must be page aligned; data may span
+     * several pages.
+     */
+    void provide(off_t offset, const std::string &data);
+
+    virtual off_t get_size() const override;
+    virtual hexdump_span get_span(off_t offset, size_t length) override;
+    virtual void request(off_t offset, size_t length) override;
+
+private:
+    void request_page(off_t page_offset);
+};
+
+}
@@ -1,14 +1,100 @@
 #include "utils/hexdump.hpp"
 
 #include <algorithm>
-#include <iomanip>
-#include <sstream>
+#include <array>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#endif
 
 
 namespace rmrf::utils {
 
-void hexdump_to_stream(
-    std::ostream &os,
+namespace {
+
+constexpr char hex_digits_lower[] = "0123456789abcdef";
+constexpr char hex_digits_upper[] = "0123456789ABCDEF";
+
+enum class byte_kind : uint8_t {
+    data,
+    unknown,
+    non_existent
+};
+
+struct hex_tables {
+    std::array<char, 512> pairs_lower;
+    std::array<char, 512> pairs_upper;
+    std::array<char, 256> textual;
+
+    hex_tables() : pairs_lower{}, pairs_upper{}, textual{} {
+        for (size_t i = 0; i < 256; i++) {
+            this->pairs_lower[2 * i] = hex_digits_lower[i >> 4];
+            this->pairs_lower[2 * i + 1] = hex_digits_lower[i & 15];
+            this->pairs_upper[2 * i] = hex_digits_upper[i >> 4];
+            this->pairs_upper[2 * i + 1] = hex_digits_upper[i & 15];
+            this->textual[i] = (i >= 32 && i < 127) ? static_cast<char>(i) : '.';
+        }
+    }
+};
+
+const hex_tables tables;
+
+/**
+ * Convert n bytes into 2 * n hex digits.
+ */
+void bytes_to_hex(const uint8_t *in, size_t n, char *out, bool uppercase) {
+    size_t i = 0;
+
+#if defined(__SSSE3__)
+    const __m128i lut = _mm_loadu_si128(reinterpret_cast<const __m128i *>(uppercase ? hex_digits_upper : hex_digits_lower));
+    const __m128i nibble = _mm_set1_epi8(0x0f);
+
+    for (; i + 16 <= n; i += 16) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i));
+        const __m128i hi = _mm_shuffle_epi8(lut, _mm_and_si128(_mm_srli_epi16(v, 4), nibble));
+        const __m128i lo = _mm_shuffle_epi8(lut, _mm_and_si128(v, nibble));
+
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + 2 * i), _mm_unpacklo_epi8(hi, lo));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + 2 * i + 16), _mm_unpackhi_epi8(hi, lo));
+    }
+#endif
+
+    const char *pairs = uppercase ? tables.pairs_upper.data() : tables.pairs_lower.data();
+
+    for (; i < n; i++) {
+        std::memcpy(out + 2 * i, pairs + 2 * in[i], 2);
+    }
+}
+
+char *write_offset(char *out, uint64_t value, bool uppercase) {
+    const char *digits = uppercase ? hex_digits_upper : hex_digits_lower;
+
+    size_t width = 8;
+
+    while (width < 16 && (value >> (4 * width))) {
+        width++;
+    }
+
+    for (size_t i = width; i > 0; i--) {
+        out[i - 1] = digits[value & 15];
+        value >>= 4;
+    }
+
+    return out + width;
+}
+
+char *write_spaces(char *out, size_t count) {
+    std::memset(out, ' ', count);
+    return out + count;
+}
+
+}
+
+void hexdump_to_buffer(
+    std::string &out,
     size_t bytes_per_line,
     size_t bytes_per_group,
     size_t space_per_byte,
@@ -18,76 +104,188 @@ void hexdump_to_stream(
     off_t voffset_at_zero,
     bool display_textual,
     bool display_uppercase,
-    hexdump_getdata_t get_data
+    const hexdump_getspan_t &get_span
 ) {
-    off_t offset_line = voffset_at_zero + offset_start;
-
-    for (
-        off_t offset = offset_start;
-        offset <= offset_end;
-        offset += (off_t)bytes_per_line, offset_line += (off_t)bytes_per_line
-    ) {
-        if (display_uppercase) {
-            os << std::uppercase;
+    out.clear();
+
+    if (offset_end < offset_start || !bytes_per_line) {
+        return;
+    }
+
+    const size_t line_count = static_cast<size_t>(offset_end - offset_start) / bytes_per_line + 1;
+    const size_t group_breaks = space_per_group ? (bytes_per_line - 1) / bytes_per_group : 0;
+    const size_t hex_width = bytes_per_line * 2 + (bytes_per_line - 1) * space_per_byte + group_breaks * space_per_group;
+    const size_t line_width = 16 + 3 + hex_width + 3 + bytes_per_line + 1;
+
+    // One allocation for the whole dump; trimmed to the real size below
+    out.resize(line_count * line_width);
+    char *pos = out.data();
+
+    std::vector<uint8_t> line_bytes(bytes_per_line);
+    std::vector<byte_kind> line_kinds(bytes_per_line);
+    std::vector<char> line_hex(bytes_per_line * 2);
+
+    off_t offset = offset_start;
+
+    for (size_t line = 0; line < line_count; line++, offset += static_cast<off_t>(bytes_per_line)) {
+        // Gather the bytes of this line; usually a single callback
+        const uint8_t *bytes = nullptr;
+        bool all_data = false;
+
+        for (size_t filled = 0; filled < bytes_per_line;) {
+            const size_t wanted = bytes_per_line - filled;
+            hexdump_span span = get_span(offset + static_cast<off_t>(filled), wanted);
+            const size_t length = std::min(span.length, wanted);
+
+            if (!length) {
+                std::fill(line_kinds.begin() + static_cast<ssize_t>(filled), line_kinds.end(), byte_kind::non_existent);
+                break;
+            }
+
+            if (span.data && !filled && length == bytes_per_line) {
+                bytes = span.data;
+                all_data = true;
+                break;
+            }
+
+            if (span.data) {
+                std::memcpy(line_bytes.data() + filled, span.data, length);
+                std::fill_n(line_kinds.begin() + static_cast<ssize_t>(filled), length, byte_kind::data);
+            } else {
+                std::fill_n(line_kinds.begin() + static_cast<ssize_t>(filled), length,
+                    hexdump_data_t::unknown == span.fill ? byte_kind::unknown : byte_kind::non_existent);
+            }
+
+            filled += length;
+        }
+
+        if (!all_data) {
+            bytes = line_bytes.data();
         }
 
-        os << std::setw(8) << std::setfill('0') << std::hex << (size_t)offset_line << " : ";
+        bytes_to_hex(bytes, bytes_per_line, line_hex.data(), display_uppercase);
 
-        std::string display_textual_data(bytes_per_line, ' ');
-        size_t display_textual_last = 0;
+        pos = write_offset(pos, static_cast<uint64_t>(voffset_at_zero + offset), display_uppercase);
+        pos = write_spaces(pos, 1);
+        *pos++ = ':';
+        pos = write_spaces(pos, 1);
 
-        std::stringstream display_hex_data;
+        char *hex_start = pos;
+        char *text_start = hex_start + hex_width + 3;
+        size_t textual_last = 0;
 
         for (size_t idx = 0; idx < bytes_per_line; idx++) {
-            off_t offset_data = offset + (off_t)idx;
-            auto data = get_data(offset_data);
-
             if (space_per_group && idx && !(idx % bytes_per_group)) {
-                display_hex_data << std::string(space_per_group, ' ');
+                pos = write_spaces(pos, space_per_group);
             }
 
             if (space_per_byte && idx) {
-                display_hex_data << std::string(space_per_byte, ' ');
+                pos = write_spaces(pos, space_per_byte);
             }
 
-            if (std::holds_alternative<hexdump_data_t>(data)) {
-                hexdump_data_t hd_data = std::get<hexdump_data_t>(data);
-
-                if (hexdump_data_t::unknown == hd_data) {
-                    display_hex_data << "??";
-                    display_textual_last = idx + 1;
-                    display_textual_data[idx] = '?';
-                } else {
-                    display_hex_data << "  ";
-                    display_textual_data[idx] = ' ';
-                }
-            } else if (std::holds_alternative<uint8_t>(data)) {
-                uint8_t hd_data = std::get<uint8_t>(data);
-
-                if (display_uppercase) {
-                    display_hex_data << std::uppercase;
-                }
-
-                display_hex_data << std::setw(2) << std::setfill('0') << std::hex << (uint32_t)hd_data;
-                display_textual_last = idx + 1;
-                display_textual_data[idx] = (hd_data >= 32 && hd_data < 127) ? (char)hd_data : '.';
-            } else {
-                display_hex_data << "!!";
-                display_textual_last = idx + 1;
-                display_textual_data[idx] = '!';
+            const byte_kind kind = all_data ? byte_kind::data : line_kinds[idx];
+
+            switch (kind) {
+            case byte_kind::data:
+                std::memcpy(pos, line_hex.data() + 2 * idx, 2);
+                text_start[idx] = tables.textual[bytes[idx]];
+                textual_last = idx + 1;
+                break;
+
+            case byte_kind::unknown:
+                pos[0] = pos[1] = '?';
+                text_start[idx] = '?';
+                textual_last = idx + 1;
+                break;
+
+            case byte_kind::non_existent:
+                pos[0] = pos[1] = ' ';
+                text_start[idx] = ' ';
+                break;
+
+            default:
+                break;
             }
+
+            pos += 2;
         }
 
         if (display_textual) {
-            os << display_hex_data.str();
-            os << " : ";
-            os << display_textual_data.substr(0, display_textual_last);
+            pos = write_spaces(pos, 1);
+            *pos++ = ':';
+            pos = write_spaces(pos, 1);
+            pos += textual_last;
+        } else if (textual_last) {
+            // Drop the padding after the last byte shown
+            const size_t last = textual_last - 1;
+            pos = hex_start + last * 2 + 2 + last * space_per_byte +
+                (space_per_group ? (last / bytes_per_group) * space_per_group : 0);
         } else {
-            os << display_hex_data.str().substr(0, std::max(size_t{}, display_textual_last * 2 + ((off_t)display_textual_last - 1) * space_per_byte + (((off_t)display_textual_last - 1) / bytes_per_group) * space_per_group));
+            pos = hex_start;
         }
 
-        os << "\n";
+        *pos++ = '\n';
     }
+
+    out.resize(static_cast<size_t>(pos - out.data()));
+}
+
+void hexdump_to_stream(
+    std::ostream &os,
+    size_t bytes_per_line,
+    size_t bytes_per_group,
+    size_t space_per_byte,
+    size_t space_per_group,
+    off_t offset_start,
+    off_t offset_end,
+    off_t voffset_at_zero,
+    bool display_textual,
+    bool display_uppercase,
+    const hexdump_getspan_t &get_span
+) {
+    std::string buffer;
+    hexdump_to_buffer(
+        buffer,
+        bytes_per_line,
+        bytes_per_group,
+        space_per_byte,
+        space_per_group,
+        offset_start,
+        offset_end,
+        voffset_at_zero,
+        display_textual,
+        display_uppercase,
+        get_span
+    );
+    os.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+}
+
+void hexdump_to_stream(
+    std::ostream &os,
+    size_t bytes_per_line,
+    size_t bytes_per_group,
+    size_t space_per_byte,
+    size_t space_per_group,
+    off_t offset_start,
+    off_t offset_end,
+    off_t voffset_at_zero,
+    bool display_textual,
+    bool display_uppercase,
+    hexdump_getdata_t get_data
+) {
+    hexdump_to_stream(
+        os,
+        bytes_per_line,
+        bytes_per_group,
+        space_per_byte,
+        space_per_group,
+        offset_start,
+        offset_end,
+        voffset_at_zero,
+        display_textual,
+        display_uppercase,
+        make_getspan_t(std::move(get_data))
+    );
 }
 
 void hexdump_to_stream(
@@ -115,10 +313,39 @@ void hexdump_to_stream(
         voffset_at_zero,
         display_textual,
         display_uppercase,
-        make_getdata_t(buffer, buffer_length)
+        make_getspan_t(buffer, buffer_length)
     );
 }
 
+std::string hexdump_to_string(
+    size_t bytes_per_line,
+    size_t bytes_per_group,
+    size_t space_per_byte,
+    size_t space_per_group,
+    off_t offset_start,
+    off_t offset_end,
+    off_t voffset_at_zero,
+    bool display_textual,
+    bool display_uppercase,
+    const hexdump_getspan_t &get_span
+) {
+    std::string result;
+    hexdump_to_buffer(
+        result,
+        bytes_per_line,
+        bytes_per_group,
+        space_per_byte,
+        space_per_group,
+        offset_start,
+        offset_end,
+        voffset_at_zero,
+        display_textual,
+        display_uppercase,
+        get_span
+    );
+    return result;
+}
+
 std::string hexdump_to_string(
     size_t bytes_per_line,
     size_t bytes_per_group,
@@ -131,9 +358,7 @@ std::string hexdump_to_string(
     bool display_uppercase,
     hexdump_getdata_t get_data
 ) {
-    std::stringstream ss;
-    hexdump_to_stream(
-        ss,
+    return hexdump_to_string(
         bytes_per_line,
         bytes_per_group,
         space_per_byte,
@@ -143,9 +368,8 @@ std::string hexdump_to_string(
         voffset_at_zero,
         display_textual,
         display_uppercase,
-        get_data
+        make_getspan_t(std::move(get_data))
     );
-    return ss.str();
 }
 
 std::string hexdump_to_string(
@@ -171,7 +395,7 @@ std::string hexdump_to_string(
         voffset_at_zero,
         display_textual,
         display_uppercase,
-        make_getdata_t(buffer, buffer_length)
+        make_getspan_t(buffer, buffer_length)
     );
 }
 
@@ -190,6 +414,50 @@ hexdump_getdata_t make_getdata_t(
     };
 }
 
+hexdump_getspan_t make_getspan_t(
+    const uint8_t* buffer,
+    size_t buflen
+) {
+    return [buffer, buflen](off_t offset, size_t length) -> hexdump_span {
+        if (offset < 0) {
+            // Report the gap up to the start of the buffer
+            const size_t gap = std::min(length, static_cast<size_t>(-offset));
+            return hexdump_span{nullptr, gap, hexdump_data_t::non_existent};
+        } else if ((size_t)offset >= buflen) {
+            return hexdump_span{nullptr, length, hexdump_data_t::non_existent};
+        } else {
+            return hexdump_span{buffer + offset, std::min(length, buflen - (size_t)offset), hexdump_data_t::non_existent};
+        }
+    };
+}
+
+hexdump_getspan_t make_getspan_t(
+    hexdump_getdata_t get_data
+) {
+    auto scratch = std::make_shared<std::vector<uint8_t>>();
+
+    return [get_data, scratch](off_t offset, size_t length) -> hexdump_span {
+        scratch->clear();
+
+        for (size_t idx = 0; idx < length; idx++) {
+            auto data = get_data(offset + (off_t)idx);
+
+            if (std::holds_alternative<uint8_t>(data)) {
+                scratch->push_back(std::get<uint8_t>(data));
+                continue;
+            }
+
+            if (!scratch->empty()) {
+                break;
+            }
+
+            return hexdump_span{nullptr, 1, std::get<hexdump_data_t>(data)};
+        }
+
+        return hexdump_span{scratch->data(), scratch->size(), hexdump_data_t::non_existent};
+    };
+}
+
 off_t hexdump_align(
     off_t voffset_at_zero,
     size_t bytes_per_line
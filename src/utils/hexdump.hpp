@@ -17,6 +17,70 @@ enum class hexdump_data_t : uint8_t {
 
 typedef std::function<std::variant<uint8_t, hexdump_data_t>(off_t)> hexdump_getdata_t;
 
+/**
+ * A run of bytes delivered to the hexdump formatter.
+ *
+ * If data is set, length bytes are available there. Otherwise the next
+ * length bytes are all of the kind given by fill.
+ */
+struct hexdump_span {
+    const uint8_t *data;
+    size_t length;
+    hexdump_data_t fill;
+};
+
+/**
+ * Deliver the bytes starting at the given offset. At most the requested
+ * length is used, but returning less is fine; the formatter asks again for
+ * the rest. A length of zero is treated as non-existent data.
+ */
+typedef std::function<hexdump_span(off_t, size_t)> hexdump_getspan_t;
+
+/**
+ * Format a hexdump into out, replacing its content.
+ * The output is formatted in place without intermediate strings.
+ */
+void hexdump_to_buffer(
+    std::string &out,
+    size_t bytes_per_line,
+    size_t bytes_per_group,
+    size_t space_per_byte,
+    size_t space_per_group,
+    off_t offset_start,
+    off_t offset_end,
+    off_t voffset_at_zero,
+    bool display_textual,
+    bool display_uppercase,
+    const hexdump_getspan_t &get_span
+);
+
+void hexdump_to_stream(
+    std::ostream &os,
+    size_t bytes_per_line,
+    size_t bytes_per_group,
+    size_t space_per_byte,
+    size_t space_per_group,
+    off_t offset_start,
+    off_t offset_end,
+    off_t voffset_at_zero,
+    bool display_textual,
+    bool display_uppercase,
+    const hexdump_getspan_t &get_span
+);
+
+std::string hexdump_to_string(
+    size_t bytes_per_line,
+    size_t bytes_per_group,
+    size_t space_per_byte,
+    size_t space_per_group,
+    off_t offset_start,
+    off_t offset_end,
+    off_t voffset_at_zero,
+    bool display_textual,
+    bool display_uppercase,
+    const hexdump_getspan_t &get_span
+);
+
 void hexdump_to_stream(
     std::ostream &os,
     size_t bytes_per_line,
@@ -78,6 +142,18 @@ hexdump_getdata_t make_getdata_t(
     size_t buflen
 );
 
+hexdump_getspan_t make_getspan_t(
+    const uint8_t* buffer,
+    size_t buflen
+);
+
+/**
+ * Adapt a per byte callback to the span interface.
+ */
+hexdump_getspan_t make_getspan_t(
+    hexdump_getdata_t get_data
+);
+
 off_t hexdump_align(
     off_t voffset_at_zero,
     size_t bytes_per_line
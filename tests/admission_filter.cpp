@@ -0,0 +1,203 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE admission_filter
+#include <boost/test/unit_test.hpp>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+
+#include <chrono>
+#include <string>
+#include <thread>
+
+#include "net/admission_filter.hpp"
+
+using rmrf::net::admission_filter;
+using rmrf::net::admission_limits;
+using rmrf::net::admission_verdict;
+
+namespace {
+
+/**
+ * Either an IPv4 or an IPv6 socket address, depending on the text.
+ */
+struct peer {
+    struct sockaddr_storage storage;
+
+    explicit peer(const std::string &text) : storage{} {
+        auto *in = reinterpret_cast<struct sockaddr_in *>(&this->storage);
+        auto *in6 = reinterpret_cast<struct sockaddr_in6 *>(&this->storage);
+
+        if (inet_pton(AF_INET, text.c_str(), &in->sin_addr) == 1) {
+            in->sin_family = AF_INET;
+        } else if (inet_pton(AF_INET6, text.c_str(), &in6->sin6_addr) == 1) {
+            in6->sin6_family = AF_INET6;
+        } else {
+            BOOST_FAIL("Invalid address " + text);
+        }
+    }
+
+    const struct sockaddr *ptr() const {
+        return reinterpret_cast<const struct sockaddr *>(&this->storage);
+    }
+};
+
+std::string address_of(unsigned i) {
+    return "10." + std::to_string(i >> 16 & 255) + "." + std::to_string(i >> 8 & 255) + "." + std::to_string(i & 255);
+}
+
+}
+
+BOOST_AUTO_TEST_CASE(burst_then_reject) {
+    admission_filter filter{admission_limits{0.001, 3, 0, 0, 24, 48, 0, 0, false}};
+    const peer client{"192.0.2.1"};
+
+    for (int i = 0; i < 3; i++) {
+        BOOST_CHECK(filter.admit(client.ptr()) == admission_verdict::accept);
+        filter.release(client.ptr());
+    }
+
+    BOOST_CHECK(filter.admit(client.ptr()) == admission_verdict::reject);
+
+    // Other sources have their own bucket
+    BOOST_CHECK(filter.admit(peer{"192.0.2.2"}.ptr()) == admission_verdict::accept);
+}
+
+BOOST_AUTO_TEST_CASE(tarpit_on_rate) {
+    admission_filter filter{admission_limits{0.001, 1, 0, 0, 24, 48, 0, 0, true}};
+    const peer client{"2001:db8::1"};
+
+    BOOST_CHECK(filter.admit(client.ptr()) == admission_verdict::accept);
+    BOOST_CHECK(filter.admit(client.ptr()) == admission_verdict::tarpit);
+}
+
+BOOST_AUTO_TEST_CASE(tokens_refill_at_rate) {
+    // One token every 10 ms
+    admission_filter filter{admission_limits{100, 1, 0, 0, 24, 48, 0, 0, false}};
+    const peer client{"192.0.2.1"};
+
+    BOOST_CHECK(filter.admit(client.ptr()) == admission_verdict::accept);
+    BOOST_CHECK(filter.admit(client.ptr()) == admission_verdict::reject);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(30));
+
+    // The bucket holds at most the burst
+    BOOST_CHECK(filter.admit(client.ptr()) == admission_verdict::accept);
+    BOOST_CHECK(filter.admit(client.ptr()) == admission_verdict::reject);
+}
+
+BOOST_AUTO_TEST_CASE(prefix_bucket_is_shared) {
+    admission_filter filter{admission_limits{0, 0, 0.001, 2, 24, 48, 0, 0, false}};
+
+    BOOST_CHECK(filter.admit(peer{"198.51.100.1"}.ptr()) == admission_verdict::accept);
+    BOOST_CHECK(filter.admit(peer{"198.51.100.2"}.ptr()) == admission_verdict::accept);
+    BOOST_CHECK(filter.admit(peer{"198.51.100.3"}.ptr()) == admission_verdict::reject);
+    BOOST_CHECK(filter.admit(peer{"198.51.101.1"}.ptr()) == admission_verdict::accept);
+
+    BOOST_CHECK(filter.admit(peer{"2001:db8:1:1::1"}.ptr()) == admission_verdict::accept);
+    BOOST_CHECK(filter.admit(peer{"2001:db8:1:2::1"}.ptr()) == admission_verdict::accept);
+    BOOST_CHECK(filter.admit(peer{"2001:db8:1:3::1"}.ptr()) == admission_verdict::reject);
+    BOOST_CHECK(filter.admit(peer{"2001:db8:2::1"}.ptr()) == admission_verdict::accept);
+}
+
+BOOST_AUTO_TEST_CASE(v4_mapped_is_v4) {
+    // Same address as seen by a dual stack listener
+    admission_filter per_address{admission_limits{0.001, 1, 0, 0, 24, 48, 0, 0, false}};
+
+    BOOST_CHECK(per_address.admit(peer{"192.0.2.1"}.ptr()) == admission_verdict::accept);
+    BOOST_CHECK(per_address.admit(peer{"::ffff:192.0.2.1"}.ptr()) == admission_verdict::reject);
+
+    // The IPv4 network size applies to mapped addresses as well
+    admission_filter per_prefix{admission_limits{0, 0, 0.001, 2, 24, 48, 0, 0, false}};
+
+    BOOST_CHECK(per_prefix.admit(peer{"::ffff:192.0.2.1"}.ptr()) == admission_verdict::accept);
+    BOOST_CHECK(per_prefix.admit(peer{"192.0.2.2"}.ptr()) == admission_verdict::accept);
+    BOOST_CHECK(per_prefix.admit(peer{"::ffff:192.0.2.3"}.ptr()) == admission_verdict::reject);
+}
+
+BOOST_AUTO_TEST_CASE(concurrency_limits) {
+    admission_filter filter{admission_limits{0, 0, 0, 0, 24, 48, 2, 3, false}};
+    const peer client{"192.0.2.1"};
+
+    BOOST_CHECK(filter.admit(client.ptr()) == admission_verdict::accept);
+    BOOST_CHECK(filter.admit(client.ptr()) == admission_verdict::accept);
+    BOOST_CHECK(filter.admit(client.ptr()) == admission_verdict::reject);
+
+    filter.release(client.ptr());
+    BOOST_CHECK(filter.admit(client.ptr()) == admission_verdict::accept);
+
+    BOOST_CHECK(filter.admit(peer{"192.0.2.2"}.ptr()) == admission_verdict::accept);
+    BOOST_CHECK_EQUAL(filter.get_active_connections(), 3u);
+    BOOST_CHECK(filter.admit(peer{"192.0.2.3"}.ptr()) == admission_verdict::reject);
+
+    filter.release(peer{"192.0.2.2"}.ptr());
+    BOOST_CHECK(filter.admit(peer{"192.0.2.3"}.ptr()) == admission_verdict::accept);
+}
+
+BOOST_AUTO_TEST_CASE(local_sockets_are_not_limited) {
+    admission_filter filter{admission_limits{0.001, 1, 0.001, 1, 24, 48, 1, 0, false}};
+    struct sockaddr local{};
+    local.sa_family = AF_UNIX;
+
+    BOOST_CHECK(filter.admit(&local) == admission_verdict::accept);
+    BOOST_CHECK(filter.admit(&local) == admission_verdict::accept);
+    BOOST_CHECK_EQUAL(filter.get_active_connections(), 2u);
+
+    filter.release(&local);
+    filter.release(&local);
+    BOOST_CHECK_EQUAL(filter.get_active_connections(), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(idle_sources_get_evicted) {
+    admission_filter filter{admission_limits{0.001, 1, 0, 0, 24, 48, 0, 0, false}, 64};
+    const peer first{address_of(0)};
+
+    BOOST_CHECK(filter.admit(first.ptr()) == admission_verdict::accept);
+    filter.release(first.ptr());
+    BOOST_CHECK(filter.admit(first.ptr()) == admission_verdict::reject);
+
+    for (unsigned i = 1; i < 1024; i++) {
+        const peer other{address_of(i)};
+        BOOST_CHECK(filter.admit(other.ptr()) == admission_verdict::accept);
+        filter.release(other.ptr());
+    }
+
+    // Forgotten in favour of newer sources, so it starts with a full bucket
+    BOOST_CHECK(filter.admit(first.ptr()) == admission_verdict::accept);
+}
+
+BOOST_AUTO_TEST_CASE(active_sources_are_kept) {
+    admission_filter filter{admission_limits{0, 0, 0, 0, 24, 48, 1, 0, false}, 64};
+    const peer first{address_of(0)};
+
+    BOOST_CHECK(filter.admit(first.ptr()) == admission_verdict::accept);
+
+    // Sources that find no free slot are let through untracked
+    for (unsigned i = 1; i < 1024; i++) {
+        BOOST_CHECK(filter.admit(peer{address_of(i)}.ptr()) == admission_verdict::accept);
+    }
+
+    BOOST_CHECK_EQUAL(filter.get_active_connections(), 1024u);
+
+    // Its open connection kept the slot from being evicted
+    BOOST_CHECK(filter.admit(first.ptr()) == admission_verdict::reject);
+}
+
+BOOST_AUTO_TEST_CASE(allow_and_deny_lists) {
+    admission_filter filter{admission_limits{0.001, 1, 0, 0, 24, 48, 1, 0, false}};
+    rmrf::net::prefix_key_t key = 0;
+    uint8_t prefix_length = 0;
+
+    BOOST_REQUIRE(rmrf::net::parse_cidr("2001:db8::/32", key, prefix_length));
+    filter.block(key, prefix_length);
+    filter.exempt("192.0.2.0/24"_cidr4);
+
+    BOOST_CHECK(filter.admit(peer{"2001:db8::1"}.ptr()) == admission_verdict::reject);
+
+    // Exempt sources are neither limited in rate nor in connections
+    for (int i = 0; i < 5; i++) {
+        BOOST_CHECK(filter.admit(peer{"192.0.2.1"}.ptr()) == admission_verdict::accept);
+    }
+
+    BOOST_CHECK(filter.admit(peer{"198.51.100.1"}.ptr()) == admission_verdict::accept);
+    BOOST_CHECK(filter.admit(peer{"198.51.100.1"}.ptr()) == admission_verdict::reject);
+}
@@ -0,0 +1,130 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE message_cache
+#include <boost/test/unit_test.hpp>
+
+#include <stdlib.h>
+
+#include <chrono>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "cache/message_cache.hpp"
+
+using rmrf::cache::message_cache;
+using rmrf::cache::message_key;
+
+namespace {
+
+/**
+ * A scratch directory for a cache, removed again afterwards.
+ */
+struct scratch_directory {
+    std::string path;
+
+    scratch_directory() : path{} {
+        char pattern[] = "/tmp/rmrf-cache-test.XXXXXX";
+        BOOST_REQUIRE(mkdtemp(pattern));
+        this->path = pattern;
+    }
+
+    ~scratch_directory() {
+        std::filesystem::remove_all(this->path);
+    }
+
+    scratch_directory(const scratch_directory &) = delete;
+    scratch_directory &operator=(const scratch_directory &) = delete;
+
+    std::string cache() const {
+        return this->path + "/cache";
+    }
+};
+
+message_key key_of(uint32_t uid) {
+    return message_key{"INBOX", 1, uid};
+}
+
+std::vector<message_key> keys_of(std::initializer_list<uint32_t> uids) {
+    std::vector<message_key> keys;
+
+    for (uint32_t uid : uids) {
+        keys.push_back(key_of(uid));
+    }
+
+    return keys;
+}
+
+}
+
+BOOST_FIXTURE_TEST_CASE(bodies_persist, scratch_directory) {
+    {
+        message_cache cache{this->cache(), 1024 * 1024};
+        cache.put(key_of(1), "Subject: one\r\n\r\nbody\r\n");
+        BOOST_CHECK(cache.contains(key_of(1)));
+        BOOST_CHECK(!cache.contains(key_of(2)));
+    }
+
+    message_cache cache{this->cache(), 1024 * 1024};
+    BOOST_CHECK_EQUAL(cache.get(key_of(1)).value_or(""), "Subject: one\r\n\r\nbody\r\n");
+}
+
+BOOST_FIXTURE_TEST_CASE(prefetch_skips_cached_and_pending, scratch_directory) {
+    message_cache cache{this->cache(), 1024 * 1024};
+    std::vector<uint32_t> fetched;
+    auto fetch = [&fetched](const message_key &key) {
+        fetched.push_back(key.uid);
+    };
+
+    cache.put(key_of(2), "two");
+    cache.prefetch(keys_of({1, 2, 3}), fetch);
+    BOOST_CHECK_EQUAL(fetched.size(), 2u);
+
+    // Still in flight
+    cache.prefetch(keys_of({1, 3, 4}), fetch);
+    BOOST_REQUIRE_EQUAL(fetched.size(), 3u);
+    BOOST_CHECK_EQUAL(fetched.back(), 4u);
+
+    // Arrived, so nothing to do
+    cache.put(key_of(1), "one");
+    cache.prefetch(keys_of({1}), fetch);
+    BOOST_CHECK_EQUAL(fetched.size(), 3u);
+
+    // Given up on by the caller
+    cache.cancel_prefetch(key_of(3));
+    cache.prefetch(keys_of({3}), fetch);
+    BOOST_CHECK_EQUAL(fetched.size(), 4u);
+}
+
+BOOST_FIXTURE_TEST_CASE(prefetch_may_complete_synchronously, scratch_directory) {
+    message_cache cache{this->cache(), 1024 * 1024};
+
+    cache.prefetch(keys_of({1, 2}), [&cache](const message_key &key) {
+        cache.put(key, "body " + std::to_string(key.uid));
+    });
+
+    BOOST_CHECK(cache.contains(key_of(1)));
+    BOOST_CHECK(cache.contains(key_of(2)));
+}
+
+BOOST_FIXTURE_TEST_CASE(lost_prefetches_expire, scratch_directory) {
+    message_cache cache{this->cache(), 1024 * 1024, 64 * 1024 * 1024, std::chrono::milliseconds(20)};
+    size_t fetched = 0;
+    auto fetch = [&fetched](const message_key &) {
+        fetched++;
+    };
+
+    // The reply never comes
+    cache.prefetch(keys_of({1}), fetch);
+    cache.prefetch(keys_of({1}), fetch);
+    BOOST_CHECK_EQUAL(fetched, 1u);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(30));
+
+    cache.prefetch(keys_of({1}), fetch);
+    BOOST_CHECK_EQUAL(fetched, 2u);
+
+    // A late reply is still taken
+    cache.put(key_of(1), "one");
+    BOOST_CHECK(cache.contains(key_of(1)));
+}
@@ -0,0 +1,228 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE prefix_table
+#include <boost/test/unit_test.hpp>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+
+#include <string>
+
+#include "net/address.hpp"
+#include "net/prefix_table.hpp"
+
+using rmrf::net::make_prefix_key;
+using rmrf::net::parse_cidr;
+using rmrf::net::prefix_key_t;
+using rmrf::net::prefix_table;
+
+namespace {
+
+prefix_key_t key_of(const std::string &text) {
+    prefix_key_t key = 0;
+    uint8_t prefix_length = 0;
+
+    BOOST_REQUIRE(parse_cidr(text, key, prefix_length));
+
+    return key;
+}
+
+int lookup(const prefix_table<int> &table, const std::string &address) {
+    const int *value = table.lookup(key_of(address));
+
+    return value ? *value : -1;
+}
+
+}
+
+BOOST_AUTO_TEST_CASE(parse_networks) {
+    prefix_key_t key = 0;
+    uint8_t prefix_length = 0;
+
+    BOOST_CHECK(parse_cidr("192.0.2.0/24", key, prefix_length));
+    BOOST_CHECK(key == make_prefix_key("192.0.2.0"_ip4));
+    BOOST_CHECK_EQUAL(prefix_length, 96 + 24);
+
+    // Host bits are cleared
+    BOOST_CHECK(parse_cidr("192.0.2.77/24", key, prefix_length));
+    BOOST_CHECK(key == make_prefix_key("192.0.2.0"_ip4));
+
+    BOOST_CHECK(parse_cidr("2001:db8::1/32", key, prefix_length));
+    BOOST_CHECK(key == make_prefix_key("2001:db8::"_ip6));
+    BOOST_CHECK_EQUAL(prefix_length, 32);
+
+    // Plain addresses are host routes
+    BOOST_CHECK(parse_cidr("192.0.2.1", key, prefix_length));
+    BOOST_CHECK_EQUAL(prefix_length, 128);
+    BOOST_CHECK(parse_cidr("::1", key, prefix_length));
+    BOOST_CHECK_EQUAL(prefix_length, 128);
+
+    BOOST_CHECK(parse_cidr("0.0.0.0/0", key, prefix_length));
+    BOOST_CHECK_EQUAL(prefix_length, 96);
+    BOOST_CHECK(parse_cidr("::/0", key, prefix_length));
+    BOOST_CHECK(key == 0);
+    BOOST_CHECK_EQUAL(prefix_length, 0);
+}
+
+BOOST_AUTO_TEST_CASE(parse_invalid_networks) {
+    prefix_key_t key = 0;
+    uint8_t prefix_length = 0;
+
+    for (const char *text : {"", "/24", "192.0.2.0/", "192.0.2.0/33", "2001:db8::/129", "192.0.2.0/-1",
+            "192.0.2.0/2x", "192.0.2.0/0024", "192.0.2", "example.org", "2001:db8::/32/1"}) {
+        BOOST_CHECK_MESSAGE(!parse_cidr(text, key, prefix_length), text);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(network_literals) {
+    constexpr auto net4 = "192.0.2.0/24"_cidr4;
+    constexpr auto net6 = "2001:db8::/32"_cidr6;
+
+    static_assert(net4.prefix_length == 24);
+    static_assert(net6.prefix_length == 32);
+
+    BOOST_CHECK(net4.contains("192.0.2.255"_ip4));
+    BOOST_CHECK(!net4.contains("192.0.3.0"_ip4));
+    BOOST_CHECK(net6.contains("2001:db8:ffff::1"_ip6));
+    BOOST_CHECK(!net6.contains("2001:db9::"_ip6));
+
+    BOOST_CHECK("0.0.0.0/0"_cidr4.contains("198.51.100.1"_ip4));
+    BOOST_CHECK("::/0"_cidr6.contains("2001:db8::1"_ip6));
+
+    // The literals agree with the runtime parser
+    prefix_key_t key = 0;
+    uint8_t prefix_length = 0;
+
+    BOOST_REQUIRE(parse_cidr("192.0.2.0/24", key, prefix_length));
+    BOOST_CHECK(key == make_prefix_key(net4.address));
+    BOOST_REQUIRE(parse_cidr("2001:db8::/32", key, prefix_length));
+    BOOST_CHECK(key == make_prefix_key(net6.address));
+}
+
+BOOST_AUTO_TEST_CASE(longest_prefix_wins) {
+    prefix_table<int> table;
+
+    table.insert("10.0.0.0/8"_cidr4, 8);
+    table.insert("10.1.0.0/16"_cidr4, 16);
+    table.insert("10.1.2.0/24"_cidr4, 24);
+    table.insert(key_of("10.1.2.3"), 128, 32);
+
+    BOOST_CHECK_EQUAL(table.size(), 4u);
+    BOOST_CHECK_EQUAL(lookup(table, "10.1.2.3"), 32);
+    BOOST_CHECK_EQUAL(lookup(table, "10.1.2.4"), 24);
+    BOOST_CHECK_EQUAL(lookup(table, "10.1.3.4"), 16);
+    BOOST_CHECK_EQUAL(lookup(table, "10.2.3.4"), 8);
+    BOOST_CHECK_EQUAL(lookup(table, "11.0.0.0"), -1);
+
+    // Insertion order does not matter
+    prefix_table<int> reversed;
+
+    reversed.insert(key_of("10.1.2.3"), 128, 32);
+    reversed.insert("10.1.2.0/24"_cidr4, 24);
+    reversed.insert("10.1.0.0/16"_cidr4, 16);
+    reversed.insert("10.0.0.0/8"_cidr4, 8);
+
+    for (const char *address : {"10.1.2.3", "10.1.2.4", "10.1.3.4", "10.2.3.4", "11.0.0.0"}) {
+        BOOST_CHECK_EQUAL(lookup(reversed, address), lookup(table, address));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(sibling_networks) {
+    prefix_table<int> table;
+
+    table.insert("192.0.2.0/25"_cidr4, 1);
+    table.insert("192.0.2.128/25"_cidr4, 2);
+    table.insert("198.51.100.0/24"_cidr4, 3);
+
+    BOOST_CHECK_EQUAL(lookup(table, "192.0.2.127"), 1);
+    BOOST_CHECK_EQUAL(lookup(table, "192.0.2.128"), 2);
+    BOOST_CHECK_EQUAL(lookup(table, "198.51.100.200"), 3);
+    BOOST_CHECK_EQUAL(lookup(table, "192.0.3.0"), -1);
+}
+
+BOOST_AUTO_TEST_CASE(ipv4_and_ipv6_share_a_table) {
+    prefix_table<int> table;
+
+    table.insert("192.0.2.0/24"_cidr4, 4);
+    table.insert("2001:db8::/32"_cidr6, 6);
+
+    BOOST_CHECK_EQUAL(lookup(table, "192.0.2.1"), 4);
+    BOOST_CHECK_EQUAL(lookup(table, "2001:db8::1"), 6);
+    BOOST_CHECK_EQUAL(lookup(table, "2001:db9::1"), -1);
+
+    // IPv4 clients of a dual stack socket match their IPv4 networks
+    BOOST_CHECK_EQUAL(lookup(table, "::ffff:192.0.2.1"), 4);
+
+    struct sockaddr_in in{};
+    in.sin_family = AF_INET;
+    in.sin_addr = "192.0.2.9"_ip4;
+    const int *value = table.lookup(reinterpret_cast<const struct sockaddr *>(&in));
+    BOOST_REQUIRE(value);
+    BOOST_CHECK_EQUAL(*value, 4);
+
+    struct sockaddr_in6 in6{};
+    in6.sin6_family = AF_INET6;
+    in6.sin6_addr = "2001:db8:1::"_ip6;
+    value = table.lookup(reinterpret_cast<const struct sockaddr *>(&in6));
+    BOOST_REQUIRE(value);
+    BOOST_CHECK_EQUAL(*value, 6);
+
+    struct sockaddr local{};
+    local.sa_family = AF_UNIX;
+    BOOST_CHECK(!table.lookup(&local));
+}
+
+BOOST_AUTO_TEST_CASE(default_route) {
+    prefix_table<int> table;
+
+    table.insert(0, 0, 0);
+    table.insert("192.0.2.0/24"_cidr4, 24);
+
+    BOOST_CHECK_EQUAL(lookup(table, "2001:db8::1"), 0);
+    BOOST_CHECK_EQUAL(lookup(table, "192.0.2.1"), 24);
+}
+
+BOOST_AUTO_TEST_CASE(replace_and_remove) {
+    prefix_table<int> table;
+
+    table.insert("10.0.0.0/8"_cidr4, 8);
+    table.insert("10.1.0.0/16"_cidr4, 16);
+    table.insert("10.1.0.0/16"_cidr4, 17);
+
+    BOOST_CHECK_EQUAL(table.size(), 2u);
+    BOOST_CHECK_EQUAL(lookup(table, "10.1.0.1"), 17);
+
+    // Only the exact network goes, the covering one matches again
+    table.remove(key_of("10.1.0.0"), 96 + 16);
+    BOOST_CHECK_EQUAL(table.size(), 1u);
+    BOOST_CHECK_EQUAL(lookup(table, "10.1.0.1"), 8);
+
+    // Networks not in the table are ignored
+    table.remove(key_of("10.2.0.0"), 96 + 16);
+    table.remove(key_of("10.0.0.0"), 96 + 4);
+    BOOST_CHECK_EQUAL(table.size(), 1u);
+
+    table.remove(key_of("10.0.0.0"), 96 + 8);
+    BOOST_CHECK_EQUAL(table.size(), 0u);
+    BOOST_CHECK_EQUAL(lookup(table, "10.1.0.1"), -1);
+
+    table.insert("10.1.0.0/16"_cidr4, 16);
+    table.clear();
+    BOOST_CHECK_EQUAL(table.size(), 0u);
+    BOOST_CHECK_EQUAL(lookup(table, "10.1.0.1"), -1);
+}
+
+BOOST_AUTO_TEST_CASE(many_networks) {
+    prefix_table<int> table;
+
+    for (int i = 0; i < 256; i++) {
+        table.insert(key_of("10." + std::to_string(i) + ".0.0"), 96 + 16, i);
+    }
+
+    BOOST_CHECK_EQUAL(table.size(), 256u);
+
+    for (int i = 0; i < 256; i++) {
+        BOOST_CHECK_EQUAL(lookup(table, "10." + std::to_string(i) + ".1.2"), i);
+    }
+
+    BOOST_CHECK_EQUAL(lookup(table, "11.0.0.0"), -1);
+}
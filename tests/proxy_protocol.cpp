@@ -0,0 +1,258 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE proxy_protocol
+#include <boost/test/unit_test.hpp>
+
+#include <sys/socket.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "net/proxy_protocol.hpp"
+
+using rmrf::net::parse_proxy_header;
+using rmrf::net::proxy_header;
+using rmrf::net::proxy_parse_status;
+
+namespace {
+
+typedef std::vector<uint8_t> bytes;
+
+proxy_parse_status parse(const bytes &data, proxy_header &header) {
+    return parse_proxy_header(data.data(), data.size(), header);
+}
+
+proxy_parse_status parse(const std::string &text, proxy_header &header) {
+    return parse(bytes(text.begin(), text.end()), header);
+}
+
+/**
+ * A v2 header with the given command, family and transport and payload.
+ */
+bytes v2(uint8_t command, uint8_t family_transport, const bytes &payload) {
+    bytes data{0x0d, 0x0a, 0x0d, 0x0a, 0x00, 0x0d, 0x0a, 0x51, 0x55, 0x49, 0x54, 0x0a};
+    data.push_back(static_cast<uint8_t>(0x20 | command));
+    data.push_back(family_transport);
+    data.push_back(static_cast<uint8_t>(payload.size() >> 8));
+    data.push_back(static_cast<uint8_t>(payload.size()));
+    data.insert(data.end(), payload.begin(), payload.end());
+
+    return data;
+}
+
+const bytes v2_tcp4_addresses{
+    192, 0, 2, 1,
+    198, 51, 100, 2,
+    0x30, 0x39,
+    0x00, 0x18
+};
+
+/**
+ * Every prefix of a valid header has to ask for more data.
+ */
+void check_prefixes(const bytes &data) {
+    for (size_t length = 0; length < data.size(); length++) {
+        proxy_header header{};
+        BOOST_CHECK_MESSAGE(parse_proxy_header(data.data(), length, header) == proxy_parse_status::incomplete,
+            "prefix of " << length << " bytes");
+    }
+}
+
+}
+
+BOOST_AUTO_TEST_CASE(v1_tcp4) {
+    const std::string text = "PROXY TCP4 192.0.2.1 198.51.100.2 12345 24\r\n";
+    proxy_header header{};
+
+    // Data of the client following the header is not part of it
+    BOOST_REQUIRE(parse(text + "LHLO example.org\r\n", header) == proxy_parse_status::done);
+    BOOST_CHECK(!header.local);
+    BOOST_CHECK(header.has_addresses);
+    BOOST_CHECK_EQUAL(header.length, text.size());
+    BOOST_CHECK_EQUAL(header.source.family(), AF_INET);
+    BOOST_CHECK_EQUAL(header.source.str(), "192.0.2.1");
+    BOOST_CHECK_EQUAL(header.source.port(), 12345);
+    BOOST_CHECK_EQUAL(header.destination.str(), "198.51.100.2");
+    BOOST_CHECK_EQUAL(header.destination.port(), 24);
+
+    check_prefixes(bytes(text.begin(), text.end()));
+}
+
+BOOST_AUTO_TEST_CASE(v1_tcp6) {
+    const std::string text = "PROXY TCP6 2001:db8::1 2001:db8::2 65535 24\r\n";
+    proxy_header header{};
+
+    BOOST_REQUIRE(parse(text, header) == proxy_parse_status::done);
+    BOOST_CHECK(header.has_addresses);
+    BOOST_CHECK_EQUAL(header.length, text.size());
+    BOOST_CHECK_EQUAL(header.source.family(), AF_INET6);
+    BOOST_CHECK_EQUAL(header.source.str(), "2001:db8::1");
+    BOOST_CHECK_EQUAL(header.source.port(), 65535);
+    BOOST_CHECK_EQUAL(header.destination.str(), "2001:db8::2");
+}
+
+BOOST_AUTO_TEST_CASE(v1_unknown) {
+    proxy_header header{};
+
+    BOOST_REQUIRE(parse(std::string("PROXY UNKNOWN\r\n"), header) == proxy_parse_status::done);
+    BOOST_CHECK(!header.has_addresses);
+    BOOST_CHECK_EQUAL(header.length, 15u);
+
+    // The rest of the line is to be ignored for UNKNOWN
+    BOOST_REQUIRE(parse(std::string("PROXY UNKNOWN ffff:f...f:ffff ffff:f...f:ffff 65535 65535\r\n"), header) ==
+        proxy_parse_status::done);
+    BOOST_CHECK(!header.has_addresses);
+}
+
+BOOST_AUTO_TEST_CASE(v1_invalid) {
+    for (const char *text : {
+            "PROXY TCP4 192.0.2.1 198.51.100.2 12345\r\n",
+            "PROXY TCP4 192.0.2.1 198.51.100.2 12345 24 1\r\n",
+            "PROXY TCP4 2001:db8::1 198.51.100.2 12345 24\r\n",
+            "PROXY TCP6 192.0.2.1 2001:db8::2 12345 24\r\n",
+            "PROXY TCP4 192.0.2.1 198.51.100.2 65536 24\r\n",
+            "PROXY TCP4 192.0.2.1 198.51.100.2 012 24\r\n",
+            "PROXY TCP4 192.0.2.1 198.51.100.2 -1 24\r\n",
+            "PROXY TCP4  192.0.2.1 198.51.100.2 12345 24\r\n",
+            "PROXY UDP4 192.0.2.1 198.51.100.2 12345 24\r\n",
+            "PROXY\r\n",
+            "proxy TCP4 192.0.2.1 198.51.100.2 12345 24\r\n",
+            "LHLO example.org\r\n"}) {
+        proxy_header header{};
+        BOOST_CHECK_MESSAGE(parse(std::string(text), header) == proxy_parse_status::invalid, text);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(v1_oversized) {
+    // The longest header allowed just fits
+    std::string text = "PROXY UNKNOWN ";
+    text.append(rmrf::net::proxy_v1_max_length - text.size() - 2, 'x');
+    text += "\r\n";
+    proxy_header header{};
+
+    BOOST_CHECK(parse(text, header) == proxy_parse_status::done);
+
+    // One more byte and the line end is out of reach
+    text.insert(text.size() - 2, "x");
+    BOOST_CHECK(parse(text, header) == proxy_parse_status::invalid);
+    BOOST_CHECK(parse(text.substr(0, rmrf::net::proxy_v1_max_length), header) == proxy_parse_status::invalid);
+    BOOST_CHECK(parse(text.substr(0, rmrf::net::proxy_v1_max_length - 1), header) == proxy_parse_status::incomplete);
+}
+
+BOOST_AUTO_TEST_CASE(v2_proxy_tcp4) {
+    const bytes data = v2(1, 0x11, v2_tcp4_addresses);
+    proxy_header header{};
+
+    BOOST_REQUIRE(parse(data, header) == proxy_parse_status::done);
+    BOOST_CHECK(!header.local);
+    BOOST_CHECK(header.has_addresses);
+    BOOST_CHECK_EQUAL(header.length, 28u);
+    BOOST_CHECK_EQUAL(header.source.str(), "192.0.2.1");
+    BOOST_CHECK_EQUAL(header.source.port(), 12345);
+    BOOST_CHECK_EQUAL(header.destination.str(), "198.51.100.2");
+    BOOST_CHECK_EQUAL(header.destination.port(), 24);
+
+    check_prefixes(data);
+}
+
+BOOST_AUTO_TEST_CASE(v2_proxy_tcp6) {
+    bytes payload{0x20, 0x01, 0x0d, 0xb8, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x01};
+    payload.insert(payload.end(), {0x20, 0x01, 0x0d, 0xb8, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x02});
+    payload.insert(payload.end(), {0xff, 0xff, 0x00, 0x18});
+    proxy_header header{};
+
+    BOOST_REQUIRE(parse(v2(1, 0x21, payload), header) == proxy_parse_status::done);
+    BOOST_CHECK(header.has_addresses);
+    BOOST_CHECK_EQUAL(header.length, 52u);
+    BOOST_CHECK_EQUAL(header.source.family(), AF_INET6);
+    BOOST_CHECK_EQUAL(header.source.str(), "2001:db8::1");
+    BOOST_CHECK_EQUAL(header.source.port(), 65535);
+    BOOST_CHECK_EQUAL(header.destination.str(), "2001:db8::2");
+    BOOST_CHECK_EQUAL(header.destination.port(), 24);
+
+    // The addresses have to fit into the announced length
+    payload.resize(35);
+    BOOST_CHECK(parse(v2(1, 0x21, payload), header) == proxy_parse_status::invalid);
+}
+
+BOOST_AUTO_TEST_CASE(v2_local) {
+    proxy_header header{};
+
+    // Health checks of the balancer carry no addresses
+    BOOST_REQUIRE(parse(v2(0, 0x00, {}), header) == proxy_parse_status::done);
+    BOOST_CHECK(header.local);
+    BOOST_CHECK(!header.has_addresses);
+    BOOST_CHECK_EQUAL(header.length, 16u);
+
+    // Addresses sent along with LOCAL are to be ignored
+    BOOST_REQUIRE(parse(v2(0, 0x11, v2_tcp4_addresses), header) == proxy_parse_status::done);
+    BOOST_CHECK(header.local);
+    BOOST_CHECK(!header.has_addresses);
+    BOOST_CHECK_EQUAL(header.length, 28u);
+}
+
+BOOST_AUTO_TEST_CASE(v2_other_protocols) {
+    proxy_header header{};
+
+    // UDP and UNIX sockets keep the balancer as peer, but are skipped
+    BOOST_REQUIRE(parse(v2(1, 0x12, v2_tcp4_addresses), header) == proxy_parse_status::done);
+    BOOST_CHECK(!header.has_addresses);
+    BOOST_CHECK_EQUAL(header.length, 28u);
+
+    BOOST_REQUIRE(parse(v2(1, 0x31, bytes(216, 0)), header) == proxy_parse_status::done);
+    BOOST_CHECK(!header.has_addresses);
+    BOOST_CHECK_EQUAL(header.length, 232u);
+}
+
+BOOST_AUTO_TEST_CASE(v2_tlvs) {
+    bytes payload = v2_tcp4_addresses;
+
+    // PP2_TYPE_AUTHORITY "mx.example.org" and PP2_TYPE_NOOP padding
+    payload.insert(payload.end(), {0x02, 0x00, 0x0e});
+    payload.insert(payload.end(), {'m', 'x', '.', 'e', 'x', 'a', 'm', 'p', 'l', 'e', '.', 'o', 'r', 'g'});
+    payload.insert(payload.end(), {0x04, 0x00, 0x03, 0, 0, 0});
+
+    bytes data = v2(1, 0x11, payload);
+    const size_t header_length = data.size();
+    data.insert(data.end(), {'L', 'H', 'L', 'O'});
+    proxy_header header{};
+
+    BOOST_REQUIRE(parse(data, header) == proxy_parse_status::done);
+    BOOST_CHECK(header.has_addresses);
+    BOOST_CHECK_EQUAL(header.length, header_length);
+    BOOST_CHECK_EQUAL(header.source.str(), "192.0.2.1");
+
+    check_prefixes(bytes(data.begin(), data.begin() + static_cast<ptrdiff_t>(header_length)));
+}
+
+BOOST_AUTO_TEST_CASE(v2_invalid) {
+    proxy_header header{};
+
+    // Unknown version and command
+    bytes data = v2(1, 0x11, v2_tcp4_addresses);
+    data[12] = 0x11;
+    BOOST_CHECK(parse(data, header) == proxy_parse_status::invalid);
+    BOOST_CHECK(parse(v2(2, 0x11, v2_tcp4_addresses), header) == proxy_parse_status::invalid);
+
+    // Addresses cut short by the announced length
+    BOOST_CHECK(parse(v2(1, 0x11, bytes(v2_tcp4_addresses.begin(), v2_tcp4_addresses.end() - 1)), header) ==
+        proxy_parse_status::invalid);
+
+    // A broken signature
+    data = v2(1, 0x11, v2_tcp4_addresses);
+    data[5] = 0x00;
+    BOOST_CHECK(parse(data, header) == proxy_parse_status::invalid);
+    BOOST_CHECK(parse_proxy_header(data.data(), 6, header) == proxy_parse_status::invalid);
+}
+
+BOOST_AUTO_TEST_CASE(v2_oversized) {
+    const size_t limit = rmrf::net::proxy_max_length - 16;
+    proxy_header header{};
+
+    BOOST_CHECK(parse(v2(1, 0x11, bytes(limit, 0)), header) == proxy_parse_status::done);
+
+    // Rejected as soon as the length is known, not after waiting for the rest
+    const bytes data = v2(1, 0x11, bytes(limit + 1, 0));
+    BOOST_CHECK(parse_proxy_header(data.data(), 16, header) == proxy_parse_status::invalid);
+    BOOST_CHECK(parse(v2(1, 0x11, bytes(65535, 0)), header) == proxy_parse_status::invalid);
+}